@@ -69,6 +69,8 @@ BACKEND_SRC_FILES:= \
     backend/program.cpp \
     backend/program.hpp \
     backend/program.h \
+    backend/program_cache.cpp \
+    backend/program_cache.hpp \
     llvm/llvm_sampler_fix.cpp \
     llvm/llvm_bitcode_link.cpp \
     llvm/llvm_gen_backend.cpp \
@@ -35,10 +35,16 @@
 
 namespace gbe
 {
+  /*! Allocator of a fixed size space tracked with a bitmap of the free units.
+   *  Allocations from the beginning take the smallest free range where they
+   *  fit, which keeps the large ranges for the vectors. Allocations from the
+   *  end take the highest free range, the register allocator uses them to
+   *  place a register in the other half of the register file.
+   */
   class SimpleAllocator
   {
   public:
-    SimpleAllocator(int32_t startOffset, int32_t size);
+    SimpleAllocator(int32_t startOffset, int32_t size, int32_t granularity);
     ~SimpleAllocator(void);
 
     /*! Allocate some memory from the pool.
@@ -56,29 +62,27 @@ namespace gbe
     void splitBlock(int32_t offset, int32_t subOffset);
 
   protected:
-    /*! Double chained list of free spaces */
-    struct Block {
-      Block(int32_t offset, int32_t size) :
-        prev(NULL), next(NULL), offset(offset), size(size) {}
-      Block *prev, *next; //!< Previous and next free blocks
-      int32_t offset;        //!< Where the free block starts
-      int32_t size;          //!< Size of the free block
-    };
-
-    /*! Try to coalesce two blocks (left and right). They must be in that order.
-     *  If the colascing was done, the left block is deleted
-     */
-    void coalesce(Block *left, Block *right);
+    typedef uint64_t Word;
+    enum { wordBits = 64 };
+    /*! First free unit from the given one, unitNum if there is none */
+    int32_t nextFree(int32_t unit) const;
+    /*! First allocated unit from the given one, unitNum if there is none */
+    int32_t nextUsed(int32_t unit) const;
+    /*! Mark a range of units as free or allocated */
+    void setRange(int32_t first, int32_t num, bool isFree);
     void dumpFreeList();
     /*! the maximum offset */
     int32_t maxOffset;
-    /*! Head and tail of the free list */
-    Block *head;
-    Block *tail;
-    /*! Handle free list element allocation */
-    DECL_POOL(Block, blockPool);
-    /*! Track allocated memory blocks <offset, size> */
-    map<int32_t, int32_t> allocatedBlocks;
+    /*! Offset of the first unit */
+    int32_t startOffset;
+    /*! Size in bytes of one unit */
+    int32_t granularity;
+    /*! Number of units of the space */
+    int32_t unitNum;
+    /*! One bit per unit, set when the unit is free */
+    vector<Word> freeUnits;
+    /*! Number of units of the allocated block starting at each unit */
+    vector<int32_t> blockUnits;
     /*! Use custom allocators */
     GBE_CLASS(SimpleAllocator);
   };
@@ -88,12 +92,13 @@ namespace gbe
    *  simulator and hardware have to deal with constant pushing which uses the
    *  register file
    *
-   *  Since Gen is pretty flexible, we just reuse the Simpleallocator
+   *  Since Gen is pretty flexible, we just reuse the Simpleallocator with one
+   *  unit per byte
    */
 
   class RegisterAllocator: public SimpleAllocator {
   public:
-    RegisterAllocator(int32_t offset, int32_t size): SimpleAllocator(offset, size) {}
+    RegisterAllocator(int32_t offset, int32_t size): SimpleAllocator(offset, size, 1) {}
 
     GBE_CLASS(RegisterAllocator);
   };
@@ -105,236 +110,156 @@ namespace gbe
 
   class ScratchAllocator: public SimpleAllocator {
   public:
-    ScratchAllocator(int32_t size): SimpleAllocator(0, size) {}
+    ScratchAllocator(int32_t size): SimpleAllocator(0, size, 32) {}
     int32_t getMaxScatchMemUsed() { return maxOffset; }
 
     GBE_CLASS(ScratchAllocator);
   };
 
   SimpleAllocator::SimpleAllocator(int32_t startOffset,
-                                   int32_t size)
-                                  : maxOffset(0) {
-    tail = head = this->newBlock(startOffset, size);
+                                   int32_t size,
+                                   int32_t granularity)
+                                  : maxOffset(0), startOffset(startOffset),
+                                    granularity(granularity),
+                                    unitNum(size / granularity) {
+    // The bits after the last unit stay cleared, they are never free
+    freeUnits.resize((unitNum + wordBits - 1) / wordBits, 0);
+    blockUnits.resize(unitNum, 0);
+    setRange(0, unitNum, true);
+  }
+
+  SimpleAllocator::~SimpleAllocator(void) {}
+
+  int32_t SimpleAllocator::nextFree(int32_t unit) const {
+    if (unit >= unitNum)
+      return unitNum;
+    uint32_t wordID = unit / wordBits;
+    Word word = freeUnits[wordID] & (~Word(0) << (unit % wordBits));
+    while (word == 0) {
+      if (++wordID == freeUnits.size())
+        return unitNum;
+      word = freeUnits[wordID];
+    }
+    return wordID * wordBits + __builtin_ctzll(word);
   }
 
-  SimpleAllocator::~SimpleAllocator(void) {
-    while (this->head) {
-      Block *next = this->head->next;
-      this->deleteBlock(this->head);
-      this->head = next;
+  int32_t SimpleAllocator::nextUsed(int32_t unit) const {
+    if (unit >= unitNum)
+      return unitNum;
+    uint32_t wordID = unit / wordBits;
+    Word word = ~freeUnits[wordID] & (~Word(0) << (unit % wordBits));
+    while (word == 0) {
+      if (++wordID == freeUnits.size())
+        return unitNum;
+      word = ~freeUnits[wordID];
+    }
+    return std::min(unitNum, int32_t(wordID * wordBits + __builtin_ctzll(word)));
+  }
+
+  void SimpleAllocator::setRange(int32_t first, int32_t num, bool isFree) {
+    while (num > 0) {
+      const uint32_t bit = first % wordBits;
+      const uint32_t count = std::min(num, int32_t(wordBits - bit));
+      const Word mask = (count == wordBits ? ~Word(0) : ((Word(1) << count) - 1)) << bit;
+      if (isFree)
+        freeUnits[first / wordBits] |= mask;
+      else
+        freeUnits[first / wordBits] &= ~mask;
+      first += count;
+      num -= count;
     }
   }
 
   void SimpleAllocator::dumpFreeList() {
-    Block *s = head;
     printf("register free list:\n");
-    while (s) {
-      printf("blk: %d(r%d.%d) (%d)\n", s->offset, s->offset/GEN_REG_SIZE, s->offset % GEN_REG_SIZE, s->size);
-      s = s->next;
+    for (int32_t first = nextFree(0); first < unitNum; ) {
+      const int32_t end = nextUsed(first);
+      const int32_t offset = startOffset + first * granularity;
+      printf("blk: %d(r%d.%d) (%d)\n", offset, offset/GEN_REG_SIZE, offset % GEN_REG_SIZE, (end - first) * granularity);
+      first = nextFree(end);
     }
     printf("free list end\n");
   }
 
   bool SimpleAllocator::isSuperRegisterFree(int32_t offset) {
     assert((offset % GEN_REG_SIZE) == 0);
-    Block *s = head;
-    while (s) {
-      if (s->offset <= offset && (s->offset+s->size) >= offset+GEN_REG_SIZE) {
-        return true;
-      }
-      if (s->offset > offset)
-        return false;
-      s = s->next;
-    }
-    return false;
+    if (offset < startOffset || offset + GEN_REG_SIZE > startOffset + unitNum * granularity)
+      return false;
+    const int32_t first = (offset - startOffset) / granularity;
+    return nextUsed(first) >= first + std::max(GEN_REG_SIZE / granularity, 1);
   }
 
   int32_t SimpleAllocator::allocate(int32_t size, int32_t alignment, bool bFwd)
   {
-    // Make it simple and just use the first block we find
-    Block *list = bFwd ? head : tail;
-    while (list) {
+    const int32_t units = (size + granularity - 1) / granularity;
+    const int32_t bytes = units * granularity;
+    int32_t best = -1, bestUnits = 0;
+
+    // Walk the free ranges
+    for (int32_t first = nextFree(0); first < unitNum; ) {
+      const int32_t end = nextUsed(first);
+      const int32_t begin = startOffset + first * granularity;
+      const int32_t limit = startOffset + end * granularity;
       int32_t aligned;
-      int32_t spaceOnLeft;
-      int32_t spaceOnRight;
-      if(bFwd) {
-        aligned = ALIGN(list->offset, alignment);
-        spaceOnLeft = aligned - list->offset;
-        spaceOnRight = list->size - size - spaceOnLeft;
-
-      // Not enough space in this block
-        if (spaceOnRight < 0) {
-          list = list->next;
-          continue;
-        }
-      } else {
-        int32_t unaligned = list->offset + list->size - size - (alignment-1);
-        if(unaligned < 0) {
-          list = list->prev;
-          continue;
-        }
-        aligned = ALIGN(unaligned, alignment);   //alloc from block's tail
-        spaceOnLeft = aligned - list->offset;
-        spaceOnRight = list->size - size - spaceOnLeft;
-
-        // Not enough space in this block
-        if (spaceOnLeft < 0) {
-          list = list->prev;
-          continue;
-        }
-      }
-
-      // Cool we can use this block
-      Block *left = list->prev;
-      Block *right = list->next;
-
-      // If we left a hole on the left, create a new block
-      if (spaceOnLeft) {
-        Block *newBlock = this->newBlock(list->offset, spaceOnLeft);
-        if (left) {
-          left->next = newBlock;
-          newBlock->prev = left;
-        }
-        if (right) {
-          newBlock->next = right;
-          right->prev = newBlock;
-        }
-        left = newBlock;
+      if (bFwd)
+        aligned = ALIGN(begin, alignment);
+      else {
+        const int32_t unaligned = limit - bytes - (alignment-1);
+        aligned = unaligned < 0 ? -1 : ALIGN(unaligned, alignment);   //alloc from block's tail
       }
-
-      // If we left a hole on the right, create a new block as well
-      if (spaceOnRight) {
-        Block *newBlock = this->newBlock(aligned + size, spaceOnRight);
-        if (left) {
-          left->next = newBlock;
-          newBlock->prev = left;
+      if (aligned >= begin && aligned + bytes <= limit) {
+        if (!bFwd)
+          best = aligned;  // the last range is the highest one
+        else if (best == -1 || end - first < bestUnits) {
+          best = aligned;
+          bestUnits = end - first;
+          if (bestUnits == units)
+            break;
         }
-        if (right) {
-          right->prev = newBlock;
-          newBlock->next = right;
-        }
-        right = newBlock;
-      }
-
-      // Chain both successors and predecessors when the entire block was
-      // allocated
-      if (spaceOnLeft == 0 && spaceOnRight == 0) {
-        if (left) left->next = right;
-        if (right) right->prev = left;
       }
-
-      // Update the head of the free blocks
-      if (list == head) {
-        if (left)
-          head = left;
-        else if (right)
-          head = right;
-        else
-          head = NULL;
-      }
-
-      // Update the tail of the free blocks
-      if (list == tail) {
-        if (right)
-          tail = right;
-        else if (left)
-          tail = left;
-        else
-          tail = NULL;
-      }
-      // Free the block and check the consistency
-      this->deleteBlock(list);
-      if (head && head->next) GBE_ASSERT(head->next->prev == head);
-      if (tail && tail->prev) GBE_ASSERT(tail->prev->next == tail);
-
-      // Track the allocation to retrieve the size later
-      allocatedBlocks.insert(std::make_pair(aligned, size));
-      // update max offset
-      if(aligned + size > maxOffset) maxOffset = aligned + size;
-      // We have a valid offset now
-      return aligned;
+      first = nextFree(end);
     }
-    return -1;
+    if (best == -1)
+      return -1;
+
+    const int32_t first = (best - startOffset) / granularity;
+    GBE_ASSERT((best - startOffset) % granularity == 0);
+    setRange(first, units, false);
+    // Track the allocation to retrieve the size later
+    blockUnits[first] = units;
+    // update max offset
+    if(best + bytes > maxOffset) maxOffset = best + bytes;
+    return best;
   }
 
   void SimpleAllocator::deallocate(int32_t offset)
   {
-    // Retrieve the size in the allocation map
-    auto it = allocatedBlocks.find(offset);
-    GBE_ASSERT(it != allocatedBlocks.end());
-    const int32_t size = it->second;
-
-    // Find the two blocks where to insert the new block
-    Block *list = tail, *next = NULL;
-    while (list != NULL) {
-      if (list->offset < offset)
-        break;
-      next = list;
-      list = list->prev;
-    }
-
-    // Create the block and insert it
-    Block *newBlock = this->newBlock(offset, size);
-    if (list) {
-      GBE_ASSERT(list->offset + list->size <= offset);
-      list->next = newBlock;
-      newBlock->prev = list;
-    } else
-      this->head = newBlock;  // list is NULL means newBlock should be the head.
-
-    if (next) {
-      GBE_ASSERT(offset + size <= next->offset);
-      next->prev = newBlock;
-      newBlock->next = next;
-    } else
-      this->tail = newBlock;  // next is NULL means newBlock should be the tail.
-
-    if (list != NULL || next != NULL)
-    {
-      // Coalesce the blocks if possible
-      this->coalesce(list, newBlock);
-      this->coalesce(newBlock, next);
-    }
-
+    // Retrieve the size of the allocation
+    const int32_t first = (offset - startOffset) / granularity;
+    GBE_ASSERT(first >= 0 && first < unitNum && blockUnits[first] != 0);
+    setRange(first, blockUnits[first], true);
     // Do not track this allocation anymore
-    allocatedBlocks.erase(it);
-  }
-
-  void SimpleAllocator::coalesce(Block *left, Block *right) {
-    if (left == NULL || right == NULL) return;
-    GBE_ASSERT(left->offset < right->offset);
-    GBE_ASSERT(left->next == right);
-    GBE_ASSERT(right->prev == left);
-    if (left->offset + left->size == right->offset) {
-      right->offset = left->offset;
-      right->size += left->size;
-      if (left->prev) left->prev->next = right;
-      right->prev = left->prev;
-      if (left == this->head)
-        this->head = right;
-      this->deleteBlock(left);
-    }
+    blockUnits[first] = 0;
   }
 
   void SimpleAllocator::splitBlock(int32_t offset, int32_t subOffset) {
-    // Retrieve the size in the allocation map
-    auto it = allocatedBlocks.find(offset);
-    GBE_ASSERT(it != allocatedBlocks.end());
-
-    while(subOffset > it->second) {
-      subOffset -= it->second;
-      offset += it->second;
-      it = allocatedBlocks.find(offset);
-      GBE_ASSERT(it != allocatedBlocks.end());
+    // Retrieve the size of the allocation
+    int32_t first = (offset - startOffset) / granularity;
+    int32_t subUnits = subOffset / granularity;
+    GBE_ASSERT(subOffset % granularity == 0);
+    GBE_ASSERT(first >= 0 && first < unitNum && blockUnits[first] != 0);
+
+    while(subUnits > blockUnits[first]) {
+      subUnits -= blockUnits[first];
+      first += blockUnits[first];
+      GBE_ASSERT(first < unitNum && blockUnits[first] != 0);
     }
 
-    if(subOffset == 0)
+    if(subUnits == 0 || subUnits == blockUnits[first])
       return;
-    int32_t size = it->second;
-    allocatedBlocks.erase(it);
-    // Track the allocation to retrieve the size later
-    allocatedBlocks.insert(std::make_pair(offset, subOffset));
-    allocatedBlocks.insert(std::make_pair(offset + subOffset, size - subOffset));
+    // Track both parts to free them separately
+    blockUnits[first + subUnits] = blockUnits[first] - subUnits;
+    blockUnits[first] = subUnits;
   }
 
   ///////////////////////////////////////////////////////////////////////////
@@ -390,10 +315,68 @@ namespace gbe
       this->kernel->scratchSize = this->alignScratchSize(scratchAllocator->getMaxScatchMemUsed());
       this->kernel->ctx = this;
       this->kernel->setUseDeviceEnqueue(fn.getUseDeviceEnqueue());
+      this->kernel->setPartialGroupGuard(fn.getPartialGroupGuard());
+      bool useBarrier = false;
+      fn.foreachInstruction([&](const ir::Instruction &insn) {
+        if (insn.isMemberOf<ir::SyncInstruction>() &&
+            (ir::cast<ir::SyncInstruction>(insn).getParameters() & ir::SYNC_WORKGROUP_EXEC))
+          useBarrier = true;
+      });
+      this->kernel->setUseBarrier(useBarrier);
     }
     return this->kernel;
   }
 
+  uint32_t Context::estimateRegisterPressure(uint32_t simdWidth) const {
+    auto regBytes = [&](ir::Register reg) -> uint32_t {
+      if (fn.isSpecialReg(reg))
+        return 0;
+      const ir::RegisterData data = fn.getRegisterData(reg);
+      if (data.family == ir::FAMILY_BOOL)
+        return 0; // May live in a flag register
+      const uint32_t size = ir::getFamilySize(data.family);
+      return data.isUniform() ? size : size * simdWidth;
+    };
+    uint32_t maxBytes = 0;
+    vector<const ir::Instruction*> insns;
+    fn.foreachBlock([&](const ir::BasicBlock &bb) {
+      const ir::Liveness::LiveOut &liveOut = liveness->getLiveOut(&bb);
+      std::set<ir::Register> live(liveOut.begin(), liveOut.end());
+      uint32_t bytes = 0;
+      for (auto reg : live)
+        bytes += regBytes(reg);
+      maxBytes = std::max(maxBytes, bytes);
+      insns.clear();
+      const_cast<ir::BasicBlock&>(bb).foreach([&](const ir::Instruction &insn) {
+        insns.push_back(&insn);
+      });
+      // Walk the block backward: the destinations are alive together with
+      // everything alive after the instruction
+      for (auto it = insns.rbegin(); it != insns.rend(); ++it) {
+        const ir::Instruction &insn = **it;
+        uint32_t deadDefBytes = 0;
+        for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID) {
+          const ir::Register reg = insn.getDst(dstID);
+          if (live.count(reg) == 0)
+            deadDefBytes += regBytes(reg);
+        }
+        maxBytes = std::max(maxBytes, bytes + deadDefBytes);
+        for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID) {
+          const ir::Register reg = insn.getDst(dstID);
+          if (live.erase(reg))
+            bytes -= regBytes(reg);
+        }
+        for (uint32_t srcID = 0; srcID < insn.getSrcNum(); ++srcID) {
+          const ir::Register reg = insn.getSrc(srcID);
+          if (live.insert(reg).second)
+            bytes += regBytes(reg);
+        }
+        maxBytes = std::max(maxBytes, bytes);
+      }
+    });
+    return maxBytes;
+  }
+
   int32_t Context::allocate(int32_t size, int32_t alignment, bool bFwd) {
     return registerAllocator->allocate(size, alignment, bFwd);
   }
@@ -71,6 +71,11 @@ namespace gbe
     INLINE const ir::Liveness &getLiveness(void) const { return *liveness; }
     /*! Tells if the register is used */
     bool isRegUsed(const ir::Register &reg) const;
+    /*! Estimate from the IR liveness the maximum number of bytes of register
+     *  file alive at the same time for the given SIMD width. Booleans and
+     *  special registers are ignored, so this is mostly a lower bound
+     */
+    uint32_t estimateRegisterPressure(uint32_t simdWidth) const;
     /*! Get the kernel we are currently compiling */
     INLINE Kernel *getKernel(void) const { return this->kernel; }
     /*! Get the function we are currently compiling */
@@ -78,6 +78,14 @@ namespace gbe
     this->labelPos.clear();
     this->errCode = NO_ERROR;
     this->regSpillTick = 0;
+    this->imageInfoOffsets.clear();
+  }
+
+  void GenContext::commitImageInfo(void) {
+    ir::ImageSet *imageSet = fn.getImageSet();
+    imageSet->clearInfo();
+    for (const auto &info : imageInfoOffsets)
+      imageSet->appendInfo(static_cast<ir::ImageInfoKey>(info.first), info.second);
   }
 
   void GenContext::setASMFileName(const char* asmFname) {
@@ -1979,6 +1987,54 @@ namespace gbe
     }
   }
 
+  void GenContext::emitIndirectReadInstruction(const SelectionInstruction &insn) {
+    GenRegister offset = ra->genReg(insn.src(0));
+    const GenRegister dst = ra->genReg(insn.dst(0));
+    const GenRegister tmp = ra->genReg(insn.dst(1));
+    const GenRegister a0 = GenRegister::addr8(0);
+    const uint32_t simdWidth = p->curr.execWidth;
+    const uint32_t baseRegOffset = GenRegister::grfOffset(ra->genReg(insn.src(1)));
+    const GenRegister indirect_src = GenRegister::indirect(dst.type, 0, GEN_WIDTH_1,
+                                                           GEN_VERTICAL_STRIDE_ONE_DIMENSIONAL,
+                                                           GEN_HORIZONTAL_STRIDE_0);
+
+    if (sel->isScalarReg(dst.reg())) {
+      p->push();
+        p->curr.execWidth = 1;
+        p->curr.predicate = GEN_PREDICATE_NONE;
+        p->curr.noMask = 1;
+        p->ADD(tmp, GenRegister::retype(offset, GEN_TYPE_UW), GenRegister::immuw(baseRegOffset));
+        p->MOV(a0, tmp);
+        p->MOV(dst, indirect_src);
+      p->pop();
+      return;
+    }
+
+    if(sel->isScalarReg(offset.reg()))
+      offset = GenRegister::retype(offset, GEN_TYPE_UW);
+    else
+      offset = GenRegister::unpacked_uw(offset);
+    // Every lane reads its own dword of the selected element. The disabled
+    // lanes read too, so their address is computed without mask.
+    p->push();
+      p->curr.predicate = GEN_PREDICATE_NONE;
+      p->curr.noMask = 1;
+      loadLaneID(tmp);
+      p->SHL(tmp, tmp, GenRegister::immuw(2));
+      p->ADD(tmp, tmp, offset);
+      p->ADD(tmp, tmp, GenRegister::immuw(baseRegOffset));
+    p->pop();
+
+    for (uint32_t quarter = 0; quarter < simdWidth / 8; ++quarter) {
+      p->push();
+        p->curr.execWidth = 8;
+        p->curr.quarterControl = quarter == 0 ? GEN_COMPRESSION_Q1 : GEN_COMPRESSION_Q2;
+        p->MOV(a0, GenRegister::Qn(tmp, quarter));
+        p->MOV(GenRegister::Qn(dst, quarter), indirect_src);
+      p->pop();
+    }
+  }
+
  void GenContext::insertJumpPos(const SelectionInstruction &insn) {
     const ir::LabelIndex label(insn.index);
     this->branchPos2.push_back(std::make_pair(label, p->store.size()));
@@ -2017,8 +2073,30 @@ namespace gbe
     uint32_t size = typeSize(regType);
     uint32_t regSize = stride(src.hstride)*size;
 
-    GBE_ASSERT(regSize == 4 || regSize == 8);
-    if(regSize == 4) {
+    GBE_ASSERT(regSize == 2 || regSize == 4 || regSize == 8);
+    if(regSize == 2) {
+      // Byte and word registers keep two bytes per lane, so one register is
+      // written for both SIMD widths. The block write can not mask words, the
+      // lanes of the instruction are merged with the stored register first.
+      GenRegister value = src;
+      p->push();
+        p->curr.predicate = GEN_PREDICATE_NONE;
+        p->curr.noMask = 1;
+        p->curr.execWidth = 8;
+        if (src.nr == payload.nr) {
+          // The register after the value is reserved for that copy
+          value.nr = src.nr + 1;
+          p->MOV(GenRegister::ud8grf(value.nr, 0), GenRegister::ud8grf(src.nr, 0));
+        }
+        this->scratchRead(GenRegister::ud8grf(payload.nr, 0), msg, scratchOffset, 1, GEN_TYPE_UD, GEN_SCRATCH_CHANNEL_MODE_DWORD);
+      p->pop();
+      p->MOV(payload, value);
+      p->curr.predicate = GEN_PREDICATE_NONE;
+      p->curr.noMask = 1;
+      p->curr.execWidth = 8;
+      this->scratchWrite(msg, scratchOffset, 1, GEN_TYPE_UD, GEN_SCRATCH_CHANNEL_MODE_DWORD);
+    }
+    else if(regSize == 4) {
       if (payload.nr != src.nr)
         p->MOV(payload, src);
       uint32_t regNum = (regSize*simdWidth) > 32 ? 2 : 1;
@@ -2050,8 +2128,12 @@ namespace gbe
     payload.nr = header + 1;
 
     p->push();
-    assert(regSize == 4 || regSize == 8);
-    if(regSize == 4) {
+    assert(regSize == 2 || regSize == 4 || regSize == 8);
+    if(regSize == 2) {
+      // One register holds the two bytes of every lane
+      p->curr.execWidth = 8;
+      this->scratchRead(GenRegister::ud8grf(dst.nr, 0), msg, scratchOffset, 1, GEN_TYPE_UD, GEN_SCRATCH_CHANNEL_MODE_DWORD);
+    } else if(regSize == 4) {
       uint32_t regNum = (regSize*simdWidth) > 32 ? 2 : 1;
       this->scratchRead(GenRegister::ud8grf(dst.nr, dst.subnr), msg, scratchOffset, regNum, GEN_TYPE_UD, GEN_SCRATCH_CHANNEL_MODE_DWORD);
     } else {
@@ -3632,7 +3714,7 @@ namespace gbe
     if (curbeType == GBE_CURBE_IMAGE_INFO) {
       std::sort(kernel->patches.begin(), kernel->patches.end());
       uint32_t offset = kernel->getCurbeOffset(GBE_CURBE_IMAGE_INFO, subType);
-      fn.getImageSet()->appendInfo(static_cast<ir::ImageInfoKey>(subType), offset);
+      imageInfoOffsets.push_back(std::make_pair(subType, offset));
     }
   }
 
@@ -151,6 +151,7 @@ namespace gbe
     void emitCompareInstruction(const SelectionInstruction &insn);
     void emitJumpInstruction(const SelectionInstruction &insn);
     void emitIndirectMoveInstruction(const SelectionInstruction &insn);
+    void emitIndirectReadInstruction(const SelectionInstruction &insn);
     void emitEotInstruction(const SelectionInstruction &insn);
     void emitNoOpInstruction(const SelectionInstruction &insn);
     void emitWaitInstruction(const SelectionInstruction &insn);
@@ -232,6 +233,11 @@ namespace gbe
     bool getProfilingMode(void) const { return inProfilingMode; }
     void setProfilingMode(bool b) { inProfilingMode = b; }
     CompileErrorCode getErrCode() { return errCode; }
+    /*! Write the image info curbe offsets of the last code generation into
+     *  the function image set. Several contexts may compile the same
+     *  function, only the one whose kernel is kept commits them
+     */
+    void commitImageInfo(void);
 
   protected:
     virtual GenEncoder* generateEncoder(void) {
@@ -252,6 +258,8 @@ namespace gbe
     bool inProfilingMode;
     uint32_t regSpillTick;
     const char* asmFileName;
+    /*! Image info curbe offsets (image info key, offset) */
+    vector<std::pair<int, uint32_t>> imageInfoOffsets;
     /*! Build the curbe patch list for the given kernel */
     void buildPatchList(void);
     /* Helper for printing the assembly */
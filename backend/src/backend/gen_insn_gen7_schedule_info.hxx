@@ -18,6 +18,7 @@ DECL_GEN7_SCHEDULE(I64Compare,      20,        80,      20)
 DECL_GEN7_SCHEDULE(I64DIVREM,       20,        80,      20)
 DECL_GEN7_SCHEDULE(Jump,            14,        1,        1)
 DECL_GEN7_SCHEDULE(IndirectMove,    20,        2,        2)
+DECL_GEN7_SCHEDULE(IndirectRead,    20,        8,        6)
 DECL_GEN7_SCHEDULE(Eot,             20,        1,        1)
 DECL_GEN7_SCHEDULE(NoOp,            20,        2,        2)
 DECL_GEN7_SCHEDULE(Wait,            20,        2,        2)
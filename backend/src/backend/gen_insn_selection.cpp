@@ -679,6 +679,8 @@ namespace gbe
     void SEL_CMP(uint32_t conditional, Reg dst, Reg src0, Reg src1);
     /* Constant buffer move instruction */
     void INDIRECT_MOVE(Reg dst, Reg tmp, Reg base, Reg regOffset, uint32_t immOffset);
+    /*! Read the element at byte offset regOffset of the contiguous elements */
+    void INDIRECT_READ(Reg dst, Reg tmp, Reg regOffset, const GenRegister *elems, uint32_t elemNum);
     /*! EOT is used to finish GPGPU threads */
     void EOT(void);
     /*! No-op */
@@ -1016,8 +1018,10 @@ namespace gbe
         const uint32_t srcNum = insn.srcNum, dstNum = insn.dstNum;
         struct RegSlot {
           RegSlot(ir::Register _reg, uint8_t _srcID,
-                   uint8_t _poolOffset, bool _isTmp, uint32_t _addr)
-                 : reg(_reg), srcID(_srcID), poolOffset(_poolOffset), isTmpReg(_isTmp), addr(_addr)
+                   uint8_t _poolOffset, bool _isTmp, bool _isPacked, uint32_t _addr,
+                   const SelectionInstruction *_remat)
+                 : reg(_reg), srcID(_srcID), poolOffset(_poolOffset), isTmpReg(_isTmp),
+                   isPacked(_isPacked), addr(_addr), remat(_remat)
           {};
           ir::Register reg;
           union {
@@ -1026,7 +1030,9 @@ namespace gbe
           };
           uint8_t poolOffset;
           bool isTmpReg;
+          bool isPacked;
           int32_t addr;
+          const SelectionInstruction *remat;
         };
         uint8_t poolOffset = 1; // keep one for scratch message header
         vector <struct RegSlot> regSet;
@@ -1043,9 +1049,13 @@ namespace gbe
             }
             struct RegSlot regSlot(reg, srcID, poolOffset,
                                    it->second.isTmpReg,
-                                   it->second.addr);
+                                   it->second.isPacked,
+                                   it->second.addr,
+                                   it->second.remat);
             if(family == ir::FAMILY_QWORD) {
               poolOffset += 2 * simdWidth / 8;
+            } else if (it->second.isPacked) {
+              poolOffset += 1; // two bytes per lane always fit in one register
             } else {
               poolOffset += simdWidth / 8;
             }
@@ -1063,7 +1073,20 @@ namespace gbe
           struct RegSlot regSlot = regSet.back();
           regSet.pop_back();
           const GenRegister selReg = insn.src(regSlot.srcID);
-          if (!regSlot.isTmpReg) {
+          if (regSlot.remat != NULL) {
+            /* Repeat the definition instead of reading the scratch space. */
+            const SelectionInstruction *def = regSlot.remat;
+            const GenRegister defDst = def->dst(0);
+            SelectionInstruction *mov = this->create(SEL_OP_MOV, 1, 1);
+            mov->state = GenInstructionState(simdWidth);
+            mov->state.noMask = 1;
+            mov->dst(0) = GenRegister(GEN_GENERAL_REGISTER_FILE,
+                                      registerPool + regSlot.poolOffset, 0,
+                                      defDst.type, defDst.vstride,
+                                      defDst.width, defDst.hstride);
+            mov->src(0) = def->src(0);
+            insn.prepend(*mov);
+          } else if (!regSlot.isTmpReg) {
           /* For temporary registers, we don't need to unspill. */
             SelectionInstruction *unspill = this->create(SEL_OP_UNSPILL_REG,
                                             1 + (ctx.reservedSpillRegs * 8) / ctx.getSimdWidth(), 0);
@@ -1071,7 +1094,9 @@ namespace gbe
             unspill->state.noMask = 1;
             auto it = SpillRegs.find(selReg.value.reg);
             GenRegister dst0;
-            if( it != SpillRegs.end()) {
+            if (regSlot.isPacked) {
+              dst0 = GenRegister::uw16grf(registerPool + regSlot.poolOffset, 0);
+            } else if( it != SpillRegs.end()) {
               dst0 = GenRegister(GEN_GENERAL_REGISTER_FILE,
                                  registerPool + regSlot.poolOffset, 0,
                                  it->second.type, it->second.vstride,
@@ -1123,8 +1148,12 @@ namespace gbe
             }
             struct RegSlot regSlot(reg, dstID, poolOffset,
                                    it->second.isTmpReg,
-                                   it->second.addr);
+                                   it->second.isPacked,
+                                   it->second.addr,
+                                   it->second.remat);
+            // a packed spill merges the new lanes in the register after the value
             if (family == ir::FAMILY_QWORD) poolOffset += 2 * simdWidth / 8;
+            else if (it->second.isPacked) poolOffset += 2;
             else poolOffset += simdWidth / 8;
             regSet.push_back(regSlot);
           }
@@ -1136,7 +1165,8 @@ namespace gbe
           struct RegSlot regSlot = regSet.back();
           regSet.pop_back();
           const GenRegister selReg = insn.dst(regSlot.dstID);
-          if(!regSlot.isTmpReg) {
+          /* Rematerialized registers are never read back from the scratch space. */
+          if(!regSlot.isTmpReg && regSlot.remat == NULL) {
             /* For temporary registers, we don't need to unspill. */
             SelectionInstruction *spill = this->create(SEL_OP_SPILL_REG,
                                           (ctx.reservedSpillRegs * 8) / ctx.getSimdWidth() , 1);
@@ -1153,10 +1183,15 @@ namespace gbe
 
             if (insn.opcode == SEL_OP_SEL)
               spill->state.predicate = GEN_PREDICATE_NONE;
-            spill->src(0) = GenRegister(GEN_GENERAL_REGISTER_FILE,
-                                        registerPool + regSlot.poolOffset, 0,
-                                        selReg.type, selReg.vstride,
-                                        selReg.width, selReg.hstride);
+            if (regSlot.isPacked)
+              spill->src(0) = simdWidth == 16 ?
+                              GenRegister::uw16grf(registerPool + regSlot.poolOffset, 0) :
+                              GenRegister::uw8grf(registerPool + regSlot.poolOffset, 0);
+            else
+              spill->src(0) = GenRegister(GEN_GENERAL_REGISTER_FILE,
+                                          registerPool + regSlot.poolOffset, 0,
+                                          selReg.type, selReg.vstride,
+                                          selReg.width, selReg.hstride);
             spill->extra.scratchOffset = regSlot.addr + selReg.quarter * 4 * simdWidth;
             spill->extra.scratchMsgHeader = registerPool;
             for(uint32_t i = 0; i < 0 + (ctx.reservedSpillRegs * 8) / ctx.getSimdWidth(); i++)
@@ -1381,6 +1416,22 @@ namespace gbe
     insn->extra.indirect_offset = immOffset;
   }
 
+  void Selection::Opaque::INDIRECT_READ(Reg dst, Reg tmp, Reg regOffset, const GenRegister *elems, uint32_t elemNum) {
+    SelectionInstruction *insn = this->appendInsn(SEL_OP_INDIRECT_READ, 2, elemNum + 1);
+    insn->dst(0) = dst;
+    insn->dst(1) = tmp;
+    insn->src(0) = regOffset;
+    for (uint32_t elemID = 0; elemID < elemNum; ++elemID)
+      insn->src(elemID + 1) = elems[elemID];
+
+    // The offset is relative to the first element
+    SelectionVector *vector = this->appendVector();
+    vector->regNum = elemNum;
+    vector->reg = &insn->src(1);
+    vector->offsetID = 1;
+    vector->isSrc = 1;
+  }
+
   void Selection::Opaque::ATOMIC(Reg dst, uint32_t function,
                                  uint32_t msgPayload, Reg src0,
                                  Reg src1, Reg src2, GenRegister bti,
@@ -7364,6 +7415,48 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
     }
   };
 
+  /*! Read an element of a register array */
+  class IndirectReadInstructionPattern : public SelectionPattern
+  {
+  public:
+    IndirectReadInstructionPattern(void) : SelectionPattern(1,1) {
+      this->opcodes.push_back(ir::OP_INDIRECT_READ);
+    }
+    INLINE bool emit(Selection::Opaque &sel, SelectionDAG &dag) const {
+      using namespace ir;
+      const ir::IndirectReadInstruction &insn = cast<ir::IndirectReadInstruction>(dag.insn);
+      const Type type = insn.getType();
+      const uint32_t elemNum = insn.getElementNum();
+      const bool isScalar = sel.isScalarReg(insn.getDst(0));
+      // The elements are allocated one after the other, a scalar one takes a
+      // dword and the others a dword per lane
+      const uint32_t elemShift = isScalar ? 2 : (sel.ctx.getSimdWidth() == 16 ? 6 : 5);
+      vector<GenRegister> elems(elemNum);
+      for (uint32_t elemID = 0; elemID < elemNum; ++elemID)
+        elems[elemID] = sel.selReg(insn.getSrc(elemID + 1), type);
+      const GenRegister dst = sel.selReg(insn.getDst(0), type);
+      const GenRegister index = sel.selReg(insn.getSrc(0), TYPE_U32);
+      const GenRegister offset = sel.selReg(sel.reg(FAMILY_DWORD, isScalar), TYPE_U32);
+      const GenRegister tmp = sel.selReg(sel.reg(FAMILY_WORD, isScalar), TYPE_U16);
+
+      sel.push();
+        if (isScalar) {
+          sel.curr.execWidth = 1;
+          sel.curr.predicate = GEN_PREDICATE_NONE;
+        }
+        // All the lanes get an offset in the elements, even the disabled ones
+        // which also read something. Out of bound indices read the last one.
+        sel.curr.noMask = 1;
+        sel.SEL_CMP(GEN_CONDITIONAL_L, offset, index, GenRegister::immud(elemNum - 1));
+        sel.SHL(offset, offset, GenRegister::immud(elemShift));
+        sel.curr.noMask = isScalar ? 1 : 0;
+        sel.INDIRECT_READ(dst, tmp, offset, &elems[0], elemNum);
+      sel.pop();
+      markAllChildren(dag);
+      return true;
+    }
+  };
+
   class CalcTimestampInstructionPattern : public SelectionPattern
   {
   public:
@@ -7545,6 +7638,19 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
             sel.ENDIF(GenRegister::immd(0), nextLabel);
           sel.block->endifOffset = -1;
         sel.pop();
+        // A uniform predicate sends all the lanes to the target, so we can
+        // skip the blocks in between as for an unconditional branch
+        const LabelIndex jip = sel.ctx.getLabelIndex(&insn);
+        if (!sel.isScalarReg(pred) || curr->belongToStructure || nextLabel == jip)
+          return;
+        sel.push();
+          sel.curr.physicalFlag = 0;
+          sel.curr.flagIndex = pred.value();
+          sel.curr.predicate = GEN_PREDICATE_NORMAL;
+          sel.curr.execWidth = 1;
+          sel.curr.noMask = 1;
+          sel.block->endifOffset -= sel.JMPI(GenRegister::immd(0), jip, ir::LabelIndex(curr->getLabelIndex().value() + 1));
+        sel.pop();
       } else {
         // Update the PcIPs
         const LabelIndex jip = sel.ctx.getLabelIndex(&insn);
@@ -8269,6 +8375,7 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
     this->insert<RegionInstructionPattern>();
     this->insert<SimdShuffleInstructionPattern>();
     this->insert<IndirectMovInstructionPattern>();
+    this->insert<IndirectReadInstructionPattern>();
     this->insert<CalcTimestampInstructionPattern>();
     this->insert<StoreProfilingInstructionPattern>();
     this->insert<WorkGroupInstructionPattern>();
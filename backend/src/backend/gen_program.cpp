@@ -68,6 +68,7 @@
 #include <iostream>
 #include <fstream>
 #include <mutex>
+#include <thread>
 #include <unistd.h>
 
 namespace gbe {
@@ -168,33 +169,13 @@ namespace gbe {
   };
 
   IVAR(OCL_SIMD_WIDTH, 8, 15, 16);
-  Kernel *GenProgram::compileKernel(const ir::Unit &unit, const std::string &name,
-                                    bool relaxMath, int profiling) {
+  BVAR(OCL_SPECULATIVE_CODEGEN, false);
+  BVAR(OCL_PRUNE_CODEGEN_STRATEGY, false);
+
 #ifdef GBE_COMPILER_AVAILABLE
-    // Be careful when the simdWidth is forced by the programmer. We can see it
-    // when the function already provides the simd width we need to use (i.e.
-    // non zero)
-    const ir::Function *fn = unit.getFunction(name);
-    const struct CodeGenStrategy* codeGenStrategy = codeGenStrategyDefault;
-    if(fn == NULL)
-      GBE_ASSERT(0);
-    uint32_t codeGenNum = sizeof(codeGenStrategyDefault) / sizeof(codeGenStrategyDefault[0]);
-    uint32_t codeGen = 0;
+  GenContext *GenProgram::newGenContext(const ir::Unit &unit, const std::string &name,
+                                        bool relaxMath, int profiling) {
     GenContext *ctx = NULL;
-    if ( fn->getSimdWidth() != 0 && OCL_SIMD_WIDTH != 15) {
-      GBE_ASSERTM(0, "unsupported SIMD width!");
-    }else if (fn->getSimdWidth() == 8 || OCL_SIMD_WIDTH == 8) {
-      codeGen = 1;
-    } else if (fn->getSimdWidth() == 16 || OCL_SIMD_WIDTH == 16){
-      codeGenStrategy = codeGenStrategySimd16;
-      codeGenNum = sizeof(codeGenStrategySimd16) / sizeof(codeGenStrategySimd16[0]);
-    } else if (fn->getSimdWidth() == 0 && OCL_SIMD_WIDTH == 15) {
-      codeGen = 0;
-    } else
-      GBE_ASSERTM(0, "unsupported SIMD width!");
-    Kernel *kernel = NULL;
-
-    // Stop when compilation is successful
     if (IS_IVYBRIDGE(deviceID)) {
       ctx = GBE_NEW(GenContext, unit, name, deviceID, relaxMath);
     } else if (IS_HASWELL(deviceID)) {
@@ -216,40 +197,125 @@ namespace gbe {
     }
     GBE_ASSERTM(ctx != NULL, "Fail to create the gen context\n");
 
-    if (profiling) {
+    if (profiling)
       ctx->setProfilingMode(true);
-      unit.getProfilingInfo()->setDeviceID(deviceID);
-    }
-
     ctx->setASMFileName(this->asm_file_name);
+    return ctx;
+  }
 
-    for (; codeGen < codeGenNum; ++codeGen) {
-      const uint32_t simdWidth = codeGenStrategy[codeGen].simdWidth;
-      const bool limitRegisterPressure = codeGenStrategy[codeGen].limitRegisterPressure;
-      const uint32_t reservedSpillRegs = codeGenStrategy[codeGen].reservedSpillRegs;
-
-      // Force the SIMD width now and try to compile
-      ir::Function *simdFn = unit.getFunction(name);
-      if(simdFn == NULL)
-        GBE_ASSERT(0);
-      simdFn->setSimdWidth(simdWidth);
-      ctx->startNewCG(simdWidth, reservedSpillRegs, limitRegisterPressure);
-      kernel = ctx->compileKernel();
+  /*! Run one code generation strategy. Returns NULL if it fails */
+  static Kernel *compileWithStrategy(GenContext *ctx, const CodeGenStrategy &strategy) {
+    for (;;) {
+      ctx->startNewCG(strategy.simdWidth, strategy.reservedSpillRegs, strategy.limitRegisterPressure);
+      Kernel *kernel = ctx->compileKernel();
       if (kernel != NULL) {
         GBE_ASSERT(ctx->getErrCode() == NO_ERROR);
-        kernel->setOclVersion(unit.getOclVersion());
-        break;
+        return kernel;
       }
-      simdFn->getImageSet()->clearInfo();
       // If we get a out of range if/endif error.
       // We need to set the context to if endif fix mode and restart the previous compile.
-      if ( ctx->getErrCode() == OUT_OF_RANGE_IF_ENDIF && !ctx->getIFENDIFFix() ) {
+      if (ctx->getErrCode() == OUT_OF_RANGE_IF_ENDIF && !ctx->getIFENDIFFix()) {
         ctx->setIFENDIFFix(true);
-        codeGen--;
-      } else
-        GBE_ASSERT(!(ctx->getErrCode() == OUT_OF_RANGE_IF_ENDIF && ctx->getIFENDIFFix()));
+        continue;
+      }
+      GBE_ASSERT(!(ctx->getErrCode() == OUT_OF_RANGE_IF_ENDIF && ctx->getIFENDIFFix()));
+      return NULL;
+    }
+  }
+#endif
+
+  Kernel *GenProgram::compileKernel(const ir::Unit &unit, const std::string &name,
+                                    bool relaxMath, int profiling) {
+#ifdef GBE_COMPILER_AVAILABLE
+    // Be careful when the simdWidth is forced by the programmer. We can see it
+    // when the function already provides the simd width we need to use (i.e.
+    // non zero)
+    const ir::Function *fn = unit.getFunction(name);
+    const struct CodeGenStrategy* codeGenStrategy = codeGenStrategyDefault;
+    if(fn == NULL)
+      GBE_ASSERT(0);
+    uint32_t codeGenNum = sizeof(codeGenStrategyDefault) / sizeof(codeGenStrategyDefault[0]);
+    uint32_t codeGen = 0;
+    if ( fn->getSimdWidth() != 0 && OCL_SIMD_WIDTH != 15) {
+      GBE_ASSERTM(0, "unsupported SIMD width!");
+    }else if (fn->getSimdWidth() == 8 || OCL_SIMD_WIDTH == 8) {
+      codeGen = 1;
+    } else if (fn->getSimdWidth() == 16 || OCL_SIMD_WIDTH == 16){
+      codeGenStrategy = codeGenStrategySimd16;
+      codeGenNum = sizeof(codeGenStrategySimd16) / sizeof(codeGenStrategySimd16[0]);
+    } else if (fn->getSimdWidth() == 0 && OCL_SIMD_WIDTH == 15) {
+      codeGen = 0;
+    } else
+      GBE_ASSERTM(0, "unsupported SIMD width!");
+    Kernel *kernel = NULL;
+    ir::Function *simdFn = unit.getFunction(name);
+
+    GenContext *ctx = this->newGenContext(unit, name, relaxMath, profiling);
+    if (profiling)
+      unit.getProfilingInfo()->setDeviceID(deviceID);
+
+    // A strategy without spill registers can not succeed if more registers
+    // than the whole register file are alive at the same time. The estimate
+    // is made on the IR, before the selection folds some values, hence the
+    // margin. It is not a bound, a pruned strategy may still have succeeded,
+    // so the pruning is only done on request
+    vector<uint32_t> strategies;
+    for (; codeGen < codeGenNum; ++codeGen) {
+      const CodeGenStrategy &strategy = codeGenStrategy[codeGen];
+      if (OCL_PRUNE_CODEGEN_STRATEGY && strategy.reservedSpillRegs == 0 &&
+          codeGen + 1 < codeGenNum) {
+        const uint32_t pressure = ctx->estimateRegisterPressure(strategy.simdWidth);
+        const uint32_t grfSize = 4*KB - GEN_REG_SIZE;
+        if (pressure > grfSize + grfSize / 4)
+          continue;
+      }
+      strategies.push_back(codeGen);
+    }
+
+    if (OCL_SPECULATIVE_CODEGEN && strategies.size() > 1 && this->asm_file_name == NULL) {
+      // Run all the strategies at once, each on its own context, and keep
+      // the first successful one in preference order. The contexts are built
+      // here since computing the liveness updates the function
+      const uint32_t num = strategies.size();
+      vector<GenContext*> ctxs(num, NULL);
+      vector<Kernel*> kernels(num, NULL);
+      ctxs[0] = ctx;
+      for (uint32_t i = 1; i < num; ++i)
+        ctxs[i] = this->newGenContext(unit, name, relaxMath, profiling);
+      vector<std::thread> threads;
+      for (uint32_t i = 0; i < num; ++i)
+        threads.push_back(std::thread([&, i]() {
+          kernels[i] = compileWithStrategy(ctxs[i], codeGenStrategy[strategies[i]]);
+        }));
+      for (auto &thread : threads)
+        thread.join();
+      for (uint32_t i = 0; i < num; ++i) {
+        if (kernels[i] != NULL && kernel == NULL) {
+          kernel = kernels[i];
+          simdFn->setSimdWidth(codeGenStrategy[strategies[i]].simdWidth);
+          ctxs[i]->commitImageInfo();
+        } else if (kernels[i] != NULL)
+          GBE_DELETE(kernels[i]); // Also deletes its context
+        else
+          GBE_DELETE(ctxs[i]);
+      }
+    } else {
+      for (auto strategy : strategies) {
+        // Force the SIMD width now and try to compile
+        simdFn->setSimdWidth(codeGenStrategy[strategy].simdWidth);
+        kernel = compileWithStrategy(ctx, codeGenStrategy[strategy]);
+        if (kernel != NULL) {
+          ctx->commitImageInfo();
+          break;
+        }
+      }
+      // The kernel owns the context on success
+      if (kernel == NULL)
+        GBE_DELETE(ctx);
     }
 
+    if (kernel != NULL)
+      kernel->setOclVersion(unit.getOclVersion());
     //GBE_ASSERTM(kernel != NULL, "Fail to compile kernel, may need to increase reserved registers for spilling.");
     return kernel;
 #else
@@ -33,6 +33,7 @@
 struct GenInstruction;
 namespace gbe
 {
+  class GenContext;
   /*! Describe a compiled kernel */
   class GenKernel : public Kernel
   {
@@ -70,10 +71,14 @@ namespace gbe
     virtual void CleanLlvmResource(void);
     /*! Implements base class */
     virtual Kernel *compileKernel(const ir::Unit &unit, const std::string &name, bool relaxMath, int profiling);
+    /*! Create the context matching the device to compile the given kernel */
+    GenContext *newGenContext(const ir::Unit &unit, const std::string &name, bool relaxMath, int profiling);
     /*! Allocate an empty kernel. */
     virtual Kernel *allocateKernel(const std::string &name) {
       return GBE_NEW(GenKernel, name, deviceID);
     }
+    /*! The assembly dump file is shared by all the kernels */
+    virtual bool canCompileConcurrently(void) const { return asm_file_name == NULL; }
     void* module;
     void* llvm_ctx;
     const char* asm_file_name;
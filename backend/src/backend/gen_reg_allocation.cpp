@@ -110,8 +110,18 @@ namespace gbe
     /*! Allocate the virtual boolean (== flags) registers */
     void allocateFlags(Selection &selection);
     /*! calculate the spill cost, what we store here is 'use count',
-     * we use [use count]/[live range] as spill cost */
+     * we use [use count]/[live range] as spill cost. Each access is weighted
+     * by the loop depth of its block */
     void calculateSpillCost(Selection &selection);
+    /*! Is it a definition cheap enough to be repeated before the uses */
+    bool isRematerializable(const SelectionInstruction &insn) const;
+    /*! Does the access cover the whole register at the kernel SIMD width */
+    bool isFullAccess(const SelectionInstruction &insn, const GenRegister &reg, bool isDst) const;
+    /*! Sub-dword registers and SIMD16 temporaries are only spilled when all
+     *  their accesses cover the whole register */
+    bool needFullAccess(ir::Register reg, ir::RegisterFamily family) const;
+    /*! Output the spill / fill counts of the kernel */
+    void outputSpillStats(const Selection &selection) const;
     /*! validated flags which contains valid value in the physical flag register */
     set<uint32_t> validatedFlags;
     /*! validated temp flag register which indicate the flag 0,1 contains which virtual flag register. */
@@ -162,6 +172,10 @@ namespace gbe
     SpilledRegs spilledRegs;
     /*! register which could be spilled.*/
     std::set<GenRegInterval*> spillCandidate;
+    /*! single definition of the registers that can be rematerialized */
+    map<ir::Register, const SelectionInstruction*> rematInsn;
+    /*! registers with an access not covering the whole register */
+    set<ir::Register> partialAccessRegs;
     /*! BBs last instruction ID map */
     map<const ir::BasicBlock *, int32_t> bbLastInsnIDMap;
     /* reserved registers for register spill/reload */
@@ -788,6 +802,7 @@ namespace gbe
   }
 
   IVAR(OCL_SIMD16_SPILL_THRESHOLD, 0, 16, 256);
+  BVAR(OCL_OUTPUT_SPILL_STATS, false);
   bool GenRegAllocator::Opaque::allocateGRFs(Selection &selection) {
     // Perform the linear scan allocator
     ctx.errCode = REGISTER_ALLOCATION_FAIL;
@@ -864,6 +879,8 @@ namespace gbe
         ctx.errCode = REGISTER_SPILL_FAIL;
         return false;
       }
+      if (OCL_OUTPUT_SPILL_STATS)
+        outputSpillStats(selection);
     }
     ctx.errCode = NO_ERROR;
     return true;
@@ -895,14 +912,16 @@ namespace gbe
       }
       auto it = spilledRegs.find(cur->reg);
       GBE_ASSERT(it != spilledRegs.end());
-      if(cur->minID == cur->maxID) {
+      // Rematerialized registers never go to the scratch space
+      if(cur->minID == cur->maxID || it->second.remat != NULL) {
         it->second.addr = -1;
         continue;
       }
 
+      // Packed registers take one GRF for both SIMD widths
       ir::RegisterFamily family = ctx.sel->getRegisterFamily(cur->reg);
-      it->second.addr = ctx.allocateScratchMem(getFamilySize(family)
-                                             * ctx.getSimdWidth());
+      it->second.addr = ctx.allocateScratchMem(it->second.isPacked ? GEN_REG_SIZE :
+                                               getFamilySize(family) * ctx.getSimdWidth());
       if (it->second.addr == -1)
         return false;
     }
@@ -932,6 +951,11 @@ namespace gbe
     return true;
   }
 
+  /*! Byte and word registers both take two bytes per lane in the GRF */
+  static INLINE bool isPackedFamily(ir::RegisterFamily family) {
+    return family == ir::FAMILY_BOOL || family == ir::FAMILY_BYTE || family == ir::FAMILY_WORD;
+  }
+
   // insert a new register with allocated offset,
   // put it to the RA map and the spill map if it could be spilled.
   INLINE void GenRegAllocator::Opaque::insertNewReg(const Selection &selection,
@@ -947,13 +971,15 @@ namespace gbe
        ir::RegisterFamily family;
        getRegAttrib(reg, regSize, &family);
        // At simd16 mode, we may introduce some simd8 registers in te instruction selection stage.
-       // To spill those simd8 temporary registers will introduce unecessary complexity. We just simply
-       // avoid to spill those temporary registers here.
-       if (ctx.getSimdWidth() == 16 && reg.value() >= ctx.getFunction().getRegisterFile().regNum())
+       // Those temporaries, like the byte and word registers, are only spilled if they are
+       // always accessed as a whole.
+       if (needFullAccess(reg, family) &&
+           (partialAccessRegs.contains(reg) || ctx.isSpecialReg(reg)))
          return;
 
        if (((regSize == ctx.getSimdWidth()/8 * GEN_REG_SIZE && family == ir::FAMILY_DWORD)
-          || (regSize == 2 * ctx.getSimdWidth()/8 * GEN_REG_SIZE && family == ir::FAMILY_QWORD))
+          || (regSize == 2 * ctx.getSimdWidth()/8 * GEN_REG_SIZE && family == ir::FAMILY_QWORD)
+          || (regSize == 2 * ctx.getSimdWidth() && isPackedFamily(family)))
           && !selection.isPartialWrite(reg)) {
          GBE_ASSERT(offsetReg.find(grfOffset) == offsetReg.end());
          offsetReg.insert(std::make_pair(grfOffset, reg));
@@ -972,18 +998,26 @@ namespace gbe
     if (reservedReg == 0)
       return false;
 
-    if (interval.reg.value() >= ctx.getFunction().getRegisterFile().regNum() &&
-        ctx.getSimdWidth() == 16)
+    uint32_t regSize;
+    ir::RegisterFamily family;
+    getRegAttrib(interval.reg, regSize, &family);
+    if (needFullAccess(interval.reg, family) &&
+        (partialAccessRegs.contains(interval.reg) || ctx.isSpecialReg(interval.reg)))
       return false;
 
-    ir::RegisterFamily family = ctx.sel->getRegisterFamily(interval.reg);
-    // we currently only support DWORD/QWORD spill
-    if(family != ir::FAMILY_DWORD && family != ir::FAMILY_QWORD)
+    // BYTE/WORD/BOOL registers are spilled with their two bytes per lane
+    const bool isPacked = isPackedFamily(family);
+    if (!isPacked && family != ir::FAMILY_DWORD && family != ir::FAMILY_QWORD)
+      return false;
+    if (isPacked && regSize != 2 * ctx.getSimdWidth())
       return false;
 
     SpillRegTag spillTag;
     spillTag.isTmpReg = interval.maxID == interval.minID;
+    spillTag.isPacked = isPacked;
     spillTag.addr = -1;
+    auto remat = rematInsn.find(interval.reg);
+    spillTag.remat = remat != rematInsn.end() ? remat->second : NULL;
 
     if (isAllocated) {
       // If this register is allocated, we need to expire it and erase it
@@ -1018,6 +1052,10 @@ namespace gbe
     return count / (float)(v.maxID - v.minID);
   }
 
+  /*! A rematerialized register costs one ALU instruction per use instead of
+   *  a scratch read and write, make it a preferred candidate */
+  static const float rematCostRatio = 0.125f;
+
   bool spillinterval_cmp(const SpillInterval &v1, const SpillInterval &v2) {
     return v1.cost < v2.cost;
   }
@@ -1081,6 +1119,8 @@ namespace gbe
     std::vector<SpillInterval> candQ;
     for (auto &p : spillCandidate) {
       float cost = getSpillCost(*p);
+      if (rematInsn.find(p->reg) != rematInsn.end())
+        cost *= rematCostRatio;
       candQ.push_back(SpillInterval(p->reg, cost));
     }
     std::sort(candQ.begin(), candQ.end(), spillinterval_cmp);
@@ -1236,6 +1276,9 @@ namespace gbe
   }
 
   int UseCountApproximate(int loopDepth) {
+    // Deeper loops are not much hotter in practice, and the count must not
+    // overflow
+    loopDepth = std::min(loopDepth, 6);
     int ret = 1;
     for (int i = 0; i < loopDepth; i++) {
       ret = ret * 10;
@@ -1243,27 +1286,113 @@ namespace gbe
     return ret;
   }
 
+  bool GenRegAllocator::Opaque::isRematerializable(const SelectionInstruction &insn) const {
+    // Only a plain move of an immediate to a whole DWORD register
+    if (insn.opcode != SEL_OP_MOV || insn.dstNum != 1 || insn.srcNum != 1)
+      return false;
+    const GenRegister &dst = insn.dst(0);
+    const GenRegister &src = insn.src(0);
+    return src.file == GEN_IMMEDIATE_VALUE &&
+           dst.file == GEN_GENERAL_REGISTER_FILE &&
+           dst.physical == 0 && dst.nr == 0 && dst.subnr == 0 && dst.quarter == 0 &&
+           dst.hstride != GEN_HORIZONTAL_STRIDE_0 &&
+           typeSize(dst.type) == 4 &&
+           insn.state.execWidth == ctx.getSimdWidth() &&
+           insn.state.predicate == GEN_PREDICATE_NONE &&
+           insn.state.modFlag == 0 &&
+           insn.state.saturate == GEN_MATH_SATURATE_NONE;
+  }
+
+  bool GenRegAllocator::Opaque::isFullAccess(const SelectionInstruction &insn,
+                                             const GenRegister &reg,
+                                             bool isDst) const {
+    if (reg.physical)
+      return true;
+    if (insn.state.execWidth != ctx.getSimdWidth() ||
+        reg.nr != 0 || reg.subnr != 0 || reg.quarter != 0)
+      return false;
+    if (!isPackedFamily(ctx.sel->getRegisterFamily(reg.reg())))
+      return true;
+    // The packed spill sequences move two bytes per lane
+    if (!isDst && reg.hstride == GEN_HORIZONTAL_STRIDE_0)
+      return true;
+    return stride(reg.hstride) * typeSize(reg.type) == 2;
+  }
+
+  bool GenRegAllocator::Opaque::needFullAccess(ir::Register reg,
+                                               ir::RegisterFamily family) const {
+    if (isPackedFamily(family))
+      return true;
+    return ctx.getSimdWidth() == 16 &&
+           reg.value() >= ctx.getFunction().getRegisterFile().regNum();
+  }
+
   void GenRegAllocator::Opaque::calculateSpillCost(Selection &selection) {
-    int BlockIndex = 0;
+    const uint32_t regNum = ctx.sel->getRegNum();
+    // The only definition of each register if it is rematerializable
+    vector<const SelectionInstruction*> rematDef(regNum, NULL);
+    vector<uint8_t> rematFail(regNum, 0);
+
     for (auto &block : *selection.blockList) {
-      int LoopDepth = ctx.fn.getLoopDepth(ir::LabelIndex(BlockIndex));
+      // Loops are described with the IR labels
+      const int LoopDepth = ctx.fn.getLoopDepth(block.bb->getLabelIndex());
       for (auto &insn : block.insnList) {
         const uint32_t srcNum = insn.srcNum, dstNum = insn.dstNum;
         for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
           const GenRegister &selReg = insn.src(srcID);
           const ir::Register reg = selReg.reg();
-          if (selReg.file == GEN_GENERAL_REGISTER_FILE)
+          if (selReg.file == GEN_GENERAL_REGISTER_FILE) {
             this->intervals[reg].accessCount += UseCountApproximate(LoopDepth);
+            // The rematerialized value is rewritten with the type of its definition
+            if (typeSize(selReg.type) != 4)
+              rematFail[reg] = 1;
+            if (!isFullAccess(insn, selReg, false))
+              partialAccessRegs.insert(reg);
+          }
         }
         for (uint32_t dstID = 0; dstID < dstNum; ++dstID) {
           const GenRegister &selReg = insn.dst(dstID);
           const ir::Register reg = selReg.reg();
-          if (selReg.file == GEN_GENERAL_REGISTER_FILE)
+          if (selReg.file == GEN_GENERAL_REGISTER_FILE) {
             this->intervals[reg].accessCount += UseCountApproximate(LoopDepth);
+            if (!isFullAccess(insn, selReg, true))
+              partialAccessRegs.insert(reg);
+            if (rematDef[reg] != NULL || !isRematerializable(insn))
+              rematFail[reg] = 1;
+            else
+              rematDef[reg] = &insn;
+          }
         }
       }
-      BlockIndex++;
     }
+
+    for (uint32_t regID = 0; regID < regNum; ++regID) {
+      const ir::Register reg(regID);
+      if (rematDef[regID] == NULL || rematFail[regID])
+        continue;
+      // Vectors are spilled and filled as a whole
+      if (vectorMap.find(reg) != vectorMap.end())
+        continue;
+      rematInsn.insert(std::make_pair(reg, rematDef[regID]));
+    }
+  }
+
+  void GenRegAllocator::Opaque::outputSpillStats(const Selection &selection) const {
+    uint32_t spillNum = 0, fillNum = 0, rematNum = 0;
+    for (auto &block : *selection.blockList)
+      for (auto &insn : block.insnList) {
+        if (insn.opcode == SEL_OP_SPILL_REG)
+          spillNum++;
+        else if (insn.opcode == SEL_OP_UNSPILL_REG)
+          fillNum++;
+      }
+    for (auto &it : spilledRegs)
+      if (it.second.remat != NULL)
+        rematNum++;
+    std::cout << ctx.getFunction().getName() << " (SIMD" << ctx.getSimdWidth() << "): "
+              << spilledRegs.size() << " registers spilled, "
+              << rematNum << " rematerialized, "
+              << spillNum << " spills, " << fillNum << " fills" << std::endl;
   }
 
   INLINE bool GenRegAllocator::Opaque::allocate(Selection &selection) {
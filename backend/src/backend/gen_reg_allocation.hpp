@@ -34,10 +34,13 @@ namespace gbe
   class GenRegister;    // Pre-register allocation Gen register
   struct GenRegInterval; // Liveness interval for each register
   class GenContext;     // Gen specific context
+  class SelectionInstruction; // Pre-register allocation Gen instruction
 
   typedef struct SpillRegTag {
     bool isTmpReg;
+    bool isPacked; //!< Sub-dword register stored with two bytes per lane
     int32_t addr;
+    const SelectionInstruction *remat; //!< Definition repeated instead of a fill
   } SpillRegTag;
 
   typedef struct HoleRegTag {
@@ -24,6 +24,7 @@
 
 #include "program.h"
 #include "program.hpp"
+#include "program_cache.hpp"
 #include "gen_program.h"
 #include "sys/platform.hpp"
 #include "sys/cvar.hpp"
@@ -51,6 +52,8 @@
 #include <iostream>
 #include <unistd.h>
 #include <mutex>
+#include <thread>
+#include <atomic>
 
 #ifdef GBE_COMPILER_AVAILABLE
 
@@ -80,7 +83,8 @@ namespace gbe {
   Kernel::Kernel(const std::string &name) :
     name(name), args(NULL), argNum(0), curbeSize(0), stackSize(0), useSLM(false),
         slmSize(0), ctx(NULL), samplerSet(NULL), imageSet(NULL), printfSet(NULL),
-        profilingInfo(NULL), useDeviceEnqueue(false) {}
+        profilingInfo(NULL), useDeviceEnqueue(false), partialGroupGuard(false),
+        useBarrier(false) {}
 
   Kernel::~Kernel(void) {
     if(ctx) GBE_DELETE(ctx);
@@ -113,6 +117,7 @@ namespace gbe {
   BVAR(OCL_STRICT_CONFORMANCE, true);
   IVAR(OCL_PROFILING_LOG, 0, 0, 1); // Int for different profiling types.
   BVAR(OCL_OUTPUT_BUILD_LOG, false);
+  IVAR(OCL_BUILD_THREADS, 0, 1, 64); // 0 means one thread per core.
 
   bool Program::buildFromLLVMModule(const void* module,
                                               std::string &error,
@@ -160,14 +165,46 @@ namespace gbe {
     if (fast_relaxed_math || !OCL_STRICT_CONFORMANCE)
       strictMath = false;
 
-    for (const auto &pair : set) {
+    // Kernels only read the unit, so they can be compiled concurrently. The
+    // results are merged below in the function set order whatever the
+    // order in which they complete
+    vector<const ir::Unit::FunctionSet::value_type*> pairs;
+    for (const auto &pair : set)
+      pairs.push_back(&pair);
+    vector<Kernel*> compiled(kernelNum, NULL);
+    uint32_t threadNum = OCL_BUILD_THREADS;
+    if (threadNum == 0)
+      threadNum = std::max(std::thread::hardware_concurrency(), 1u);
+    threadNum = std::min(threadNum, kernelNum);
+    if (OCL_PROFILING_LOG || !this->canCompileConcurrently())
+      threadNum = 1;
+
+    std::atomic<uint32_t> nextKernel(0);
+    auto compileKernels = [&]() {
+      uint32_t id;
+      while ((id = nextKernel++) < kernelNum)
+        compiled[id] = this->compileKernel(unit, pairs[id]->first, !strictMath, OCL_PROFILING_LOG);
+    };
+    if (threadNum > 1) {
+      vector<std::thread> threads;
+      for (uint32_t i = 0; i < threadNum; ++i)
+        threads.push_back(std::thread(compileKernels));
+      for (auto &thread : threads)
+        thread.join();
+    } else
+      compileKernels();
+
+    for (uint32_t id = 0; id < kernelNum; ++id) {
+      const auto &pair = *pairs[id];
       const std::string &name = pair.first;
-      Kernel *kernel = this->compileKernel(unit, name, !strictMath, OCL_PROFILING_LOG);
+      Kernel *kernel = compiled[id];
       if (!kernel) {
         error +=  name;
         error += ":(GBE): error: failed in Gen backend.\n";
         if (OCL_OUTPUT_BUILD_LOG)
           llvm::errs() << error;
+        for (uint32_t i = id + 1; i < kernelNum; ++i)
+          if (compiled[i]) GBE_DELETE(compiled[i]);
         return false;
       }
       kernel->setSamplerSet(pair.second->getSamplerSet());
@@ -360,6 +397,8 @@ namespace gbe {
     OUT_UPDATE_SZ(compileWgSize[0]);
     OUT_UPDATE_SZ(compileWgSize[1]);
     OUT_UPDATE_SZ(compileWgSize[2]);
+    OUT_UPDATE_SZ(partialGroupGuard);
+    OUT_UPDATE_SZ(useBarrier);
     /* samplers. */
     if (!samplerSet->empty()) {   //samplerSet is always valid, allocated in Function::Function
       has_samplerset = 1;
@@ -491,6 +530,8 @@ namespace gbe {
     IN_UPDATE_SZ(compileWgSize[0]);
     IN_UPDATE_SZ(compileWgSize[1]);
     IN_UPDATE_SZ(compileWgSize[2]);
+    IN_UPDATE_SZ(partialGroupGuard);
+    IN_UPDATE_SZ(useBarrier);
 
     IN_UPDATE_SZ(has_samplerset);
     if (has_samplerset) {
@@ -573,6 +614,8 @@ namespace gbe {
     outs << spaces_nl << "  useSLM: " << useSLM << "\n";
     outs << spaces_nl << "  slmSize: " << slmSize << "\n";
     outs << spaces_nl << "  compileWgSize: " << compileWgSize[0] << compileWgSize[1] << compileWgSize[2] << "\n";
+    outs << spaces_nl << "  partialGroupGuard: " << partialGroupGuard << "\n";
+    outs << spaces_nl << "  useBarrier: " << useBarrier << "\n";
 
     outs << spaces_nl << "  Argument Number is " << argNum << "\n";
     for (uint32_t i = 0; i < argNum; i++) {
@@ -620,6 +663,24 @@ namespace gbe {
 
   BVAR(OCL_DEBUGINFO, false);
 #ifdef GBE_COMPILER_AVAILABLE
+  /* LLVM options are process wide and ParseCommandLineOptions is not thread
+   * safe. Parse the options we always need once, and serialize the parsing of
+   * the -mllvm options coming from the build options.
+   */
+  static std::mutex llvmOptionsMutex;
+
+  static void initLLVMOptions(void) {
+    // GVN now has a 100 instructions limit on block scan, use a bigger one
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
+    static std::once_flag llvmOptionsInitialized;
+    std::call_once(llvmOptionsInitialized, [] {
+      const char *args[] = {"beignet", "-memdep-block-scan-limit=200", NULL};
+      std::lock_guard<std::mutex> lock(llvmOptionsMutex);
+      llvm::cl::ParseCommandLineOptions(2, args);
+    });
+#endif
+  }
+
   static bool buildModuleFromSource(const char *source, llvm::Module** out_module, llvm::LLVMContext* llvm_ctx,
                                     std::string dumpLLVMFileName, std::string dumpSPIRBinaryName, std::vector<std::string>& options, size_t stringSize, char *err,
                                     size_t *errSize, uint32_t oclVersion) {
@@ -632,17 +693,7 @@ namespace gbe {
     }
 
     args.push_back("-cl-kernel-arg-info");
-    // The ParseCommandLineOptions used for mllvm args can not be used with multithread
-    // and GVN now have a 100 inst limit on block scan. Now only pass a bigger limit
-    // for each context only once, this can also fix multithread bug.
-#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
-    static bool ifsetllvm = false;
-    if(!ifsetllvm) {
-      args.push_back("-mllvm");
-      args.push_back("-memdep-block-scan-limit=200");
-      ifsetllvm = true;
-    }
-#endif
+    initLLVMOptions();
 #ifdef GEN7_SAMPLER_CLAMP_BORDER_WORKAROUND
     args.push_back("-DGEN7_SAMPLER_CLAMP_BORDER_WORKAROUND");
 #endif
@@ -725,7 +776,10 @@ namespace gbe {
         Args[i + 1] = Clang.getFrontendOpts().LLVMArgs[i].c_str();
       }
       Args[NumArgs + 1] = 0;
-      llvm::cl::ParseCommandLineOptions(NumArgs + 1, Args);
+      {
+        std::lock_guard<std::mutex> lock(llvmOptionsMutex);
+        llvm::cl::ParseCommandLineOptions(NumArgs + 1, Args);
+      }
       delete [] Args;
     }
   
@@ -1039,6 +1093,22 @@ EXTEND_QUOTE:
     return true;
   }
 
+  /*! The Gen binary format does not carry printf, profiling or device
+   *  enqueue information, so these programs always go through a full build
+   */
+  static bool programIsCacheable(gbe_program gbeProgram) {
+    const gbe::Program *program = (const gbe::Program*) gbeProgram;
+    if (OCL_PROFILING_LOG || program->getDeviceEnqueueKernelName(0) != NULL)
+      return false;
+    for (uint32_t i = 0; i < program->getKernelNum(); ++i) {
+      const gbe::Kernel *kernel = program->getKernel(i);
+      if (kernel->getPrintfNum() || kernel->getUseDeviceEnqueue() ||
+          strlen(kernel->getFunctionAttributes()) != 0)
+        return false;
+    }
+    return true;
+  }
+
   static gbe_program programNewFromSource(uint32_t deviceID,
                                           const char *source,
                                           size_t stringSize,
@@ -1057,13 +1127,27 @@ EXTEND_QUOTE:
                                 stringSize, err, errSize, oclVersion))
       return NULL;
 
+    // Dumps are side effects of a real build, never serve them from the cache
+    std::string cacheKey;
+    if (dumpLLVMFileName.empty() && dumpASMFileName.empty() && dumpSPIRBinaryName.empty())
+      cacheKey = programCacheKey(deviceID, source, clOpt, oclVersion);
+    if (!cacheKey.empty()) {
+      std::string binary;
+      if (programCacheLoad(cacheKey, binary)) {
+        gbe_program cached = gbe_program_new_from_binary(deviceID, binary.c_str(), binary.size());
+        if (cached) {
+          if (errSize)
+            *errSize = 0;
+          return cached;
+        }
+      }
+    }
+
     gbe_program p;
     // will delete the module and act in GenProgram::CleanLlvmResource().
     llvm::Module * out_module;
     llvm::LLVMContext* llvm_ctx = new llvm::LLVMContext;
-    static std::mutex llvm_mutex;
-    if (!llvm::llvm_is_multithreaded())
-      llvm_mutex.lock();
+    acquireLLVMContextLock();
 
     if (buildModuleFromSource(source, &out_module, llvm_ctx, dumpLLVMFileName, dumpSPIRBinaryName, clOpt,
                               stringSize, err, errSize, oclVersion)) {
@@ -1094,9 +1178,15 @@ EXTEND_QUOTE:
     } else
       p = NULL;
 
-    if (!llvm::llvm_is_multithreaded())
-      llvm_mutex.unlock();
+    releaseLLVMContextLock();
 
+    if (p && !cacheKey.empty() && programIsCacheable(p)) {
+      char *binary = NULL;
+      size_t binarySize = gbe_program_serialize_to_binary(p, &binary, 0);
+      if (binarySize)
+        programCacheStore(cacheKey, binary, binarySize);
+      free(binary);
+    }
     return p;
   }
 #endif
@@ -1462,6 +1552,18 @@ EXTEND_QUOTE:
     return kernel->getUseDeviceEnqueue();
   }
 
+  static uint32_t kernelHasPartialGroupGuard(gbe_kernel gbeKernel) {
+    if (gbeKernel == NULL) return 0;
+    const gbe::Kernel *kernel = (const gbe::Kernel*) gbeKernel;
+    return kernel->getPartialGroupGuard();
+  }
+
+  static uint32_t kernelUseBarrier(gbe_kernel gbeKernel) {
+    if (gbeKernel == NULL) return 0;
+    const gbe::Kernel *kernel = (const gbe::Kernel*) gbeKernel;
+    return kernel->getUseBarrier();
+  }
+
   static void* kernelDupPrintfSet(gbe_kernel gbeKernel) {
     if (gbeKernel == NULL) return NULL;
     const gbe::Kernel *kernel = (const gbe::Kernel*) gbeKernel;
@@ -1516,15 +1618,31 @@ EXTEND_QUOTE:
   }
 } /* namespace gbe */
 
-std::mutex llvm_ctx_mutex;
+/* Since LLVM 3.9 every build owns its LLVMContext and the backend keeps its
+ * state in the unit and the contexts being compiled, so builds only need to
+ * be serialized when they share the global LLVMContext or when LLVM itself
+ * is not thread safe.
+ */
+static std::mutex llvm_ctx_mutex;
+static bool needLLVMContextLock()
+{
+#if defined(GBE_COMPILER_AVAILABLE) && LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 39
+  return !llvm::llvm_is_multithreaded();
+#else
+  return true;
+#endif
+}
+
 void acquireLLVMContextLock()
 {
-  llvm_ctx_mutex.lock();
+  if (needLLVMContextLock())
+    llvm_ctx_mutex.lock();
 }
 
 void releaseLLVMContextLock()
 {
-  llvm_ctx_mutex.unlock();
+  if (needLLVMContextLock())
+    llvm_ctx_mutex.unlock();
 }
 
 GBE_EXPORT_SYMBOL gbe_program_new_from_source_cb *gbe_program_new_from_source = NULL;
@@ -1582,6 +1700,8 @@ GBE_EXPORT_SYMBOL gbe_get_printf_buf_bti_cb *gbe_get_printf_buf_bti = NULL;
 GBE_EXPORT_SYMBOL gbe_release_printf_info_cb *gbe_release_printf_info = NULL;
 GBE_EXPORT_SYMBOL gbe_output_printf_cb *gbe_output_printf = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_use_device_enqueue_cb *gbe_kernel_use_device_enqueue = NULL;
+GBE_EXPORT_SYMBOL gbe_kernel_has_partial_group_guard_cb *gbe_kernel_has_partial_group_guard = NULL;
+GBE_EXPORT_SYMBOL gbe_kernel_use_barrier_cb *gbe_kernel_use_barrier = NULL;
 
 #ifdef GBE_COMPILER_AVAILABLE
 namespace gbe
@@ -1638,6 +1758,8 @@ namespace gbe
       gbe_release_printf_info = gbe::kernelReleasePrintfSet;
       gbe_output_printf = gbe::kernelOutputPrintf;
       gbe_kernel_use_device_enqueue = gbe::kernelUseDeviceEnqueue;
+      gbe_kernel_has_partial_group_guard = gbe::kernelHasPartialGroupGuard;
+      gbe_kernel_use_barrier = gbe::kernelUseBarrier;
       genSetupCallBacks();
     }
 
@@ -391,8 +391,15 @@ extern gbe_kernel_get_ocl_version_cb *gbe_kernel_get_ocl_version;
 /* Kernel use device enqueue or not.  */
 typedef uint32_t (gbe_kernel_use_device_enqueue_cb)(gbe_kernel);
 extern gbe_kernel_use_device_enqueue_cb *gbe_kernel_use_device_enqueue;
-
-/*mutex to lock global llvmcontext access.*/
+/*! Says if the kernel disables the work items beyond the global size, so that
+ *  the partial work groups may be dispatched with the shape of the full ones */
+typedef uint32_t (gbe_kernel_has_partial_group_guard_cb)(gbe_kernel);
+extern gbe_kernel_has_partial_group_guard_cb *gbe_kernel_has_partial_group_guard;
+/*! Says if the kernel has a work group barrier */
+typedef uint32_t (gbe_kernel_use_barrier_cb)(gbe_kernel);
+extern gbe_kernel_use_barrier_cb *gbe_kernel_use_barrier;
+
+/*mutex to lock global llvmcontext access, only taken when LLVM is not thread safe.*/
 extern void acquireLLVMContextLock();
 extern void releaseLLVMContextLock();
 
@@ -221,6 +221,8 @@ namespace gbe {
        scratchSize       |
        useSLM            |
        slmSize           |
+       partialGroupGuard |
+       useBarrier        |
        samplers          |
        images            |
        code_size         |
@@ -238,6 +240,16 @@ namespace gbe {
     INLINE bool setUseDeviceEnqueue(bool useDeviceEnqueue) {
       return this->useDeviceEnqueue = useDeviceEnqueue;
     }
+    /*! Does kernel disable the work items beyond the global size */
+    INLINE bool getPartialGroupGuard(void) const { return this->partialGroupGuard; }
+    /*! Change the partial work group info of the kernel */
+    INLINE bool setPartialGroupGuard(bool partialGroupGuard) {
+      return this->partialGroupGuard = partialGroupGuard;
+    }
+    /*! Does kernel wait for the work items of its group */
+    INLINE bool getUseBarrier(void) const { return this->useBarrier; }
+    /*! Change the barrier info of the kernel */
+    INLINE bool setUseBarrier(bool useBarrier) { return this->useBarrier = useBarrier; }
 
   protected:
     friend class Context;      //!< Owns the kernels
@@ -261,6 +273,8 @@ namespace gbe {
     uint32_t compileWgSize[3]; //!< required work group size by kernel attribute.
     std::string functionAttributes; //!< function attribute qualifiers combined.
     bool useDeviceEnqueue;          //!< Has device enqueue?
+    bool partialGroupGuard;         //!< Disables the work items beyond the global size?
+    bool useBarrier;                //!< Has a work group barrier?
     GBE_CLASS(Kernel);         //!< Use custom allocators
   };
 
@@ -343,6 +357,8 @@ namespace gbe {
                                   bool relaxMath, int profiling) = 0;
     /*! Allocate an empty kernel. */
     virtual Kernel *allocateKernel(const std::string &name) = 0;
+    /*! Says if compileKernel may run for several kernels at the same time */
+    virtual bool canCompileConcurrently(void) const { return true; }
     /*! Kernels sorted by their name */
     map<std::string, Kernel*> kernels;
     /*! Global (constants) outside any kernel */
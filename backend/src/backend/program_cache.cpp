@@ -0,0 +1,296 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file program_cache.cpp
+ */
+
+#include "backend/program_cache.hpp"
+#include "sys/platform.hpp"
+#include "sys/cvar.hpp"
+#include "src/GBEConfig.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace gbe
+{
+  SVAR(OCL_PROGRAM_CACHE_DIR, "");
+  IVAR(OCL_PROGRAM_CACHE_SIZE, 1, 256, 1 << 20); // In MB
+
+  /*! Every entry starts with this header, followed by the Gen binary */
+  struct CacheEntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;      //!< Size of the binary following the header
+    uint64_t checksum;  //!< Detects truncated or corrupted entries
+  };
+  static const uint32_t cacheMagic = TO_MAGIC('G', 'B', 'E', 'C');
+  static const uint32_t cacheVersion = 1;
+  /*! Temporary files older than this belong to a dead process */
+  static const time_t cacheStaleTmpAge = 3600;
+
+  /*! 64 bits FNV-1a. Two different bases give us a 128 bits key */
+  class Hasher {
+  public:
+    Hasher(uint64_t basis) : h(basis) {}
+    void update(const void *data, size_t size) {
+      const uint8_t *p = (const uint8_t *) data;
+      for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+      }
+    }
+    void update(const std::string &str) { update(str.c_str(), str.size() + 1); }
+    template <typename T> void updateValue(const T &x) { update(&x, sizeof(x)); }
+    uint64_t value(void) const { return h; }
+  private:
+    uint64_t h;
+  };
+  static const uint64_t fnvBasis0 = 0xcbf29ce484222325ull;
+  static const uint64_t fnvBasis1 = 0x84222325cbf29ce4ull;
+
+  static uint64_t checksum(const char *data, size_t size) {
+    Hasher h(fnvBasis0);
+    h.update(data, size);
+    return h.value();
+  }
+
+  bool programCacheEnabled(void) {
+    return !OCL_PROGRAM_CACHE_DIR.empty();
+  }
+
+  static std::string entryPath(const std::string &key) {
+    return OCL_PROGRAM_CACHE_DIR + "/" + key + ".bin";
+  }
+
+  /*! Identify the compiler binary itself, so that a rebuilt libgbe.so or a
+   *  new libocl bitcode never picks up entries produced by the old one
+   */
+  static void hashCompilerIdentity(Hasher &h) {
+    h.updateValue(LIBGBE_VERSION_MAJOR);
+    h.updateValue(LIBGBE_VERSION_MINOR);
+    Dl_info info;
+    struct stat st;
+    if (dladdr((void *) &programCacheKey, &info) && info.dli_fname &&
+        stat(info.dli_fname, &st) == 0) {
+      h.updateValue(st.st_size);
+      h.updateValue(st.st_mtime);
+    }
+    // The OpenCL 1.2 and 2.0 libraries, as picked by llvm_bitcode_link.cpp
+    const char *vars[] = {"OCL_BITCODE_LIB_PATH", "OCL_BITCODE_LIB_20_PATH"};
+    const char *defaults[] = {OCL_BITCODE_BIN, OCL_BITCODE_BIN_20};
+    for (int i = 0; i < 2; ++i) {
+      const char *bitcode = getenv(vars[i]);
+      if (bitcode == NULL || *bitcode == '\0')
+        bitcode = defaults[i];
+      if (stat(bitcode, &st) == 0) {
+        h.updateValue(st.st_size);
+        h.updateValue(st.st_mtime);
+      }
+    }
+  }
+
+  /*! Collect the OCL_* variables. Returns false if a debug output is
+   *  requested, since a cache hit would silently skip it
+   */
+  static bool collectEnvironment(std::vector<std::string> &vars) {
+    for (char **env = environ; env && *env; ++env) {
+      const char *var = *env;
+      if (strncmp(var, "OCL_", 4) != 0)
+        continue;
+      if (strncmp(var, "OCL_PROGRAM_CACHE_", 18) == 0)
+        continue;
+      if (strncmp(var, "OCL_OUTPUT_", 11) == 0) {
+        const char *value = strchr(var, '=');
+        if (value && strcmp(value + 1, "0") != 0 && value[1] != '\0')
+          return false;
+      }
+      vars.push_back(var);
+    }
+    std::sort(vars.begin(), vars.end());
+    return true;
+  }
+
+  std::string programCacheKey(uint32_t deviceID,
+                              const char *source,
+                              const std::vector<std::string> &clOpt,
+                              uint32_t oclVersion)
+  {
+    if (!programCacheEnabled() || source == NULL)
+      return "";
+    // Included files are not part of the key
+    if (strstr(source, "#include") != NULL)
+      return "";
+    std::vector<std::string> vars;
+    if (!collectEnvironment(vars))
+      return "";
+
+    Hasher h[2] = {Hasher(fnvBasis0), Hasher(fnvBasis1)};
+    for (uint32_t i = 0; i < 2; ++i) {
+      hashCompilerIdentity(h[i]);
+      h[i].updateValue(deviceID);
+      h[i].updateValue(oclVersion);
+      h[i].updateValue(clOpt.size());
+      for (const auto &opt : clOpt)
+        h[i].update(opt);
+      h[i].updateValue(vars.size());
+      for (const auto &var : vars)
+        h[i].update(var);
+      h[i].update(source, strlen(source));
+    }
+
+    char key[33];
+    snprintf(key, sizeof(key), "%016llx%016llx",
+             (unsigned long long) h[0].value(),
+             (unsigned long long) h[1].value());
+    return key;
+  }
+
+  bool programCacheLoad(const std::string &key, std::string &binary) {
+    if (key.empty())
+      return false;
+    const std::string path = entryPath(key);
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL)
+      return false;
+
+    CacheEntryHeader header;
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+                 header.magic == cacheMagic &&
+                 header.version == cacheVersion &&
+                 header.size > 0 && header.size < (1ull << 32);
+    if (valid) {
+      binary.resize(header.size);
+      valid = fread(&binary[0], 1, header.size, f) == header.size &&
+              checksum(binary.c_str(), binary.size()) == header.checksum;
+    }
+    fclose(f);
+
+    if (!valid) {
+      binary.clear();
+      unlink(path.c_str());
+      return false;
+    }
+    // The modification time orders the entries for eviction
+    utimes(path.c_str(), NULL);
+    return true;
+  }
+
+  struct CacheFile {
+    std::string path;
+    off_t size;
+    time_t mtime;
+    bool operator< (const CacheFile &other) const { return mtime < other.mtime; }
+  };
+
+  /*! Remove the least recently used entries until the cache fits. Only one
+   *  process trims at a time, the others just skip it
+   */
+  static void programCacheTrim(void) {
+    const std::string lockPath = OCL_PROGRAM_CACHE_DIR + "/.lock";
+    int lockFd = open(lockPath.c_str(), O_CREAT | O_RDWR, 0600);
+    if (lockFd < 0)
+      return;
+    if (flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+      close(lockFd);
+      return;
+    }
+
+    DIR *dir = opendir(OCL_PROGRAM_CACHE_DIR.c_str());
+    if (dir != NULL) {
+      std::vector<CacheFile> files;
+      uint64_t total = 0;
+      const time_t now = time(NULL);
+      struct dirent *entry;
+      while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (name[0] == '.')
+          continue;
+        CacheFile file;
+        file.path = OCL_PROGRAM_CACHE_DIR + "/" + name;
+        struct stat st;
+        if (stat(file.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+          continue;
+        if (strstr(name, ".tmp.") != NULL) {
+          if (now - st.st_mtime > cacheStaleTmpAge)
+            unlink(file.path.c_str());
+          continue;
+        }
+        file.size = st.st_size;
+        file.mtime = st.st_mtime;
+        total += st.st_size;
+        files.push_back(file);
+      }
+      closedir(dir);
+
+      const uint64_t limit = uint64_t(OCL_PROGRAM_CACHE_SIZE) << 20;
+      std::sort(files.begin(), files.end());
+      for (size_t i = 0; i < files.size() && total > limit; ++i) {
+        if (unlink(files[i].path.c_str()) == 0)
+          total -= files[i].size;
+      }
+    }
+
+    flock(lockFd, LOCK_UN);
+    close(lockFd);
+  }
+
+  void programCacheStore(const std::string &key, const char *binary, size_t size) {
+    if (key.empty() || binary == NULL || size == 0)
+      return;
+    mkdir(OCL_PROGRAM_CACHE_DIR.c_str(), 0700);
+
+    // Write a private file and publish it atomically
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".tmp.%d.%lx", (int) getpid(), (unsigned long) pthread_self());
+    const std::string path = entryPath(key);
+    const std::string tmpPath = path + suffix;
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (f == NULL)
+      return;
+
+    CacheEntryHeader header;
+    header.magic = cacheMagic;
+    header.version = cacheVersion;
+    header.size = size;
+    header.checksum = checksum(binary, size);
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                   fwrite(binary, 1, size, f) == size;
+    written = (fclose(f) == 0) && written;
+    if (!written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+      unlink(tmpPath.c_str());
+      return;
+    }
+
+    programCacheTrim();
+  }
+} /* namespace gbe */
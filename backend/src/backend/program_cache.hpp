@@ -0,0 +1,53 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file program_cache.hpp
+ *
+ * Persistent on-disk cache of the Gen binaries built from OpenCL C source.
+ * Entries are content addressed: the key hashes the source, the processed
+ * clang options, the device ID, the compiler version and every OCL_*
+ * environment variable that may change the generated code. Entries are
+ * written to a temporary file and renamed in place so that any number of
+ * processes can share the same directory.
+ */
+#ifndef __GBE_PROGRAM_CACHE_HPP__
+#define __GBE_PROGRAM_CACHE_HPP__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace gbe
+{
+  /*! Says if the cache is enabled (OCL_PROGRAM_CACHE_DIR is set) */
+  bool programCacheEnabled(void);
+  /*! Compute the key of a build. Returns an empty string when the build
+   *  must not go through the cache
+   */
+  std::string programCacheKey(uint32_t deviceID,
+                              const char *source,
+                              const std::vector<std::string> &clOpt,
+                              uint32_t oclVersion);
+  /*! Read the Gen binary stored under key. Returns false on a miss */
+  bool programCacheLoad(const std::string &key, std::string &binary);
+  /*! Store the Gen binary under key and trim the cache to its size limit */
+  void programCacheStore(const std::string &key, const char *binary, size_t size);
+} /* namespace gbe */
+
+#endif /* __GBE_PROGRAM_CACHE_HPP__ */
@@ -79,6 +79,8 @@ struct BinInterpCallBackInitializer
     gbe_release_printf_info = gbe::kernelReleasePrintfSet;
     gbe_output_printf = gbe::kernelOutputPrintf;
     gbe_kernel_use_device_enqueue = gbe::kernelUseDeviceEnqueue;
+    gbe_kernel_has_partial_group_guard = gbe::kernelHasPartialGroupGuard;
+    gbe_kernel_use_barrier = gbe::kernelUseBarrier;
   }
 
   ~BinInterpCallBackInitializer() {
@@ -563,6 +563,12 @@ namespace ir {
     INLINE bool setUseDeviceEnqueue(bool useDeviceEnqueue) {
       return this->useDeviceEnqueue = useDeviceEnqueue;
     }
+    /*! Does it disable the work items beyond the global size */
+    INLINE bool getPartialGroupGuard(void) const { return this->partialGroupGuard; }
+    /*! Change the partial work group info of the function */
+    INLINE bool setPartialGroupGuard(bool partialGroupGuard) {
+      return this->partialGroupGuard = partialGroupGuard;
+    }
   private:
     friend class Context;           //!< Can freely modify a function
     std::string name;               //!< Function name
@@ -591,6 +597,7 @@ namespace ir {
     int32_t wgBroadcastSLM;         //!< Used for broadcast the workgroup value.
     int32_t tidMapSLM;              //!< Used to store the map between groupid and hw thread.
     bool useDeviceEnqueue;          //!< Has device enqueue?
+    bool partialGroupGuard;         //!< Disables the work items beyond the global size?
     GBE_CLASS(Function);            //!< Use custom allocator
   };
 
@@ -988,6 +988,29 @@ namespace ir {
       Register src[2];
     };
 
+    class ALIGNED_INSTRUCTION IndirectReadInstruction :
+      public BasePolicy,
+      public TupleSrcPolicy<IndirectReadInstruction>,
+      public NDstPolicy<IndirectReadInstruction, 1>
+    {
+    public:
+      INLINE IndirectReadInstruction(Type type, Register dst, Tuple src, uint32_t elemNum) {
+        this->type = type;
+        this->dst[0] = dst;
+        this->src = src;
+        this->srcNum = elemNum + 1;
+        this->opcode = OP_INDIRECT_READ;
+      }
+      INLINE Type getType(void) const { return this->type; }
+      INLINE uint32_t getElementNum(void) const { return this->srcNum - 1; }
+      INLINE bool wellFormed(const Function &fn, std::string &why) const;
+      INLINE void out(std::ostream &out, const Function &fn) const;
+      Type type;
+      uint16_t srcNum;            //!< Index and elements
+      Tuple src;
+      Register dst[1];
+    };
+
     class ALIGNED_INSTRUCTION LabelInstruction :
       public BasePolicy,
       public NSrcPolicy<LabelInstruction, 0>,
@@ -1596,6 +1619,27 @@ namespace ir {
       return true;
     }
 
+    INLINE bool IndirectReadInstruction::wellFormed(const Function &fn, std::string &whyNot) const
+    {
+      const RegisterFamily family = getFamily(this->type);
+      if (UNLIKELY(family != FAMILY_DWORD)) {
+        whyNot = "Only dword registers can be read indirectly";
+        return false;
+      }
+      if (UNLIKELY(this->srcNum < 2)) {
+        whyNot = "Wrong number of source.";
+        return false;
+      }
+      if (UNLIKELY(checkSpecialRegForWrite(dst[0], fn, whyNot) == false))
+        return false;
+      if (UNLIKELY(checkRegisterData(family, dst[0], fn, whyNot) == false))
+        return false;
+      for (uint32_t srcID = 0; srcID < this->srcNum; ++srcID)
+        if (UNLIKELY(checkRegisterData(FAMILY_DWORD, getSrc(fn, srcID), fn, whyNot) == false))
+          return false;
+      return true;
+    }
+
     // Only a label index is required
     INLINE bool LabelInstruction::wellFormed(const Function &fn, std::string &whyNot) const
     {
@@ -1897,6 +1941,14 @@ namespace ir {
       out << " %" << this->getSrc(fn, 1) << " offset: " << this->offset;
     }
 
+    INLINE void IndirectReadInstruction::out(std::ostream &out, const Function &fn) const {
+      this->outOpcode(out);
+      out << "." << type << " %" << this->getDst(fn, 0) << " %" << this->getSrc(fn, 0) << " {";
+      for (uint32_t i = 1; i < this->srcNum; ++i)
+        out << "%" << this->getSrc(fn, i) << (i != this->srcNum - 1u ? " " : "");
+      out << "}";
+    }
+
     INLINE void LabelInstruction::out(std::ostream &out, const Function &fn) const {
       this->outOpcode(out);
       out << " $" << labelIndex;
@@ -2217,6 +2269,10 @@ START_INTROSPECTION(IndirectMovInstruction)
 #include "ir/instruction.hxx"
 END_INTROSPECTION(IndirectMovInstruction)
 
+START_INTROSPECTION(IndirectReadInstruction)
+#include "ir/instruction.hxx"
+END_INTROSPECTION(IndirectReadInstruction)
+
 START_INTROSPECTION(LabelInstruction)
 #include "ir/instruction.hxx"
 END_INTROSPECTION(LabelInstruction)
@@ -2444,6 +2500,8 @@ DECL_MEM_FN(SimdShuffleInstruction, Type, getType(void), getType())
 DECL_MEM_FN(RegionInstruction, uint32_t, getOffset(void), getOffset())
 DECL_MEM_FN(IndirectMovInstruction, uint32_t, getOffset(void), getOffset())
 DECL_MEM_FN(IndirectMovInstruction, Type, getType(void), getType())
+DECL_MEM_FN(IndirectReadInstruction, Type, getType(void), getType())
+DECL_MEM_FN(IndirectReadInstruction, uint32_t, getElementNum(void), getElementNum())
 DECL_MEM_FN(SampleInstruction, Type, getSrcType(void), getSrcType())
 DECL_MEM_FN(SampleInstruction, Type, getDstType(void), getDstType())
 DECL_MEM_FN(SampleInstruction, uint8_t, getSamplerIndex(void), getSamplerIndex())
@@ -2749,6 +2807,10 @@ DECL_MEM_FN(MemInstruction, void,     setBtiReg(Register reg), setBtiReg(reg))
     return internal::IndirectMovInstruction(type, dst, src0, src1, offset).convert();
   }
 
+  Instruction INDIRECT_READ(Type type, Register dst, Tuple src, uint32_t elemNum) {
+    return internal::IndirectReadInstruction(type, dst, src, elemNum).convert();
+  }
+
   // LABEL
   Instruction LABEL(LabelIndex labelIndex) {
     return internal::LabelInstruction(labelIndex).convert();
@@ -613,6 +613,16 @@ namespace ir {
     static bool isClassOf(const Instruction &insn);
   };
 
+  /*! Read the element of a register array selected by an index register */
+  class IndirectReadInstruction : public Instruction {
+  public:
+    Type getType(void) const;
+    /*! Number of registers in the array, after the index source */
+    uint32_t getElementNum(void) const;
+    /*! Return true if the given instruction is an instance of this class */
+    static bool isClassOf(const Instruction &insn);
+  };
+
   /*! Indirect Move instruction */
   class WaitInstruction : public Instruction {
   public:
@@ -885,6 +895,8 @@ namespace ir {
   Instruction READ_ARF(Type type, Register dst, ARFRegister arf);
   Instruction REGION(Register dst, Register src, uint32_t offset);
   Instruction INDIRECT_MOV(Type type, Register dst, Register src0, Register src1, uint32_t offset);
+  /*! indirect_read.type dst index {src1,...,src_elemNum} */
+  Instruction INDIRECT_READ(Type type, Register dst, Tuple src, uint32_t elemNum);
   /*! typed write */
   Instruction TYPED_WRITE(uint8_t imageIndex, Tuple src, uint8_t srcNum, Type srcType, Type coordType);
   /*! sample textures */
@@ -118,3 +118,4 @@ DECL_INSN(PRINTF, PrintfInstruction)
 DECL_INSN(MBREAD, MediaBlockReadInstruction)
 DECL_INSN(MBWRITE, MediaBlockWriteInstruction)
 DECL_INSN(BFREV, UnaryInstruction)
+DECL_INSN(INDIRECT_READ, IndirectReadInstruction)
@@ -22,39 +22,91 @@
  * \author Benjamin Segovia <benjamin.segovia@intel.com>
  */
 #include "ir/liveness.hpp"
+#include "sys/cvar.hpp"
 #include <sstream>
 
 namespace gbe {
 namespace ir {
 
+  size_t LiveSet::size(void) const {
+    if (dense == false) return regs.size();
+    size_t num = 0;
+    for (auto word : words) num += __builtin_popcountll(word);
+    return num;
+  }
+
+  uint32_t LiveSet::nextBit(uint32_t from) const {
+    const uint32_t wordNum = words.size();
+    uint32_t wordID = from / wordBits;
+    if (wordID >= wordNum) return this->bitNum();
+    Word word = words[wordID] & (~Word(0) << (from % wordBits));
+    while (word == 0) {
+      if (++wordID == wordNum) return this->bitNum();
+      word = words[wordID];
+    }
+    return wordID * wordBits + __builtin_ctzll(word);
+  }
+
+  bool LiveSet::unionWith(const LiveSet &other) {
+    bool changed = false;
+    if (dense && other.dense) {
+      if (other.words.size() > words.size())
+        words.resize(other.words.size(), 0);
+      for (uint32_t i = 0; i < other.words.size(); ++i) {
+        const Word merged = words[i] | other.words[i];
+        changed |= merged != words[i];
+        words[i] = merged;
+      }
+    } else
+      for (auto reg : other)
+        changed |= this->insert(reg);
+    return changed;
+  }
+
+  bool LiveSet::unionWithDifference(const LiveSet &a, const LiveSet &b) {
+    bool changed = false;
+    if (dense && a.dense && b.dense) {
+      if (a.words.size() > words.size())
+        words.resize(a.words.size(), 0);
+      for (uint32_t i = 0; i < a.words.size(); ++i) {
+        const Word killed = i < b.words.size() ? b.words[i] : 0;
+        const Word merged = words[i] | (a.words[i] & ~killed);
+        changed |= merged != words[i];
+        words[i] = merged;
+      }
+    } else
+      for (auto reg : a)
+        if (b.contains(reg) == false)
+          changed |= this->insert(reg);
+    return changed;
+  }
+
+  /*! Sparse register sets instead of bit vectors (to compare both) */
+  BVAR(OCL_SPARSE_LIVENESS, false);
+
   Liveness::Liveness(Function &fn, bool isInGenBackend) : fn(fn) {
+    dense = !OCL_SPARSE_LIVENESS;
     // Initialize UEVar and VarKill for each block
     fn.foreachBlock([this](const BasicBlock &bb) {
       this->initBlock(bb);
-      // If the bb has ret instruction, add it to the work list set.
+      // If the bb has ret instruction, the return value is alive at its end
       const Instruction *lastInsn = bb.getLastInstruction();
       const ir::Opcode op = lastInsn->getOpcode();
       struct BlockInfo * info = liveness[&bb];
-      if (op == OP_RET) {
-        workSet.insert(info);
+      if (op == OP_RET)
         info->liveOut.insert(ocl::retVal);
-      }
     });
     // Now with iterative analysis, we compute liveout and livein sets
-    while (unvisitBlocks.size()) {
-      if (workSet.size() == 0)
-        workSet.insert(--unvisitBlocks.end(), unvisitBlocks.end());
-      this->computeLiveInOut();
-    }
+    this->computeLiveInOut();
     // extend register (def in loop, use out-of-loop) liveness to the whole loop
     set<Register> extentRegs;
     // Only in Gen backend we need to take care of extra live out analysis.
     if (isInGenBackend) {
       this->computeExtraLiveInOut(extentRegs);
-      // analyze uniform values. The extentRegs contains all the values which is
-      // defined in a loop and use out-of-loop which could not be a uniform. The reason
-      // is that when it reenter the second time, it may active different lanes. So
-      // reenter many times may cause it has different values in different lanes.
+      // analyze uniform values. The registers merged after a divergent branch
+      // and the ones defined in a loop with a divergent exit and used out of it
+      // are not uniform: the lanes may get them from different paths or
+      // iterations.
       this->analyzeUniform(&extentRegs);
     }
   }
@@ -106,61 +158,242 @@ namespace ir {
     for (auto &pair : liveness) GBE_SAFE_DELETE(pair.second);
   }
 
+  /*! Uniform values only from the data flow of the sources, without looking
+   *  at the branches (to compare both) */
+  BVAR(OCL_DIVERGENCE_ANALYSIS, true);
+
+  /*! Can the instruction give a uniform destination from uniform sources */
+  static bool isUniformDef(const Function &fn, const Instruction &insn, Register reg) {
+    const Opcode opcode = insn.getOpcode();
+    // do not change dst uniform for simd id and block reads
+    if (opcode == OP_SIMD_ID || opcode == OP_MBREAD ||
+        (opcode == OP_LOAD && cast<LoadInstruction>(insn).isBlock()))
+      return false;
+    // FIXME, ADDSAT and uniform vector should be supported.
+    return fn.getRegisterFamily(reg) != FAMILY_QWORD &&
+           opcode != OP_ATOMIC &&
+           opcode != OP_MUL_HI &&
+           opcode != OP_HADD &&
+           opcode != OP_RHADD &&
+           opcode != OP_READ_ARF &&
+           opcode != OP_ADDSAT &&
+           opcode != OP_IME &&
+           (insn.getDstNum() == 1 || opcode != OP_LOAD);
+  }
+
+  void Liveness::getPostDominators(const vector<const BasicBlock*> &blocks,
+                                   const map<const BasicBlock*, uint32_t> &blockID,
+                                   vector<int32_t> &ipdom) const {
+    const uint32_t blockNum = blocks.size();
+    const uint32_t exit = blockID.find(&fn.getBottomBlock())->second;
+    // Post-order of the reversed CFG from the exit block
+    vector<int32_t> order(blockNum, -1);
+    vector<uint32_t> postOrder;
+    vector<std::pair<uint32_t, BlockSet::const_iterator>> stack;
+    vector<uint8_t> visited(blockNum, 0);
+    visited[exit] = 1;
+    stack.push_back(std::make_pair(exit, blocks[exit]->getPredecessorSet().begin()));
+    while (stack.empty() == false) {
+      const uint32_t id = stack.back().first;
+      auto &it = stack.back().second;
+      if (it != blocks[id]->getPredecessorSet().end()) {
+        const uint32_t pred = blockID.find(*it)->second;
+        ++it;
+        if (visited[pred] == 0) {
+          visited[pred] = 1;
+          stack.push_back(std::make_pair(pred, blocks[pred]->getPredecessorSet().begin()));
+        }
+      } else {
+        order[id] = postOrder.size();
+        postOrder.push_back(id);
+        stack.pop_back();
+      }
+    }
+
+    // Iterate on the reverse post-order until the immediate post-dominators
+    // are stable (Cooper, Harvey and Kennedy). The blocks not reaching the
+    // exit have none.
+    ipdom.assign(blockNum, -1);
+    ipdom[exit] = exit;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (auto it = postOrder.rbegin(); it != postOrder.rend(); ++it) {
+        const uint32_t id = *it;
+        if (id == exit) continue;
+        int32_t newIpdom = -1;
+        for (auto succ : blocks[id]->getSuccessorSet()) {
+          int32_t other = blockID.find(succ)->second;
+          if (ipdom[other] == -1) continue;
+          if (newIpdom == -1) {
+            newIpdom = other;
+            continue;
+          }
+          while (other != newIpdom) {
+            while (order[other] < order[newIpdom]) other = ipdom[other];
+            while (order[newIpdom] < order[other]) newIpdom = ipdom[newIpdom];
+          }
+        }
+        if (newIpdom != ipdom[id]) {
+          ipdom[id] = newIpdom;
+          changed = true;
+        }
+      }
+    }
+    ipdom[exit] = -1;
+  }
+
   void Liveness::analyzeUniform(set<Register> *extentRegs) {
-    fn.foreachBlock([this, extentRegs](const BasicBlock &bb) {
-      const_cast<BasicBlock&>(bb).foreach([this, extentRegs](const Instruction &insn) {
-        const uint32_t srcNum = insn.getSrcNum();
-        const uint32_t dstNum = insn.getDstNum();
-        bool uniform = true;
+    const uint32_t regNum = fn.regNum();
+    vector<const BasicBlock*> blocks;
+    map<const BasicBlock*, uint32_t> blockID;
+    fn.foreachBlock([&](const BasicBlock &bb) {
+      blockID[&bb] = blocks.size();
+      blocks.push_back(&bb);
+    });
 
-        //do not change dst uniform for simd id
-        if (insn.getOpcode() == ir::OP_SIMD_ID)
-          uniform = false;
+    // The registers defined in the function are uniform until a divergent
+    // source, instruction or branch is found. The others keep their profile
+    // setting (lid, kernel arguments...), as the ones created uniform
+    vector<uint8_t> divergent(regNum, 0);
+    vector<uint8_t> defined(regNum, 0);
+    bool changed = false;
+    auto markDivergent = [&](Register reg) {
+      if (divergent[reg.value()] || fn.isUniformRegister(reg))
+        return;
+      divergent[reg.value()] = 1;
+      changed = true;
+    };
+    fn.foreachInstruction([&](const Instruction &insn) {
+      for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID) {
+        const Register reg = insn.getDst(dstID);
+        defined[reg.value()] = 1;
+        if (!isUniformDef(fn, insn, reg))
+          markDivergent(reg);
+        // Without the control dependences, the merged values can not be uniform
+        if (!OCL_DIVERGENCE_ANALYSIS &&
+            (insn.getParent()->definedPhiRegs.contains(reg) || extentRegs->contains(reg)))
+          markDivergent(reg);
+      }
+    });
+    for (uint32_t regID = 0; regID < regNum; ++regID)
+      if (defined[regID] == 0 && !fn.isUniformRegister(Register(regID)))
+        divergent[regID] = 1;
 
-        // do not change dst uniform for block read
-        if ((insn.getOpcode() == ir::OP_LOAD && ir::cast<ir::LoadInstruction>(insn).isBlock()) ||
-            insn.getOpcode() == ir::OP_MBREAD)
-          uniform = false;
+    vector<int32_t> ipdom;
+    if (OCL_DIVERGENCE_ANALYSIS)
+      this->getPostDominators(blocks, blockID, ipdom);
+    vector<uint8_t> divergentBranch(blocks.size(), 0);
+    vector<uint8_t> region(blocks.size());
+    vector<uint32_t> worklist;
+    vector<const BlockInfo*> innerJoins;
+    auto isLiveIn = [](const BlockInfo *info, Register reg) {
+      return info->upwardUsed.contains(reg) ||
+             (info->liveOut.contains(reg) && !info->varKill.contains(reg));
+    };
+    const vector<Loop *> &loops = fn.getLoops();
 
-        for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
-          const Register reg = insn.getSrc(srcID);
-          if (!fn.isUniformRegister(reg))
+    // Iterate until no register becomes divergent
+    changed = true;
+    while (changed) {
+      changed = false;
+      // A destination computed from a divergent source is divergent
+      fn.foreachInstruction([&](const Instruction &insn) {
+        bool uniform = true;
+        for (uint32_t srcID = 0; srcID < insn.getSrcNum(); ++srcID)
+          if (divergent[insn.getSrc(srcID).value()])
             uniform = false;
+        if (uniform) return;
+        for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID)
+          markDivergent(insn.getDst(dstID));
+      });
+      if (!OCL_DIVERGENCE_ANALYSIS)
+        continue;
+
+      // Lanes leaving a divergent branch meet again at its immediate
+      // post-dominator. The values defined in between and still used there
+      // differ from one lane to the other
+      for (uint32_t id = 0; id < blocks.size(); ++id) {
+        if (divergentBranch[id]) continue;
+        const BasicBlock &bb = *blocks[id];
+        const_cast<BasicBlock&>(bb).foreach([&](const Instruction &insn) {
+          if (insn.isMemberOf<BranchInstruction>() &&
+              cast<BranchInstruction>(insn).isPredicated() &&
+              divergent[cast<BranchInstruction>(insn).getPredicateIndex().value()])
+            divergentBranch[id] = 1;
+        });
+        if (divergentBranch[id] == 0) continue;
+
+        const int32_t join = ipdom[id];
+        std::fill(region.begin(), region.end(), 0);
+        worklist.clear();
+        for (auto succ : bb.getSuccessorSet())
+          worklist.push_back(blockID[succ]);
+        while (worklist.empty() == false) {
+          const uint32_t curr = worklist.back();
+          worklist.pop_back();
+          if (region[curr] || (int32_t) curr == join) continue;
+          region[curr] = 1;
+          for (auto succ : blocks[curr]->getSuccessorSet())
+            worklist.push_back(blockID[succ]);
+        }
+        // Without any join, nothing defined in the region is uniform. The
+        // lanes may also meet before the post-dominator, at the blocks of the
+        // region with several predecessors. The phi copies of the region may
+        // be done by some lanes only, but with uniform writes for all of them
+        const BlockInfo *joinInfo = join == -1 ? NULL : liveness[blocks[join]];
+        innerJoins.clear();
+        for (uint32_t curr = 0; curr < blocks.size(); ++curr)
+          if (region[curr] && blocks[curr]->getPredecessorSet().size() > 1)
+            innerJoins.push_back(liveness[blocks[curr]]);
+        for (uint32_t curr = 0; curr < blocks.size(); ++curr) {
+          if (region[curr] == 0) continue;
+          for (auto reg : blocks[curr]->definedPhiRegs)
+            markDivergent(reg);
+          for (auto reg : liveness[blocks[curr]]->varKill) {
+            if (joinInfo == NULL || isLiveIn(joinInfo, reg)) {
+              markDivergent(reg);
+              continue;
+            }
+            for (auto info : innerJoins)
+              if (isLiveIn(info, reg)) {
+                markDivergent(reg);
+                break;
+              }
+          }
         }
+      }
 
-        // A destination is a killed value
-        for (uint32_t dstID = 0; dstID < dstNum; ++dstID) {
-          const Register reg = insn.getDst(dstID);
-          int opCode = insn.getOpcode();
-          // FIXME, ADDSAT and uniform vector should be supported.
-          if (uniform &&
-              fn.getRegisterFamily(reg) != ir::FAMILY_QWORD &&
-              !insn.getParent()->definedPhiRegs.contains(reg) &&
-              opCode != ir::OP_ATOMIC &&
-              opCode != ir::OP_MUL_HI &&
-              opCode != ir::OP_HADD &&
-              opCode != ir::OP_RHADD &&
-              opCode != ir::OP_READ_ARF &&
-              opCode != ir::OP_ADDSAT &&
-              opCode != ir::OP_IME &&
-              (dstNum == 1 || insn.getOpcode() != ir::OP_LOAD) &&
-              !extentRegs->contains(reg)
-             )
-            fn.setRegisterUniform(reg, true);
+      // Lanes leaving a loop at different iterations see different values
+      // of the registers defined in the loop
+      for (auto l : loops) {
+        bool divergentExit = false;
+        for (auto &x : l->exits)
+          divergentExit |= divergentBranch[blockID[&fn.getBlock(x.first)]] != 0;
+        if (!divergentExit) continue;
+        for (auto &x : l->exits) {
+          const BlockInfo *exit = liveness[&fn.getBlock(x.second)];
+          for (auto bb : l->bbs)
+            for (auto reg : liveness[&fn.getBlock(bb)]->varKill)
+              if (exit->upwardUsed.contains(reg))
+                markDivergent(reg);
         }
-      });
-    });
+      }
+    }
+
+    for (uint32_t regID = 0; regID < regNum; ++regID)
+      if (defined[regID] && divergent[regID] == 0)
+        fn.setRegisterUniform(Register(regID), true);
   }
 
   void Liveness::initBlock(const BasicBlock &bb) {
     GBE_ASSERT(liveness.contains(&bb) == false);
-    BlockInfo *info = GBE_NEW(BlockInfo, bb);
+    BlockInfo *info = GBE_NEW(BlockInfo, bb, dense, fn.regNum());
     // Traverse all instructions to handle UEVar and VarKill
     const_cast<BasicBlock&>(bb).foreach([this, info](const Instruction &insn) {
       this->initInstruction(*info, insn);
     });
     liveness[&bb] = info;
-    unvisitBlocks.insert(info);
     if(!bb.liveout.empty())
       info->liveOut.insert(bb.liveout.begin(), bb.liveout.end());
   }
@@ -182,32 +415,73 @@ namespace ir {
     }
   }
 
-// Use simple backward data flow analysis to solve the liveness problem.
+  void Liveness::getPostOrder(vector<BlockInfo*> &order) {
+    set<const BasicBlock*> visited;
+    vector<std::pair<const BasicBlock*, BlockSet::const_iterator>> stack;
+    const BasicBlock *top = &fn.getTopBlock();
+    visited.insert(top);
+    stack.push_back(std::make_pair(top, top->getSuccessorSet().begin()));
+    while (stack.empty() == false) {
+      const BasicBlock *bb = stack.back().first;
+      auto &succ = stack.back().second;
+      if (succ == bb->getSuccessorSet().end()) {
+        order.push_back(liveness[bb]);
+        stack.pop_back();
+        continue;
+      }
+      const BasicBlock *next = *succ++;
+      if (visited.contains(next)) continue;
+      visited.insert(next);
+      stack.push_back(std::make_pair(next, next->getSuccessorSet().begin()));
+    }
+    // The blocks not reachable from the top block still need a liveness
+    fn.foreachBlock([&](const BasicBlock &bb) {
+      if (visited.contains(&bb) == false)
+        order.push_back(liveness[&bb]);
+    });
+  }
+
+  // Use simple backward data flow analysis to solve the liveness problem. The
+  // blocks are visited in post-order so that most successors of a block are
+  // done before it, and a block is visited again only when the liveIn of one
+  // of its successors grew
   void Liveness::computeLiveInOut(void) {
-    while(!workSet.empty()) {
-      auto currInfo = *workSet.begin();
-      workSet.erase(currInfo);
-      if (unvisitBlocks.find(currInfo) != unvisitBlocks.end())
-        unvisitBlocks.erase(currInfo);
-      for (auto currOutVar : currInfo->liveOut)
-        if (!currInfo->varKill.contains(currOutVar))
-          currInfo->upwardUsed.insert(currOutVar);
-      bool isChanged = false;
-      for (auto prev : currInfo->bb.getPredecessorSet()) {
-        BlockInfo *prevInfo = liveness[prev];
-        if (unvisitBlocks.find(currInfo) != unvisitBlocks.end())
-          unvisitBlocks.erase(currInfo);
-        for (auto currInVar : currInfo->upwardUsed) {
-          if (!prevInfo->bb.undefPhiRegs.contains(currInVar)) {
-            auto changed = prevInfo->liveOut.insert(currInVar);
-            if (changed.second) isChanged = true;
+    vector<BlockInfo*> order;
+    this->getPostOrder(order);
+    const uint32_t blockNum = order.size();
+    map<const BasicBlock*, uint32_t> orderID;
+    for (uint32_t i = 0; i < blockNum; ++i)
+      orderID[&order[i]->bb] = i;
+
+    vector<uint8_t> pending(blockNum, 1u);
+    uint32_t pendingNum = blockNum;
+    while (pendingNum > 0) {
+      for (uint32_t i = 0; i < blockNum; ++i) {
+        if (pending[i] == 0) continue;
+        pending[i] = 0;
+        pendingNum--;
+        BlockInfo *currInfo = order[i];
+        currInfo->upwardUsed.unionWithDifference(currInfo->liveOut, currInfo->varKill);
+        for (auto prev : currInfo->bb.getPredecessorSet()) {
+          BlockInfo *prevInfo = liveness[prev];
+          bool isChanged = false;
+          if (prev->undefPhiRegs.empty())
+            isChanged = prevInfo->liveOut.unionWith(currInfo->upwardUsed);
+          else {
+            for (auto currInVar : currInfo->upwardUsed)
+              if (!prev->undefPhiRegs.contains(currInVar))
+                isChanged |= prevInfo->liveOut.insert(currInVar);
+          }
+          const uint32_t prevID = orderID[prev];
+          if (isChanged && pending[prevID] == 0) {
+            pending[prevID] = 1;
+            pendingNum++;
           }
         }
-        if (isChanged )
-          workSet.insert(prevInfo);
       }
-    };
-   }
+    }
+  }
+
 /*
   As we run in SIMD mode with prediction mask to indicate active lanes.
   If a vreg is defined in a loop, and there are som uses of the vreg out of the loop,
@@ -25,8 +25,10 @@
 #define __GBE_IR_LIVENESS_HPP__
 
 #include <list>
+#include <iterator>
 #include "sys/map.hpp"
 #include "sys/set.hpp"
+#include "sys/vector.hpp"
 #include "ir/register.hpp"
 #include "ir/function.hpp"
 
@@ -44,6 +46,120 @@ namespace ir {
     DF_SUCC = 1
   };
 
+  /*! Set of registers used by the liveness. The registers are either kept in
+   *  a std::set (sparse) or as one bit per register of the function (dense),
+   *  where unions and differences are computed a word at a time. Both are
+   *  iterated in increasing register order
+   */
+  class LiveSet
+  {
+  public:
+    typedef uint64_t Word;
+    typedef set<Register> RegSet;
+    static const uint32_t wordBits = 64;
+    /*! Build an empty set able to hold regNum registers without growing */
+    LiveSet(bool dense = false, uint32_t regNum = 0) : dense(dense) {
+      if (dense) words.resize((regNum + wordBits - 1) / wordBits, 0);
+    }
+    /*! Iterate the registers of the set in increasing order */
+    class const_iterator {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef Register value_type;
+      typedef ptrdiff_t difference_type;
+      typedef const Register *pointer;
+      typedef const Register &reference;
+      INLINE const_iterator(const LiveSet *live, RegSet::const_iterator it) :
+        owner(live), it(it), bit(0) {}
+      INLINE const_iterator(const LiveSet *live, uint32_t bit) :
+        owner(live), bit(live->nextBit(bit)) { reg = Register(this->bit); }
+      INLINE const Register &operator* (void) const {
+        return owner->dense ? reg : *it;
+      }
+      INLINE const Register *operator-> (void) const { return &**this; }
+      INLINE const_iterator &operator++ (void) {
+        if (owner->dense) {
+          bit = owner->nextBit(bit + 1);
+          reg = Register(bit);
+        } else
+          ++it;
+        return *this;
+      }
+      INLINE const_iterator operator++ (int) {
+        const_iterator old = *this;
+        ++*this;
+        return old;
+      }
+      INLINE bool operator== (const const_iterator &other) const {
+        return owner->dense ? bit == other.bit : it == other.it;
+      }
+      INLINE bool operator!= (const const_iterator &other) const {
+        return !(*this == other);
+      }
+    private:
+      const LiveSet *owner;               //!< Set we iterate on
+      RegSet::const_iterator it;          //!< Position in a sparse set
+      uint32_t bit;                       //!< Position in a dense set
+      Register reg;                       //!< Register at bit
+    };
+    typedef const_iterator iterator;
+    INLINE const_iterator begin(void) const {
+      return dense ? const_iterator(this, 0u) : const_iterator(this, regs.begin());
+    }
+    INLINE const_iterator end(void) const {
+      return dense ? const_iterator(this, bitNum()) : const_iterator(this, regs.end());
+    }
+    INLINE const_iterator find(Register reg) const {
+      if (dense)
+        return this->contains(reg) ? const_iterator(this, uint32_t(reg)) : this->end();
+      return const_iterator(this, regs.find(reg));
+    }
+    INLINE bool contains(Register reg) const {
+      if (dense) {
+        const uint32_t id = reg;
+        return id < bitNum() && (words[id / wordBits] & bitMask(id)) != 0;
+      }
+      return regs.contains(reg);
+    }
+    /*! Return true if the register was not in the set yet */
+    INLINE bool insert(Register reg) {
+      if (dense) {
+        const uint32_t id = reg;
+        if (id >= bitNum()) words.resize(id / wordBits + 1, 0);
+        Word &word = words[id / wordBits];
+        if (word & bitMask(id)) return false;
+        word |= bitMask(id);
+        return true;
+      }
+      return regs.insert(reg).second;
+    }
+    template <typename It>
+    INLINE void insert(It first, It last) {
+      for (; first != last; ++first) this->insert(*first);
+    }
+    INLINE void erase(Register reg) {
+      if (dense) {
+        const uint32_t id = reg;
+        if (id < bitNum()) words[id / wordBits] &= ~bitMask(id);
+      } else
+        regs.erase(reg);
+    }
+    size_t size(void) const;
+    INLINE bool empty(void) const { return this->begin() == this->end(); }
+    /*! this |= other. Return true if the set changed */
+    bool unionWith(const LiveSet &other);
+    /*! this |= (a - b). Return true if the set changed */
+    bool unionWithDifference(const LiveSet &a, const LiveSet &b);
+  private:
+    INLINE static Word bitMask(uint32_t id) { return Word(1) << (id % wordBits); }
+    INLINE uint32_t bitNum(void) const { return words.size() * wordBits; }
+    /*! First register of the set greater or equal to from (or bitNum) */
+    uint32_t nextBit(uint32_t from) const;
+    RegSet regs;         //!< Sparse storage
+    vector<Word> words;  //!< Dense storage
+    bool dense;          //!< Which storage is used
+  };
+
   /*! Compute liveness of each register */
   class Liveness : public NonCopyable
   {
@@ -51,14 +167,15 @@ namespace ir {
     Liveness(Function &fn, bool isInGenBackend = false);
     ~Liveness(void);
     /*! Set of variables used upwards in the block (before a definition) */
-    typedef set<Register> UEVar;
+    typedef LiveSet UEVar;
     /*! Set of variables alive at the exit of the block */
-    typedef set<Register> LiveOut;
+    typedef LiveSet LiveOut;
     /*! Set of variables actually killed in each block */
-    typedef set<Register> VarKill;
+    typedef LiveSet VarKill;
     /*! Per-block info */
     struct BlockInfo : public NonCopyable {
-      BlockInfo(const BasicBlock &bb) : bb(bb) {}
+      BlockInfo(const BasicBlock &bb, bool dense, uint32_t regNum) :
+        bb(bb), upwardUsed(dense, regNum), liveOut(dense, regNum), varKill(dense, regNum) {}
       const BasicBlock &bb;
       INLINE bool inUpwardUsed(Register reg) const {
         return upwardUsed.contains(reg);
@@ -135,11 +252,17 @@ namespace ir {
     /*! Now really compute LiveOut based on UEVar and VarKill */
     void computeLiveInOut(void);
     void computeExtraLiveInOut(set<Register> &extentRegs);
+    /*! Divergence analysis: mark the registers with the same value in all
+     *  the lanes as uniform */
     void analyzeUniform(set<Register> *extentRegs);
-    /*! Set of work list block which has exit(return) instruction */
-    typedef set <struct BlockInfo*> WorkSet;
-    WorkSet workSet;
-    WorkSet unvisitBlocks;
+    /*! Immediate post-dominator of each block, -1 for none */
+    void getPostDominators(const vector<const BasicBlock*> &blocks,
+                           const map<const BasicBlock*, uint32_t> &blockID,
+                           vector<int32_t> &ipdom) const;
+    /*! Blocks in post-order of the CFG, then the unreachable ones */
+    void getPostOrder(vector<BlockInfo*> &order);
+    /*! Use bit vectors or std::sets for the register sets */
+    bool dense;
 
     /*! Use custom allocators */
     GBE_CLASS(Liveness);
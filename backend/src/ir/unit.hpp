@@ -46,6 +46,8 @@ namespace ir {
     /*! Moved from printf pass */
     map<void *, PrintfSet::PrintfFmt*> printfs;
     vector<std::string> blockFuncs;
+    /*! Kernels disabling the work items beyond the global size themselves */
+    vector<std::string> partialGroupKernels;
     /*! Create an empty unit */
     Unit(PointerSize pointerSize = POINTER_32_BITS);
     /*! Release everything (*including* the function pointers) */
@@ -24,6 +24,8 @@
 
 #include "ir/value.hpp"
 #include "ir/liveness.hpp"
+#include <algorithm>
+#include <iterator>
 
 namespace gbe {
 namespace ir {
@@ -41,24 +43,23 @@ namespace ir {
   {
   public:
     LiveOutSet(Liveness &liveness, const FunctionDAG &dag);
-    ~LiveOutSet(void);
-    /*! One set per register */
-    typedef set<ValueDef*> RegDefSet;
-    /*! We have one map of liveout register per block */
-    typedef map<Register, RegDefSet*> BlockDefMap;
-    /*! All the block definitions map in the functions */
-    typedef map<const BasicBlock*, BlockDefMap*> FunctionDefMap;
+    /*! Definitions of one register, sorted by address (i.e. by index in the
+     *  DAG since the definitions are stored in one array)
+     */
+    typedef vector<ValueDef*> RegDefSet;
+    /*! Liveout registers of a block (sorted) and their definitions */
+    struct BlockDefMap {
+      vector<Register> regs;
+      vector<RegDefSet> defs;
+    };
     /*! Performs the double look-up to get the set of defs per register */
     RegDefSet &getDefSet(const BasicBlock *bb, Register reg);
-    /*! Build a UD-chain as the union of the predecessor chains */
-    void makeDefSet(DefSet &udChain, const BasicBlock &bb, Register reg);
-    /*! Fast per register definition set allocation */
-    DECL_POOL(RegDefSet, regDefSetPool);
-    /*! Fast register sets allocation */
-    DECL_POOL(BlockDefMap, blockDefMapPool);
-    FunctionDefMap defMap;    //!< All per-block data
-    Liveness &liveness;       //!< Contains LiveOut information
-    const FunctionDAG &dag;   //!< Structure we are building
+    /*! Append the union of the predecessor chains to udChain */
+    void makeDefSet(vector<ValueDef*> &udChain, const BasicBlock &bb, Register reg);
+    map<const BasicBlock*, uint32_t> blockIndex; //!< Index of each block in defMap
+    vector<BlockDefMap> defMap;                  //!< All per-block data
+    Liveness &liveness;                          //!< Contains LiveOut information
+    const FunctionDAG &dag;                      //!< Structure we are building
   private:
     /*! Initialize liveOut with the instruction destination values */
     void initializeInstructionDef(void);
@@ -85,69 +86,68 @@ namespace ir {
 
   LiveOutSet::RegDefSet &LiveOutSet::getDefSet(const BasicBlock *bb, Register reg)
   {
-    auto bbIt = defMap.find(bb);
-    GBE_ASSERT(bbIt != defMap.end());
-    auto defIt = bbIt->second->find(reg);
-    GBE_ASSERT(defIt != bbIt->second->end() && defIt->second != NULL);
-    return *defIt->second;
+    auto bbIt = blockIndex.find(bb);
+    GBE_ASSERT(bbIt != blockIndex.end());
+    BlockDefMap &block = defMap[bbIt->second];
+    auto regIt = std::lower_bound(block.regs.begin(), block.regs.end(), reg);
+    GBE_ASSERT(regIt != block.regs.end() && *regIt == reg);
+    return block.defs[regIt - block.regs.begin()];
   }
 
-  void LiveOutSet::makeDefSet(DefSet &udChain, const BasicBlock &bb, Register reg)
+  void LiveOutSet::makeDefSet(vector<ValueDef*> &udChain, const BasicBlock &bb, Register reg)
   {
+    const size_t first = udChain.size();
+
     // Iterate over all the predecessors
     const auto &preds = bb.getPredecessorSet();
     for (const auto &pred : preds) {
       if (pred->undefPhiRegs.contains(reg))
         continue;
       RegDefSet &predDef = this->getDefSet(pred, reg);
-      for (auto def : predDef) udChain.insert(def);
+      udChain.insert(udChain.end(), predDef.begin(), predDef.end());
     }
 
     // If this is the top block we must take into account both function
     // arguments and special registers
     const Function &fn = bb.getParent();
-    if (fn.isEntryBlock(bb) == false) return;
-
-    // Is it a function input?
-    const FunctionArgument *arg = fn.getArg(reg);
-    const PushLocation *pushed = fn.getPushLocation(reg);
-
-    // Is it a pushed register?
-    if (pushed != NULL) {
-      ValueDef *def = const_cast<ValueDef*>(dag.getDefAddress(pushed));
-      udChain.insert(def);
-    }
-    // Is a function argument?
-    else if (arg != NULL) {
-      ValueDef *def = const_cast<ValueDef*>(dag.getDefAddress(arg));
-      udChain.insert(def);
-    }
-    // Is it a special register?
-    else if (fn.isSpecialReg(reg) == true) {
-      ValueDef *def = const_cast<ValueDef*>(dag.getDefAddress(reg));
-      udChain.insert(def);
+    if (fn.isEntryBlock(bb) == true) {
+      // Is it a function input?
+      const FunctionArgument *arg = fn.getArg(reg);
+      const PushLocation *pushed = fn.getPushLocation(reg);
+
+      // Is it a pushed register?
+      if (pushed != NULL)
+        udChain.push_back(const_cast<ValueDef*>(dag.getDefAddress(pushed)));
+      // Is a function argument?
+      else if (arg != NULL)
+        udChain.push_back(const_cast<ValueDef*>(dag.getDefAddress(arg)));
+      // Is it a special register?
+      else if (fn.isSpecialReg(reg) == true)
+        udChain.push_back(const_cast<ValueDef*>(dag.getDefAddress(reg)));
     }
+
+    // The predecessors may share definitions
+    std::sort(udChain.begin() + first, udChain.end());
+    udChain.erase(std::unique(udChain.begin() + first, udChain.end()), udChain.end());
   }
 
   void LiveOutSet::initializeInstructionDef(void) {
     const Function &fn = liveness.getFunction();
+    defMap.resize(fn.blockNum());
 
     // Iterate over each block and initialize the liveOut data
     fn.foreachBlock([&](const BasicBlock &bb) {
-      GBE_ASSERT(defMap.find(&bb) == defMap.end());
-
-      // Allocate a map of register definitions
-      auto blockDefMap = this->newBlockDefMap();
-      defMap.insert(std::make_pair(&bb, blockDefMap));
+      GBE_ASSERT(blockIndex.find(&bb) == blockIndex.end());
+      const uint32_t index = blockIndex.size();
+      blockIndex.insert(std::make_pair(&bb, index));
+      BlockDefMap &blockDefMap = defMap[index];
 
       // We only consider liveout registers
       const auto &info = this->liveness.getBlockInfo(&bb);
-      const auto &liveOut = info.liveOut;
-      for (auto reg : liveOut) {
-        GBE_ASSERT(blockDefMap->find(reg) == blockDefMap->end());
-        auto regDefSet = this->newRegDefSet();
-        blockDefMap->insert(std::make_pair(reg, regDefSet));
-      }
+      for (auto reg : info.liveOut)
+        blockDefMap.regs.push_back(reg);
+      std::sort(blockDefMap.regs.begin(), blockDefMap.regs.end());
+      blockDefMap.defs.resize(blockDefMap.regs.size());
 
       // Now traverse the blocks backwards and find the definition of each
       // liveOut register
@@ -163,10 +163,9 @@ namespace ir {
           if (info.inLiveOut(reg) == false) continue;
           defined.insert(reg);
           // Insert the outgoing definition for this register
-          auto regDefSet = blockDefMap->find(reg);
           ValueDef *def = const_cast<ValueDef*>(this->dag.getDefAddress(&insn, dstID));
-          GBE_ASSERT(regDefSet != blockDefMap->end() && def != NULL);
-          regDefSet->second->insert(def);
+          GBE_ASSERT(def != NULL);
+          this->getDefSet(&bb, reg).push_back(def);
         }
       }
     });
@@ -179,8 +178,7 @@ namespace ir {
     // The first block must also transfer the function arguments
     const BasicBlock &top = fn.getTopBlock();
     const Liveness::BlockInfo &info = this->liveness.getBlockInfo(&top);
-    GBE_ASSERT(defMap.contains(&top) == true);
-    auto blockDefMap = defMap.find(&top)->second;
+    GBE_ASSERT(blockIndex.contains(&top) == true);
 
     // Insert all the values that are not overwritten in the block and alive at
     // the end of it
@@ -192,9 +190,7 @@ namespace ir {
       // If we overwrite it, do not transfer the initial value
       if (info.inVarKill(reg) == true) continue;
       ValueDef *def = const_cast<ValueDef*>(this->dag.getDefAddress(&arg));
-      auto it = blockDefMap->find(reg);
-      GBE_ASSERT(it != blockDefMap->end());
-      it->second->insert(def);
+      this->getDefSet(&top, reg).push_back(def);
     }
 
     // Now transfer the special registers that are not over-written
@@ -207,9 +203,7 @@ namespace ir {
       // If we overwrite it, do not transfer the initial value
       if (info.inVarKill(reg) == true) continue;
       ValueDef *def = const_cast<ValueDef*>(this->dag.getDefAddress(reg));
-      auto it = blockDefMap->find(reg);
-      GBE_ASSERT(it != blockDefMap->end());
-      it->second->insert(def);
+      this->getDefSet(&top, reg).push_back(def);
     }
 
     // Finally do the same thing with pushed registers
@@ -221,14 +215,13 @@ namespace ir {
       // If we overwrite it, do not transfer the initial value
       if (info.inVarKill(reg) == true) continue;
       ValueDef *def = const_cast<ValueDef*>(this->dag.getDefAddress(&pushed.second));
-      auto it = blockDefMap->find(reg);
-      GBE_ASSERT(it != blockDefMap->end());
-      it->second->insert(def);
+      this->getDefSet(&top, reg).push_back(def);
     }
   }
 
   void LiveOutSet::iterateLiveOut(void) {
     bool changed = true;
+    RegDefSet merged;
 
     while (changed) {
       changed = false;
@@ -238,47 +231,43 @@ namespace ir {
       liveness.foreach<DF_PRED>([&](Liveness::BlockInfo &curr,
                                     const Liveness::BlockInfo &pred)
       {
-        const BasicBlock &bb = curr.bb;
         const BasicBlock &pbb = pred.bb;
-        for (auto reg : curr.liveOut) {
+        BlockDefMap &block = defMap[blockIndex.find(&curr.bb)->second];
+        const uint32_t regNum = block.regs.size();
+        for (uint32_t i = 0; i < regNum; ++i) {
+          const Register reg = block.regs[i];
           if (pred.inLiveOut(reg) == false) continue;
           if (curr.inVarKill(reg) == true) continue;
-          RegDefSet &currSet = this->getDefSet(&bb, reg);
+          RegDefSet &currSet = block.defs[i];
           RegDefSet &predSet = this->getDefSet(&pbb, reg);
+          if (std::includes(currSet.begin(), currSet.end(),
+                            predSet.begin(), predSet.end()))
+            continue;
 
           // Transfer the values
-          for (auto def : predSet) {
-            if (currSet.contains(def)) continue;
-            changed = true;
-            currSet.insert(def);
-          }
+          merged.clear();
+          std::set_union(currSet.begin(), currSet.end(),
+                         predSet.begin(), predSet.end(),
+                         std::back_inserter(merged));
+          currSet.swap(merged);
+          changed = true;
         }
       });
     }
   }
 
-  LiveOutSet::~LiveOutSet(void) {
-    for (const auto pair : defMap) {
-      BlockDefMap *block = pair.second;
-      for (auto regSet : *block)
-        this->deleteRegDefSet(regSet.second);
-      this->deleteBlockDefMap(block);
-    }
-  }
-
   std::ostream &operator<< (std::ostream &out, LiveOutSet &set) {
-    for (const auto &pair : set.defMap) {
+    for (const auto &pair : set.blockIndex) {
       // To recognize the block, just print its instructions
       out << "Block:" << std::endl;
       for (const auto &insn : *pair.first) out << insn << std::endl;
 
       // Iterate over all alive registers to get their definitions
-      const LiveOutSet::BlockDefMap *defMap = pair.second;
-      if (defMap->size() > 0) out << "LiveSet:" << std::endl;
-      for (const auto &pair : *defMap) {
-        const Register reg = pair.first;
-        const LiveOutSet::RegDefSet *set = pair.second;
-        for (auto def : *set) {
+      const LiveOutSet::BlockDefMap &defMap = set.defMap[pair.second];
+      if (defMap.regs.size() > 0) out << "LiveSet:" << std::endl;
+      for (uint32_t i = 0; i < defMap.regs.size(); ++i) {
+        const Register reg = defMap.regs[i];
+        for (auto def : defMap.defs[i]) {
           const ValueDef::Type type = def->getType();
           if (type == ValueDef::DEF_FN_ARG)
             out << "%" << reg << ": " << "function input" << std::endl;
@@ -297,214 +286,172 @@ namespace ir {
     return out;
   }
 
+  /*! Group the values by key in data, and make one chain per key from it. The
+   *  values keep their order in pairs
+   */
+  template <typename T>
+  static void makeChains(vector<ValueChain<T>> &chains,
+                         vector<T*> &data,
+                         uint32_t keyNum,
+                         const vector<std::pair<uint32_t, T*>> &pairs)
+  {
+    vector<uint32_t> offset(keyNum + 1, 0u);
+    for (const auto &pair : pairs) offset[pair.first + 1]++;
+    for (uint32_t key = 0; key < keyNum; ++key) offset[key + 1] += offset[key];
+    data.resize(pairs.size());
+    vector<uint32_t> cursor(offset.begin(), offset.end() - 1);
+    for (const auto &pair : pairs) data[cursor[pair.first]++] = pair.second;
+    chains.resize(keyNum);
+    for (uint32_t key = 0; key < keyNum; ++key)
+      chains[key] = ValueChain<T>(data.data() + offset[key], offset[key + 1] - offset[key]);
+  }
+
   FunctionDAG::FunctionDAG(Liveness &liveness) :
     fn(liveness.getFunction())
   {
-    // We first start with empty chains
-    udEmpty = this->newDefSet();
-    duEmpty = this->newUseSet();
+    const uint32_t regNum = fn.regNum();
 
-    // First create the chains and insert them in their respective maps
-    fn.foreachInstruction([this](const Instruction &insn) {
+    // Number all the values. The destinations (resp. sources) of an
+    // instruction are consecutive in defs (resp. uses)
+    uint32_t defNum = 0, useNum = 0;
+    fn.foreachInstruction([&](const Instruction &insn) {
+      insnValues.push_back(InsnValues(&insn, defNum, useNum));
+      defNum += insn.getDstNum();
+      useNum += insn.getSrcNum();
+    });
+    const uint32_t argNum = fn.argNum();
+    const uint32_t firstSpecialID = fn.getFirstSpecialReg();
+    const uint32_t specialNum = fn.getSpecialRegNum();
+    const Function::PushMap &pushMap = fn.getPushMap();
+    defs.reserve(defNum + argNum + specialNum + pushMap.size());
+    uses.reserve(useNum);
+    fn.foreachInstruction([&](const Instruction &insn) {
       // sources == value uses
       const uint32_t srcNum = insn.getSrcNum();
-      for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
-        ValueUse *valueUse = this->newValueUse(&insn, srcID);
-        useName.insert(std::make_pair(*valueUse, valueUse));
-        udGraph.insert(std::make_pair(*valueUse, udEmpty));
-      }
+      for (uint32_t srcID = 0; srcID < srcNum; ++srcID)
+        uses.push_back(ValueUse(&insn, srcID));
       // destinations == value defs
       const uint32_t dstNum = insn.getDstNum();
-      for (uint32_t dstID = 0; dstID < dstNum; ++dstID) {
-        ValueDef *valueDef = this->newValueDef(&insn, dstID);
-        defName.insert(std::make_pair(*valueDef, valueDef));
-        duGraph.insert(std::make_pair(*valueDef, duEmpty));
-      }
+      for (uint32_t dstID = 0; dstID < dstNum; ++dstID)
+        defs.push_back(ValueDef(&insn, dstID));
     });
 
-    // Function arguments are also value definitions
-    const uint32_t argNum = fn.argNum();
+    // Function arguments, special registers and pushed registers are also
+    // value definitions. There is at most one of them per register
+    regInitDef.resize(regNum, uint32_t(-1));
     for (uint32_t argID = 0; argID < argNum; ++argID) {
       const FunctionArgument &arg = fn.getArg(argID);
-      ValueDef *valueDef = this->newValueDef(&arg);
-      defName.insert(std::make_pair(*valueDef, valueDef));
-      duGraph.insert(std::make_pair(*valueDef, duEmpty));
+      regInitDef[arg.reg] = defs.size();
+      defs.push_back(ValueDef(&arg));
     }
-
-    // Special registers are also definitions
-    const uint32_t firstID = fn.getFirstSpecialReg();
-    const uint32_t specialNum = fn.getSpecialRegNum();
-    for (uint32_t regID = firstID; regID < firstID + specialNum; ++regID) {
+    for (uint32_t regID = firstSpecialID; regID < firstSpecialID + specialNum; ++regID) {
       const Register reg(regID);
-      ValueDef *valueDef = this->newValueDef(reg);
-      defName.insert(std::make_pair(*valueDef, valueDef));
-      duGraph.insert(std::make_pair(*valueDef, duEmpty));
+      regInitDef[reg] = defs.size();
+      defs.push_back(ValueDef(reg));
     }
-
-    // Pushed registers are also definitions
-    const Function::PushMap &pushMap = fn.getPushMap();
     for (const auto &pushed : pushMap) {
-      ValueDef *valueDef = this->newValueDef(&pushed.second);
-      defName.insert(std::make_pair(*valueDef, valueDef));
-      duGraph.insert(std::make_pair(*valueDef, duEmpty));
+      regInitDef[pushed.first] = defs.size();
+      defs.push_back(ValueDef(&pushed.second));
     }
+    std::sort(insnValues.begin(), insnValues.end());
 
     // We create the liveOutSet to help us transfer the definitions
     LiveOutSet liveOutSet(liveness, *this);
 
-    // Build UD chains traversing the blocks top to bottom
+    // Build UD chains traversing the blocks top to bottom. A chain is a range
+    // of udData that all the uses of a register share until it is redefined
+    typedef std::pair<uint32_t, uint32_t> Range;
+    vector<Range> udRange(useNum, Range(0u, 0u));
+    vector<Range> regRange(regNum);
+    vector<uint32_t> regStamp(regNum, 0u);
+    uint32_t stamp = 0, useID = 0, defID = 0;
     fn.foreachBlock([&](const BasicBlock &bb) {
-      // Track the allocated chains to be able to reuse them
-      map<Register, DefSet*> allocated;
-      // Some chains may be not used (ie they are dead). We track them to be
-      // able to deallocate them later
-      set<DefSet*> unused;
+      // Chains from the previous blocks are not valid anymore
+      stamp++;
 
       // For each instruction build the UD chains
       const_cast<BasicBlock&>(bb).foreach([&](const Instruction &insn) {
         // Instruction sources consumes definitions
         const uint32_t srcNum = insn.getSrcNum();
-        for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
+        for (uint32_t srcID = 0; srcID < srcNum; ++srcID, ++useID) {
           const Register src = insn.getSrc(srcID);
-          const ValueUse use(&insn, srcID);
-          auto ud = udGraph.find(use);
-          GBE_ASSERT(ud != udGraph.end());
-
-          // We already allocate the ud chain for this register
-          auto it = allocated.find(src);
-          if (it != allocated.end()) {
-            udGraph.erase(ud);
-            udGraph.insert(std::make_pair(use, it->second));
-            if (unused.contains(it->second))
-              unused.erase(it->second);
-          }
           // Create a new one from the predecessor chains (upward used value)
-          else {
-            DefSet *udChain = this->newDefSet();
-            liveOutSet.makeDefSet(*udChain, bb, src);
-            allocated.insert(std::make_pair(src, udChain));
-            ud->second = udChain;
+          if (regStamp[src] != stamp) {
+            const uint32_t first = udData.size();
+            liveOutSet.makeDefSet(udData, bb, src);
+            regRange[src] = Range(first, udData.size() - first);
+            regStamp[src] = stamp;
           }
+          udRange[useID] = regRange[src];
         }
 
         // Instruction destinations create new chains
         const uint32_t dstNum = insn.getDstNum();
-        for (uint32_t dstID = 0; dstID < dstNum; ++dstID) {
+        for (uint32_t dstID = 0; dstID < dstNum; ++dstID, ++defID) {
           const Register dst = insn.getDst(dstID);
-          ValueDef *def = const_cast<ValueDef*>(this->getDefAddress(&insn, dstID));
-          DefSet *udChain = this->newDefSet();
-          udChain->insert(def);
-          unused.insert(udChain);
-          // Remove the previous definition if any
-          if (allocated.contains(dst) == true)
-            allocated.erase(dst);
-          allocated.insert(std::make_pair(dst, udChain));
+          regRange[dst] = Range(udData.size(), 1u);
+          regStamp[dst] = stamp;
+          udData.push_back(&defs[defID]);
         }
       });
-
-      // Deallocate unused chains
-      for (auto set : unused) this->deleteDefSet(set);
     });
-
-    // Build the DU chains from the UD ones
-    fn.foreachInstruction([&](const Instruction &insn) {
-
-      // For each value definition of each source, we push back this use
-      const uint32_t srcNum = insn.getSrcNum();
-      for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
-        ValueUse *use = const_cast<ValueUse*>(getUseAddress(&insn, srcID));
-
-        // Find all definitions for this source
-        const auto &defs = this->getDef(&insn, srcID);
-        for (auto def : defs) {
-          auto uses = duGraph.find(*def);
-          UseSet *du = uses->second;
-          GBE_ASSERT(uses != duGraph.end());
-          if (du == duEmpty) {
-            duGraph.erase(*def);
-            du = this->newUseSet();
-            duGraph.insert(std::make_pair(*def, du));
-          }
-          du->insert(use);
-        }
-      }
-    });
-
-    // Allocate the set of uses and defs per register
-    const uint32_t regNum = fn.regNum();
-    for (uint32_t regID = 0; regID < regNum; ++regID) {
-      const Register reg(regID);
-      UseSet *useSet = GBE_NEW_NO_ARG(UseSet);
-      DefSet *defSet = GBE_NEW_NO_ARG(DefSet);
-      regUse.insert(std::make_pair(reg, useSet));
-      regDef.insert(std::make_pair(reg, defSet));
-    }
-
-    // Fill use sets (one per register)
-    for (auto &useSet : duGraph) {
-      for (auto use : *useSet.second) {
-        const Register reg = use->getRegister();
-        auto it = regUse.find(reg);
-        GBE_ASSERT(it != regUse.end() && it->second != NULL);
-        it->second->insert(use);
+    GBE_ASSERT(useID == useNum && defID == defNum);
+    udChains.resize(useNum);
+    for (uint32_t useID = 0; useID < useNum; ++useID)
+      udChains[useID] = DefSet(udData.data() + udRange[useID].first, udRange[useID].second);
+
+    // Build the DU chains from the UD ones. The uses are in program order
+    vector<std::pair<uint32_t, ValueUse*>> useOfDef;
+    vector<std::pair<uint32_t, ValueUse*>> useOfReg;
+    vector<std::pair<uint32_t, ValueDef*>> defOfReg;
+    vector<uint8_t> defIsUsed(defs.size(), 0u);
+    for (uint32_t useID = 0; useID < useNum; ++useID) {
+      ValueUse *use = &uses[useID];
+      const DefSet &chain = udChains[useID];
+      for (auto def : chain) {
+        const uint32_t defID = def - defs.data();
+        useOfDef.push_back(std::make_pair(defID, use));
+        defIsUsed[defID] = 1u;
       }
+      // Only the uses with a definition are recorded per register
+      if (chain.empty() == false)
+        useOfReg.push_back(std::make_pair(uint32_t(use->getRegister()), use));
     }
+    makeChains(duChains, duData, defs.size(), useOfDef);
 
-    // Fill def sets (one per register)
-    for (auto &defSet : udGraph) {
-      for (auto def : *defSet.second) {
-        const Register reg = def->getRegister();
-        auto it = regDef.find(reg);
-        GBE_ASSERT(it != regDef.end() && it->second != NULL);
-        it->second->insert(def);
-      }
-    }
+    // Same for the definitions, we only keep the used ones
+    for (uint32_t defID = 0; defID < defs.size(); ++defID)
+      if (defIsUsed[defID])
+        defOfReg.push_back(std::make_pair(uint32_t(defs[defID].getRegister()), &defs[defID]));
+    makeChains(regUse, regUseData, regNum, useOfReg);
+    makeChains(regDef, regDefData, regNum, defOfReg);
   }
 
-/*! Helper to deallocate objects */
-#define PTR_RELEASE(TYPE, VAR) \
-  do { \
-    if (VAR && destroyed.contains(VAR) == false) { \
-      destroyed.insert(VAR); \
-      delete##TYPE(VAR); \
-    } \
-  } while (0)
-
-  FunctionDAG::~FunctionDAG(void) {
-
-    // We track the already destroyed pointers
-    set<void*> destroyed;
+  FunctionDAG::~FunctionDAG(void) {}
 
-    // Release the empty ud-chains and du-chains
-    PTR_RELEASE(DefSet, udEmpty);
-    PTR_RELEASE(UseSet, duEmpty);
-
-    // We free all the ud-chains
-    for (const auto &pair : udGraph) {
-      auto defs = pair.second;
-      if (destroyed.contains(defs)) continue;
-      for (auto def : *defs) PTR_RELEASE(ValueDef, def);
-      PTR_RELEASE(DefSet, defs);
-    }
-
-    // We free all the du-chains
-    for (const auto &pair : duGraph) {
-      auto uses = pair.second;
-      if (destroyed.contains(uses)) continue;
-      for (auto use : *uses) PTR_RELEASE(ValueUse, use);
-      PTR_RELEASE(UseSet, uses);
-    }
-
-    // Release all the use and definition sets per register
-    for (const auto &pair : regUse) GBE_SAFE_DELETE(pair.second);
-    for (const auto &pair : regDef) GBE_SAFE_DELETE(pair.second);
+  const FunctionDAG::InsnValues &FunctionDAG::getInsnValues(const Instruction *insn) const {
+    const InsnValues key(insn, 0, 0);
+    auto it = std::lower_bound(insnValues.begin(), insnValues.end(), key);
+    GBE_ASSERT(it != insnValues.end() && it->insn == insn);
+    return *it;
+  }
+  uint32_t FunctionDAG::getDefIndex(const ValueDef &def) const {
+    uint32_t defID;
+    if (def.getType() == ValueDef::DEF_INSN_DST) {
+      GBE_ASSERT(def.getDstID() < def.getInstruction()->getDstNum());
+      defID = this->getInsnValues(def.getInstruction()).firstDef + def.getDstID();
+    } else
+      defID = regInitDef[def.getRegister()];
+    GBE_ASSERT(defID < defs.size() && defs[defID].getType() == def.getType());
+    return defID;
+  }
+  uint32_t FunctionDAG::getUseIndex(const Instruction *insn, uint32_t srcID) const {
+    GBE_ASSERT(srcID < insn->getSrcNum());
+    return this->getInsnValues(insn).firstUse + srcID;
   }
-#undef PTR_RELEASE
 
   const UseSet &FunctionDAG::getUse(const ValueDef &def) const {
-    auto it = duGraph.find(def);
-    GBE_ASSERT(it != duGraph.end());
-    return *it->second;
+    return duChains[this->getDefIndex(def)];
   }
   const UseSet &FunctionDAG::getUse(const Instruction *insn, uint32_t dstID) const {
     return this->getUse(ValueDef(insn, dstID));
@@ -512,32 +459,27 @@ namespace ir {
   const UseSet &FunctionDAG::getUse(const FunctionArgument *arg) const {
     return this->getUse(ValueDef(arg));
   }
+  const UseSet &FunctionDAG::getUse(const PushLocation *pushed) const {
+    return this->getUse(ValueDef(pushed));
+  }
   const UseSet &FunctionDAG::getUse(const Register &reg) const {
     return this->getUse(ValueDef(reg));
   }
   const DefSet &FunctionDAG::getDef(const ValueUse &use) const {
-    auto it = udGraph.find(use);
-    GBE_ASSERT(it != udGraph.end());
-    return *it->second;
+    return this->getDef(use.getInstruction(), use.getSrcID());
   }
   const DefSet &FunctionDAG::getDef(const Instruction *insn, uint32_t srcID) const {
-    return this->getDef(ValueUse(insn, srcID));
+    return udChains[this->getUseIndex(insn, srcID)];
   }
   const UseSet *FunctionDAG::getRegUse(const Register &reg) const {
-    auto it = regUse.find(reg);
-    GBE_ASSERT(it != regUse.end());
-    return it->second;
+    return &regUse[reg];
   }
   const DefSet *FunctionDAG::getRegDef(const Register &reg) const {
-    auto it = regDef.find(reg);
-    GBE_ASSERT(it != regDef.end());
-    return it->second;
+    return &regDef[reg];
   }
 
   const ValueDef *FunctionDAG::getDefAddress(const ValueDef &def) const {
-    auto it = defName.find(def);
-    GBE_ASSERT(it != defName.end() && it->second != NULL);
-    return it->second;
+    return &defs[this->getDefIndex(def)];
   }
   const ValueDef *FunctionDAG::getDefAddress(const PushLocation *pushed) const {
     return this->getDefAddress(ValueDef(pushed));
@@ -552,10 +494,7 @@ namespace ir {
     return this->getDefAddress(ValueDef(reg));
   }
   const ValueUse *FunctionDAG::getUseAddress(const Instruction *insn, uint32_t srcID) const {
-    const ValueUse use(insn, srcID);
-    auto it = useName.find(use);
-    GBE_ASSERT(it != useName.end() && it->second != NULL);
-    return it->second;
+    return &uses[this->getUseIndex(insn, srcID)];
   }
 
   void FunctionDAG::getRegUDBBs(Register r, set<const BasicBlock *> &BBs) const{
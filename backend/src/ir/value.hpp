@@ -28,6 +28,7 @@
 #include "ir/function.hpp"
 #include "sys/set.hpp"
 #include "sys/map.hpp"
+#include "sys/vector.hpp"
 
 namespace gbe {
 namespace ir {
@@ -185,15 +186,40 @@ namespace ir {
     return src0 < src1;
   }
 
+  /*! A chain of values is a view on a flat array owned by the FunctionDAG.
+   *  The values are sorted by their index in the DAG and appear only once
+   */
+  template <typename T>
+  class ValueChain
+  {
+  public:
+    typedef T *const *const_iterator;
+    INLINE ValueChain(void) : first(NULL), num(0) {}
+    INLINE ValueChain(T *const *first, uint32_t num) : first(first), num(num) {}
+    INLINE const_iterator begin(void) const { return first; }
+    INLINE const_iterator end(void) const { return first + num; }
+    INLINE size_t size(void) const { return num; }
+    INLINE bool empty(void) const { return num == 0; }
+    /*! Linear search, the chains are usually very short */
+    INLINE bool contains(const T *value) const {
+      for (uint32_t i = 0; i < num; ++i)
+        if (first[i] == value) return true;
+      return false;
+    }
+  private:
+    T *const *first; //!< First value of the chain
+    uint32_t num;    //!< Number of values in the chain
+  };
+
   /*! All uses of a definition */
-  typedef set<ValueUse*> UseSet;
+  typedef ValueChain<ValueUse> UseSet;
   /*! All possible definitions for a use */
-  typedef set<ValueDef*> DefSet;
+  typedef ValueChain<ValueDef> DefSet;
 
-  /*! Get the chains (in both directions) for the complete program. This data
-   *  structure is unfortunately way too brutal. Using std::sets all over the
-   *  place just burns a huge amount of memory. There is work to do to decrease
-   *  the memory footprint
+  /*! Get the chains (in both directions) for the complete program. All the
+   *  values are numbered: the destinations (resp. sources) of an instruction
+   *  get consecutive indices and every chain is a range of a flat array
+   *  indexed by these numbers. Nothing is allocated per value
    */
   class FunctionDAG : public NonCopyable
   {
@@ -234,10 +260,6 @@ namespace ir {
     const DefSet *getRegDef(const Register &reg) const;
     /*! Get the function we have the graph for */
     INLINE const Function &getFunction(void) const { return fn; }
-    /*! The DefSet for each definition use */
-    typedef map<ValueUse, DefSet*> UDGraph;
-    /*! The UseSet for each definition */
-    typedef map<ValueDef, UseSet*> DUGraph;
     /*! get register's use and define BB set */
     void getRegUDBBs(Register r, set<const BasicBlock *> &BBs) const;
     // check whether two register interering in the specific BB.
@@ -255,19 +277,35 @@ namespace ir {
     /*! check whether two registers which are both in livein set interfering in the current BB. */
     bool interfereLivein(const BasicBlock *bb, Register r0, Register r1) const;
   private:
-    UDGraph udGraph;                   //!< All the UD chains
-    DUGraph duGraph;                   //!< All the DU chains
-    DefSet *udEmpty;                   //!< Void use set
-    UseSet *duEmpty;                   //!< Void def set
-    ValueDef *undefined;               //!< Undefined value
-    map<ValueUse, ValueUse*> useName;  //!< Get the ValueUse pointer from the value
-    map<ValueDef, ValueDef*> defName;  //!< Get the ValueDef pointer from the value
-    map<Register, UseSet*> regUse;     //!< All uses of registers
-    map<Register, DefSet*> regDef;     //!< All defs of registers
-    DECL_POOL(ValueDef, valueDefPool); //!< Fast ValueDef allocation
-    DECL_POOL(ValueUse, valueUsePool); //!< Fast ValueUse allocation
-    DECL_POOL(DefSet, udChainPool);    //!< Fast DefSet allocation
-    DECL_POOL(UseSet, duChainPool);    //!< Fast UseSet allocation
+    /*! Indices of the first destination and source of an instruction */
+    struct InsnValues {
+      INLINE InsnValues(const Instruction *insn, uint32_t firstDef, uint32_t firstUse) :
+        insn(insn), firstDef(firstDef), firstUse(firstUse) {}
+      INLINE bool operator< (const InsnValues &other) const {
+        return uintptr_t(insn) < uintptr_t(other.insn);
+      }
+      const Instruction *insn;
+      uint32_t firstDef;
+      uint32_t firstUse;
+    };
+    /*! Find the value indices of the instruction */
+    const InsnValues &getInsnValues(const Instruction *insn) const;
+    /*! Get the index of the definition in defs */
+    uint32_t getDefIndex(const ValueDef &def) const;
+    /*! Get the index of the use in uses */
+    uint32_t getUseIndex(const Instruction *insn, uint32_t srcID) const;
+    vector<InsnValues> insnValues;     //!< Sorted by instruction address
+    vector<ValueDef> defs;             //!< All the definitions
+    vector<ValueUse> uses;             //!< All the uses
+    vector<uint32_t> regInitDef;       //!< Argument, special or pushed def per register
+    vector<DefSet> udChains;           //!< ud-chain of each use
+    vector<UseSet> duChains;           //!< du-chain of each definition
+    vector<UseSet> regUse;             //!< All uses of each register
+    vector<DefSet> regDef;             //!< All defs of each register
+    vector<ValueDef*> udData;          //!< Storage of the ud-chains
+    vector<ValueUse*> duData;          //!< Storage of the du-chains
+    vector<ValueUse*> regUseData;      //!< Storage of the uses per register
+    vector<ValueDef*> regDefData;      //!< Storage of the defs per register
     const Function &fn;                //!< Function we are referring to
     GBE_CLASS(FunctionDAG);            //   Use internal allocators
   };
@@ -19,6 +19,50 @@
 #include "ocl_async.h"
 #include "ocl_sync.h"
 #include "ocl_workitem.h"
+#include "ocl_simd.h"
+
+uint4 __gen_ocl_sub_group_block_read_ui_local4(const local uint *p);
+void __gen_ocl_sub_group_block_write_ui_local4(local uint *p, uint4 data);
+
+/* Each thread copies whole blocks of 4 dwords per lane with one oword block
+ * read and write, and all the work items copy the dwords left after the last
+ * block. A block read only needs dword aligned addresses but a block write
+ * needs oword aligned ones. The last thread of the work group may not have
+ * all its lanes and copies its blocks one dword per lane. */
+#define BLOCK_COPY(DST_SPACE, SRC_SPACE, READ, WRITE) \
+void __gen_ocl_block_copy_##SRC_SPACE##_to_##DST_SPACE(DST_SPACE uint *dst, \
+                                                    const SRC_SPACE uint *src, uint num) { \
+  uint simd = get_simd_size(); \
+  uint block = simd * 4; \
+  uint block_num = num / block; \
+  uint thread_num = get_num_sub_groups(); \
+  if (get_sub_group_size() == simd) { \
+    for (uint i = get_sub_group_id(); i < block_num; i += thread_num) \
+      WRITE(dst + i * block, READ(src + i * block)); \
+  } else { \
+    for (uint i = get_sub_group_id(); i < block_num; i += thread_num) \
+      for (uint j = get_sub_group_local_id(); j < block; j += get_sub_group_size()) \
+        dst[i * block + j] = src[i * block + j]; \
+  } \
+  uint size = get_local_size(2) * get_local_size(1) * get_local_size(0); \
+  uint offset = get_local_id(2) * get_local_size(1) + get_local_id(1); \
+  offset = offset * get_local_size(0) + get_local_id(0); \
+  for (uint i = block_num * block + offset; i < num; i += size) \
+    dst[i] = src[i]; \
+}
+BLOCK_COPY(local, global, intel_sub_group_block_read4, __gen_ocl_sub_group_block_write_ui_local4)
+BLOCK_COPY(global, local, __gen_ocl_sub_group_block_read_ui_local4, intel_sub_group_block_write4)
+#undef BLOCK_COPY
+
+/* Only the char and short types can make a copy size which is not a whole
+ * number of dwords */
+#define BLOCK_BODY(DST_SPACE, SRC_SPACE, TYPE) \
+  if (((size_t)dst & 15) == 0 && ((size_t)src & 3) == 0 && \
+      (num * sizeof(TYPE)) % sizeof(uint) == 0) { \
+    __gen_ocl_block_copy_##SRC_SPACE##_to_##DST_SPACE((DST_SPACE uint *)dst, \
+                                  (const SRC_SPACE uint *)src, num * sizeof(TYPE) / sizeof(uint)); \
+    return 0; \
+  }
 
 #define BODY(SRC_STRIDE, DST_STRIDE) \
   uint size = get_local_size(2) * get_local_size(1) * get_local_size(0); \
@@ -36,10 +80,12 @@
 #define DEFN(TYPE) \
 OVERLOADABLE event_t async_work_group_copy (local TYPE *dst,  const global TYPE *src, \
 							 size_t num, event_t event) { \
+  BLOCK_BODY(local, global, TYPE); \
   BODY(1, 1); \
 } \
 OVERLOADABLE event_t async_work_group_copy (global TYPE *dst,  const local TYPE *src, \
 							  size_t num, event_t event) { \
+  BLOCK_BODY(global, local, TYPE); \
   BODY(1, 1); \
 } \
 OVERLOADABLE event_t async_work_group_strided_copy (local TYPE *dst,  const global TYPE *src, \
@@ -62,6 +108,7 @@ DEF(long)
 DEF(ulong)
 DEF(float)
 DEF(double)
+#undef BLOCK_BODY
 #undef BODY
 #undef DEFN
 #undef DEF
@@ -70,8 +117,18 @@ OVERLOADABLE void wait_group_events (int num_events, event_t *event_list) {
   barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
 }
 
+/* Load one dword of every cache line of the range. Nothing waits for the
+ * loads, the thread only stalls if it later reads the same registers. */
+void __gen_ocl_prefetch(const global char *p, size_t size) {
+  const global char *end = p + size;
+  for (p = (const global char *)((size_t)p & ~(size_t)63); p < end; p += 64)
+    *(volatile const global uint *)p;
+}
+
 #define DEFN(TYPE) \
-OVERLOADABLE void prefetch(const global TYPE *p, size_t num) { }
+OVERLOADABLE void prefetch(const global TYPE *p, size_t num) { \
+  __gen_ocl_prefetch((const global char *)p, num * sizeof(TYPE)); \
+}
 #define DEF(TYPE) \
 DEFN(TYPE); DEFN(TYPE##2); DEFN(TYPE##3); DEFN(TYPE##4); DEFN(TYPE##8); DEFN(TYPE##16)
 DEF(char);
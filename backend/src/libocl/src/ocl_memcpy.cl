@@ -17,10 +17,21 @@
  */
 #include "ocl_memcpy.h"
 typedef int __attribute__((may_alias)) AI;
+/* Only dword aligned, as the untyped messages need */
+typedef int4 __attribute__((may_alias, aligned(4))) AI4;
 
+/* The untyped messages read and write up to 4 dwords per lane at any dword
+ * aligned address, in every address space. Once the destination is dword
+ * aligned, the copy is done 16 bytes at a time when the source is aligned
+ * the same way, and with dword reads of the source shifted into place when it
+ * is not, instead of one byte message per byte. */
 #define DECL_TWO_SPACE_MEMCOPY_FN(NAME, DST_SPACE, SRC_SPACE) \
 void __gen_memcpy_ ##NAME## _align (DST_SPACE uchar* dst, SRC_SPACE uchar* src, size_t size) { \
   size_t index = 0; \
+  while((index + 16) <= size) { \
+    *((DST_SPACE AI4 *)(dst + index)) = *((SRC_SPACE AI4 *)(src + index)); \
+    index += 16; \
+  } \
   while((index + 4) <= size) { \
     *((DST_SPACE AI *)(dst + index)) = *((SRC_SPACE AI *)(src + index)); \
     index += 4; \
@@ -32,6 +43,25 @@ void __gen_memcpy_ ##NAME## _align (DST_SPACE uchar* dst, SRC_SPACE uchar* src,
 } \
 void __gen_memcpy_ ##NAME (DST_SPACE uchar* dst, SRC_SPACE uchar* src, size_t size) { \
   size_t index = 0; \
+  while(index < size && ((size_t)(dst + index) & 3) != 0) { \
+    dst[index] = src[index]; \
+    index++; \
+  } \
+  const uint shift = ((size_t)(src + index) & 3) * 8; \
+  if(shift == 0) { \
+    __gen_memcpy_ ##NAME## _align(dst + index, src + index, size - index); \
+    return; \
+  } \
+  if((index + 4) <= size) { \
+    SRC_SPACE AI *from = (SRC_SPACE AI *)(src + index - shift / 8); \
+    uint lo = *from++; \
+    while((index + 4) <= size) { \
+      uint hi = *from++; \
+      *((DST_SPACE AI *)(dst + index)) = (lo >> shift) | (hi << (32 - shift)); \
+      lo = hi; \
+      index += 4; \
+    } \
+  } \
   while(index < size) { \
     dst[index] = src[index]; \
     index++; \
@@ -16,11 +16,20 @@
  *
  */
 #include "ocl_memset.h"
+/* Only dword aligned, as the untyped messages need */
+typedef uint4 __attribute__((aligned(4))) AU4;
 
+/* Same as the copies, 16 bytes per message once the destination is dword
+ * aligned */
 #define DECL_MEMSET_FN(NAME, DST_SPACE) \
 void __gen_memset_ ##NAME## _align (DST_SPACE uchar* dst, uchar val, size_t size) { \
   size_t index = 0; \
   uint v = (val << 24) | (val << 16) | (val << 8) | val; \
+  uint4 v4 = (uint4)(v); \
+  while((index + 16) <= size) { \
+    *((DST_SPACE AU4 *)(dst + index)) = v4; \
+    index += 16; \
+  } \
   while((index + 4) <= size) { \
     *((DST_SPACE uint *)(dst + index)) = v; \
     index += 4; \
@@ -32,10 +41,11 @@ void __gen_memset_ ##NAME## _align (DST_SPACE uchar* dst, uchar val, size_t size
 } \
 void __gen_memset_ ##NAME (DST_SPACE uchar* dst, uchar val, size_t size) { \
   size_t index = 0; \
-  while(index < size) { \
+  while(index < size && ((size_t)(dst + index) & 3) != 0) { \
     dst[index] = val; \
     index++; \
- } \
+  } \
+  __gen_memset_ ##NAME## _align(dst + index, val, size - index); \
 }
 
 DECL_MEMSET_FN(g, __global)
@@ -21,8 +21,13 @@
 #include <iostream>
 #include <sstream>
 #include <set>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
 
 #include "sys/cvar.hpp"
+#include "sys/platform.hpp"
 #include "src/GBEConfig.h"
 #include "llvm_includes.hpp"
 #include "llvm/llvm_gen_backend.hpp"
@@ -32,52 +37,232 @@ using namespace llvm;
 
 SVAR(OCL_BITCODE_LIB_PATH, OCL_BITCODE_BIN);
 SVAR(OCL_BITCODE_LIB_20_PATH, OCL_BITCODE_BIN_20);
+IVAR(OCL_BITCODE_LIB_CACHE_SIZE, 0, 64, 4096); // In entries, 0 disables the cache
+BVAR(OCL_OUTPUT_LINK_TIME, false);
 
 namespace gbe
 {
-  static Module* createOclBitCodeModule(LLVMContext& ctx,
-                                                 bool strictMath,
-                                                 uint32_t oclVersion)
+  static bool findOclBitCodeFile(uint32_t oclVersion, std::string &FilePath)
   {
     std::string bitCodeFiles = oclVersion >= 200 ?
                                OCL_BITCODE_LIB_20_PATH : OCL_BITCODE_LIB_PATH;
     if(bitCodeFiles == "")
       bitCodeFiles = oclVersion >= 200 ? OCL_BITCODE_BIN_20 : OCL_BITCODE_BIN;
     std::istringstream bitCodeFilePath(bitCodeFiles);
+
+    while (std::getline(bitCodeFilePath, FilePath, ':')) {
+      if(access(FilePath.c_str(), R_OK) == 0)
+        return true;
+    }
+    printf("Fatal Error: ocl lib %s does not exist\n", bitCodeFiles.c_str());
+    return false;
+  }
+
+  static void setMathFastFlag(Module &oclLib, bool strictMath)
+  {
+    llvm::GlobalVariable* mathFastFlag = oclLib.getGlobalVariable("__ocl_math_fastpath_flag");
+    assert(mathFastFlag);
+    Type* intTy = IntegerType::get(oclLib.getContext(), 32);
+    mathFastFlag->setInitializer(ConstantInt::get(intTy, strictMath ? 0 : 1));
+  }
+
+  /* Every build runs in its own LLVMContext, so the library module itself
+   * cannot be shared. What we keep for the whole process is the content of
+   * the bitcode file, the names of the functions it provides, and for every
+   * set of library functions called by a program, the library already reduced
+   * to their closure. The reduced library is small, so parsing it in the new
+   * context is much cheaper than loading the full library lazily and
+   * materializing the functions one by one.
+   */
+  struct OclLibFile {
+    OclLibFile(void) : indexed(false) {}
+    std::unique_ptr<MemoryBuffer> buffer;  //!< Content of the bitcode file
+    std::set<std::string> functions;       //!< Functions of the library
+    bool indexed;                          //!< functions is valid (immutable once set)
+  };
+
+  struct OclLibClosure {
+    std::string bitcode;                   //!< Library reduced to the closure
+    std::vector<std::string> exported;     //!< Builtins kept out of internalization
+  };
+
+  static std::mutex oclLibMutex;
+  static std::map<std::string, std::shared_ptr<OclLibFile>> oclLibFiles;
+  static std::map<std::string, std::shared_ptr<const OclLibClosure>> oclLibClosures;
+  static std::deque<std::string> oclLibClosureOrder;
+
+  static std::shared_ptr<OclLibFile> getOclLibFile(const std::string &FilePath)
+  {
+    std::lock_guard<std::mutex> lock(oclLibMutex);
+    auto it = oclLibFiles.find(FilePath);
+    if (it != oclLibFiles.end())
+      return it->second;
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(FilePath);
+    if (!buffer)
+      return NULL;
+    std::shared_ptr<OclLibFile> file = std::make_shared<OclLibFile>();
+    file->buffer = std::move(buffer.get());
+    oclLibFiles[FilePath] = file;
+    return file;
+  }
+
+  static Module* createOclBitCodeModule(LLVMContext& ctx,
+                                                 bool strictMath,
+                                                 uint32_t oclVersion)
+  {
     std::string FilePath;
-    bool findBC = false;
     Module* oclLib = NULL;
     SMDiagnostic Err;
 
-    while (std::getline(bitCodeFilePath, FilePath, ':')) {
-      if(access(FilePath.c_str(), R_OK) == 0) {
-        findBC = true;
-        break;
-      }
-    }
-    if (!findBC) {
-      printf("Fatal Error: ocl lib %s does not exist\n", bitCodeFiles.c_str());
+    if (!findOclBitCodeFile(oclVersion, FilePath))
       return NULL;
-    }
 
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR <= 35
     oclLib = getLazyIRFileModule(FilePath, Err, ctx);
 #else
-    oclLib = getLazyIRFileModule(FilePath, Err, ctx).release();
+    std::shared_ptr<OclLibFile> file;
+    if (OCL_BITCODE_LIB_CACHE_SIZE > 0)
+      file = getOclLibFile(FilePath);
+    if (file) {
+      std::unique_ptr<MemoryBuffer> buffer =
+        MemoryBuffer::getMemBuffer(file->buffer->getMemBufferRef(), false);
+      oclLib = getLazyIRModule(std::move(buffer), Err, ctx).release();
+    } else
+      oclLib = getLazyIRFileModule(FilePath, Err, ctx).release();
 #endif
     if (!oclLib) {
       printf("Fatal Error: ocl lib can not be opened\n");
       return NULL;
     }
 
-    llvm::GlobalVariable* mathFastFlag = oclLib->getGlobalVariable("__ocl_math_fastpath_flag");
-    assert(mathFastFlag);
-    Type* intTy = IntegerType::get(ctx, 32);
-    mathFastFlag->setInitializer(ConstantInt::get(intTy, strictMath ? 0 : 1));
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR > 35
+    if (file) {
+      std::set<std::string> functions;
+      for (Module::iterator F = oclLib->begin(), E = oclLib->end(); F != E; ++F)
+        functions.insert(F->getName().str());
+      std::lock_guard<std::mutex> lock(oclLibMutex);
+      if (!file->indexed) {
+        file->functions.swap(functions);
+        file->indexed = true;
+      }
+    }
+#endif
+
+    setMathFastFlag(*oclLib, strictMath);
+    return oclLib;
+  }
+
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
+  /* Walk the calls of the program like materializedFuncCall does, without
+   * touching the library: collect the library functions the program calls.
+   */
+  static bool collectLibraryRoots(Module& src, const std::set<std::string>& libFuncs,
+                                  llvm::Function& KF, std::set<std::string>& visited,
+                                  std::set<std::string>& roots) {
+    for (llvm::Function::iterator B = KF.begin(), BE = KF.end(); B != BE; B++) {
+      for (BasicBlock::iterator instI = B->begin(),
+           instE = B->end(); instI != instE; ++instI) {
+        llvm::CallInst* call = dyn_cast<llvm::CallInst>(instI);
+        if (!call)
+          continue;
+
+        llvm::Function * callFunc = call->getCalledFunction();
+        if (callFunc && callFunc->getIntrinsicID() != 0)
+          continue;
+
+        std::string fnName = call->getCalledValue()->stripPointerCasts()->getName();
+        if (!visited.insert(fnName).second)
+          continue;
+
+        if (libFuncs.count(fnName)) {
+          roots.insert(fnName);
+          continue;
+        }
+        llvm::Function *srcF = src.getFunction(fnName);
+        if (!srcF || !collectLibraryRoots(src, libFuncs, *srcF, visited, roots))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  /* Look up the reduced library for the calls of src. On a miss, key is set
+   * so that the caller can store the library it builds.
+   */
+  static Module* loadOclLibClosure(Module& src, bool strictMath, uint32_t oclVersion,
+                                   std::string& key, std::vector<std::string>& exported)
+  {
+    std::string FilePath;
+    if (!findOclBitCodeFile(oclVersion, FilePath))
+      return NULL;
+    std::shared_ptr<OclLibFile> file = getOclLibFile(FilePath);
+    if (!file)
+      return NULL;
+    {
+      std::lock_guard<std::mutex> lock(oclLibMutex);
+      if (!file->indexed)
+        return NULL;
+    }
+
+    std::set<std::string> visited, roots;
+    for (Module::iterator SF = src.begin(), E = src.end(); SF != E; ++SF) {
+      if (SF->isDeclaration() || !isKernelFunction(*SF))
+        continue;
+      if (!collectLibraryRoots(src, file->functions, *SF, visited, roots))
+        return NULL;
+    }
 
+    std::ostringstream keyStream;
+    keyStream << FilePath << '\n' << oclVersion;
+    for (const auto &root : roots)
+      keyStream << '\n' << root;
+    key = keyStream.str();
+
+    std::shared_ptr<const OclLibClosure> closure;
+    {
+      std::lock_guard<std::mutex> lock(oclLibMutex);
+      auto it = oclLibClosures.find(key);
+      if (it != oclLibClosures.end())
+        closure = it->second;
+    }
+    if (!closure)
+      return NULL;
+
+    SMDiagnostic Err;
+    MemoryBufferRef buffer(closure->bitcode, FilePath);
+    Module *oclLib = parseIR(buffer, Err, src.getContext()).release();
+    if (!oclLib)
+      return NULL;
+    setMathFastFlag(*oclLib, strictMath);
+    exported = closure->exported;
     return oclLib;
   }
 
+  static void storeOclLibClosure(const std::string& key, Module& oclLib,
+                                 const std::vector<std::string>& exported)
+  {
+    std::shared_ptr<OclLibClosure> closure = std::make_shared<OclLibClosure>();
+    raw_string_ostream OS(closure->bitcode);
+#if LLVM_VERSION_MAJOR >= 7
+    WriteBitcodeToFile(oclLib, OS);
+#else
+    WriteBitcodeToFile(&oclLib, OS);
+#endif
+    OS.flush();
+    closure->exported = exported;
+
+    std::lock_guard<std::mutex> lock(oclLibMutex);
+    if (oclLibClosures.count(key))
+      return;
+    while (oclLibClosureOrder.size() >= (size_t)OCL_BITCODE_LIB_CACHE_SIZE) {
+      oclLibClosures.erase(oclLibClosureOrder.front());
+      oclLibClosureOrder.pop_front();
+    }
+    oclLibClosures[key] = closure;
+    oclLibClosureOrder.push_back(key);
+  }
+#endif
+
   static bool materializedFuncCall(Module& src, Module& lib, llvm::Function& KF,
                                    std::set<std::string>& MFS,
                                    std::vector<GlobalValue *>&Gvs) {
@@ -151,18 +336,114 @@ namespace gbe
   }
 
 
-  Module* runBitCodeLinker(Module *mod, bool strictMath, ir::Unit &unit)
+  /* Materialize the library functions needed by the kernels of src and the
+   * builtins, and drop everything else from lib. */
+  static bool materializeOclLib(Module *src, Module *lib,
+                                const std::vector<const char *> &builtinFuncs,
+                                std::vector<std::string> &exported)
   {
-    LLVMContext& ctx = mod->getContext();
     std::set<std::string> materializedFuncs;
     std::vector<GlobalValue *> Gvs;
 
+    for (Module::iterator SF = src->begin(), E = src->end(); SF != E; ++SF) {
+      if (SF->isDeclaration()) continue;
+      if (!isKernelFunction(*SF)) continue;
+      if (!materializedFuncCall(*src, *lib, *SF, materializedFuncs, Gvs)) {
+        return false;
+      }
+      Gvs.push_back((GlobalValue *)&*SF);
+    }
+
+    for (auto &f : builtinFuncs) {
+      const std::string fnName(f);
+      if (!materializedFuncs.insert(fnName).second) {
+        continue;
+      }
+
+      llvm::Function *newMF = lib->getFunction(fnName);
+      if (!newMF) {
+        printf("Can not find the function: %s\n", fnName.c_str());
+        return false;
+      }
+      std::string ErrInfo;// = "Not Materializable";
+      if (newMF->isMaterializable()) {
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+        if (llvm::Error EC = newMF->materialize()) {
+          std::string Msg;
+          handleAllErrors(std::move(EC), [&](ErrorInfoBase &EIB) {
+            Msg = EIB.message();
+          });
+          printf("Can not materialize the function: %s, because %s\n", fnName.c_str(), Msg.c_str());
+          return false;
+        }
+#elif LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 36
+        if (std::error_code EC = newMF->materialize()) {
+          printf("Can not materialize the function: %s, because %s\n", fnName.c_str(), EC.message().c_str());
+          return false;
+        }
+#else
+        if (newMF->Materialize(&ErrInfo)) {
+          printf("Can not materialize the function: %s, because %s\n", fnName.c_str(), ErrInfo.c_str());
+          return false;
+        }
+#endif
+      }
+
+      if (!materializedFuncCall(*src, *lib, *newMF, materializedFuncs, Gvs)) {
+        return false;
+      }
+
+      Gvs.push_back((GlobalValue *)newMF);
+      exported.push_back(fnName);
+    }
+
+  /* The llvm 3.8 now has a strict materialized check for all value by checking
+   * module is materialized. If we want to use library as old style that just
+   * materialize what we need, we need to remove what we did not need before
+   * materialize all of the module. To do this, we need all of the builtin
+   * funcitons and what are needed from the kernel functions, these functions
+   * are materalized and are recorded in Gvs, the GlobalValue like PI are also
+   * needed and are added. Now we could not use use_empty to check if the GVs
+   * are needed before the module is marked as all materialized, so we just
+   * materialize all of them as there are only 7 GVs. Then we use GVExtraction
+   * pass to extract the functions and values in Gvs from the library module.
+   * After extract what we need and remove what we do not need, we use 
+   * materializeAll to mark the module as materialized. */
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
+    /* Get all GlobalValue from module. */
+    Module::GlobalListType &GVlist = lib->getGlobalList();
+    for(Module::global_iterator GVitr = GVlist.begin();GVitr != GVlist.end();++GVitr) {
+      GlobalValue * GV = &*GVitr;
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+      ExitOnError ExitOnErr("Can not materialize the clonedLib: ");
+      ExitOnErr(lib->materialize(GV));
+#else
+      lib->materialize(GV);
+#endif
+      Gvs.push_back(GV);
+    }
+    llvm::legacy::PassManager Extract;
+    /* Extract all values we need using GVExtractionPass. */
+    Extract.add(createGVExtractionPass(Gvs, false));
+    Extract.run(*lib);
+    /* Mark the library module as materialized for later use. */
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+    ExitOnError ExitOnErr("Can not materialize the clonedLib: ");
+    ExitOnErr(lib->materializeAll());
+#else
+    lib->materializeAll();
+#endif
+#endif
+    return true;
+  }
+
+  Module* runBitCodeLinker(Module *mod, bool strictMath, ir::Unit &unit)
+  {
+    LLVMContext& ctx = mod->getContext();
     uint32_t oclVersion = getModuleOclVersion(mod);
     ir::PointerSize size = oclVersion >= 200 ? ir::POINTER_64_BITS : ir::POINTER_32_BITS;
     unit.setPointerSize(size);
-    Module* clonedLib = createOclBitCodeModule(ctx, strictMath, oclVersion);
-    if (clonedLib == NULL)
-      return NULL;
+    const double startTime = OCL_OUTPUT_LINK_TIME ? getSeconds() : 0.0;
 
     std::vector<const char *> kernels;
     std::vector<const char *> kerneltmp;
@@ -233,105 +514,40 @@ namespace gbe
       strcpy(tmp,funcName);
       kernels.push_back(tmp);
       kerneltmp.push_back(tmp);
-
-      if (!materializedFuncCall(*mod, *clonedLib, *SF, materializedFuncs, Gvs)) {
-        delete clonedLib;
-        return NULL;
-      }
-      Gvs.push_back((GlobalValue *)&*SF);
     }
 
     if (kernels.empty()) {
       printf("One module without kernel function!\n");
-      delete clonedLib;
       return NULL;
     }
 
-    for (auto &f : builtinFuncs) {
-      const std::string fnName(f);
-      if (!materializedFuncs.insert(fnName).second) {
-        continue;
-      }
-
-      llvm::Function *newMF = clonedLib->getFunction(fnName);
-      if (!newMF) {
-        printf("Can not find the function: %s\n", fnName.c_str());
-        delete clonedLib;
-        return NULL;
-      }
-      std::string ErrInfo;// = "Not Materializable";
-      if (newMF->isMaterializable()) {
-#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
-        if (llvm::Error EC = newMF->materialize()) {
-          std::string Msg;
-          handleAllErrors(std::move(EC), [&](ErrorInfoBase &EIB) {
-            Msg = EIB.message();
-          });
-          printf("Can not materialize the function: %s, because %s\n", fnName.c_str(), Msg.c_str());
-          delete clonedLib;
-          return NULL;
-        }
-#elif LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 36
-        if (std::error_code EC = newMF->materialize()) {
-          printf("Can not materialize the function: %s, because %s\n", fnName.c_str(), EC.message().c_str());
-          delete clonedLib;
-          return NULL;
-        }
-#else
-        if (newMF->Materialize(&ErrInfo)) {
-          printf("Can not materialize the function: %s, because %s\n", fnName.c_str(), ErrInfo.c_str());
-          delete clonedLib;
-          return NULL;
-        }
+    /* Builtins called by the program, they must stay visible after linking */
+    std::vector<std::string> exported;
+    Module* clonedLib = NULL;
+    std::string closureKey;
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
+    if (OCL_BITCODE_LIB_CACHE_SIZE > 0)
+      clonedLib = loadOclLibClosure(*mod, strictMath, oclVersion, closureKey, exported);
 #endif
-      }
+    const bool closureCached = clonedLib != NULL;
 
-      if (!materializedFuncCall(*mod, *clonedLib, *newMF, materializedFuncs, Gvs)) {
+    if (clonedLib == NULL) {
+      clonedLib = createOclBitCodeModule(ctx, strictMath, oclVersion);
+      if (clonedLib == NULL)
+        return NULL;
+      if (!materializeOclLib(mod, clonedLib, builtinFuncs, exported)) {
         delete clonedLib;
         return NULL;
       }
-
-      Gvs.push_back((GlobalValue *)newMF);
-      kernels.push_back(f);
-    }
-
-  /* The llvm 3.8 now has a strict materialized check for all value by checking
-   * module is materialized. If we want to use library as old style that just
-   * materialize what we need, we need to remove what we did not need before
-   * materialize all of the module. To do this, we need all of the builtin
-   * funcitons and what are needed from the kernel functions, these functions
-   * are materalized and are recorded in Gvs, the GlobalValue like PI are also
-   * needed and are added. Now we could not use use_empty to check if the GVs
-   * are needed before the module is marked as all materialized, so we just
-   * materialize all of them as there are only 7 GVs. Then we use GVExtraction
-   * pass to extract the functions and values in Gvs from the library module.
-   * After extract what we need and remove what we do not need, we use 
-   * materializeAll to mark the module as materialized. */
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
-    /* Get all GlobalValue from module. */
-    Module::GlobalListType &GVlist = clonedLib->getGlobalList();
-    for(Module::global_iterator GVitr = GVlist.begin();GVitr != GVlist.end();++GVitr) {
-      GlobalValue * GV = &*GVitr;
-#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
-      ExitOnError ExitOnErr("Can not materialize the clonedLib: ");
-      ExitOnErr(clonedLib->materialize(GV));
-#else
-      clonedLib->materialize(GV);
+      if (!closureKey.empty())
+        storeOclLibClosure(closureKey, *clonedLib, exported);
 #endif
-      Gvs.push_back(GV);
     }
-    llvm::legacy::PassManager Extract;
-    /* Extract all values we need using GVExtractionPass. */
-    Extract.add(createGVExtractionPass(Gvs, false));
-    Extract.run(*clonedLib);
-    /* Mark the library module as materialized for later use. */
-#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
-    ExitOnError ExitOnErr("Can not materialize the clonedLib: ");
-    ExitOnErr(clonedLib->materializeAll());
-#else
-    clonedLib->materializeAll();
-#endif
-#endif
+
+    for (const auto &f : exported)
+      kernels.push_back(f.c_str());
+    const double loadTime = OCL_OUTPUT_LINK_TIME ? getSeconds() : 0.0;
 
     /* the SPIR binary datalayout maybe different with beignet's bitcode */
     if(clonedLib->getDataLayout() != mod->getDataLayout())
@@ -379,6 +595,13 @@ namespace gbe
     for(size_t i = 0;i < kerneltmp.size(); i++)
       delete[] kerneltmp[i];
 
+    if (OCL_OUTPUT_LINK_TIME) {
+      const double endTime = getSeconds();
+      printf("libocl %s: load %.3f ms, link %.3f ms\n",
+             closureCached ? "closure cached" : "lazily materialized",
+             (loadTime - startTime) * 1000.0, (endTime - loadTime) * 1000.0);
+    }
+
     return clonedLib;
   }
 
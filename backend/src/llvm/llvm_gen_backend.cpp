@@ -3209,6 +3209,8 @@ namespace gbe
     this->regTranslator.clear();
     this->labelMap.clear();
     this->emitFunctionPrototype(F);
+    fn.setPartialGroupGuard(std::find(unit.partialGroupKernels.begin(), unit.partialGroupKernels.end(),
+                                      F.getName().str()) != unit.partialGroupKernels.end());
 
     this->allocateGlobalVariableRegister(F);
 
@@ -4049,6 +4051,7 @@ namespace gbe
       case GEN_OCL_IN_PRIVATE:
       case GEN_OCL_SIMD_ID:
       case GEN_OCL_SIMD_SHUFFLE:
+      case GEN_OCL_INDIRECT_READ:
       case GEN_OCL_VME:
       case GEN_OCL_IME:
       case GEN_OCL_WORK_GROUP_ALL:
@@ -4078,6 +4081,10 @@ namespace gbe
       case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM2:
       case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM4:
       case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM8:
+      case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL:
+      case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL2:
+      case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL4:
+      case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL8:
       case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_IMAGE:
       case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_IMAGE2:
       case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_IMAGE4:
@@ -4148,6 +4155,10 @@ namespace gbe
       case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM2:
       case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM4:
       case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM8:
+      case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL:
+      case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL2:
+      case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL4:
+      case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL8:
       case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_IMAGE:
       case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_IMAGE2:
       case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_IMAGE4:
@@ -4481,7 +4492,7 @@ namespace gbe
 
     Value *llvmPtr = *(AI++);
     ir::AddressSpace addrSpace = addressSpaceLLVMToGen(llvmPtr->getType()->getPointerAddressSpace());
-    GBE_ASSERT(addrSpace == ir::MEM_GLOBAL);
+    GBE_ASSERT(addrSpace == ir::MEM_GLOBAL || addrSpace == ir::MEM_LOCAL);
     ir::Register pointer = this->getRegister(llvmPtr);
 
     ir::Register ptr;
@@ -4489,7 +4500,12 @@ namespace gbe
     unsigned SurfaceIndex = 0xff;
 
     ir::AddressMode AM;
-    if (legacyMode) {
+    if (addrSpace == ir::MEM_LOCAL) {
+      // The local pointers are already offsets in the SLM
+      AM = ir::AM_StaticBti;
+      SurfaceIndex = BTI_LOCAL;
+      ptr = pointer;
+    } else if (legacyMode) {
       Value *bti = getBtiRegister(llvmPtr);
       Value *ptrBase = getPointerBase(llvmPtr);
       ir::Register baseReg = this->getRegister(ptrBase);
@@ -5557,6 +5573,17 @@ namespace gbe
             ctx.SIMD_SHUFFLE(getType(ctx, I.getType()), dst, src0, src1);
             break;
           }
+          case GEN_OCL_INDIRECT_READ:
+          {
+            // The index followed by the elements
+            vector<ir::Register> srcTupleData;
+            for (; AI != CS.arg_end(); ++AI)
+              srcTupleData.push_back(this->getRegister(*AI));
+            const ir::Register dst = this->getRegister(&I);
+            const ir::Tuple srcTuple = ctx.arrayTuple(&srcTupleData[0], srcTupleData.size());
+            ctx.INDIRECT_READ(getType(ctx, I.getType()), dst, srcTuple, srcTupleData.size() - 1);
+            break;
+          }
           case GEN_OCL_DEBUGWAIT:
           {
             ctx.WAIT();
@@ -5617,20 +5644,28 @@ namespace gbe
             break;
           }
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM:
+          case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL:
             this->emitBlockReadWriteMemInst(I, CS, false, 1); break;
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM2:
+          case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL2:
             this->emitBlockReadWriteMemInst(I, CS, false, 2); break;
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM4:
+          case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL4:
             this->emitBlockReadWriteMemInst(I, CS, false, 4); break;
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM8:
+          case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL8:
             this->emitBlockReadWriteMemInst(I, CS, false, 8); break;
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL:
             this->emitBlockReadWriteMemInst(I, CS, true, 1); break;
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM2:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL2:
             this->emitBlockReadWriteMemInst(I, CS, true, 2); break;
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM4:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL4:
             this->emitBlockReadWriteMemInst(I, CS, true, 4); break;
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM8:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL8:
             this->emitBlockReadWriteMemInst(I, CS, true, 8); break;
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_IMAGE:
             this->emitBlockReadWriteImageInst(I, CS, false, 1); break;
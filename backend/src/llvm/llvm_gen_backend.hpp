@@ -132,8 +132,14 @@ namespace gbe
   /*! Remove the GEP instructions */
   llvm::BasicBlockPass *createRemoveGEPPass(const ir::Unit &unit);
 
+  /*! Keep the small private arrays indexed with a variable in registers */
+  llvm::FunctionPass *createPrivateArrayPromotionPass();
+
+  /*! Disable the work items beyond the global size in the kernels */
+  llvm::FunctionPass *createPartialGroupGuardPass(ir::Unit &unit);
+
   /*! Merge load/store if possible */
-  llvm::BasicBlockPass *createLoadStoreOptimizationPass();
+  llvm::FunctionPass *createLoadStoreOptimizationPass();
 
   /*! Scalarize all vector op instructions */
   llvm::FunctionPass* createScalarizePass();
@@ -177,6 +177,7 @@ DECL_LLVM_GEN_FUNCTION(SIMD_SHUFFLE, intel_sub_group_shuffle)
 DECL_LLVM_GEN_FUNCTION(READ_TM, __gen_ocl_read_tm)
 DECL_LLVM_GEN_FUNCTION(REGION, __gen_ocl_region)
 DECL_LLVM_GEN_FUNCTION(IN_PRIVATE, __gen_ocl_in_private)
+DECL_LLVM_GEN_FUNCTION(INDIRECT_READ, __gen_ocl_indirect_read)
 
 DECL_LLVM_GEN_FUNCTION(VME, __gen_ocl_vme)
 DECL_LLVM_GEN_FUNCTION(IME, __gen_ocl_ime)
@@ -234,6 +235,14 @@ DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_MEM, __gen_ocl_sub_group_block_w
 DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_MEM2, __gen_ocl_sub_group_block_write_ui_mem2)
 DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_MEM4, __gen_ocl_sub_group_block_write_ui_mem4)
 DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_MEM8, __gen_ocl_sub_group_block_write_ui_mem8)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_READ_UI_LOCAL, __gen_ocl_sub_group_block_read_ui_local)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_READ_UI_LOCAL2, __gen_ocl_sub_group_block_read_ui_local2)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_READ_UI_LOCAL4, __gen_ocl_sub_group_block_read_ui_local4)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_READ_UI_LOCAL8, __gen_ocl_sub_group_block_read_ui_local8)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_LOCAL, __gen_ocl_sub_group_block_write_ui_local)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_LOCAL2, __gen_ocl_sub_group_block_write_ui_local2)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_LOCAL4, __gen_ocl_sub_group_block_write_ui_local4)
+DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_WRITE_UI_LOCAL8, __gen_ocl_sub_group_block_write_ui_local8)
 DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_READ_UI_IMAGE, __gen_ocl_sub_group_block_read_ui_image)
 DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_READ_UI_IMAGE2, __gen_ocl_sub_group_block_read_ui_image2)
 DECL_LLVM_GEN_FUNCTION(SUB_GROUP_BLOCK_READ_UI_IMAGE4, __gen_ocl_sub_group_block_read_ui_image4)
@@ -20,15 +20,20 @@
  * \author Yang Rong <rong.r.yang@intel.com>
  */
 
+#include <algorithm>
+
 #include "llvm_includes.hpp"
 
 #include "llvm/llvm_gen_backend.hpp"
 #include "sys/map.hpp"
+#include "sys/cvar.hpp"
 
 
 using namespace llvm;
 
 namespace gbe {
+    IVAR(OCL_INLINE_MEMCPY_SIZE, 0, 64, 256); // In bytes, 0 always calls the libocl functions
+
     class InstrinsicLowering : public BasicBlockPass
     {
     public:
@@ -89,6 +94,77 @@ namespace gbe {
         CI->eraseFromParent();
         return NewCI;
       }
+      /*! Access type of the next bytes of a copy or set, the widest one the
+       *  alignment allows: the untyped messages read or write up to 4 dwords
+       *  per lane at any dword aligned address */
+      static Type *getChunkType(LLVMContext &Context, uint64_t align, uint64_t remaining) {
+        if (align >= 4 && remaining >= 16)
+          return VectorType::get(Type::getInt32Ty(Context), 4);
+        if (align >= 4 && remaining >= 8)
+          return VectorType::get(Type::getInt32Ty(Context), 2);
+        if (align >= 4 && remaining >= 4)
+          return Type::getInt32Ty(Context);
+        if (align >= 2 && remaining >= 2)
+          return Type::getInt16Ty(Context);
+        return Type::getInt8Ty(Context);
+      }
+      /*! Copy or set a small constant size with loads and stores instead of
+       *  calling the libocl loop, so that SROA can also keep a copied struct
+       *  in registers. Return false if the call must be kept */
+      static bool expandSmallMemIntrinsic(CallInst *CI, bool isMemSet) {
+        ConstantInt *size = dyn_cast<ConstantInt>(CI->getArgOperand(2));
+        ConstantInt *align = dyn_cast<ConstantInt>(CI->getArgOperand(3));
+        ConstantInt *isVolatile = dyn_cast<ConstantInt>(CI->getArgOperand(4));
+        if (size == NULL || align == NULL || isVolatile == NULL || !isVolatile->isZero())
+          return false;
+        if (size->getZExtValue() > uint64_t(OCL_INLINE_MEMCPY_SIZE))
+          return false;
+        ConstantInt *val = NULL;
+        if (isMemSet) {
+          val = dyn_cast<ConstantInt>(CI->getArgOperand(1));
+          if (val == NULL)
+            return false;
+        }
+
+        LLVMContext &Context = CI->getContext();
+        IRBuilder<> Builder(CI->getParent(), BasicBlock::iterator(CI));
+        Value *dst = CI->getArgOperand(0);
+        Value *src = isMemSet ? NULL : CI->getArgOperand(1);
+        const uint64_t byteNum = size->getZExtValue();
+        const uint64_t baseAlign = std::max(align->getZExtValue(), uint64_t(1));
+        const uint8_t byte = isMemSet ? uint8_t(val->getZExtValue()) : 0;
+        uint64_t offset = 0;
+        while (offset < byteNum) {
+          const uint64_t chunkAlign = MinAlign(baseAlign, offset);
+          Type *chunkTy = getChunkType(Context, chunkAlign, byteNum - offset);
+          const uint32_t dstSpace = dst->getType()->getPointerAddressSpace();
+          Value *dstPtr = Builder.CreateConstGEP1_32(dst, offset);
+          dstPtr = Builder.CreateBitCast(dstPtr, PointerType::get(chunkTy, dstSpace));
+          Value *data;
+          if (isMemSet) {
+            Type *elemTy = chunkTy->getScalarType();
+            const uint32_t elemBytes = elemTy->getPrimitiveSizeInBits() / 8;
+            uint64_t splat = 0;
+            for (uint32_t i = 0; i < elemBytes; ++i)
+              splat = (splat << 8) | byte;
+            data = ConstantInt::get(elemTy, splat);
+            if (VectorType *vecTy = dyn_cast<VectorType>(chunkTy))
+              data = ConstantVector::getSplat(vecTy->getNumElements(), cast<Constant>(data));
+          } else {
+            const uint32_t srcSpace = src->getType()->getPointerAddressSpace();
+            Value *srcPtr = Builder.CreateConstGEP1_32(src, offset);
+            srcPtr = Builder.CreateBitCast(srcPtr, PointerType::get(chunkTy, srcSpace));
+            LoadInst *load = Builder.CreateLoad(srcPtr);
+            load->setAlignment(chunkAlign);
+            data = load;
+          }
+          StoreInst *store = Builder.CreateStore(data, dstPtr);
+          store->setAlignment(chunkAlign);
+          offset += chunkTy->getPrimitiveSizeInBits() / 8;
+        }
+        CI->eraseFromParent();
+        return true;
+      }
       virtual bool runOnBasicBlock(BasicBlock &BB)
       {
         bool changedBlock = false;
@@ -110,6 +186,10 @@ namespace gbe {
               continue;
             switch (intrinsicID) {
               case Intrinsic::memcpy: {
+                if (expandSmallMemIntrinsic(CI, false)) {
+                  changedBlock = true;
+                  break;
+                }
                 Type *IntPtr = TD.getIntPtrType(Context);
                 Value *Size = Builder.CreateIntCast(CI->getArgOperand(2), IntPtr,
                                                     /* isSigned */ false);
@@ -129,6 +209,10 @@ namespace gbe {
                 break;
               }
               case Intrinsic::memset: {
+                if (expandSmallMemIntrinsic(CI, true)) {
+                  changedBlock = true;
+                  break;
+                }
                 Value *Op0 = CI->getArgOperand(0);
                 Value *val = Builder.CreateIntCast(CI->getArgOperand(1), IntegerType::getInt8Ty(Context),
                                                     /* isSigned */ false);
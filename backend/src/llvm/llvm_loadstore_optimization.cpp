@@ -20,19 +20,24 @@
  * then merge successive load/store that are compatible is beneficial.
  * The method of checking whether two load/store is compatible are borrowed
  * from Vectorize passes in llvm.
+ *
+ * The search for compatible load/store is not limited to one basic block: it
+ * goes on in the block where all the paths leaving the block meet again, when
+ * the blocks in between are simple if/else sides. This is the code left by
+ * the unrolled loops with a condition in the body and by the if-conversion.
  */
 
 #include "llvm_includes.hpp"
 
 using namespace llvm;
 namespace gbe {
-  class GenLoadStoreOptimization : public BasicBlockPass {
+  class GenLoadStoreOptimization : public FunctionPass {
 
   public:
     static char ID;
     ScalarEvolution *SE;
     const DataLayout *TD;
-    GenLoadStoreOptimization() : BasicBlockPass(ID) {}
+    GenLoadStoreOptimization() : FunctionPass(ID) {}
 
     void getAnalysisUsage(AnalysisUsage &AU) const {
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
@@ -45,26 +50,32 @@ namespace gbe {
       AU.setPreservesCFG();
     }
 
-    virtual bool runOnBasicBlock(BasicBlock &BB) {
+    virtual bool runOnFunction(Function &F) {
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
       SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
 #else
       SE = &getAnalysis<ScalarEvolution>();
 #endif
       #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 37
-        TD = &BB.getModule()->getDataLayout();
+        TD = &F.getParent()->getDataLayout();
       #elif LLVM_VERSION_MINOR >= 5
         DataLayoutPass *DLP = getAnalysisIfAvailable<DataLayoutPass>();
         TD = DLP ? &DLP->getDataLayout() : nullptr;
       #else
         TD = getAnalysisIfAvailable<DataLayout>();
       #endif
-      return optimizeLoadStore(BB);
+      bool changed = false;
+      for (Function::iterator BB = F.begin(); BB != F.end(); ++BB)
+        changed |= optimizeLoadStore(*BB);
+      return changed;
     }
     Type *getValueType(Value *insn);
     Value *getPointerOperand(Value *I);
     unsigned getAddressSpace(Value *I);
     bool isSimpleLoadStore(Value *I);
+    bool isOrderingPoint(Instruction *I, bool isLoad, unsigned addrSpace,
+                         bool conditional);
+    BasicBlock *findJoinBlock(BasicBlock *BB, SmallVector<BasicBlock *, 2> &sides);
     bool optimizeLoadStore(BasicBlock &BB);
 
     bool isLoadStoreCompatible(Value *A, Value *B, int *dist, int *elementSize,
@@ -73,8 +84,7 @@ namespace gbe {
                    Instruction *first, int offset);
     void mergeStore(BasicBlock &BB, SmallVector<Instruction *, 16> &merged,
                     Instruction *first, Instruction *last, int offset);
-    bool findConsecutiveAccess(BasicBlock &BB,
-                               SmallVector<Instruction *, 16> &merged,
+    void findConsecutiveAccess(SmallVector<Instruction *, 16> &merged,
                                const BasicBlock::iterator &start,
                                unsigned maxVecSize, bool isLoad,
                                int *addrOffset, Instruction *&first,
@@ -206,45 +216,126 @@ namespace gbe {
     }
   };
 
+  // Check if the instruction met while searching for load/store to merge with
+  // a load/store of addrSpace must stop the search. Loads are moved before the
+  // instructions in between and stores after them, so nothing writing memory
+  // (like a barrier) may be crossed by the loads, and nothing touching memory
+  // by the stores. The load/store of another address space can be crossed. In
+  // a conditional block, any access to the same address space stops the search.
+  bool GenLoadStoreOptimization::isOrderingPoint(Instruction *I, bool isLoad,
+                                                 unsigned addrSpace,
+                                                 bool conditional) {
+    if (isa<LoadInst>(I) || isa<StoreInst>(I)) {
+      if (!isSimpleLoadStore(I))
+        return true;
+      if (getAddressSpace(I) != addrSpace)
+        return false;
+      return conditional || (isLoad && isa<StoreInst>(I)) ||
+             (!isLoad && isa<LoadInst>(I));
+    }
+    if (isLoad)
+      return I->mayWriteToMemory();
+    return I->mayReadOrWriteMemory();
+  }
+
+  // Find the block run by all the lanes leaving BB, if they may only go
+  // through one or two blocks with no other entry on the way (if/else sides).
+  // The sides are returned in sides. A load/store of the returned block may
+  // be merged with the ones of BB.
+  BasicBlock *GenLoadStoreOptimization::findJoinBlock(BasicBlock *BB,
+                                                      SmallVector<BasicBlock *, 2> &sides) {
+    sides.clear();
+    BranchInst *br = dyn_cast<BranchInst>(BB->getTerminator());
+    if (!br) return NULL;
+
+    // The single successor of a side
+    auto sideExit = [BB](BasicBlock *side) -> BasicBlock * {
+      if (side == BB || side->getSinglePredecessor() != BB)
+        return NULL;
+      BranchInst *sbr = dyn_cast<BranchInst>(side->getTerminator());
+      if (!sbr || sbr->isConditional())
+        return NULL;
+      return sbr->getSuccessor(0);
+    };
+
+    BasicBlock *join = NULL;
+    BasicBlock *s0 = br->getSuccessor(0);
+    BasicBlock *s1 = br->isConditional() ? br->getSuccessor(1) : s0;
+    if (s0 == s1)
+      join = s0;
+    else if (sideExit(s0) == s1) {
+      sides.push_back(s0);
+      join = s1;
+    } else if (sideExit(s1) == s0) {
+      sides.push_back(s1);
+      join = s0;
+    } else if (sideExit(s0) != NULL && sideExit(s0) == sideExit(s1)) {
+      sides.push_back(s0);
+      sides.push_back(s1);
+      join = sideExit(s0);
+    } else
+      return NULL;
+
+    if (join == BB) return NULL;
+    for (pred_iterator PI = pred_begin(join); PI != pred_end(join); ++PI)
+      if (*PI != BB && std::find(sides.begin(), sides.end(), *PI) == sides.end())
+        return NULL;
+    return join;
+  }
+
   // When searching for consecutive memory access, we do it in a small window,
   // if the window is too large, it would take up too much compiling time.
   // An Important rule we have followed is don't try to change load/store order.
-  // But an exeption is 'load& store that are from different address spaces. The
-  // return value will indicate wheter such kind of reorder happens.
-  bool
-  GenLoadStoreOptimization::findConsecutiveAccess(BasicBlock &BB,
-                            SmallVector<Instruction*, 16> &merged,
+  // But an exeption is 'load& store that are from different address spaces.
+  // The window starts in the block of start and goes on in the join blocks
+  // found by findJoinBlock.
+  void
+  GenLoadStoreOptimization::findConsecutiveAccess(SmallVector<Instruction*, 16> &merged,
                             const BasicBlock::iterator &start,
                             unsigned maxVecSize,
                             bool isLoad,
                             int *addrOffset,
                             Instruction *&first,
                             Instruction *&last) {
-    if(!isSimpleLoadStore(&*start)) return false;
+    if(!isSimpleLoadStore(&*start)) return;
 
     unsigned targetAddrSpace = getAddressSpace(&*start);
 
-    BasicBlock::iterator E = BB.end();
+    BasicBlock *BB = start->getParent();
     BasicBlock::iterator J = start;
     ++J;
 
     unsigned maxLimit = maxVecSize * 8;
-    bool crossAddressSpace = false;
-    // When we are merging loads and there are some other AddressSpace stores
-    // lies among them, we are saying that loadStoreReorder happens. The same
-    // for merging stores and there are some other AddressSpace load among them.
-    bool loadStoreReorder = false;
     bool ready = false;
     int elementSize;
 
     SmallVector<mergedInfo *, 32> searchInsnArray;
     SmallVector<mergedInfo *, 32> orderedInstrs;
+    SmallVector<BasicBlock *, 2> sides;
+    SmallVector<BasicBlock *, 8> region;
     mergedInfo meInfoArray[32];
     int indx = 0;
     meInfoArray[indx++].init(&*start, 0);
     searchInsnArray.push_back(&meInfoArray[0]);
+    region.push_back(BB);
 
-    for(unsigned ss = 0; J!= E && ss <= maxLimit; ++ss, ++J) {
+    for(unsigned ss = 0; ss <= maxLimit; ++ss, ++J) {
+      if (J == BB->end()) {
+        BasicBlock *join = findJoinBlock(BB, sides);
+        if (join == NULL ||
+            std::find(region.begin(), region.end(), join) != region.end())
+          break;
+        // Nothing in the sides may be crossed by the merged load/store
+        bool blocked = false;
+        for (auto side : sides)
+          for (BasicBlock::iterator I = side->begin(); I != side->end() && !blocked; ++I)
+            blocked = isOrderingPoint(&*I, isLoad, targetAddrSpace, true);
+        if (blocked)
+          break;
+        region.push_back(join);
+        BB = join;
+        J = BB->begin();
+      }
       if((isLoad && isa<LoadInst>(*J)) || (!isLoad && isa<StoreInst>(*J))) {
           int distance;
           if(isLoadStoreCompatible(searchInsnArray[0]->mInsn, &*J, &distance, &elementSize, maxVecSize))
@@ -252,33 +343,15 @@ namespace gbe {
             meInfoArray[indx].init(&*J, distance);
             searchInsnArray.push_back(&meInfoArray[indx]);
             indx++;
-            if (crossAddressSpace)
-              loadStoreReorder = true;
 
             if(indx >= 32)
               break;
-          }
-      } else if((isLoad && isa<StoreInst>(*J))) {
-        // simple stop to keep read/write order
-        StoreInst *st = cast<StoreInst>(&*J);
-        unsigned addrSpace = st->getPointerAddressSpace();
-        if (addrSpace != targetAddrSpace) {
-          crossAddressSpace = true;
-        } else {
-          break;
-        }
-      } else if ((!isLoad && isa<LoadInst>(*J))) {
-        LoadInst *ld = cast<LoadInst>(&*J);
-        unsigned addrSpace = ld->getPointerAddressSpace();
-        if (addrSpace != targetAddrSpace) {
-          crossAddressSpace = true;
-        } else {
-          break;
-        }
-      }
+          } else if (!isSimpleLoadStore(&*J))
+            break;
+      } else if (isOrderingPoint(&*J, isLoad, targetAddrSpace, false))
+        break;
     }
 
-
     if(indx > 1)
     {
       first = (*searchInsnArray.begin())->mInsn;
@@ -330,8 +403,6 @@ namespace gbe {
         }
       }
     }
-
-    return loadStoreReorder;
   }
 
   void GenLoadStoreOptimization::mergeStore(BasicBlock &BB,
@@ -385,27 +456,18 @@ namespace gbe {
   }
 
   // Find the safe iterator (will not be deleted after the merge) we can
-  // point to. If reorder happens, we need to
-  // point to the instruction after the first of toBeDeleted. If no reorder,
-  // we are safe to point to the instruction after the last of toBeDeleted
+  // point to. The merged load/store may be in the next blocks and some
+  // load/store of the current block in between may be left, so we point to the
+  // first instruction after current not in toBeDeleted, in the current block
   static BasicBlock::iterator
   findSafeInstruction(SmallVector<Instruction*, 16> &toBeDeleted,
-                           const BasicBlock::iterator &current,
-                           bool reorder) {
+                           const BasicBlock::iterator &current) {
     BasicBlock::iterator safe = current;
-    unsigned size = toBeDeleted.size();
-    if (reorder) {
-      BasicBlock *BB = &*current->getParent();
-      for (; safe != BB->end(); ++safe) {
-        if (std::find(toBeDeleted.begin(), toBeDeleted.end(), &*safe) ==
-            toBeDeleted.end())
-          break;
-      }
-    } else {
-      // TODO we should use the furthest instruction, so that the outer loop
-      // ends quicker.
-      safe = BasicBlock::iterator(toBeDeleted[size - 1]);
-      ++safe;
+    BasicBlock *BB = &*current->getParent();
+    for (; safe != BB->end(); ++safe) {
+      if (std::find(toBeDeleted.begin(), toBeDeleted.end(), &*safe) ==
+          toBeDeleted.end())
+        break;
     }
     return safe;
   }
@@ -428,14 +490,14 @@ namespace gbe {
         Instruction *first = nullptr, *last = nullptr;
         unsigned maxVecSize = (ty->isFloatTy() || ty->isIntegerTy(32)) ? 4 :
                               (ty->isIntegerTy(16) ? 8 : 16);
-        bool reorder = findConsecutiveAccess(BB, merged, BBI, maxVecSize,
-                                             isLoad, &addrOffset, first, last);
+        findConsecutiveAccess(merged, BBI, maxVecSize,
+                              isLoad, &addrOffset, first, last);
         uint32_t size = merged.size();
         uint32_t pos = 0;
         bool doDeleting = size > 1;
         if (doDeleting) {
           // choose next undeleted instruction
-          BBI = findSafeInstruction(merged, BBI, reorder);
+          BBI = findSafeInstruction(merged, BBI);
         }
 
         while(size > 1) {
@@ -466,7 +528,7 @@ namespace gbe {
     return changed;
   }
 
-  BasicBlockPass *createLoadStoreOptimizationPass() {
+  FunctionPass *createLoadStoreOptimizationPass() {
     return new GenLoadStoreOptimization();
   }
 };
@@ -0,0 +1,153 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * When the global size is not a multiple of the local size, the last work
+ * groups of a dimension are partial. Instead of one launch per combination of
+ * full and partial groups, the runtime dispatches the partial groups with the
+ * same shape as the full ones, the walker only disabling the lanes beyond the
+ * last thread of a group. This pass makes the kernel disable the other work
+ * items beyond the global size: the body is only run when the local IDs are
+ * below the size of the group, computed from the global size and the group
+ * ID, and get_local_size returns this size.
+ *
+ * The disabled work items do not reach the barriers and do not take part in
+ * the work group and sub group functions, so the kernels using them are left
+ * alone and the runtime keeps a launch per kind of group for them.
+ */
+
+#include "sys/cvar.hpp"
+#include "llvm_includes.hpp"
+#include "llvm/llvm_gen_backend.hpp"
+#include "ir/unit.hpp"
+
+using namespace llvm;
+
+namespace gbe {
+
+  BVAR(OCL_SINGLE_NDRANGE_DISPATCH, true);
+
+  class PartialGroupGuard : public FunctionPass {
+  public:
+    static char ID;
+    PartialGroupGuard(ir::Unit &unit) : FunctionPass(ID), unit(unit) {}
+
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+    virtual StringRef getPassName() const
+#else
+    virtual const char *getPassName() const
+#endif
+    {
+      return "Disable the work items of the partial work groups";
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+  private:
+    /*! True if all the work items of a group must run the kernel */
+    bool needWholeGroup(Function &F) const;
+    /*! Call the work item builtin NAME of the dimension */
+    Value *callWorkItemFn(IRBuilder<> &builder, const char *name, uint32_t dim) const;
+    ir::Unit &unit;
+  };
+
+  char PartialGroupGuard::ID = 0;
+
+  bool PartialGroupGuard::needWholeGroup(Function &F) const {
+    for (inst_iterator I = inst_begin(&F), E = inst_end(&F); I != E; ++I) {
+      CallInst *call = dyn_cast<CallInst>(&*I);
+      if (call == NULL)
+        continue;
+      Function *callee = call->getCalledFunction();
+      if (callee == NULL || !callee->isDeclaration())
+        return true;
+      const StringRef name = callee->getName();
+      if (name.startswith("__gen_ocl_barrier") ||
+          name.startswith("__gen_ocl_work_group_") ||
+          name.startswith("__gen_ocl_sub_group_") ||
+          name.startswith("sub_group_") ||
+          name.startswith("intel_sub_group_") ||
+          name == "get_simd_size" ||
+          name == "get_sub_group_local_id" ||
+          name.startswith("__gen_enqueue_kernel") ||
+          name.startswith("__gen_ocl_get_enqueue_info"))
+        return true;
+    }
+    return false;
+  }
+
+  Value *PartialGroupGuard::callWorkItemFn(IRBuilder<> &builder, const char *name, uint32_t dim) const {
+    Module *M = builder.GetInsertBlock()->getParent()->getParent();
+    Type *intTy = builder.getInt32Ty();
+    const std::string fnName = std::string(name) + char('0' + dim);
+    Function *fn = cast<Function>(M->getOrInsertFunction(fnName, FunctionType::get(intTy, false)));
+    return builder.CreateCall(fn);
+  }
+
+  bool PartialGroupGuard::runOnFunction(Function &F) {
+    if (!OCL_SINGLE_NDRANGE_DISPATCH || !isKernelFunction(F) || needWholeGroup(F))
+      return false;
+
+    // The guard comes after the allocas, they stay in the entry block
+    LLVMContext &ctx = F.getContext();
+    BasicBlock &entry = F.getEntryBlock();
+    BasicBlock::iterator first = entry.begin();
+    while (isa<AllocaInst>(&*first))
+      ++first;
+    BasicBlock *body = entry.splitBasicBlock(first, "partial.group.body");
+    BasicBlock *exit = BasicBlock::Create(ctx, "partial.group.exit", &F);
+    ReturnInst::Create(ctx, exit);
+
+    // local size = min(enqueued local size, global size - group ID * enqueued local size)
+    Instruction *jump = entry.getTerminator();
+    IRBuilder<> builder(jump);
+    Value *localSize[3];
+    Value *inGroup = builder.getTrue();
+    for (uint32_t dim = 0; dim < 3; ++dim) {
+      Value *enqueued = callWorkItemFn(builder, "__gen_ocl_get_enqueued_local_size", dim);
+      Value *groupID = callWorkItemFn(builder, "__gen_ocl_get_group_id", dim);
+      Value *globalSize = callWorkItemFn(builder, "__gen_ocl_get_global_size", dim);
+      Value *localID = callWorkItemFn(builder, "__gen_ocl_get_local_id", dim);
+      Value *left = builder.CreateSub(globalSize, builder.CreateMul(groupID, enqueued));
+      localSize[dim] = builder.CreateSelect(builder.CreateICmpULT(left, enqueued), left, enqueued);
+      inGroup = builder.CreateAnd(inGroup, builder.CreateICmpULT(localID, localSize[dim]));
+    }
+    builder.CreateCondBr(inGroup, body, exit);
+    jump->eraseFromParent();
+
+    // get_local_size reads the size of the enqueued groups from the curbe
+    SmallVector<CallInst*, 8> localSizeCalls;
+    for (inst_iterator I = inst_begin(&F), E = inst_end(&F); I != E; ++I) {
+      CallInst *call = dyn_cast<CallInst>(&*I);
+      if (call == NULL || call->getCalledFunction() == NULL)
+        continue;
+      const StringRef name = call->getCalledFunction()->getName();
+      if (name.startswith("__gen_ocl_get_local_size") && name.size() == 25)
+        localSizeCalls.push_back(call);
+    }
+    for (auto call : localSizeCalls) {
+      const uint32_t dim = call->getCalledFunction()->getName().back() - '0';
+      call->replaceAllUsesWith(localSize[dim]);
+      call->eraseFromParent();
+    }
+
+    unit.partialGroupKernels.push_back(F.getName().str());
+    return true;
+  }
+
+  FunctionPass *createPartialGroupGuardPass(ir::Unit &unit) {
+    return new PartialGroupGuard(unit);
+  }
+} /* namespace gbe */
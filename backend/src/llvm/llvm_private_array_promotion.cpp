@@ -0,0 +1,231 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SROA leaves in memory the private arrays indexed with a variable, and they
+ * end up in the stack, where every access is a scratch message. This pass
+ * turns the small ones of dwords into a vector, only accessed with
+ * extractelement and insertelement, so that mem2reg keeps them in registers.
+ * The scalarize pass then reads an element with a variable index through an
+ * indirect register access and writes it with one select per element.
+ *
+ * The arrays are promoted from the smallest one until the dwords promoted in
+ * the function reach OCL_PRIVATE_ARRAY_REG_SIZE: every promoted dword takes
+ * one register per 8 lanes for its whole live range, and too many of them
+ * make the kernel spill or fall back to SIMD8.
+ */
+
+#include <algorithm>
+
+#include "sys/cvar.hpp"
+#include "llvm_includes.hpp"
+#include "llvm/llvm_gen_backend.hpp"
+
+using namespace llvm;
+
+namespace gbe {
+
+  IVAR(OCL_PRIVATE_ARRAY_REG_SIZE, 0, 32, 128); // In dwords per work item, 0 disables the promotion
+
+  /*! Largest array kept in registers, this is also the largest vector the
+   *  scalarize pass handles */
+  static const uint32_t maxPromotedElemNum = 32;
+
+  class PrivateArrayPromotion : public FunctionPass {
+  public:
+    static char ID;
+    PrivateArrayPromotion() : FunctionPass(ID) {}
+
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+    virtual StringRef getPassName() const
+#else
+    virtual const char *getPassName() const
+#endif
+    {
+      return "Promote private arrays to registers";
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+  private:
+    /*! Element number of the array if it can be promoted, 0 otherwise */
+    uint32_t getPromotableElemNum(AllocaInst *alloca) const;
+    /*! The whole array value written by an initialization intrinsic */
+    Constant *getInitValue(IntrinsicInst *intr, VectorType *vecTy) const;
+    void promote(AllocaInst *alloca, uint32_t elemNum);
+  };
+
+  char PrivateArrayPromotion::ID = 0;
+
+  static bool isLifetimeMarker(const IntrinsicInst *intr) {
+    return intr->getIntrinsicID() == Intrinsic::lifetime_start ||
+           intr->getIntrinsicID() == Intrinsic::lifetime_end;
+  }
+
+  Constant *PrivateArrayPromotion::getInitValue(IntrinsicInst *intr, VectorType *vecTy) const {
+    const uint32_t elemNum = vecTy->getNumElements();
+    ConstantInt *length = dyn_cast<ConstantInt>(intr->getArgOperand(2));
+    if (length == NULL || length->getZExtValue() != elemNum * 4)
+      return NULL;
+
+    // int array[N] = {0};
+    if (MemSetInst *memSet = dyn_cast<MemSetInst>(intr)) {
+      ConstantInt *value = dyn_cast<ConstantInt>(memSet->getValue());
+      if (value == NULL || !value->isZero())
+        return NULL;
+      return ConstantAggregateZero::get(vecTy);
+    }
+
+    // int array[N] = {...}; copied from a constant global
+    MemCpyInst *memCpy = dyn_cast<MemCpyInst>(intr);
+    if (memCpy == NULL)
+      return NULL;
+    GlobalVariable *global = dyn_cast<GlobalVariable>(memCpy->getSource()->stripPointerCasts());
+    if (global == NULL || !global->isConstant() || !global->hasInitializer())
+      return NULL;
+    Constant *init = global->getInitializer();
+    if (init->getType() != ArrayType::get(vecTy->getElementType(), elemNum))
+      return NULL;
+    SmallVector<Constant*, 32> elems;
+    for (uint32_t elemID = 0; elemID < elemNum; ++elemID)
+      elems.push_back(init->getAggregateElement(elemID));
+    return ConstantVector::get(elems);
+  }
+
+  uint32_t PrivateArrayPromotion::getPromotableElemNum(AllocaInst *alloca) const {
+    ArrayType *arrayTy = dyn_cast<ArrayType>(alloca->getAllocatedType());
+    if (arrayTy == NULL || alloca->isArrayAllocation())
+      return 0;
+    Type *elemTy = arrayTy->getElementType();
+    const uint32_t elemNum = arrayTy->getNumElements();
+    if (!elemTy->isFloatTy() && !elemTy->isIntegerTy(32))
+      return 0;
+    if (elemNum < 2 || elemNum > maxPromotedElemNum)
+      return 0;
+    VectorType *vecTy = VectorType::get(elemTy, elemNum);
+
+    // The array is only read and written one element at a time. The
+    // arrays only indexed with constants are already split by SROA.
+    bool variableIndex = false;
+    for (Value::user_iterator U = alloca->user_begin(); U != alloca->user_end(); ++U) {
+      if (GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(*U)) {
+        ConstantInt *first = dyn_cast<ConstantInt>(gep->getOperand(1));
+        if (gep->getNumIndices() != 2 || first == NULL || !first->isZero())
+          return 0;
+        if (!isa<ConstantInt>(gep->getOperand(2)))
+          variableIndex = true;
+        for (Value::user_iterator GU = gep->user_begin(); GU != gep->user_end(); ++GU) {
+          if (LoadInst *load = dyn_cast<LoadInst>(*GU)) {
+            if (!load->isSimple())
+              return 0;
+          } else if (StoreInst *store = dyn_cast<StoreInst>(*GU)) {
+            if (!store->isSimple() || store->getPointerOperand() != gep)
+              return 0;
+          } else
+            return 0;
+        }
+      } else if (BitCastInst *bitCast = dyn_cast<BitCastInst>(*U)) {
+        for (Value::user_iterator BU = bitCast->user_begin(); BU != bitCast->user_end(); ++BU) {
+          IntrinsicInst *intr = dyn_cast<IntrinsicInst>(*BU);
+          if (intr == NULL)
+            return 0;
+          if (isLifetimeMarker(intr))
+            continue;
+          if (intr->getArgOperand(0) != bitCast || getInitValue(intr, vecTy) == NULL)
+            return 0;
+        }
+      } else
+        return 0;
+    }
+    return variableIndex ? elemNum : 0;
+  }
+
+  void PrivateArrayPromotion::promote(AllocaInst *alloca, uint32_t elemNum) {
+    ArrayType *arrayTy = cast<ArrayType>(alloca->getAllocatedType());
+    VectorType *vecTy = VectorType::get(arrayTy->getElementType(), elemNum);
+    IRBuilder<> builder(alloca);
+    AllocaInst *vecAlloca = builder.CreateAlloca(vecTy, nullptr, alloca->getName());
+
+    SmallVector<Instruction*, 16> users;
+    for (Value::user_iterator U = alloca->user_begin(); U != alloca->user_end(); ++U)
+      users.push_back(cast<Instruction>(*U));
+
+    for (auto user : users) {
+      SmallVector<Instruction*, 16> accesses;
+      for (Value::user_iterator U = user->user_begin(); U != user->user_end(); ++U)
+        accesses.push_back(cast<Instruction>(*U));
+
+      for (auto access : accesses) {
+        builder.SetInsertPoint(access);
+        if (LoadInst *load = dyn_cast<LoadInst>(access)) {
+          Value *vec = builder.CreateLoad(vecAlloca);
+          Value *elem = builder.CreateExtractElement(vec, user->getOperand(2));
+          load->replaceAllUsesWith(elem);
+        } else if (StoreInst *store = dyn_cast<StoreInst>(access)) {
+          Value *vec = builder.CreateLoad(vecAlloca);
+          vec = builder.CreateInsertElement(vec, store->getValueOperand(), user->getOperand(2));
+          builder.CreateStore(vec, vecAlloca);
+        } else {
+          IntrinsicInst *intr = cast<IntrinsicInst>(access);
+          if (!isLifetimeMarker(intr))
+            builder.CreateStore(getInitValue(intr, vecTy), vecAlloca);
+        }
+        access->eraseFromParent();
+      }
+      user->eraseFromParent();
+    }
+    alloca->eraseFromParent();
+  }
+
+  static bool cmpElemNum(const std::pair<AllocaInst*, uint32_t> &a0,
+                         const std::pair<AllocaInst*, uint32_t> &a1) {
+    return a0.second < a1.second;
+  }
+
+  bool PrivateArrayPromotion::runOnFunction(Function &F) {
+    if (OCL_PRIVATE_ARRAY_REG_SIZE == 0 || !isKernelFunction(F))
+      return false;
+
+    // All the functions are inlined, the private arrays are the allocas of
+    // the entry block
+    std::vector<std::pair<AllocaInst*, uint32_t>> candidates;
+    BasicBlock &entry = F.getEntryBlock();
+    for (BasicBlock::iterator I = entry.begin(); I != entry.end(); ++I) {
+      AllocaInst *alloca = dyn_cast<AllocaInst>(&*I);
+      if (alloca == NULL)
+        continue;
+      const uint32_t elemNum = getPromotableElemNum(alloca);
+      if (elemNum != 0)
+        candidates.push_back(std::make_pair(alloca, elemNum));
+    }
+
+    // Keep as many arrays as possible in the register budget
+    std::stable_sort(candidates.begin(), candidates.end(), cmpElemNum);
+    uint32_t promotedSize = 0;
+    bool changed = false;
+    for (auto &candidate : candidates) {
+      if (promotedSize + candidate.second > uint32_t(OCL_PRIVATE_ARRAY_REG_SIZE))
+        break;
+      promotedSize += candidate.second;
+      promote(candidate.first, candidate.second);
+      changed = true;
+    }
+    return changed;
+  }
+
+  FunctionPass *createPrivateArrayPromotionPass() {
+    return new PrivateArrayPromotion();
+  }
+} /* namespace gbe */
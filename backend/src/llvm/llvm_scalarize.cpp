@@ -707,6 +707,10 @@ namespace gbe {
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM2:
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM4:
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_MEM8:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL2:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL4:
+          case GEN_OCL_SUB_GROUP_BLOCK_WRITE_UI_LOCAL8:
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_US_MEM:
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_US_MEM2:
           case GEN_OCL_SUB_GROUP_BLOCK_WRITE_US_MEM4:
@@ -721,6 +725,9 @@ namespace gbe {
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM2:
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM4:
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_MEM8:
+          case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL2:
+          case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL4:
+          case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_LOCAL8:
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_IMAGE2:
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_IMAGE4:
           case GEN_OCL_SUB_GROUP_BLOCK_READ_UI_IMAGE8:
@@ -789,14 +796,33 @@ namespace gbe {
     // ==> nothing (just use %foo's %ith component instead of %res)
 
     if (! isa<Constant>(extr->getOperand(1))) {
-        // TODO: Variably referenced components. Probably handle/emulate through
-        // a series of selects.
-        //NOT_IMPLEMENTED; //gla::UnsupportedFunctionality("Variably referenced vector components");
-        //TODO: This is a implement for the non-constant index, we use an allocated new vector
-        //to store the need vector elements.
         Value* foo = extr->getOperand(0);
         Type* fooTy = foo ? foo->getType() : NULL;
 
+        // Dword components stay in registers, the backend reads the selected
+        // one with an indirect register access
+        Type* elemTy = GetBasicType(fooTy);
+        if (elemTy->isFloatTy() || elemTy->isIntegerTy(32)) {
+          Function* readFn = cast<Function>(module->getOrInsertFunction(
+                             "__gen_ocl_indirect_read", FunctionType::get(intTy, intTy, true)));
+          readFn->setDoesNotAccessMemory();
+          SmallVector<Value*, 32> args;
+          args.push_back(builder->CreateZExtOrTrunc(extr->getOperand(1), intTy));
+          for (int i = 0; i < GetComponentCount(foo); ++i) {
+            Value* foo_i = getComponent(i, foo);
+            assert(foo_i && "There is unhandled vector component");
+            args.push_back(elemTy == intTy ? foo_i : builder->CreateBitCast(foo_i, intTy));
+          }
+          Value* readComp = builder->CreateCall(readFn, args);
+          if (elemTy != intTy)
+            readComp = builder->CreateBitCast(readComp, elemTy);
+          extr->replaceAllUsesWith(readComp);
+          return true;
+        }
+
+        //For the other components, we use an allocated new vector to store
+        //the need vector elements.
+
         Value* Alloc;
         if(vectorAlloca.find(foo) == vectorAlloca.end())
         {
@@ -844,15 +870,21 @@ namespace gbe {
     //     %res = insertValue <n x ty> %foo, %i
     // ==> nothing (just make a new VectorValues with the new component)
 
-    if (! isa<Constant>(ins->getOperand(2))) {
-      // TODO: Variably referenced components. Probably handle/emulate through
-      // a series of selects.
-      NOT_IMPLEMENTED;   //gla::UnsupportedFunctionality("Variably referenced vector components");
+    VectorValues& vVals = vectorVals[ins];
+    Value* idx = ins->getOperand(2);
+    if (! isa<Constant>(idx)) {
+      // Variably referenced component: every component selects between its
+      // old value and the inserted one
+      for (int i = 0; i < GetComponentCount(ins); ++i) {
+        Value* isComp = builder->CreateICmpEQ(idx, ConstantInt::get(idx->getType(), i));
+        setComponent(vVals, i, builder->CreateSelect(isComp, ins->getOperand(1),
+                                                     getComponent(i, ins->getOperand(0))));
+      }
+      return true;
     }
 
-    int component = GetConstantInt(ins->getOperand(2));
+    int component = GetConstantInt(idx);
 
-    VectorValues& vVals = vectorVals[ins];
     for (int i = 0; i < GetComponentCount(ins); ++i) {
       setComponent(vVals, i, i == component ? ins->getOperand(1)
                    : getComponent(i, ins->getOperand(0)));
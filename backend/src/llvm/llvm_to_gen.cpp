@@ -361,6 +361,8 @@ namespace gbe
 #else
     passes.add(createScalarReplAggregatesPass(64, true, -1, -1, 64));
 #endif
+    passes.add(createPrivateArrayPromotionPass());
+    passes.add(createPartialGroupGuardPass(unit));
     passes.add(createLoadStoreOptimizationPass());
     passes.add(createConstantPropagationPass());
     passes.add(createPromoteMemoryToRegisterPass());
@@ -0,0 +1,88 @@
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cstdio>
+#include <string>
+
+/* Build the same number of independent programs from one thread, then from
+ * one thread per core, and report the speedup of the parallel builds.
+ */
+#define PARALLEL_BUILD_PROGRAMS  32
+#define PARALLEL_BUILD_MAX_THREADS  64
+
+struct build_job {
+  int first;
+  int count;
+  int round;
+};
+
+static void build_programs(int first, int count, int round)
+{
+  char source[1024];
+  for (int i = first; i < first + count; i++) {
+    /* Make every source unique so that nothing can be reused between builds */
+    snprintf(source, sizeof(source),
+      "/* round %d */\n"
+      "__kernel void bench_parallel_build(__global float4 *dst, __global const float4 *src, int n)\n"
+      "{\n"
+      "  int id = get_global_id(0);\n"
+      "  float4 acc = src[id];\n"
+      "  for (int i = 0; i < n; i++) {\n"
+      "    acc = mad(acc, src[id + i + %d], (float4)(%d.5f));\n"
+      "    acc = sin(acc) * cos(acc + %d.0f) + sqrt(fabs(acc));\n"
+      "  }\n"
+      "  dst[id] = acc;\n"
+      "}\n", round, i, i, i);
+    const char *str = source;
+    cl_int status;
+    cl_program prog = clCreateProgramWithSource(ctx, 1, &str, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    OCL_CALL(clBuildProgram, prog, 1, &device, NULL, NULL, NULL);
+    clReleaseProgram(prog);
+  }
+}
+
+static void *build_thread_function(void *arg)
+{
+  build_job *job = (build_job *)arg;
+  build_programs(job->first, job->count, job->round);
+  return NULL;
+}
+
+static double build_with_threads(int thread_num, int round)
+{
+  struct timeval start,stop;
+  pthread_t tid[PARALLEL_BUILD_MAX_THREADS];
+  build_job jobs[PARALLEL_BUILD_MAX_THREADS];
+
+  gettimeofday(&start,0);
+  for (int t = 0; t < thread_num; t++) {
+    jobs[t].first = PARALLEL_BUILD_PROGRAMS * t / thread_num;
+    jobs[t].count = PARALLEL_BUILD_PROGRAMS * (t + 1) / thread_num - jobs[t].first;
+    jobs[t].round = round;
+    OCL_ASSERT(pthread_create(&tid[t], NULL, build_thread_function, &jobs[t]) == 0);
+  }
+  for (int t = 0; t < thread_num; t++)
+    pthread_join(tid[t], NULL);
+  gettimeofday(&stop,0);
+  return time_subtract(&stop, &start, 0);
+}
+
+double benchmark_build_parallel(void)
+{
+  int thread_num = sysconf(_SC_NPROCESSORS_ONLN);
+  if (thread_num < 1)
+    thread_num = 1;
+  if (thread_num > PARALLEL_BUILD_MAX_THREADS)
+    thread_num = PARALLEL_BUILD_MAX_THREADS;
+
+  const double serial = build_with_threads(1, 0);
+  const double parallel = build_with_threads(thread_num, 1);
+
+  printf("\t%d programs, 1 thread: %.1f ms, %d threads: %.1f ms",
+         PARALLEL_BUILD_PROGRAMS, serial, thread_num, parallel);
+  return serial / parallel;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_build_parallel, "x");
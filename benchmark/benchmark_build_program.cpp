@@ -0,0 +1,130 @@
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/* Number of kernels in the generated program. The Gen code generation of the
+ * kernels is spread over OCL_BUILD_THREADS threads, so run this benchmark with
+ * OCL_BUILD_THREADS=1,2,4,... to see how the build time scales with the cores.
+ */
+#define BUILD_KERNEL_NUM  32
+#define BUILD_LOOP_COUNT  4
+
+static std::string benchmark_build_program_source(int iteration)
+{
+  std::string source;
+  char buf[1024];
+
+  /* Make every source unique so that nothing can be reused between builds */
+  snprintf(buf, sizeof(buf), "/* build %d */\n", iteration);
+  source += buf;
+  for (int k = 0; k < BUILD_KERNEL_NUM; k++) {
+    snprintf(buf, sizeof(buf),
+      "__kernel void bench_build_%d(__global float4 *dst, __global const float4 *src, int n)\n"
+      "{\n"
+      "  int id = get_global_id(0);\n"
+      "  float4 acc = src[id];\n"
+      "  for (int i = 0; i < n; i++) {\n"
+      "    acc = mad(acc, src[id + i + %d], (float4)(%d.5f));\n"
+      "    acc = sin(acc) * cos(acc + %d.0f) + sqrt(fabs(acc));\n"
+      "    if (acc.x > %d.0f) acc = native_divide(acc, acc.yzwx + 1.0f);\n"
+      "  }\n"
+      "  dst[id] = acc;\n"
+      "}\n", k, k, k, k, k);
+    source += buf;
+  }
+  return source;
+}
+
+double benchmark_build_program(void)
+{
+  struct timeval start,stop;
+  double elapsed = 0;
+  const char *threads = getenv("OCL_BUILD_THREADS");
+
+  for (int i = 0; i < BUILD_LOOP_COUNT; i++) {
+    std::string source = benchmark_build_program_source(i);
+    const char *str = source.c_str();
+    cl_int status;
+    cl_program prog = clCreateProgramWithSource(ctx, 1, &str, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+
+    gettimeofday(&start,0);
+    OCL_CALL(clBuildProgram, prog, 1, &device, NULL, NULL, NULL);
+    gettimeofday(&stop,0);
+    elapsed += time_subtract(&stop, &start, 0);
+
+    cl_uint kernel_num = 0;
+    OCL_CALL(clCreateKernelsInProgram, prog, 0, NULL, &kernel_num);
+    OCL_ASSERT(kernel_num == BUILD_KERNEL_NUM);
+    clReleaseProgram(prog);
+  }
+
+  printf("\t%d kernels, OCL_BUILD_THREADS=%s", BUILD_KERNEL_NUM, threads ? threads : "1");
+  /* Average build time of the whole program */
+  return elapsed / BUILD_LOOP_COUNT;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_build_program, "ms");
+
+/* Build one kernel keeping many vectors alive, so that the register allocator
+ * runs out of registers. Run it with OCL_OUTPUT_SPILL_STATS=1 to also see how
+ * many registers get spilled.
+ */
+#define PRESSURE_VECTOR_NUM  48
+
+static std::string benchmark_build_pressure_source(int iteration)
+{
+  std::string source;
+  char buf[256];
+
+  snprintf(buf, sizeof(buf),
+    "/* build %d */\n"
+    "__kernel void bench_build_pressure(__global float4 *dst, __global const float4 *src, int n)\n"
+    "{\n"
+    "  int id = get_global_id(0);\n", iteration);
+  source += buf;
+  for (int v = 0; v < PRESSURE_VECTOR_NUM; v++) {
+    snprintf(buf, sizeof(buf), "  float4 v%d = src[id * %d + %d];\n", v, PRESSURE_VECTOR_NUM, v);
+    source += buf;
+  }
+  source += "  for (int i = 0; i < n; i++) {\n";
+  for (int v = 0; v < PRESSURE_VECTOR_NUM; v++) {
+    snprintf(buf, sizeof(buf), "    v%d = mad(v%d, v%d, (float4)(%d.5f));\n",
+             v, v, (v + 1) % PRESSURE_VECTOR_NUM, v);
+    source += buf;
+  }
+  source += "  }\n";
+  for (int v = 0; v < PRESSURE_VECTOR_NUM; v++) {
+    snprintf(buf, sizeof(buf), "  dst[id * %d + %d] = v%d;\n", PRESSURE_VECTOR_NUM, v, v);
+    source += buf;
+  }
+  source += "}\n";
+  return source;
+}
+
+double benchmark_build_register_pressure(void)
+{
+  struct timeval start,stop;
+  double elapsed = 0;
+
+  for (int i = 0; i < BUILD_LOOP_COUNT; i++) {
+    std::string source = benchmark_build_pressure_source(i);
+    const char *str = source.c_str();
+    cl_int status;
+    cl_program prog = clCreateProgramWithSource(ctx, 1, &str, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+
+    gettimeofday(&start,0);
+    OCL_CALL(clBuildProgram, prog, 1, &device, NULL, NULL, NULL);
+    gettimeofday(&stop,0);
+    elapsed += time_subtract(&stop, &start, 0);
+    clReleaseProgram(prog);
+  }
+
+  printf("\t%d float4 values alive", PRESSURE_VECTOR_NUM);
+  return elapsed / BUILD_LOOP_COUNT;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_build_register_pressure, "ms");
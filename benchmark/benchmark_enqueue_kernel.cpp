@@ -0,0 +1,119 @@
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+
+/* Host time spent in clEnqueueNDRangeKernel for a tiny kernel, which is what
+ * limits the launch rate of small kernels. The GPU time is not measured: the
+ * queue is drained outside of the timed region. Run it with
+ * OCL_LAUNCH_STATE_CACHE=0 to compare with the states rebuilt on every launch.
+ */
+#define ENQUEUE_LOOP_COUNT  20000
+#define ENQUEUE_DATA_SIZE   64
+
+static double enqueue_time(cl_uint dim)
+{
+  struct timeval start,stop;
+  double elapsed = 0;
+
+  /* Warm up, the first launch also uploads the kernel */
+  OCL_NDRANGE(dim);
+  OCL_FINISH();
+
+  for (int i = 0; i < ENQUEUE_LOOP_COUNT; i++) {
+    gettimeofday(&start,0);
+    OCL_NDRANGE(dim);
+    gettimeofday(&stop,0);
+    elapsed += time_subtract(&stop, &start, 0);
+    OCL_FINISH();
+  }
+  /* Average host time of one enqueue in us */
+  return elapsed * 1000 / ENQUEUE_LOOP_COUNT;
+}
+
+static void enqueue_setup(void)
+{
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  OCL_CREATE_BUFFER(buf[0], 0, ENQUEUE_DATA_SIZE * sizeof(float), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, ENQUEUE_DATA_SIZE * sizeof(float), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+}
+
+double benchmark_enqueue_kernel(void)
+{
+  const char *cache = getenv("OCL_LAUNCH_STATE_CACHE");
+
+  enqueue_setup();
+  globals[0] = ENQUEUE_DATA_SIZE;
+  locals[0] = 16;
+  const double us = enqueue_time(1);
+
+  printf("\t%d launches, OCL_LAUNCH_STATE_CACHE=%s", ENQUEUE_LOOP_COUNT, cache ? cache : "1");
+  return us;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_enqueue_kernel, "us");
+
+/* Same with one work group as large as the kernel allows, where most of the
+ * host time goes to the local IDs written in the curbe of every thread
+ */
+double benchmark_enqueue_large_group(void)
+{
+  size_t wg_size = 0;
+
+  enqueue_setup();
+  OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_WORK_GROUP_SIZE,
+           sizeof(wg_size), &wg_size, NULL);
+  OCL_ASSERT(wg_size >= 64);
+  globals[0] = locals[0] = 16;
+  globals[1] = locals[1] = wg_size / 64;
+  globals[2] = locals[2] = 4;
+  const double us = enqueue_time(3);
+
+  printf("\t%d launches, local size %zux%zux%zu", ENQUEUE_LOOP_COUNT, locals[0], locals[1], locals[2]);
+  return us;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_enqueue_large_group, "us");
+
+/* Launch and run a kernel whose global size is not a multiple of the local
+ * size in any dimension. The partial work groups run in the same walker as
+ * the full ones. Run it with OCL_SINGLE_NDRANGE_DISPATCH=0 to compare with
+ * one launch per kind of work group, 8 here.
+ */
+#define NONUNIFORM_LOOP_COUNT  2000
+
+double benchmark_enqueue_nonuniform(void)
+{
+  struct timeval start,stop;
+  const char *single = getenv("OCL_SINGLE_NDRANGE_DISPATCH");
+  const size_t global_size[3] = {61, 29, 7};
+  const size_t local_size[3] = {16, 4, 2};
+  const size_t n = global_size[0] * global_size[1] * global_size[2];
+
+  OCL_CREATE_KERNEL("compiler_nonuniform_ndrange");
+  OCL_CREATE_BUFFER(buf[0], 0, n * sizeof(cl_int4), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  for (int d = 0; d < 3; d++) {
+    globals[d] = global_size[d];
+    locals[d] = local_size[d];
+  }
+
+  /* Warm up */
+  OCL_NDRANGE(3);
+  OCL_FINISH();
+
+  gettimeofday(&start,0);
+  for (int i = 0; i < NONUNIFORM_LOOP_COUNT; i++)
+    OCL_NDRANGE(3);
+  OCL_FINISH();
+  gettimeofday(&stop,0);
+
+  printf("\tglobal size %zux%zux%zu, OCL_SINGLE_NDRANGE_DISPATCH=%s",
+         global_size[0], global_size[1], global_size[2], single ? single : "1");
+  /* Average time of one launch in us */
+  return time_subtract(&stop, &start, 0) * 1000 / NONUNIFORM_LOOP_COUNT;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_enqueue_nonuniform, "us");
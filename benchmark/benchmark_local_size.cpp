@@ -0,0 +1,62 @@
+#include "utests/utest_helper.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/* GPU time of a 2D kernel enqueued without a local size on a profiling queue.
+ * The first launches try the candidate local sizes, the last ones run with
+ * the fastest of them. Run it with OCL_TUNE_LOCAL_SIZE=0 to compare with the
+ * default local size, and with OCL_TUNE_LOCAL_SIZE_FILE=/dev/null so that the
+ * local size tuned by a previous run is not reused.
+ */
+#define LOCAL_SIZE_WIDTH        1920
+#define LOCAL_SIZE_HEIGHT       1080
+#define LOCAL_SIZE_TUNING_RUNS  32
+#define LOCAL_SIZE_LOOP_COUNT   16
+
+double benchmark_local_size(void)
+{
+  const char *tune = getenv("OCL_TUNE_LOCAL_SIZE");
+  const size_t n = LOCAL_SIZE_WIDTH * LOCAL_SIZE_HEIGHT;
+  const size_t global_size[2] = {LOCAL_SIZE_WIDTH, LOCAL_SIZE_HEIGHT};
+  const cl_int width = LOCAL_SIZE_WIDTH, height = LOCAL_SIZE_HEIGHT;
+  cl_command_queue profiling_queue = NULL;
+  cl_ulong elapsed = 0;
+  cl_int status;
+
+  profiling_queue = clCreateCommandQueue(ctx, device, CL_QUEUE_PROFILING_ENABLE, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_CALL(cl_kernel_init, "bench_local_size.cl", "bench_local_size_blur", SOURCE, "");
+  OCL_CREATE_BUFFER(buf[0], 0, n * sizeof(float), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(float), NULL);
+
+  OCL_MAP_BUFFER(0);
+  for (size_t i = 0; i < n; i++)
+    ((float*)buf_data[0])[i] = (rand() & 255) * (1.0f / 255.0f);
+  OCL_UNMAP_BUFFER(0);
+
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(2, sizeof(cl_int), &width);
+  OCL_SET_ARG(3, sizeof(cl_int), &height);
+
+  for (int i = 0; i < LOCAL_SIZE_TUNING_RUNS + LOCAL_SIZE_LOOP_COUNT; i++) {
+    cl_event exec_event;
+    cl_ulong time_start, time_end;
+
+    OCL_CALL(clEnqueueNDRangeKernel, profiling_queue, kernel, 2, NULL, global_size, NULL, 0, NULL, &exec_event);
+    OCL_CALL(clWaitForEvents, 1, &exec_event);
+    OCL_CALL(clGetEventProfilingInfo, exec_event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &time_start, NULL);
+    OCL_CALL(clGetEventProfilingInfo, exec_event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &time_end, NULL);
+    clReleaseEvent(exec_event);
+    if (i >= LOCAL_SIZE_TUNING_RUNS)
+      elapsed += time_end - time_start;
+  }
+  clReleaseCommandQueue(profiling_queue);
+
+  printf("\t%dx%d, OCL_TUNE_LOCAL_SIZE=%s", LOCAL_SIZE_WIDTH, LOCAL_SIZE_HEIGHT, tune ? tune : "0");
+  /* Average GPU time of one tuned launch in us */
+  return (double)elapsed / 1000 / LOCAL_SIZE_LOOP_COUNT;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_local_size, "us");
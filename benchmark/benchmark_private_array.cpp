@@ -0,0 +1,35 @@
+#include "utests/utest_helper.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/* Kernels indexing a small private array with the data. The arrays are kept
+ * in registers and read with indirect register accesses. Run it with
+ * OCL_PRIVATE_ARRAY_REG_SIZE=0 to compare with the arrays in the stack.
+ */
+#define PRIVATE_ARRAY_GLOBAL_SIZE  (1024 * 1024)
+#define PRIVATE_ARRAY_LOOP_COUNT   256
+
+static double benchmark_private_array(const char *str_kernel)
+{
+  const char *regSize = getenv("OCL_PRIVATE_ARRAY_REG_SIZE");
+  const double elapsed = time_loop_kernel("bench_private_array.cl", str_kernel,
+                                          PRIVATE_ARRAY_GLOBAL_SIZE, sizeof(cl_uint),
+                                          PRIVATE_ARRAY_LOOP_COUNT);
+
+  printf("\tOCL_PRIVATE_ARRAY_REG_SIZE=%s", regSize ? regSize : "32");
+  return BANDWIDTH(PRIVATE_ARRAY_GLOBAL_SIZE * PRIVATE_ARRAY_LOOP_COUNT, elapsed);
+}
+
+double benchmark_private_array_lookup(void)
+{
+  return benchmark_private_array("bench_private_array_lookup");
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_private_array_lookup, "Mop/s");
+
+double benchmark_private_array_histogram(void)
+{
+  return benchmark_private_array("bench_private_array_histogram");
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_private_array_histogram, "Mop/s");
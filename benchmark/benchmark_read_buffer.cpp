@@ -1,5 +1,7 @@
 #include "utests/utest_helper.hpp"
 #include <sys/time.h>
+#include <cstdlib>
+#include <cstring>
 
 double benchmark_read_buffer(void)
 {
@@ -48,3 +50,57 @@ double benchmark_read_buffer(void)
 }
 
 MAKE_BENCHMARK_FROM_FUNCTION(benchmark_read_buffer, "GB/S");
+
+/* Bandwidth of clEnqueueReadBuffer and clEnqueueWriteBuffer for transfers from
+ * 1MB to 256MB, the value is the one of the largest. The large transfers are
+ * split across the copy threads of the context. Run it with OCL_COPY_THREADS=1
+ * to compare with a single thread.
+ */
+#define HOST_COPY_MIN_SIZE   (1 << 20)
+#define HOST_COPY_MAX_SIZE   (256 << 20)
+
+static double host_copy_buffer(bool read)
+{
+  struct timeval start,stop;
+  const char *threads = getenv("OCL_COPY_THREADS");
+  double bandwidth = 0;
+
+  OCL_CREATE_BUFFER(buf[0], 0, HOST_COPY_MAX_SIZE, NULL);
+  char *host = (char *)malloc(HOST_COPY_MAX_SIZE);
+  /* Fault the pages in */
+  memset(host, 1, HOST_COPY_MAX_SIZE);
+  OCL_CALL(clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, HOST_COPY_MAX_SIZE, host, 0, NULL, NULL);
+
+  printf("	OCL_COPY_THREADS=%s", threads ? threads : "default");
+  for (size_t sz = HOST_COPY_MIN_SIZE; sz <= HOST_COPY_MAX_SIZE; sz *= 4) {
+    /* About 1GB per size */
+    const int loop = (1 << 30) / sz;
+    gettimeofday(&start,0);
+    for (int i = 0; i < loop; i++) {
+      if (read)
+        OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, sz, host, 0, NULL, NULL);
+      else
+        OCL_CALL(clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, sz, host, 0, NULL, NULL);
+    }
+    gettimeofday(&stop,0);
+    double elapsed = time_subtract(&stop, &start, 0);
+    bandwidth = BANDWIDTH(sz * loop, elapsed);
+    printf(", %zuMB: %.1f GB/S", sz >> 20, bandwidth);
+  }
+  free(host);
+  return bandwidth;
+}
+
+double benchmark_enqueue_read_buffer(void)
+{
+  return host_copy_buffer(true);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_enqueue_read_buffer, "GB/S");
+
+double benchmark_enqueue_write_buffer(void)
+{
+  return host_copy_buffer(false);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_enqueue_write_buffer, "GB/S");
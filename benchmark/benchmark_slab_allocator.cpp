@@ -0,0 +1,162 @@
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include "cl_mem_slab.h"
+}
+
+/* Stress the slab allocator of the small buffers from several threads against
+ * a stand-in driver, whose buffer objects are page granular host allocations,
+ * so that it runs without a GPU. Every buffer is filled with its own tag and
+ * checked when it is released, which catches two buffers given overlapping
+ * slots. The real driver also pays an ioctl per buffer object, so the gain on
+ * the GPU is larger. Run it with OCL_SLAB_MAX_SIZE=0 to compare with one
+ * buffer object per buffer.
+ */
+#define SLAB_THREAD_NUM     4
+#define SLAB_LIVE_BUFFERS   256
+#define SLAB_OPERATIONS     200000
+#define SLAB_PAGE_SIZE      4096
+
+struct _cl_buffer {
+  volatile int ref;
+  size_t size;
+  char *data;
+};
+
+static volatile long slab_stub_bytes = 0;
+
+static cl_buffer slab_stub_alloc(cl_buffer_mgr, const char *, size_t sz, size_t)
+{
+  cl_buffer bo = (cl_buffer)malloc(sizeof(struct _cl_buffer));
+  bo->ref = 1;
+  bo->size = (sz + SLAB_PAGE_SIZE - 1) & ~(size_t)(SLAB_PAGE_SIZE - 1);
+  /* The kernel hands out zeroed pages */
+  bo->data = (char *)calloc(1, bo->size);
+  __sync_fetch_and_add(&slab_stub_bytes, (long)bo->size);
+  return bo;
+}
+
+static void slab_stub_reference(cl_buffer bo)
+{
+  __sync_fetch_and_add(&bo->ref, 1);
+}
+
+static int slab_stub_unreference(cl_buffer bo)
+{
+  if (__sync_sub_and_fetch(&bo->ref, 1) != 0)
+    return 0;
+  __sync_fetch_and_sub(&slab_stub_bytes, (long)bo->size);
+  free(bo->data);
+  free(bo);
+  return 1;
+}
+
+/* The driver callbacks the slab allocator calls */
+extern "C" {
+cl_buffer (*cl_buffer_alloc)(cl_buffer_mgr, const char *, size_t, size_t) = slab_stub_alloc;
+void (*cl_buffer_reference)(cl_buffer) = slab_stub_reference;
+int (*cl_buffer_unreference)(cl_buffer) = slab_stub_unreference;
+}
+
+struct slab_buffer {
+  cl_buffer bo;
+  struct cl_slab *slab;
+  size_t offset;
+  size_t size;
+  uint32_t tag;
+};
+
+struct slab_job {
+  cl_slab_allocator *allocator;
+  uint32_t seed;
+  long peak_bytes;
+  bool overlap;
+};
+
+/* Same fallback as cl_mem_allocate */
+static void slab_buffer_alloc(slab_job *job, slab_buffer *buf, size_t size, uint32_t tag)
+{
+  buf->size = size;
+  buf->tag = tag;
+  buf->slab = cl_slab_alloc(job->allocator, size, &buf->bo, &buf->offset);
+  if (buf->slab == NULL) {
+    buf->bo = cl_buffer_alloc(NULL, "CL memory object", size, 64);
+    buf->offset = 0;
+  }
+  uint32_t *data = (uint32_t *)(buf->bo->data + buf->offset);
+  for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+    data[i] = tag;
+}
+
+static void slab_buffer_free(slab_job *job, slab_buffer *buf)
+{
+  const uint32_t *data = (const uint32_t *)(buf->bo->data + buf->offset);
+  for (size_t i = 0; i < buf->size / sizeof(uint32_t); i++)
+    if (data[i] != buf->tag)
+      job->overlap = true;
+  if (buf->slab)
+    cl_slab_free(buf->slab, buf->offset);
+  cl_buffer_unreference(buf->bo);
+}
+
+static void *slab_thread_function(void *arg)
+{
+  slab_job *job = (slab_job *)arg;
+  slab_buffer live[SLAB_LIVE_BUFFERS];
+  uint32_t x = job->seed;
+
+  for (int i = 0; i < SLAB_LIVE_BUFFERS; i++)
+    slab_buffer_alloc(job, &live[i], 4 << (i % 11), job->seed + i);
+  for (int op = 0; op < SLAB_OPERATIONS; op++) {
+    /* xorshift */
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    slab_buffer *buf = &live[x % SLAB_LIVE_BUFFERS];
+    slab_buffer_free(job, buf);
+    slab_buffer_alloc(job, buf, 4 + ((x >> 8) % 1024) * 4, x);
+    if (slab_stub_bytes > job->peak_bytes)
+      job->peak_bytes = slab_stub_bytes;
+  }
+  for (int i = 0; i < SLAB_LIVE_BUFFERS; i++)
+    slab_buffer_free(job, &live[i]);
+  return NULL;
+}
+
+double benchmark_slab_allocator(void)
+{
+  struct timeval start,stop;
+  const char *max_size = getenv("OCL_SLAB_MAX_SIZE");
+  pthread_t tid[SLAB_THREAD_NUM];
+  slab_job jobs[SLAB_THREAD_NUM];
+  long peak_bytes = 0;
+
+  cl_slab_allocator *allocator = cl_slab_allocator_new(NULL);
+  gettimeofday(&start,0);
+  for (int t = 0; t < SLAB_THREAD_NUM; t++) {
+    jobs[t].allocator = allocator;
+    jobs[t].seed = 0x9e3779b9u * (t + 1);
+    jobs[t].peak_bytes = 0;
+    jobs[t].overlap = false;
+    pthread_create(&tid[t], NULL, slab_thread_function, &jobs[t]);
+  }
+  for (int t = 0; t < SLAB_THREAD_NUM; t++) {
+    pthread_join(tid[t], NULL);
+    OCL_ASSERT(!jobs[t].overlap);
+    if (jobs[t].peak_bytes > peak_bytes)
+      peak_bytes = jobs[t].peak_bytes;
+  }
+  gettimeofday(&stop,0);
+  cl_slab_allocator_delete(allocator);
+  OCL_ASSERT(slab_stub_bytes == 0);
+
+  printf("\t%d threads, peak %ld KB of bos, OCL_SLAB_MAX_SIZE=%s",
+         SLAB_THREAD_NUM, peak_bytes / 1024, max_size ? max_size : "4096");
+  /* Average time of one release and allocation in ns */
+  return time_subtract(&stop, &start, 0) * 1e6 / (SLAB_THREAD_NUM * SLAB_OPERATIONS);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_slab_allocator, "ns");
@@ -0,0 +1,105 @@
+#include "utests/utest_helper.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/* Kernels copying structs, which clang turns into memcpy calls. The copies of
+ * up to OCL_INLINE_MEMCPY_SIZE bytes with a constant size are done with loads
+ * and stores of up to 16 bytes, the larger ones call the libocl functions.
+ * Run it with OCL_INLINE_MEMCPY_SIZE=0 to compare with every copy calling the
+ * libocl functions.
+ */
+#define STRUCT_COPY_GLOBAL_SIZE  (256 * 1024)
+#define STRUCT_COPY_LOOP_COUNT   64
+
+typedef struct {
+  float pos[4];
+  float vel[4];
+  float mass;
+  uint32_t id;
+  uint32_t flags;
+  uint32_t pad;
+} particle;
+
+typedef struct __attribute__((packed)) {
+  uint8_t tag;
+  uint32_t key;
+  uint16_t len;
+  uint32_t value[4];
+} record;
+
+typedef struct {
+  float v[8][4];
+} block;
+
+/* The fields of the particles other than pos are the ones of src, flags as
+ * the loop count is even */
+static bool struct_copy_check_small(const void *src, const void *dst, size_t id)
+{
+  const particle *s = (const particle *)src + id, *d = (const particle *)dst + id;
+  return memcmp(s->vel, d->vel, sizeof(s->vel)) == 0 &&
+         memcmp(&s->mass, &d->mass, sizeof(s->mass)) == 0 &&
+         s->id == d->id && s->flags == d->flags && s->pad == d->pad;
+}
+
+static bool struct_copy_check_packed(const void *src, const void *dst, size_t id)
+{
+  const record *s = (const record *)src, *d = (const record *)dst + id;
+  const size_t n = STRUCT_COPY_GLOBAL_SIZE;
+  uint32_t sum = 0;
+  record r;
+
+  for (uint32_t i = 0; i < STRUCT_COPY_LOOP_COUNT; i++) {
+    r = s[(id + i * 64) % n];
+    sum += r.key ^ r.value[i & 3];
+  }
+  r.key = sum;
+  return memcmp(&r, d, sizeof(r)) == 0;
+}
+
+static bool struct_copy_check_large(const void *src, const void *dst, size_t id)
+{
+  return memcmp((const block *)src + id, (const block *)dst + id, sizeof(block)) == 0;
+}
+
+static double benchmark_struct_copy(const char *str_kernel, size_t struct_size,
+                                    bool (*check)(const void *, const void *, size_t))
+{
+  const char *inlineSize = getenv("OCL_INLINE_MEMCPY_SIZE");
+  const size_t sz = STRUCT_COPY_GLOBAL_SIZE * struct_size;
+  const double elapsed = time_loop_kernel("bench_struct_copy.cl", str_kernel,
+                                          STRUCT_COPY_GLOBAL_SIZE, struct_size,
+                                          STRUCT_COPY_LOOP_COUNT);
+
+  OCL_MAP_BUFFER(0);
+  OCL_MAP_BUFFER(1);
+  for (size_t id = 0; id < STRUCT_COPY_GLOBAL_SIZE; id++)
+    OCL_ASSERT(check(buf_data[0], buf_data[1], id));
+  OCL_UNMAP_BUFFER(0);
+  OCL_UNMAP_BUFFER(1);
+
+  printf("\t%zu bytes, OCL_INLINE_MEMCPY_SIZE=%s", struct_size, inlineSize ? inlineSize : "64");
+  /* Bytes of the structs copied */
+  return BANDWIDTH(sz * STRUCT_COPY_LOOP_COUNT, elapsed);
+}
+
+double benchmark_struct_copy_small(void)
+{
+  return benchmark_struct_copy("bench_struct_copy_small", sizeof(particle), struct_copy_check_small);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_struct_copy_small, "MB/s");
+
+double benchmark_struct_copy_packed(void)
+{
+  return benchmark_struct_copy("bench_struct_copy_packed", sizeof(record), struct_copy_check_packed);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_struct_copy_packed, "MB/s");
+
+double benchmark_struct_copy_large(void)
+{
+  return benchmark_struct_copy("bench_struct_copy_large", sizeof(block), struct_copy_check_large);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_struct_copy_large, "MB/s");
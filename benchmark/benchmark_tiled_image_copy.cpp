@@ -0,0 +1,58 @@
+#include <string.h>
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+
+/* Bandwidth of clEnqueueWriteImage and clEnqueueReadImage of a tiled 4K RGBA
+ * image, which are tiled and detiled on the CPU. Run it with OCL_CPU_TILING=0
+ * to compare with the copies through the GTT, and with OCL_TILING=1 or 2 for
+ * the X or Y tiles.
+ */
+#define TILED_COPY_W      3840
+#define TILED_COPY_H      2160
+#define TILED_COPY_LOOP   20
+
+double benchmark_tiled_image_copy(void)
+{
+  struct timeval start,stop;
+  const char *cpu_tiling = getenv("OCL_CPU_TILING");
+  const size_t origin[3] = {0, 0, 0};
+  const size_t region[3] = {TILED_COPY_W, TILED_COPY_H, 1};
+  const size_t sz = TILED_COPY_W * TILED_COPY_H * 4;
+  cl_image_format format;
+  cl_image_desc desc;
+
+  memset(&desc, 0x0, sizeof(cl_image_desc));
+  memset(&format, 0x0, sizeof(cl_image_format));
+  format.image_channel_order = CL_RGBA;
+  format.image_channel_data_type = CL_UNORM_INT8;
+  desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+  desc.image_width = TILED_COPY_W;
+  desc.image_height = TILED_COPY_H;
+  OCL_CREATE_IMAGE(buf[0], 0, &format, &desc, NULL);
+
+  char *src = (char *)malloc(sz);
+  char *dst = (char *)malloc(sz);
+  for (size_t i = 0; i < sz; i++)
+    src[i] = rand();
+  /* Fault the pages in */
+  memset(dst, 0, sz);
+  OCL_CALL(clEnqueueWriteImage, queue, buf[0], CL_TRUE, origin, region, 0, 0, src, 0, NULL, NULL);
+
+  gettimeofday(&start,0);
+  for (int i = 0; i < TILED_COPY_LOOP; i++) {
+    OCL_CALL(clEnqueueWriteImage, queue, buf[0], CL_TRUE, origin, region, 0, 0, src, 0, NULL, NULL);
+    OCL_CALL(clEnqueueReadImage, queue, buf[0], CL_TRUE, origin, region, 0, 0, dst, 0, NULL, NULL);
+  }
+  gettimeofday(&stop,0);
+  OCL_ASSERT(memcmp(src, dst, sz) == 0);
+  free(src);
+  free(dst);
+
+  printf("\t%dx%d RGBA8, OCL_CPU_TILING=%s", TILED_COPY_W, TILED_COPY_H,
+         cpu_tiling ? cpu_tiling : "1");
+  double elapsed = time_subtract(&stop, &start, 0);
+  /* Bytes written and read */
+  return 2.0 * sz * TILED_COPY_LOOP / (elapsed * 1e6);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_tiled_image_copy, "GB/S");
@@ -0,0 +1,20 @@
+/* 3x3 box filter of a 2D float buffer, the neighbour work items read the
+   same rows */
+kernel void bench_local_size_blur(
+  global const float *src,
+  global float *dst,
+  int width,
+  int height)
+{
+  int x = get_global_id(0);
+  int y = get_global_id(1);
+  float sum = 0.0f;
+
+  for (int dy = -1; dy <= 1; dy++)
+    for (int dx = -1; dx <= 1; dx++) {
+      int sx = clamp(x + dx, 0, width - 1);
+      int sy = clamp(y + dy, 0, height - 1);
+      sum += src[sy * width + sx];
+    }
+  dst[y * width + x] = sum * (1.0f / 9.0f);
+}
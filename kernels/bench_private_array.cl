@@ -0,0 +1,33 @@
+/* Lookup table of every work item, indexed with the data */
+kernel void bench_private_array_lookup(
+  global uint *src,
+  global uint *dst,
+  uint loop)
+{
+  uint lut[16];
+  uint id = get_global_id(0);
+  for (int i = 0; i < 16; i++)
+    lut[i] = src[(id + i) % get_global_size(0)];
+
+  uint x = id;
+  for(; loop > 0; loop--)
+    x = lut[x & 15] ^ (x >> 4);
+  dst[id] = x;
+}
+
+/* Histogram of every work item, updated with the data */
+kernel void bench_private_array_histogram(
+  global uint *src,
+  global uint *dst,
+  uint loop)
+{
+  uint count[8] = {0};
+  uint id = get_global_id(0);
+  uint x = src[id];
+
+  for(; loop > 0; loop--) {
+    count[x & 7]++;
+    x = x * 1103515245 + 12345;
+  }
+  dst[id] = count[0] ^ count[3] ^ count[x & 7];
+}
@@ -0,0 +1,71 @@
+typedef struct {
+  float4 pos;
+  float4 vel;
+  float mass;
+  uint id;
+  uint flags;
+  uint pad;
+} particle;
+
+/* Struct of 48 bytes copied between global and private memory and between
+ * private variables */
+kernel void bench_struct_copy_small(
+  global particle *src,
+  global particle *dst,
+  uint loop)
+{
+  uint id = get_global_id(0);
+  particle p = src[id];
+  particle q;
+
+  for(; loop > 0; loop--) {
+    q = p;
+    q.pos += q.vel;
+    q.flags ^= q.id;
+    p = q;
+  }
+  dst[id] = p;
+}
+
+typedef struct __attribute__((packed)) {
+  uchar tag;
+  uint key;
+  ushort len;
+  uint value[4];
+} record;
+
+/* Packed struct of 23 bytes, only byte aligned */
+kernel void bench_struct_copy_packed(
+  global record *src,
+  global record *dst,
+  uint loop)
+{
+  uint id = get_global_id(0);
+  uint n = get_global_size(0);
+  uint sum = 0;
+  record r;
+
+  for(uint i = 0; i < loop; i++) {
+    r = src[(id + i * 64) % n];
+    sum += r.key ^ r.value[i & 3];
+  }
+  r.key = sum;
+  dst[id] = r;
+}
+
+typedef struct {
+  float4 v[8];
+} block;
+
+/* Struct of 128 bytes, copied with the libocl loop */
+kernel void bench_struct_copy_large(
+  global block *src,
+  global block *dst,
+  uint loop)
+{
+  uint id = get_global_id(0);
+  uint n = get_global_size(0);
+
+  for(uint i = 0; i < loop; i++)
+    dst[(id + i * 64) % n] = src[(id + i * 64) % n];
+}
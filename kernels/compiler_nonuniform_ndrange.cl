@@ -0,0 +1,10 @@
+kernel void compiler_nonuniform_ndrange(global int4 *dst)
+{
+  size_t x = get_global_id(0) - get_global_offset(0);
+  size_t y = get_global_id(1) - get_global_offset(1);
+  size_t z = get_global_id(2) - get_global_offset(2);
+  size_t id = (z * get_global_size(1) + y) * get_global_size(0) + x;
+
+  dst[id].xyz = (int3)(get_local_size(0), get_local_size(1), get_local_size(2));
+  atomic_inc((global int *)(dst + id) + 3);
+}
@@ -0,0 +1,26 @@
+#ifdef SIMD_SIZE
+#define REQD_SIMD __attribute__((intel_reqd_sub_group_size(SIMD_SIZE)))
+#else
+#define REQD_SIMD
+#endif
+
+/* A private array read and written with a per lane index, a uniform index and
+ * an index clamped from out of range values
+ */
+REQD_SIMD
+__kernel void compiler_private_array_indirect(__global int *dst,
+                                              __global const int *idx,
+                                              int uniform_idx)
+{
+  int gid = get_global_id(0);
+  int lane_idx = idx[gid];
+  int a[16];
+  int i;
+
+  for (i = 0; i < 16; ++i)
+    a[i] = gid * 16 + i * i;
+  a[lane_idx & 15] += 3;
+  dst[3 * gid] = a[(lane_idx * 5) & 15];
+  dst[3 * gid + 1] = a[uniform_idx];
+  dst[3 * gid + 2] = a[clamp(lane_idx - 4, 0, 15)];
+}
@@ -0,0 +1,85 @@
+#ifdef SIMD_SIZE
+#define REQD_SIMD __attribute__((intel_reqd_sub_group_size(SIMD_SIZE)))
+#else
+#define REQD_SIMD
+#endif
+
+/* The counter is uniform and still used after the loop */
+REQD_SIMD
+__kernel void compiler_uniform_loop(__global int *dst, int n)
+{
+  int gid = get_global_id(0);
+  int acc = gid;
+  int i;
+  for (i = 0; i < n; ++i)
+    acc = acc * 3 + i;
+  dst[gid] = acc + i * 1000;
+}
+
+/* Every value of the loop is uniform but the lanes leave it at different
+ * iterations, so the counter and the last value are divergent after it
+ */
+REQD_SIMD
+__kernel void compiler_divergent_break(__global int *dst, __global const int *src, int n)
+{
+  int gid = get_global_id(0);
+  int last = -1;
+  int i;
+  for (i = 0; i < n; ++i) {
+    last = src[i] + i;
+    if (last > gid)
+      break;
+  }
+  dst[gid] = i * 1000 + last;
+}
+
+/* The branches are taken by all lanes or none */
+REQD_SIMD
+__kernel void compiler_uniform_if(__global int *dst, __global const int *src, int flag)
+{
+  int gid = get_global_id(0);
+  int v = src[gid];
+  if (flag & 1) {
+    v = v * 2 + 1;
+    if (flag & 2)
+      v -= gid;
+  } else {
+    v ^= 0x55;
+    if (flag & 4)
+      v += flag;
+  }
+  dst[gid] = v;
+}
+
+/* Both definitions of v are uniform, the value after the join is not */
+REQD_SIMD
+__kernel void compiler_divergent_join(__global int *dst, int a)
+{
+  int gid = get_global_id(0);
+  int v = a * 5;
+  int acc = 0;
+  int j;
+  if (gid & 1)
+    v = a + 7;
+  for (j = 0; j < (v & 3); ++j)
+    acc += j + 1;
+  dst[gid] = v * 10 + acc;
+}
+
+/* The lanes meet before the post-dominator of the divergent if, the exit:
+ * both definitions of p are uniform, but not the value at the inner join
+ */
+REQD_SIMD
+__kernel void compiler_divergent_early_return(__global int *dst, int a, int mask)
+{
+  int gid = get_global_id(0);
+  int p;
+  if (gid & 1)
+    p = a + 1;
+  else {
+    p = a * 2;
+    if (gid & mask)
+      return;
+  }
+  dst[gid] = p;
+}
@@ -0,0 +1,6 @@
+__kernel void
+runtime_chained_kernels(__global uint *buf, uint step)
+{
+  int id = (int)get_global_id(0);
+  buf[id] = buf[id] * 3 + step;
+}
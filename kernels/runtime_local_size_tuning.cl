@@ -0,0 +1,17 @@
+/* Every work item reads the global ID of its mirror in the group through the
+ * local memory, so a wrong group shape or size shows in the result
+ */
+__kernel void runtime_local_size_tuning(__global int *dst, __global int *sizes, __local int *tmp)
+{
+  const int lid = get_local_id(0) + get_local_id(1) * get_local_size(0);
+  const int gid = get_global_id(0) + get_global_id(1) * get_global_size(0);
+  const int n = get_local_size(0) * get_local_size(1);
+
+  tmp[lid] = gid;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  dst[gid] = tmp[n - 1 - lid];
+  if (gid == 0) {
+    sizes[0] = get_local_size(0);
+    sizes[1] = get_local_size(1);
+  }
+}
@@ -0,0 +1,21 @@
+__kernel void
+runtime_tiled_image2d_to_buffer(__read_only image2d_t src, __global uint *dst)
+{
+  int2 coord = (int2)(get_global_id(0), get_global_id(1));
+  dst[coord.y * get_global_size(0) + coord.x] = read_imageui(src, coord).x;
+}
+
+__kernel void
+runtime_tiled_buffer_to_image2d(__global const uint *src, __write_only image2d_t dst)
+{
+  int2 coord = (int2)(get_global_id(0), get_global_id(1));
+  write_imageui(dst, coord, (uint4)(src[coord.y * get_global_size(0) + coord.x], 0, 0, 0));
+}
+
+__kernel void
+runtime_tiled_image3d_to_buffer(__read_only image3d_t src, __global uint *dst)
+{
+  int4 coord = (int4)(get_global_id(0), get_global_id(1), get_global_id(2), 0);
+  size_t i = (coord.z * get_global_size(1) + coord.y) * get_global_size(0) + coord.x;
+  dst[i] = read_imageui(src, coord).x;
+}
@@ -23,6 +23,7 @@
 #include "cl_context.h"
 #include "cl_program.h"
 #include "cl_alloc.h"
+#include "cl_local_size_tuner.h"
 #include "CL/cl.h"
 #include <stdio.h>
 #include <string.h>
@@ -92,6 +93,8 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
   cl_uint i;
   cl_event e = NULL;
   cl_int event_status;
+  struct cl_tuning_entry *tuning = NULL;
+  cl_int tuning_candidate = -1;
 
   do {
     if (!CL_OBJECT_IS_COMMAND_QUEUE(command_queue)) {
@@ -150,6 +153,9 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
       if (kernel->vme) {
         fixed_local_sz[0] = 16;
         fixed_local_sz[1] = 1;
+      } else if (cl_local_size_tuning_enabled()) {
+        cl_local_size_tune(kernel, command_queue, work_dim, global_work_size,
+                           fixed_local_sz, &tuning, &tuning_candidate);
       } else {
         uint j, maxDimSize = 64 /* from 64? */, maxGroupSize = 256; //MAX_WORK_GROUP_SIZE may too large
         size_t realGroupSize = 1;
@@ -208,12 +214,12 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
     }
 
     int i, j, k;
-    const size_t global_wk_sz_div[3] = {
+    size_t global_wk_sz_div[3] = {
       fixed_global_sz[0] / fixed_local_sz[0] * fixed_local_sz[0],
       fixed_global_sz[1] / fixed_local_sz[1] * fixed_local_sz[1],
       fixed_global_sz[2] / fixed_local_sz[2] * fixed_local_sz[2]};
 
-    const size_t global_wk_sz_rem[3] = {
+    size_t global_wk_sz_rem[3] = {
       fixed_global_sz[0] % fixed_local_sz[0],
       fixed_global_sz[1] % fixed_local_sz[1],
       fixed_global_sz[2] % fixed_local_sz[2]};
@@ -222,6 +228,18 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
     count *= global_wk_sz_rem[1] ? 2 : 1;
     count *= global_wk_sz_rem[2] ? 2 : 1;
 
+    /* The kernels disabling the work items beyond the global size themselves
+       run the partial work groups in the same walker as the full ones, which
+       have the same shape */
+    if (count > 1 && interp_kernel_has_partial_group_guard(kernel->opaque)) {
+      for (i = 0; i < 3; i++) {
+        if (global_wk_sz_rem[i])
+          global_wk_sz_div[i] += fixed_local_sz[i];
+        global_wk_sz_rem[i] = 0;
+      }
+      count = 1;
+    }
+
     const size_t *global_wk_all[2] = {global_wk_sz_div, global_wk_sz_rem};
     cl_bool allow_immediate_submit = cl_command_queue_allow_bypass_submit(command_queue);
     /* Go through the at most 8 cases and euque if there is work items left */
@@ -254,6 +272,9 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
             break;
           }
           e->exec_data.mid_event_of_enq = (count > 1);
+          /* The tuned local sizes divide the global size, there is one launch */
+          e->exec_data.tuning = tuning;
+          e->exec_data.tuning_candidate = tuning_candidate;
           count--;
 
           /* We will flush the ndrange if no event depend. Else we will add it to queue list.
@@ -120,6 +120,15 @@ set_image_info(char *curbe,
     *(uint32_t*)(curbe + image_info->dataTypeSlot) = image->fmt.image_channel_data_type;
 }
 
+LOCAL void
+cl_command_queue_set_image_info(cl_kernel k)
+{
+  uint32_t i;
+
+  for (i = 0; i < k->image_sz; i++)
+    set_image_info(k->curbe, &k->images[i], cl_mem_image(k->args[k->images[i].arg_idx].mem));
+}
+
 LOCAL cl_int
 cl_command_queue_bind_image(cl_command_queue queue, cl_kernel k, cl_gpgpu gpgpu, uint32_t *max_bti)
 {
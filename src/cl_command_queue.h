@@ -31,9 +31,9 @@ struct intel_gpgpu;
 typedef struct _cl_command_queue_enqueue_worker {
   cl_command_queue queue;
   pthread_t tid;
-  cl_uint cookie;
   cl_bool quit;
   list_head enqueued_events;
+  list_head ready_events; // Out of order queues only, the enqueued events without pending depend event
   cl_uint in_exec_status; // Same value as CL_COMPLETE, CL_SUBMITTED ...
 } _cl_command_queue_enqueue_worker;
 
@@ -86,6 +86,8 @@ extern int cl_command_queue_flush_gpgpu(cl_gpgpu);
 extern cl_int cl_command_queue_bind_surface(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
 /* Bind all the image surfaces in the GPGPU state */
 extern cl_int cl_command_queue_bind_image(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
+/* Write the image sizes and formats in the curbe without binding the images */
+extern void cl_command_queue_set_image_info(cl_kernel);
 /* Bind all exec info to bind table */
 extern cl_int cl_command_queue_bind_exec_info(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
 
@@ -95,7 +97,8 @@ extern void cl_command_queue_insert_event(cl_command_queue, cl_event);
 extern void cl_command_queue_remove_event(cl_command_queue, cl_event);
 extern void cl_command_queue_insert_barrier_event(cl_command_queue queue, cl_event event);
 extern void cl_command_queue_remove_barrier_event(cl_command_queue queue, cl_event event);
-extern void cl_command_queue_notify(cl_command_queue queue);
+/* One of the depend events of the enqueued event completed */
+extern void cl_command_queue_depend_complete(cl_command_queue queue, cl_event event);
 extern void cl_command_queue_enqueue_event(cl_command_queue queue, cl_event event);
 extern cl_int cl_command_queue_init_enqueue(cl_command_queue queue);
 extern void cl_command_queue_destroy_enqueue(cl_command_queue queue);
@@ -21,6 +21,64 @@
 #include "cl_event.h"
 #include "cl_alloc.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+/* Max number of kernels submitted with one batch buffer, 1 disables chaining */
+static int
+max_chained_kernels(void)
+{
+  static int max_chained = -1;
+  if (max_chained < 0) {
+    int value = 16;
+    // can't use IVAR (backend/src/sys/cvar.hpp) here as it's C++
+    const char *env = getenv("OCL_MAX_CHAINED_KERNELS");
+    if (env != NULL)
+      sscanf(env, "%i", &value);
+    max_chained = value < 1 ? 1 : value;
+  }
+  return max_chained;
+}
+
+static cl_bool
+event_can_chain(cl_event e)
+{
+  /* Kernels enqueuing child kernels read back their queue right after the flush */
+  return e->exec_data.type == EnqueueNDRangeKernel &&
+         e->exec_data.gpgpu != NULL &&
+         cl_gpgpu_get_kernel(e->exec_data.gpgpu) == NULL &&
+         cl_event_get_status(e) == CL_QUEUED &&
+         cl_event_is_ready(e) == CL_COMPLETE;
+}
+
+/* Chain the batches of the consecutive kernels in the list, so that the flush of
+   the first one submits all of them with a single execbuffer. The flushes of the
+   next ones return the error of that execbuffer, so their events fail with it */
+static void
+chain_ready_kernels(list_head *ready_list)
+{
+  const int max_chained = max_chained_kernels();
+  cl_event e, prev = NULL;
+  list_node *pos;
+  int chained = 0;
+
+  if (cl_gpgpu_chain == NULL || max_chained <= 1)
+    return;
+
+  list_for_each(pos, ready_list)
+  {
+    e = list_entry(pos, _cl_event, enqueue_node);
+    if (!event_can_chain(e)) {
+      prev = NULL;
+      continue;
+    }
+    if (prev && chained < max_chained &&
+        cl_gpgpu_chain(prev->exec_data.gpgpu, e->exec_data.gpgpu) == 0)
+      chained++;
+    else
+      chained = 1;
+    prev = e;
+  }
+}
 
 static void *
 worker_thread_function(void *Arg)
@@ -28,7 +86,6 @@ worker_thread_function(void *Arg)
   cl_command_queue_enqueue_worker worker = (cl_command_queue_enqueue_worker)Arg;
   cl_command_queue queue = worker->queue;
   cl_event e;
-  cl_uint cookie = -1;
   list_node *pos;
   list_node *n;
   list_head ready_list;
@@ -44,34 +101,31 @@ worker_thread_function(void *Arg)
       return NULL;
     }
 
-    if (list_empty(&worker->enqueued_events)) {
-      CL_OBJECT_WAIT_ON_COND(queue);
-      continue;
-    }
-
-    /* The cookie will change when event status change or something happend to
-       this command queue. If we already checked the event list and do not find
-       anything to exec, we need to wait the cookie update, to avoid loop for ever. */
-    if (cookie == worker->cookie) {
-      CL_OBJECT_WAIT_ON_COND(queue);
-      continue;
-    }
-
-    /* Here we hold lock to check event status, to avoid missing the status notify*/
+    /* The depend events count down depend_pending with the lock held, so the
+       ready events are known without checking the status of the others. */
     list_init(&ready_list);
-    list_for_each_safe(pos, n, &worker->enqueued_events)
-    {
-      e = list_entry(pos, _cl_event, enqueue_node);
-      if (cl_event_is_ready(e) <= CL_COMPLETE) {
+    if (queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+      list_for_each_safe(pos, n, &worker->ready_events)
+      {
+        e = list_entry(pos, _cl_event, ready_node);
+        assert(e->depend_pending == 0);
+        list_node_del(&e->ready_node);
+        list_node_del(&e->enqueue_node);
+        list_add_tail(&ready_list, &e->enqueue_node);
+      }
+    } else {
+      list_for_each_safe(pos, n, &worker->enqueued_events)
+      {
+        e = list_entry(pos, _cl_event, enqueue_node);
+        if (e->depend_pending > 0)
+          break; /* in in-order mode, can't skip over non-ready events */
         list_node_del(&e->enqueue_node);
         list_add_tail(&ready_list, &e->enqueue_node);
-      } else if(!(queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)){
-        break; /* in in-order mode, can't skip over non-ready events */
       }
     }
 
     if (list_empty(&ready_list)) { /* Nothing to do, just wait. */
-      cookie = worker->cookie;
+      CL_OBJECT_WAIT_ON_COND(queue);
       continue;
     }
 
@@ -95,6 +149,8 @@ worker_thread_function(void *Arg)
       worker->in_exec_status = CL_SUBMITTED;
       CL_OBJECT_NOTIFY_COND(queue);
       CL_OBJECT_UNLOCK(queue);
+    } else {
+      chain_ready_kernels(&ready_list);
     }
 
     list_for_each_safe(pos, n, &ready_list)
@@ -120,29 +176,43 @@ worker_thread_function(void *Arg)
 }
 
 LOCAL void
-cl_command_queue_notify(cl_command_queue queue)
+cl_command_queue_depend_complete(cl_command_queue queue, cl_event event)
 {
-  if (CL_OBJECT_GET_REF(queue) < 1) {
-    return;
-  }
+  cl_command_queue_enqueue_worker worker = &queue->worker;
 
   assert(queue && (((cl_base_object)queue)->magic == CL_OBJECT_COMMAND_QUEUE_MAGIC));
+  assert(event->queue == queue);
   CL_OBJECT_LOCK(queue);
-  queue->worker.cookie++;
-  CL_OBJECT_NOTIFY_COND(queue);
+  assert(event->depend_pending > 0);
+  event->depend_pending--;
+  if (event->depend_pending == 0) {
+    /* Only wake up the worker if it can run the event now */
+    if (queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+      list_add_tail(&worker->ready_events, &event->ready_node);
+      CL_OBJECT_NOTIFY_COND(queue);
+    } else if (worker->enqueued_events.head_node.n == &event->enqueue_node) {
+      CL_OBJECT_NOTIFY_COND(queue);
+    }
+  }
   CL_OBJECT_UNLOCK(queue);
 }
 
 LOCAL void
 cl_command_queue_enqueue_event(cl_command_queue queue, cl_event event)
 {
+  cl_command_queue_enqueue_worker worker = &queue->worker;
+
   CL_OBJECT_INC_REF(event);
   assert(CL_OBJECT_IS_COMMAND_QUEUE(queue));
   CL_OBJECT_LOCK(queue);
-  assert(queue->worker.quit == CL_FALSE);
+  assert(worker->quit == CL_FALSE);
   assert(list_node_out_of_list(&event->enqueue_node));
-  list_add_tail(&queue->worker.enqueued_events, &event->enqueue_node);
-  queue->worker.cookie++;
+  /* Keep the lock, the depend events completing from now on wait for it to
+     count the event down. */
+  event->depend_pending = cl_event_add_dependents(event);
+  list_add_tail(&worker->enqueued_events, &event->enqueue_node);
+  if (event->depend_pending == 0 && (queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+    list_add_tail(&worker->ready_events, &event->ready_node);
   CL_OBJECT_NOTIFY_COND(queue);
   CL_OBJECT_UNLOCK(queue);
 }
@@ -154,8 +224,8 @@ cl_command_queue_init_enqueue(cl_command_queue queue)
   worker->queue = queue;
   worker->quit = CL_FALSE;
   worker->in_exec_status = CL_COMPLETE;
-  worker->cookie = 8;
   list_init(&worker->enqueued_events);
+  list_init(&worker->ready_events);
 
   if (pthread_create(&worker->tid, NULL, worker_thread_function, worker)) {
     DEBUGP(DL_ERROR, "Can not create worker thread for queue %p...\n", queue);
@@ -193,6 +263,10 @@ cl_command_queue_destroy_enqueue(cl_command_queue queue)
     {
       e = list_entry(pos, _cl_event, enqueue_node);
       list_node_del(&e->enqueue_node);
+      if (!list_node_out_of_list(&e->ready_node))
+        list_node_del(&e->ready_node);
+      /* Its depend events must not count it down anymore */
+      cl_event_remove_dependents(e);
       cl_event_set_status(e, -1); // Give waiters a chance to wakeup.
       cl_event_delete(e);
     }
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <emmintrin.h>
 
 #define MAX_GROUP_SIZE_IN_HALFSLICE   512
 static INLINE size_t cl_kernel_compute_batch_sz(cl_kernel k) { return 256+256; }
@@ -39,6 +40,84 @@ static INLINE size_t cl_kernel_compute_batch_sz(cl_kernel k) { return 256+256; }
 /* "Varing" payload is the part of the curbe that changes accross threads in the
  *  same work group. Right now, it consists in local IDs and block IPs
  */
+
+/* Copy with 16 bytes SSE moves. The curbe and its varying fields are made of
+ * full 16 bytes blocks, only the tail of an odd sized curbe goes through memcpy
+ */
+static INLINE void
+cl_copy_16b(char *dst, const char *src, size_t sz)
+{
+  size_t i;
+  for (i = 0; i + 16 <= sz; i += 16)
+    _mm_storeu_si128((__m128i *) (dst + i), _mm_loadu_si128((const __m128i *) (src + i)));
+  if (i < sz)
+    memcpy(dst + i, src + i, sz - i);
+}
+
+/* The varying data of every thread is kept as the X, Y and Z local IDs, the
+ * block IPs and the thread ID, one after the other, so a launch with the same
+ * local size as the previous one only copies it
+ */
+static cl_varying_payload *
+cl_get_varying_payload(cl_kernel ker,
+                       const size_t *local_wk_sz,
+                       size_t simd_sz,
+                       size_t thread_n,
+                       int dw_ip)
+{
+  cl_varying_payload *payload = ker->payload;
+  const size_t id_sz = simd_sz * sizeof(uint32_t);
+  const uint32_t thread_sz = ALIGN(4 * id_sz + sizeof(uint32_t), 16);
+  size_t i, j, k, curr = 0;
+
+  if (payload && payload->thread_n == thread_n &&
+      payload->local_wk_sz[0] == local_wk_sz[0] &&
+      payload->local_wk_sz[1] == local_wk_sz[1] &&
+      payload->local_wk_sz[2] == local_wk_sz[2])
+    return payload;
+
+  cl_free(payload);
+  ker->payload = payload = cl_calloc(1, sizeof(cl_varying_payload) + thread_n * thread_sz);
+  if (payload == NULL)
+    return NULL;
+  payload->local_wk_sz[0] = local_wk_sz[0];
+  payload->local_wk_sz[1] = local_wk_sz[1];
+  payload->local_wk_sz[2] = local_wk_sz[2];
+  payload->thread_n = thread_n;
+  payload->thread_sz = thread_sz;
+
+  /* 0xffff means that the lane is inactivated */
+  for (i = 0; i < thread_n; ++i) {
+    char *data = payload->data + i * thread_sz;
+    for (j = 0; j < simd_sz; ++j) {
+      if (dw_ip)
+        ((uint32_t *) (data + 3 * id_sz))[j] = 0xffff;
+      else
+        ((uint16_t *) (data + 3 * id_sz))[j] = 0xffff;
+    }
+    *(uint32_t *) (data + 4 * id_sz) = i;
+  }
+
+  /* Compute the IDs and the block IPs */
+  for (k = 0; k < local_wk_sz[2]; ++k)
+  for (j = 0; j < local_wk_sz[1]; ++j)
+  for (i = 0; i < local_wk_sz[0]; ++i, ++curr) {
+    char *data = payload->data + (curr / simd_sz) * thread_sz;
+    const size_t lane = curr % simd_sz;
+    ((uint32_t *) data)[lane] = i;
+    ((uint32_t *) (data + id_sz))[lane] = j;
+    ((uint32_t *) (data + 2 * id_sz))[lane] = k;
+    if (dw_ip)
+      ((uint32_t *) (data + 3 * id_sz))[lane] = 0;
+    else
+      ((uint16_t *) (data + 3 * id_sz))[lane] = 0;
+  }
+  return payload;
+}
+
+/* Fill the curbe of every thread: the data shared by all threads followed by
+ * the varying payload
+ */
 static cl_int
 cl_set_varying_payload(const cl_kernel ker,
                        char *data,
@@ -47,82 +126,47 @@ cl_set_varying_payload(const cl_kernel ker,
                        size_t cst_sz,
                        size_t thread_n)
 {
-  uint32_t *ids[3] = {NULL,NULL,NULL};
-  uint16_t *block_ips = NULL;
-  uint32_t *thread_ids = NULL;
-  size_t i, j, k, curr = 0;
+  cl_varying_payload *payload;
+  size_t i, j;
   int32_t id_offset[3], ip_offset, tid_offset;
-  cl_int err = CL_SUCCESS;
   int32_t dw_ip_offset = -1;
+  const size_t id_sz = simd_sz * sizeof(uint32_t);
+  size_t ip_sz = simd_sz * sizeof(uint16_t);
 
   id_offset[0] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_X, 0);
   id_offset[1] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Y, 0);
   id_offset[2] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Z, 0);
   ip_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_BLOCK_IP, 0);
   tid_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_THREAD_ID, 0);
-  if (ip_offset < 0)
+  if (ip_offset < 0) {
     dw_ip_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_DW_BLOCK_IP, 0);
-  assert(ip_offset < 0 || dw_ip_offset < 0);
-  assert(ip_offset >= 0 || dw_ip_offset >= 0);
-
-  if (id_offset[0] >= 0)
-    TRY_ALLOC(ids[0], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  if (id_offset[1] >= 0)
-    TRY_ALLOC(ids[1], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  if (id_offset[2] >= 0)
-    TRY_ALLOC(ids[2], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  TRY_ALLOC(block_ips, (uint16_t*) alloca(sizeof(uint16_t)*thread_n*simd_sz));
-  if (tid_offset >= 0) {
-    TRY_ALLOC(thread_ids, (uint32_t*) alloca(sizeof(uint32_t)*thread_n));
-    memset(thread_ids, 0, sizeof(uint32_t)*thread_n);
+    ip_offset = dw_ip_offset;
+    ip_sz = id_sz;
   }
-  /* 0xffff means that the lane is inactivated */
-  memset(block_ips, 0xff, sizeof(int16_t)*thread_n*simd_sz);
-
-
-  /* Compute the IDs and the block IPs */
-  for (k = 0; k < local_wk_sz[2]; ++k)
-  for (j = 0; j < local_wk_sz[1]; ++j)
-  for (i = 0; i < local_wk_sz[0]; ++i, ++curr) {
-    if (id_offset[0] >= 0)
-      ids[0][curr] = i;
-    if (id_offset[1] >= 0)
-      ids[1][curr] = j;
-    if (id_offset[2] >= 0)
-      ids[2][curr] = k;
-    block_ips[curr] = 0;
-    if (thread_ids)
-      thread_ids[curr/simd_sz] = curr/simd_sz;
+  assert(ip_offset >= 0);
+
+  /* The payload is shared by the launches of the kernel from every queue */
+  CL_OBJECT_LOCK(ker);
+  payload = cl_get_varying_payload(ker, local_wk_sz, simd_sz, thread_n, dw_ip_offset >= 0);
+  if (payload == NULL) {
+    CL_OBJECT_UNLOCK(ker);
+    return CL_OUT_OF_HOST_MEMORY;
   }
 
   /* Copy them to the curbe buffer */
-  curr = 0;
   for (i = 0; i < thread_n; ++i, data += cst_sz) {
-    uint32_t *ids0 = (uint32_t *) (data + id_offset[0]);
-    uint32_t *ids1 = (uint32_t *) (data + id_offset[1]);
-    uint32_t *ids2 = (uint32_t *) (data + id_offset[2]);
-    uint16_t *ips  = (uint16_t *) (data + ip_offset);
-    uint32_t *dw_ips  = (uint32_t *) (data + dw_ip_offset);
-
-    if (thread_ids)
-      *(uint32_t *)(data + tid_offset) = thread_ids[i];
-
-    for (j = 0; j < simd_sz; ++j, ++curr) {
-      if (id_offset[0] >= 0)
-        ids0[j] = ids[0][curr];
-      if (id_offset[1] >= 0)
-        ids1[j] = ids[1][curr];
-      if (id_offset[2] >= 0)
-        ids2[j] = ids[2][curr];
-      if (ip_offset >= 0)
-        ips[j] = block_ips[curr];
-      if (dw_ip_offset >= 0)
-        dw_ips[j] = block_ips[curr];
-    }
+    const char *varying = payload->data + i * payload->thread_sz;
+    cl_copy_16b(data, ker->curbe, cst_sz);
+    for (j = 0; j < 3; ++j)
+      if (id_offset[j] >= 0)
+        cl_copy_16b(data + id_offset[j], varying + j * id_sz, id_sz);
+    cl_copy_16b(data + ip_offset, varying + 3 * id_sz, ip_sz);
+    if (tid_offset >= 0)
+      *(uint32_t *) (data + tid_offset) = *(const uint32_t *) (varying + 4 * id_sz);
   }
+  CL_OBJECT_UNLOCK(ker);
 
-error:
-  return err;
+  return CL_SUCCESS;
 }
 
 static int
@@ -205,7 +249,7 @@ cl_upload_constant_buffer(cl_command_queue queue, cl_kernel ker, cl_gpgpu gpgpu)
       *(uint32_t *) (ker->curbe + curbe_offset) = offset;
 
       cl_buffer_map(mem->bo, 1);
-      void * addr = cl_buffer_get_virtual(mem->bo);
+      char * addr = (char *)cl_buffer_get_virtual(mem->bo) + mem->offset;
       memcpy(cst_addr + offset, addr, mem->size);
       cl_buffer_unmap(mem->bo);
       offset += mem->size;
@@ -352,6 +396,76 @@ cl_alloc_printf(cl_gpgpu gpgpu, cl_kernel ker, void* printf_info, int printf_num
   return 0;
 }
 
+/* Launch states are kept per kernel unless OCL_LAUNCH_STATE_CACHE=0 */
+static int
+cl_launch_state_cache_enabled(void)
+{
+  static int enabled = -1;
+  if (enabled < 0) {
+    int value = 1;
+    // can't use BVAR (backend/src/sys/cvar.hpp) here as it's C++
+    const char *env = getenv("OCL_LAUNCH_STATE_CACHE");
+    if (env != NULL)
+      sscanf(env, "%i", &value);
+    enabled = value;
+  }
+  return enabled;
+}
+
+/* The states of a launch can be reused if everything they hold only depends on
+ * the bindings. Printf, profiling and device enqueue buffers are allocated per
+ * launch and the OCL 1.2 constant buffer is a copy of the argument contents
+ */
+static int
+cl_launch_state_cacheable(cl_command_queue queue, cl_kernel ker, int printf_num)
+{
+  int32_t arg;
+
+  if (!cl_launch_state_cache_enabled() || cl_gpgpu_state_reuse == NULL)
+    return 0;
+  if (printf_num || (queue->props & CL_QUEUE_PROFILING_ENABLE) ||
+      interp_get_profiling_bti(ker->opaque) != 0 ||
+      ker->useDeviceEnqueue || ker->vme || ker->exec_info_n > 0 || !ker->curbe)
+    return 0;
+  if (interp_kernel_get_ocl_version(ker->opaque) < 200) {
+    if (interp_program_get_global_constant_size(ker->program->opaque) > 0)
+      return 0;
+    for (arg = 0; arg < ker->arg_n; ++arg)
+      if (interp_kernel_get_arg_type(ker->opaque, arg) == GBE_ARG_CONSTANT_PTR &&
+          ker->args[arg].mem)
+        return 0;
+  }
+  return 1;
+}
+
+/* Everything the surface, sampler and IDRT states are built from. The bos of
+ * the arguments are referenced by the relocations of the kept states, so a bo
+ * address can not be reused by another buffer while the signature is alive.
+ * The kernel drops its state when an argument is replaced, to not keep the
+ * bos of the released buffers. The small buffers share slab bos, a new one
+ * may get the same bo and slot
+ */
+static uint32_t
+cl_launch_state_signature(cl_kernel ker, const cl_gpgpu_kernel *kernel, uintptr_t *sig)
+{
+  uint32_t i, n = 0;
+
+  sig[n++] = kernel->thread_n;
+  sig[n++] = kernel->slm_sz;
+  sig[n++] = kernel->curbe_sz;
+  for (i = 0; i < ker->arg_n; ++i) {
+    cl_mem mem = ker->args[i].mem;
+    sig[n++] = (uintptr_t) mem;
+    sig[n++] = mem ? (uintptr_t) mem->bo : 0;
+    sig[n++] = mem ? (uintptr_t) mem->offset : 0;
+    sig[n++] = mem ? (uintptr_t) mem->size : 0;
+    sig[n++] = (uintptr_t) ker->args[i].ptr;
+  }
+  for (i = 0; i < ker->sampler_sz; ++i)
+    sig[n++] = ker->samplers[i];
+  return n;
+}
+
 LOCAL cl_int
 cl_command_queue_ND_range_gen7(cl_command_queue queue,
                                cl_kernel ker,
@@ -364,12 +478,15 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
                                const size_t *local_wk_sz,
                                const size_t *local_wk_sz_use)
 {
-  cl_gpgpu gpgpu = cl_gpgpu_new(queue->ctx->drv);
+  cl_gpgpu gpgpu = NULL;
+  cl_launch_state *state = NULL;
+  uintptr_t *sig = NULL;
+  uint32_t sig_n = 0, arg_epoch = 0;
   cl_context ctx = queue->ctx;
-  char *final_curbe = NULL;  /* Includes them and one sub-buffer per group */
+  char *final_curbe = NULL;  /* Mapped curbes, one sub-buffer per thread */
   cl_gpgpu_kernel kernel;
   const uint32_t simd_sz = cl_kernel_get_simd_width(ker);
-  size_t i, batch_sz = 0u, local_sz = 0u;
+  size_t batch_sz = 0u, local_sz = 0u;
   size_t cst_sz = interp_kernel_get_curbe_size(ker->opaque);
   int32_t scratch_sz = interp_kernel_get_scratch_size(ker->opaque);
   size_t thread_n = 0u;
@@ -378,6 +495,8 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   size_t global_size = global_wk_sz[0] * global_wk_sz[1] * global_wk_sz[2];
   void* printf_info = NULL;
   uint32_t max_bti = 0;
+  cl_mem *mem_args = NULL;
+  cl_uint mem_arg_n = 0, i;
 
   if (ker->exec_info_n > 0) {
     cst_sz += ker->exec_info_n * sizeof(void *);
@@ -416,6 +535,41 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   }
 
   printf_info = interp_dup_printfset(ker->opaque);
+  printf_num = interp_get_printf_num(printf_info);
+
+  /* Relaunch the states of a previous NDRange with the same bindings */
+  if (cl_launch_state_cacheable(queue, ker, printf_num)) {
+    arg_epoch = ker->arg_epoch;
+    TRY_ALLOC (sig, (uintptr_t*) alloca(sizeof(uintptr_t) * (3 + 5 * ker->arg_n + ker->sampler_sz)));
+    sig_n = cl_launch_state_signature(ker, &kernel, sig);
+    state = cl_kernel_take_launch_state(ker, sig, sig_n);
+    if (state && cl_gpgpu_state_reuse(state->gpgpu, &kernel) != 0) {
+      /* Still running, build new states for this launch */
+      cl_kernel_put_launch_state(ker, state);
+      state = NULL;
+    }
+    if (state) {
+      state->arg_epoch = arg_epoch;
+      gpgpu = state->gpgpu;
+      cl_gpgpu_set_printf_info(gpgpu, printf_info);
+      /* Other launches of the kernel may have left other images in the curbe */
+      cl_command_queue_set_image_info(ker);
+      goto upload_curbe;
+    }
+  }
+
+  gpgpu = cl_gpgpu_new(queue->ctx->drv);
+  if (gpgpu == NULL)
+    goto error;
+  if (sig) {
+    state = cl_launch_state_new(gpgpu, sig, sig_n);
+    if (state == NULL) {
+      cl_gpgpu_delete(gpgpu);
+      gpgpu = NULL;
+      goto error;
+    }
+    state->arg_epoch = arg_epoch;
+  }
   cl_gpgpu_set_printf_info(gpgpu, printf_info);
 
   /* Setup the kernel */
@@ -425,7 +579,6 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
     err = cl_gpgpu_state_init(gpgpu, ctx->devices[0]->max_compute_unit * ctx->devices[0]->max_thread_per_unit, cst_sz / 32, 0);
   if (err != 0)
     goto error;
-  printf_num = interp_get_printf_num(printf_info);
   if (printf_num) {
     if (cl_alloc_printf(gpgpu, ker, printf_info, printf_num, global_size) != 0)
       goto error;
@@ -464,15 +617,16 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
 
   cl_gpgpu_states_setup(gpgpu, &kernel);
 
+upload_curbe:
   /* Curbe step 2. Give the localID and upload it to video memory */
   if (ker->curbe) {
     assert(cst_sz > 0);
-    TRY_ALLOC (final_curbe, (char*) alloca(thread_n * cst_sz));
-    for (i = 0; i < thread_n; ++i) {
-        memcpy(final_curbe + cst_sz * i, ker->curbe, cst_sz);
-    }
-    TRY (cl_set_varying_payload, ker, final_curbe, local_wk_sz_use, simd_sz, cst_sz, thread_n);
-    if (cl_gpgpu_upload_curbes(gpgpu, final_curbe, thread_n*cst_sz) != 0)
+    final_curbe = cl_gpgpu_map_curbes(gpgpu);
+    if (final_curbe == NULL)
+      goto error;
+    err = cl_set_varying_payload(ker, final_curbe, local_wk_sz_use, simd_sz, cst_sz, thread_n);
+    cl_gpgpu_unmap_curbes(gpgpu);
+    if (err != CL_SUCCESS)
       goto error;
   }
 
@@ -489,13 +643,39 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   /* Close the batch buffer and submit it */
   cl_gpgpu_batch_end(gpgpu, 0);
 
+  /* The kernel may get other arguments and these buffers be released before
+   * the NDRange runs, their bos or slab slots must not be reused before */
+  for (i = 0; i < ker->arg_n; i++)
+    if (ker->args[i].mem)
+      mem_arg_n++;
+  if (mem_arg_n) {
+    TRY_ALLOC (mem_args, cl_calloc(mem_arg_n, sizeof(cl_mem)));
+    for (i = 0, mem_arg_n = 0; i < ker->arg_n; i++)
+      if (ker->args[i].mem) {
+        cl_mem_add_ref(ker->args[i].mem);
+        mem_args[mem_arg_n++] = ker->args[i].mem;
+      }
+  }
+
   event->exec_data.queue = queue;
   event->exec_data.gpgpu = gpgpu;
   event->exec_data.type = EnqueueNDRangeKernel;
+  event->exec_data.mem_args = mem_args;
+  event->exec_data.mem_arg_n = mem_arg_n;
+  if (state) {
+    /* Given back to the kernel when the event is released */
+    cl_kernel_add_ref(ker);
+    event->exec_data.kernel = ker;
+    event->exec_data.launch_state = state;
+  }
 
   return CL_SUCCESS;
 
 error:
+  if (state)
+    cl_launch_state_delete(state);
+  else if (gpgpu)
+    cl_gpgpu_delete(gpgpu);
   /* only some command/buffer internal error reach here, so return error code OOR */
   return CL_OUT_OF_RESOURCES;
 }
@@ -30,6 +30,9 @@
 #include "cl_khr_icd.h"
 #include "cl_kernel.h"
 #include "cl_program.h"
+#include "cl_mem_slab.h"
+#include "cl_copy_engine.h"
+#include "cl_local_size_tuner.h"
 
 #include "CL/cl.h"
 #include "CL/cl_gl.h"
@@ -46,9 +49,6 @@ cl_context_add_queue(cl_context ctx, cl_command_queue queue) {
   cl_context_add_ref(ctx);
 
   CL_OBJECT_LOCK(ctx);
-  while (ctx->queue_modify_disable) {
-    CL_OBJECT_WAIT_ON_COND(ctx);
-  }
   list_add_tail(&ctx->queues, &queue->base.node);
   ctx->queue_num++;
   CL_OBJECT_UNLOCK(ctx);
@@ -61,9 +61,6 @@ cl_context_remove_queue(cl_context ctx, cl_command_queue queue) {
   assert(queue->ctx == ctx);
 
   CL_OBJECT_LOCK(ctx);
-  while (ctx->queue_modify_disable) {
-    CL_OBJECT_WAIT_ON_COND(ctx);
-  }
   list_node_del(&queue->base.node);
   ctx->queue_num--;
   CL_OBJECT_UNLOCK(ctx);
@@ -338,11 +335,12 @@ cl_context_new(struct _cl_context_prop *props, cl_uint dev_num, cl_device_id* al
   list_init(&ctx->samplers);
   list_init(&ctx->events);
   list_init(&ctx->programs);
-  ctx->queue_modify_disable = CL_FALSE;
   TRY_ALLOC_NO_ERR (ctx->drv, cl_driver_new(props));
   ctx->props = *props;
   ctx->ver = cl_driver_get_ver(ctx->drv);
   ctx->image_queue = NULL;
+  ctx->slab_allocator = cl_slab_allocator_new(cl_driver_get_bufmgr(ctx->drv));
+  ctx->copy_engine = cl_copy_engine_new();
 
 exit:
   return ctx;
@@ -402,6 +400,9 @@ cl_context_delete(cl_context ctx)
 
   cl_free(ctx->prop_user);
   cl_free(ctx->devices);
+  cl_slab_allocator_delete(ctx->slab_allocator);
+  cl_copy_engine_delete(ctx->copy_engine);
+  cl_local_size_tuning_release(ctx);
   cl_driver_delete(ctx->drv);
   CL_OBJECT_DESTROY_BASE(ctx);
   cl_free(ctx);
@@ -111,7 +111,6 @@ struct _cl_context {
   cl_uint device_num;               /* Devices number of this context */
   list_head queues;                 /* All command queues currently allocated */
   cl_uint queue_num;                /* All queue number currently allocated */
-  cl_uint queue_modify_disable;     /* Temp disable queue list change. */
   list_head mem_objects;            /* All memory object currently allocated */
   cl_uint mem_object_num;           /* All memory number currently allocated */
   list_head samplers;               /* All sampler object currently allocated */
@@ -134,6 +133,10 @@ struct _cl_context {
                                      /* User's callback when error occur in context */
   void *user_data;                   /* A pointer to user supplied data */
   cl_command_queue image_queue;      /* A internal command queue for image data copying */
+  struct _cl_slab_allocator *slab_allocator; /* Small buffers sub-allocated in shared bos */
+  struct _cl_copy_engine *copy_engine; /* Threads of the large host copies */
+  struct cl_tuning_entry *tuning_entries; /* Local sizes tuned for the kernels */
+  cl_bool tuning_file_loaded;        /* The tuned local sizes of the file are read */
 };
 
 #define CL_OBJECT_CONTEXT_MAGIC 0x20BBCADE993134AALL
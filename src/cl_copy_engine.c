@@ -0,0 +1,307 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A single thread copying with memcpy reaches a fraction of the memory
+ * bandwidth. The large copies between the host memory and the mapped bos are
+ * cut in parts of at least COPY_PART_MIN bytes, taken in turn by the thread
+ * of the queue and the threads of the engine. A single copy runs at a time,
+ * a copy requested while the threads are busy is done by its caller alone.
+ *
+ * The destinations larger than COPY_STREAMING_MIN, which the caches cannot
+ * keep anyway, and the uncached mappings are written with non temporal stores
+ * to not read every destination line before writing it.
+ */
+
+#include "cl_copy_engine.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <emmintrin.h>
+
+#define COPY_PART_MIN        (1024 * 1024)
+#define COPY_STREAMING_MIN   (8 * 1024 * 1024)
+#define COPY_MAX_THREADS     16
+
+typedef struct copy_job {
+  char *dst;
+  const char *src;
+  size_t dst_row_pitch, dst_slice_pitch;
+  size_t src_row_pitch, src_slice_pitch;
+  size_t row_bytes, rows, slices;
+  size_t part_n;
+  size_t part_sz;               /* Bytes of a part of a single row, or rows */
+  int streaming;
+  volatile size_t next_part;
+  int users;                    /* Threads of the engine in the job */
+} copy_job;
+
+struct _cl_copy_engine {
+  pthread_mutex_t lock;
+  pthread_mutex_t busy;         /* Held by the thread submitting a copy */
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  copy_job *job;
+  uint32_t generation;
+  int quit;
+  int thread_n;
+  pthread_t threads[COPY_MAX_THREADS];
+};
+
+LOCAL int
+cl_copy_engine_thread_n(void)
+{
+  static int thread_n = -1;
+  if (thread_n < 0) {
+    long cpu_n = sysconf(_SC_NPROCESSORS_ONLN);
+    int value = MIN(4, cpu_n > 0 ? (int)cpu_n : 1);
+    // can't use IVAR (backend/src/sys/cvar.hpp) here as it's C++
+    const char *env = getenv("OCL_COPY_THREADS");
+    if (env != NULL)
+      sscanf(env, "%i", &value);
+    thread_n = MAX(1, MIN(value, COPY_MAX_THREADS + 1));
+  }
+  return thread_n;
+}
+
+static void
+copy_streaming(char *dst, const char *src, size_t n)
+{
+  const size_t head = MIN(n, (16 - ((uintptr_t)dst & 15)) & 15);
+
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  n -= head;
+  for (; n >= 64; n -= 64, dst += 64, src += 64) {
+    __m128i a = _mm_loadu_si128((const __m128i *)src);
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+    __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+    __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+    _mm_stream_si128((__m128i *)dst, a);
+    _mm_stream_si128((__m128i *)(dst + 16), b);
+    _mm_stream_si128((__m128i *)(dst + 32), c);
+    _mm_stream_si128((__m128i *)(dst + 48), d);
+  }
+  for (; n >= 16; n -= 16, dst += 16, src += 16)
+    _mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+  memcpy(dst, src, n);
+}
+
+static INLINE void
+copy_bytes(char *dst, const char *src, size_t n, int streaming)
+{
+  if (streaming)
+    copy_streaming(dst, src, n);
+  else
+    memcpy(dst, src, n);
+}
+
+static void
+copy_part(const copy_job *job, size_t part)
+{
+  if (job->rows * job->slices == 1) {
+    const size_t offset = part * job->part_sz;
+    copy_bytes(job->dst + offset, job->src + offset,
+               MIN(job->part_sz, job->row_bytes - offset), job->streaming);
+  } else {
+    const size_t last = MIN((part + 1) * job->part_sz, job->rows * job->slices);
+    size_t r;
+    for (r = part * job->part_sz; r < last; r++) {
+      const size_t y = r % job->rows, z = r / job->rows;
+      copy_bytes(job->dst + z * job->dst_slice_pitch + y * job->dst_row_pitch,
+                 job->src + z * job->src_slice_pitch + y * job->src_row_pitch,
+                 job->row_bytes, job->streaming);
+    }
+  }
+}
+
+static void
+copy_job_run(copy_job *job)
+{
+  size_t part;
+  while ((part = __sync_fetch_and_add(&job->next_part, 1)) < job->part_n)
+    copy_part(job, part);
+  /* The streaming stores must be visible when the copy returns */
+  if (job->streaming)
+    _mm_sfence();
+}
+
+static void *
+copy_thread_function(void *arg)
+{
+  cl_copy_engine *engine = arg;
+  uint32_t generation;
+
+  pthread_mutex_lock(&engine->lock);
+  generation = engine->generation;
+  for (;;) {
+    while (!engine->quit && engine->generation == generation)
+      pthread_cond_wait(&engine->work_cond, &engine->lock);
+    if (engine->quit)
+      break;
+    generation = engine->generation;
+    copy_job *job = engine->job;
+    /* The caller may have finished the whole job already */
+    if (job == NULL)
+      continue;
+    job->users++;
+    pthread_mutex_unlock(&engine->lock);
+    copy_job_run(job);
+    pthread_mutex_lock(&engine->lock);
+    if (--job->users == 0)
+      pthread_cond_signal(&engine->done_cond);
+  }
+  pthread_mutex_unlock(&engine->lock);
+  return NULL;
+}
+
+LOCAL cl_copy_engine *
+cl_copy_engine_new(void)
+{
+  const int thread_n = cl_copy_engine_thread_n() - 1;
+  cl_copy_engine *engine = NULL;
+  int i;
+
+  if (thread_n == 0)
+    return NULL;
+  TRY_ALLOC_NO_ERR (engine, CALLOC(cl_copy_engine));
+  pthread_mutex_init(&engine->lock, NULL);
+  pthread_mutex_init(&engine->busy, NULL);
+  pthread_cond_init(&engine->work_cond, NULL);
+  pthread_cond_init(&engine->done_cond, NULL);
+  for (i = 0; i < thread_n; i++) {
+    if (pthread_create(&engine->threads[i], NULL, copy_thread_function, engine))
+      break;
+    engine->thread_n++;
+  }
+  if (engine->thread_n == 0)
+    goto error;
+
+exit:
+  return engine;
+error:
+  cl_copy_engine_delete(engine);
+  engine = NULL;
+  goto exit;
+}
+
+LOCAL void
+cl_copy_engine_delete(cl_copy_engine *engine)
+{
+  int i;
+
+  if (engine == NULL)
+    return;
+  pthread_mutex_lock(&engine->lock);
+  engine->quit = 1;
+  pthread_cond_broadcast(&engine->work_cond);
+  pthread_mutex_unlock(&engine->lock);
+  for (i = 0; i < engine->thread_n; i++)
+    pthread_join(engine->threads[i], NULL);
+  pthread_cond_destroy(&engine->done_cond);
+  pthread_cond_destroy(&engine->work_cond);
+  pthread_mutex_destroy(&engine->busy);
+  pthread_mutex_destroy(&engine->lock);
+  cl_free(engine);
+}
+
+static void
+copy_job_submit(cl_copy_engine *engine, copy_job *job, size_t units, size_t unit_sz)
+{
+  const size_t size = units * unit_sz;
+  size_t part_n;
+
+  job->next_part = 0;
+  job->users = 0;
+  if (engine == NULL || size < CL_COPY_ENGINE_THREADED_MIN ||
+      pthread_mutex_trylock(&engine->busy) != 0) {
+    job->part_n = 1;
+    job->part_sz = units;
+    copy_job_run(job);
+    return;
+  }
+
+  /* A few parts per thread to balance the threads descheduled for a while */
+  part_n = MIN(size / COPY_PART_MIN, (size_t)(4 * (engine->thread_n + 1)));
+  job->part_sz = (units + part_n - 1) / part_n;
+  if (unit_sz == 1)
+    job->part_sz = ALIGN(job->part_sz, 4096);
+  job->part_n = (units + job->part_sz - 1) / job->part_sz;
+
+  pthread_mutex_lock(&engine->lock);
+  engine->job = job;
+  engine->generation++;
+  pthread_cond_broadcast(&engine->work_cond);
+  pthread_mutex_unlock(&engine->lock);
+
+  copy_job_run(job);
+
+  /* All the parts are taken, wait for the ones still copied by the engine */
+  pthread_mutex_lock(&engine->lock);
+  while (job->users > 0)
+    pthread_cond_wait(&engine->done_cond, &engine->lock);
+  engine->job = NULL;
+  pthread_mutex_unlock(&engine->lock);
+  pthread_mutex_unlock(&engine->busy);
+}
+
+LOCAL void
+cl_copy_engine_copy(cl_copy_engine *engine, void *dst, const void *src,
+                    size_t size, cl_bool write_combined)
+{
+  copy_job job;
+
+  memset(&job, 0, sizeof(job));
+  job.dst = dst;
+  job.src = src;
+  job.row_bytes = size;
+  job.rows = job.slices = 1;
+  job.streaming = write_combined || size >= COPY_STREAMING_MIN;
+  copy_job_submit(engine, &job, size, 1);
+}
+
+LOCAL void
+cl_copy_engine_copy_rect(cl_copy_engine *engine,
+                         void *dst, size_t dst_row_pitch, size_t dst_slice_pitch,
+                         const void *src, size_t src_row_pitch, size_t src_slice_pitch,
+                         size_t row_bytes, size_t rows, size_t slices,
+                         cl_bool write_combined)
+{
+  copy_job job;
+
+  if (rows * slices == 1) {
+    cl_copy_engine_copy(engine, dst, src, row_bytes, write_combined);
+    return;
+  }
+  memset(&job, 0, sizeof(job));
+  job.dst = dst;
+  job.src = src;
+  job.dst_row_pitch = dst_row_pitch;
+  job.dst_slice_pitch = dst_slice_pitch;
+  job.src_row_pitch = src_row_pitch;
+  job.src_slice_pitch = src_slice_pitch;
+  job.row_bytes = row_bytes;
+  job.rows = rows;
+  job.slices = slices;
+  job.streaming = write_combined || row_bytes * rows * slices >= COPY_STREAMING_MIN;
+  copy_job_submit(engine, &job, rows * slices, row_bytes);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_COPY_ENGINE_H__
+#define __CL_COPY_ENGINE_H__
+
+#include "CL/cl.h"
+#include <stddef.h>
+
+/* Smallest copy split across the threads */
+#define CL_COPY_ENGINE_THREADED_MIN  (4 * 1024 * 1024)
+
+/* Host threads of a context sharing the large host copies */
+typedef struct _cl_copy_engine cl_copy_engine;
+
+/* Number of threads of a copy, with the caller, set with OCL_COPY_THREADS */
+extern int cl_copy_engine_thread_n(void);
+
+/* NULL if the copies are not threaded */
+extern cl_copy_engine *cl_copy_engine_new(void);
+
+/* No copy may be running */
+extern void cl_copy_engine_delete(cl_copy_engine *engine);
+
+/* memcpy, split across the threads of the engine if it is large. engine may be
+ * NULL. write_combined tells that dst is an uncached mapping, which is always
+ * written with streaming stores */
+extern void cl_copy_engine_copy(cl_copy_engine *engine, void *dst, const void *src,
+                                size_t size, cl_bool write_combined);
+
+/* Same for slices of rows of row_bytes bytes */
+extern void cl_copy_engine_copy_rect(cl_copy_engine *engine,
+                                     void *dst, size_t dst_row_pitch, size_t dst_slice_pitch,
+                                     const void *src, size_t src_row_pitch, size_t src_slice_pitch,
+                                     size_t row_bytes, size_t rows, size_t slices,
+                                     cl_bool write_combined);
+
+#endif /* __CL_COPY_ENGINE_H__ */
@@ -40,6 +40,9 @@ cl_device_enqueue_fix_offset(cl_kernel ker) {
 
     if(!ker->args[i].is_svm) {
       mem = ker->args[i].mem;
+      /* The bo is pinned at the address of its data */
+      if (cl_mem_slab_detach(mem) != CL_SUCCESS)
+        return -1;
       ptr = cl_mem_map(mem, 0);
       cl_buffer_set_softpin_offset(mem->bo, (size_t)ptr);
       cl_buffer_set_bo_use_full_range(mem->bo, 1);
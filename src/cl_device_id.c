@@ -35,6 +35,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/sysinfo.h>
+#include <sys/utsname.h>
 
 #ifndef CL_VERSION_1_2
 #define CL_DEVICE_BUILT_IN_KERNELS 0x103F
@@ -944,12 +945,12 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   cl_event kernel_finished;
   size_t n = 3;
   cl_int test_data[3] = {3, 7, 5};
-  const char* kernel_source = "__kernel void self_test(__global int *buf) {"
-  "  __local int tmp[3];"
-  "  tmp[get_local_id(0)] = buf[get_local_id(0)];"
-  "  barrier(CLK_LOCAL_MEM_FENCE);"
-  "  buf[get_global_id(0)] = tmp[2 - get_local_id(0)] + buf[get_global_id(0)];"
-  "}"; // using __local to catch the "no SLM on Haswell" problem
+  /* Built with gbe_bin_generater like the internal kernels, so that the test
+     does not run the OpenCL C front end */
+  extern char cl_internal_self_test_str[];
+  extern size_t cl_internal_self_test_str_size;
+  const unsigned char *kernel_binary = (const unsigned char *)cl_internal_self_test_str;
+  const size_t kernel_binary_size = cl_internal_self_test_str_size;
   static int tested = 0;
   static cl_self_test_res ret = SELF_TEST_OTHER_FAIL;
   if (tested != 0)
@@ -962,11 +963,12 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   if (status == CL_SUCCESS) {
     queue = clCreateCommandQueueWithProperties(ctx, device, 0, &status);
     if (status == CL_SUCCESS) {
-      program = clCreateProgramWithSource(ctx, 1, &kernel_source, NULL, &status);
+      program = clCreateProgramWithBinary(ctx, 1, &device, &kernel_binary_size,
+                                          &kernel_binary, NULL, &status);
       if (status == CL_SUCCESS) {
         status = clBuildProgram(program, 1, &device, "", NULL, NULL);
         if (status == CL_SUCCESS) {
-          kernel = clCreateKernel(program, "self_test", &status);
+          kernel = clCreateKernel(program, "__cl_self_test", &status);
           if (status == CL_SUCCESS) {
             buffer = clCreateBuffer(ctx, CL_MEM_COPY_HOST_PTR, n*4, test_data, &status);
             if (status == CL_SUCCESS) {
@@ -1007,6 +1009,129 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   return ret;
 }
 
+/* The self-test verdicts are kept in OCL_SELF_TEST_FILE, by default a file in
+ * the home directory, one line per device, kernel and beignet version, so
+ * that only the first process runs the test. OCL_FORCE_SELF_TEST=1 runs it
+ * again and replaces the verdict. */
+static const char *
+self_test_file_path(void)
+{
+  static char path[1024];
+  // can't use SVAR (backend/src/sys/cvar.hpp) here as it's C++
+  const char *env = getenv("OCL_SELF_TEST_FILE");
+  const char *home = getenv("HOME");
+  if (env != NULL)
+    return env[0] ? env : NULL;
+  if (home == NULL)
+    return NULL;
+  snprintf(path, sizeof(path), "%s/.beignet_self_test", home);
+  return path;
+}
+
+/* Value of a parameter of the i915 module, which can make the test fail */
+static void
+i915_parameter(const char *name, char *value, size_t size)
+{
+  char path[128];
+  FILE *file;
+  snprintf(path, sizeof(path), "/sys/module/i915/parameters/%s", name);
+  value[0] = '\0';
+  if ((file = fopen(path, "r")) == NULL)
+    return;
+  if (fscanf(file, "%31s", value) != 1)
+    value[0] = '\0';
+  fclose(file);
+}
+
+static void
+self_test_key(cl_device_id device, char *key, size_t size)
+{
+  char ppgtt[32], cmd_parser[32];
+  struct utsname buf;
+  if (uname(&buf) != 0)
+    buf.release[0] = buf.version[0] = '\0';
+  i915_parameter("enable_ppgtt", ppgtt, sizeof(ppgtt));
+  i915_parameter("enable_cmd_parser", cmd_parser, sizeof(cmd_parser));
+  snprintf(key, size, "%x %s %s ppgtt=%s cmd_parser=%s beignet %s", device->device_id,
+           buf.release, buf.version, ppgtt, cmd_parser,
+           LIBCL_DRIVER_VERSION_STRING BEIGNET_GIT_SHA1_STRING);
+}
+
+/* Lines of "verdict atomic_verdict key", the last one of the key wins */
+static int
+self_test_load(cl_device_id device, cl_self_test_res *ret, cl_self_test_res *atomic_ret)
+{
+  const char *path = self_test_file_path();
+  char key[512], line[640], line_key[512];
+  int force = 0, found = 0, verdict, atomic_verdict;
+  FILE *file;
+
+  const char *env = getenv("OCL_FORCE_SELF_TEST");
+  if (env != NULL)
+    sscanf(env, "%i", &force);
+  if (force || path == NULL || (file = fopen(path, "r")) == NULL)
+    return 0;
+  self_test_key(device, key, sizeof(key));
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "%i %i %511[^\n]", &verdict, &atomic_verdict, line_key) != 3 ||
+        strcmp(line_key, key) != 0)
+      continue;
+    if ((verdict != SELF_TEST_PASS && verdict != SELF_TEST_SLM_FAIL) ||
+        (atomic_verdict != SELF_TEST_PASS && atomic_verdict != SELF_TEST_ATOMIC_FAIL))
+      continue;
+    *ret = verdict;
+    *atomic_ret = atomic_verdict;
+    found = 1;
+  }
+  fclose(file);
+  return found;
+}
+
+static void
+self_test_save(cl_device_id device, cl_self_test_res ret, cl_self_test_res atomic_ret)
+{
+  const char *path = self_test_file_path();
+  char key[512];
+  FILE *file;
+
+  /* The other failures, like a context that can't be created, are not
+     properties of the device */
+  if (ret != SELF_TEST_PASS && ret != SELF_TEST_SLM_FAIL)
+    return;
+  if (path == NULL || (file = fopen(path, "a")) == NULL)
+    return;
+  self_test_key(device, key, sizeof(key));
+  fprintf(file, "%i %i %s\n", ret, atomic_ret, key);
+  fclose(file);
+}
+
+/* Self-test verdict of the device, tested or loaded once per process */
+static cl_self_test_res
+cl_device_self_test(cl_device_id device)
+{
+  static int tested = 0;
+  static cl_self_test_res ret = SELF_TEST_OTHER_FAIL;
+  cl_self_test_res atomic_ret = SELF_TEST_PASS;
+
+  if (tested)
+    return ret;
+  tested = 1;
+  if (!self_test_load(device, &ret, &atomic_ret)) {
+    ret = cl_self_test(device, SELF_TEST_PASS);
+    if (ret == SELF_TEST_ATOMIC_FAIL) {
+      atomic_ret = ret;
+      device->atomic_test_result = ret;
+      ret = cl_self_test(device, ret);
+    }
+    self_test_save(device, ret, atomic_ret);
+  }
+  if (atomic_ret == SELF_TEST_ATOMIC_FAIL) {
+    device->atomic_test_result = atomic_ret;
+    printf("Beignet: warning - disable atomic in L3 feature.\n");
+  }
+  return ret;
+}
+
 LOCAL cl_int
 cl_get_device_ids(cl_platform_id    platform,
                   cl_device_type    device_type,
@@ -1019,12 +1144,7 @@ cl_get_device_ids(cl_platform_id    platform,
   /* Do we have a usable device? */
   device = cl_get_gt_device(device_type);
   if (device) {
-    cl_self_test_res ret = cl_self_test(device, SELF_TEST_PASS);
-    if (ret == SELF_TEST_ATOMIC_FAIL) {
-      device->atomic_test_result = ret;
-      ret = cl_self_test(device, ret);
-      printf("Beignet: warning - disable atomic in L3 feature.\n");
-    }
+    cl_self_test_res ret = cl_device_self_test(device);
 
     if(ret == SELF_TEST_SLM_FAIL) {
       int disable_self_test = 0;
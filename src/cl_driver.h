@@ -212,9 +212,13 @@ extern cl_gpgpu_state_init_cb *cl_gpgpu_state_init;
 typedef void (cl_gpgpu_set_perf_counters_cb)(cl_gpgpu, cl_buffer perf);
 extern cl_gpgpu_set_perf_counters_cb *cl_gpgpu_set_perf_counters;
 
-/* Fills current curbe buffer with data */
-typedef int (cl_gpgpu_upload_curbes_cb)(cl_gpgpu, const void* data, uint32_t size);
-extern cl_gpgpu_upload_curbes_cb *cl_gpgpu_upload_curbes;
+/* Map the curbe buffer to fill it in place, NULL on failure */
+typedef void* (cl_gpgpu_map_curbes_cb)(cl_gpgpu);
+extern cl_gpgpu_map_curbes_cb *cl_gpgpu_map_curbes;
+
+/* Relocate the buffer addresses of the filled curbes and unmap them */
+typedef void (cl_gpgpu_unmap_curbes_cb)(cl_gpgpu);
+extern cl_gpgpu_unmap_curbes_cb *cl_gpgpu_unmap_curbes;
 
 typedef cl_buffer (cl_gpgpu_alloc_constant_buffer_cb)(cl_gpgpu, uint32_t size, uint8_t bti);
 extern cl_gpgpu_alloc_constant_buffer_cb *cl_gpgpu_alloc_constant_buffer;
@@ -223,6 +227,11 @@ extern cl_gpgpu_alloc_constant_buffer_cb *cl_gpgpu_alloc_constant_buffer;
 typedef void (cl_gpgpu_states_setup_cb)(cl_gpgpu, cl_gpgpu_kernel *kernel);
 extern cl_gpgpu_states_setup_cb *cl_gpgpu_states_setup;
 
+/* Prepare the states of a previous launch to run the kernel again with the
+ * same bindings. Returns -1 if the previous launch is still running */
+typedef int (cl_gpgpu_state_reuse_cb)(cl_gpgpu, cl_gpgpu_kernel *kernel);
+extern cl_gpgpu_state_reuse_cb *cl_gpgpu_state_reuse;
+
 /* Upload the constant samplers as specified inside the OCL kernel */
 typedef void (cl_gpgpu_upload_samplers_cb)(cl_gpgpu *state, const void *data, uint32_t n);
 extern cl_gpgpu_upload_samplers_cb *cl_gpgpu_upload_samplers;
@@ -247,6 +256,13 @@ extern cl_gpgpu_batch_end_cb *cl_gpgpu_batch_end;
 typedef int (cl_gpgpu_flush_cb)(cl_gpgpu);
 extern cl_gpgpu_flush_cb *cl_gpgpu_flush;
 
+/* Run the batch of next right after the batch of the gpgpu, with a barrier
+ * between the two kernels. Flushing the gpgpu then submits both and flushing
+ * next only returns the result of that submission. Returns -1 if the batches
+ * can't be chained. NULL if the device does not support it */
+typedef int (cl_gpgpu_chain_cb)(cl_gpgpu, cl_gpgpu next);
+extern cl_gpgpu_chain_cb *cl_gpgpu_chain;
+
 /* new a event for a batch buffer */
 typedef cl_gpgpu_event (cl_gpgpu_event_new_cb)(cl_gpgpu);
 extern cl_gpgpu_event_new_cb *cl_gpgpu_event_new;
@@ -437,6 +453,10 @@ extern cl_buffer_get_fd_cb *cl_buffer_get_fd;
 typedef int (cl_buffer_get_tiling_align_cb)(cl_context ctx, uint32_t tiling_mode, uint32_t dim);
 extern cl_buffer_get_tiling_align_cb *cl_buffer_get_tiling_align;
 
+/* Get the bit 6 swizzling of a tiled buffer, a cl_bit6_swizzle_t */
+typedef int (cl_buffer_get_swizzle_cb)(cl_buffer);
+extern cl_buffer_get_swizzle_cb *cl_buffer_get_swizzle;
+
 typedef cl_buffer (cl_buffer_get_buffer_from_fd_cb)(cl_context ctx, int fd, int size);
 extern cl_buffer_get_buffer_from_fd_cb *cl_buffer_get_buffer_from_fd;
 
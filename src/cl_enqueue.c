@@ -22,9 +22,11 @@
 #include "cl_driver.h"
 #include "cl_event.h"
 #include "cl_command_queue.h"
+#include "cl_kernel.h"
 #include "cl_utils.h"
 #include "cl_alloc.h"
 #include "cl_device_enqueue.h"
+#include "cl_copy_engine.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -46,7 +48,7 @@ cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
   //and it is randomly. So temporary disable it, use map/copy/unmap to read.
   //Should re-enable it after find root cause.
   if (0 && !mem->is_userptr) {
-    if (cl_buffer_get_subdata(mem->bo, data->offset + buffer->sub_offset,
+    if (cl_buffer_get_subdata(mem->bo, mem->offset + data->offset + buffer->sub_offset,
                               data->size, data->ptr) != 0)
       err = CL_MAP_FAILURE;
   } else {
@@ -57,7 +59,8 @@ cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
       //sometimes, application invokes read buffer, instead of map buffer, even if userptr is enabled
       //memcpy is not necessary for this case
       if (data->ptr != (char *)src_ptr + data->offset + buffer->sub_offset)
-        memcpy(data->ptr, (char *)src_ptr + data->offset + buffer->sub_offset, data->size);
+        cl_copy_engine_copy(mem->ctx->copy_engine, data->ptr,
+                            (char *)src_ptr + data->offset + buffer->sub_offset, data->size, CL_FALSE);
       cl_mem_unmap_auto(mem);
     }
   }
@@ -97,20 +100,14 @@ cl_enqueue_read_buffer_rect(enqueue_data *data, cl_int status)
 
   if (data->row_pitch == region[0] && data->row_pitch == data->host_row_pitch &&
       (region[2] == 1 || (data->slice_pitch == region[0] * region[1] && data->slice_pitch == data->host_slice_pitch))) {
-    memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
+    cl_copy_engine_copy(mem->ctx->copy_engine, dst_ptr, src_ptr,
+                        region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2],
+                        CL_FALSE);
   } else {
-    cl_uint y, z;
-    for (z = 0; z < region[2]; z++) {
-      const char *src = src_ptr;
-      char *dst = dst_ptr;
-      for (y = 0; y < region[1]; y++) {
-        memcpy(dst, src, region[0]);
-        src += data->row_pitch;
-        dst += data->host_row_pitch;
-      }
-      src_ptr = (char *)src_ptr + data->slice_pitch;
-      dst_ptr = (char *)dst_ptr + data->host_slice_pitch;
-    }
+    cl_copy_engine_copy_rect(mem->ctx->copy_engine,
+                             dst_ptr, data->host_row_pitch, data->host_slice_pitch,
+                             src_ptr, data->row_pitch, data->slice_pitch,
+                             region[0], region[1], region[2], CL_FALSE);
   }
 
   err = cl_mem_unmap_auto(mem);
@@ -131,16 +128,19 @@ cl_enqueue_write_buffer(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
-  if (mem->is_userptr) {
+  /* The pwrite of cl_buffer_subdata copies on a single thread */
+  if (mem->is_userptr ||
+      (mem->ctx->copy_engine && data->size >= CL_COPY_ENGINE_THREADED_MIN)) {
     void *dst_ptr = cl_mem_map_auto(mem, 1);
     if (dst_ptr == NULL)
       err = CL_MAP_FAILURE;
     else {
-      memcpy((char *)dst_ptr + data->offset + buffer->sub_offset, data->const_ptr, data->size);
+      cl_copy_engine_copy(mem->ctx->copy_engine, (char *)dst_ptr + data->offset + buffer->sub_offset,
+                          data->const_ptr, data->size, mem->mapped_gtt);
       cl_mem_unmap_auto(mem);
     }
   } else {
-    if (cl_buffer_subdata(mem->bo, data->offset + buffer->sub_offset,
+    if (cl_buffer_subdata(mem->bo, mem->offset + data->offset + buffer->sub_offset,
                           data->size, data->const_ptr) != 0)
       err = CL_MAP_FAILURE;
   }
@@ -180,20 +180,14 @@ cl_enqueue_write_buffer_rect(enqueue_data *data, cl_int status)
 
   if (data->row_pitch == region[0] && data->row_pitch == data->host_row_pitch &&
       (region[2] == 1 || (data->slice_pitch == region[0] * region[1] && data->slice_pitch == data->host_slice_pitch))) {
-    memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
+    cl_copy_engine_copy(mem->ctx->copy_engine, dst_ptr, src_ptr,
+                        region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2],
+                        mem->mapped_gtt);
   } else {
-    cl_uint y, z;
-    for (z = 0; z < region[2]; z++) {
-      const char *src = src_ptr;
-      char *dst = dst_ptr;
-      for (y = 0; y < region[1]; y++) {
-        memcpy(dst, src, region[0]);
-        src += data->host_row_pitch;
-        dst += data->row_pitch;
-      }
-      src_ptr = (char *)src_ptr + data->host_slice_pitch;
-      dst_ptr = (char *)dst_ptr + data->slice_pitch;
-    }
+    cl_copy_engine_copy_rect(mem->ctx->copy_engine,
+                             dst_ptr, data->row_pitch, data->slice_pitch,
+                             src_ptr, data->host_row_pitch, data->host_slice_pitch,
+                             region[0], region[1], region[2], mem->mapped_gtt);
   }
 
   err = cl_mem_unmap_auto(mem);
@@ -216,6 +210,10 @@ cl_enqueue_read_image(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
+  if (cl_mem_image_tiled_copy(image, origin, region, data->ptr,
+                              data->row_pitch, data->slice_pitch, CL_FALSE))
+    return err;
+
   if (!(src_ptr = cl_mem_map_auto(mem, 0))) {
     err = CL_MAP_FAILURE;
     goto error;
@@ -261,6 +259,10 @@ cl_enqueue_write_image(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
+  if (cl_mem_image_tiled_copy(image, data->origin, data->region, (void *)data->const_ptr,
+                              data->row_pitch, data->slice_pitch, CL_TRUE))
+    return err;
+
   if (!(dst_ptr = cl_mem_map_auto(mem, 1))) {
     err = CL_MAP_FAILURE;
     goto error;
@@ -324,6 +326,14 @@ cl_enqueue_map_buffer(enqueue_data *data, cl_int status)
   return err;
 }
 
+/* Start of a region in the host memory of a CL_MEM_USE_HOST_PTR image */
+static void *
+cl_image_host_region(struct _cl_mem_image *image, const size_t *origin)
+{
+  return (char *)image->base.host_ptr + image->bpp * origin[0] +
+         image->host_row_pitch * origin[1] + image->host_slice_pitch * origin[2];
+}
+
 static cl_int
 cl_enqueue_map_image(enqueue_data *data, cl_int status)
 {
@@ -359,7 +369,10 @@ cl_enqueue_map_image(enqueue_data *data, cl_int status)
 
     if(mem->flags & CL_MEM_USE_HOST_PTR) {
       assert(mem->host_ptr);
-      if (!mem->is_userptr)
+      if (!mem->is_userptr &&
+          !cl_mem_image_tiled_copy(image, data->origin, data->region,
+                                   cl_image_host_region(image, data->origin),
+                                   image->host_row_pitch, image->host_slice_pitch, CL_FALSE))
         //src and dst need add offset in function cl_mem_copy_image_region
         cl_mem_copy_image_region(data->origin, data->region,
                                  mem->host_ptr, image->host_row_pitch, image->host_slice_pitch,
@@ -424,7 +437,9 @@ cl_enqueue_unmap_mem_object(enqueue_data *data, cl_int status)
         row_pitch = image->slice_pitch;
       else
         row_pitch = image->row_pitch;
-      if (!memobj->is_userptr)
+      if (!memobj->is_userptr &&
+          !cl_mem_image_tiled_copy(image, origin, region, cl_image_host_region(image, origin),
+                                   image->host_row_pitch, image->host_slice_pitch, CL_TRUE))
         //v_ptr have added offset, host_ptr have not added offset.
         cl_mem_copy_image_region(origin, region, v_ptr, row_pitch, image->slice_pitch,
                                  memobj->host_ptr, image->host_row_pitch, image->host_slice_pitch,
@@ -562,6 +577,18 @@ cl_int cl_enqueue_svm_mem_fill(enqueue_data *data, cl_int status) {
   return CL_SUCCESS;
 }
 
+static void
+cl_enqueue_release_mem_args(enqueue_data *data)
+{
+  cl_uint i;
+
+  for (i = 0; i < data->mem_arg_n; i++)
+    cl_mem_delete(data->mem_args[i]);
+  cl_free(data->mem_args);
+  data->mem_args = NULL;
+  data->mem_arg_n = 0;
+}
+
 static cl_int
 cl_enqueue_ndrange(enqueue_data *data, cl_int status)
 {
@@ -579,6 +606,7 @@ cl_enqueue_ndrange(enqueue_data *data, cl_int status)
     void *batch_buf = cl_gpgpu_ref_batch_buf(data->gpgpu);
     cl_gpgpu_sync(batch_buf);
     cl_gpgpu_unref_batch_buf(batch_buf);
+    cl_enqueue_release_mem_args(data);
   }
 
   return err;
@@ -604,6 +632,17 @@ cl_enqueue_delete(enqueue_data *data)
       data->type == EnqueueNDRangeKernel ||
       data->type == EnqueueFillBuffer ||
       data->type == EnqueueFillImage) {
+    /* Not run, or failed */
+    cl_enqueue_release_mem_args(data);
+    if (data->launch_state) {
+      /* Keep the states for the next NDRange of the same kernel */
+      cl_kernel_put_launch_state(data->kernel, data->launch_state);
+      cl_kernel_delete(data->kernel);
+      data->launch_state = NULL;
+      data->kernel = NULL;
+      data->gpgpu = NULL;
+      return;
+    }
     if (data->gpgpu) {
       cl_gpgpu_delete(data->gpgpu);
       data->gpgpu = NULL;
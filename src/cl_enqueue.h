@@ -78,6 +78,12 @@ typedef struct _enqueue_data {
                                  void *svm_pointers[],
                                  void *user_data);  /* pointer to pfn_free_func of clEnqueueSVMFree */
   cl_gpgpu gpgpu;
+  struct cl_launch_state *launch_state; /* Owns gpgpu when it can launch kernel again */
+  cl_kernel kernel;          /* Kernel of the NDRange, retained with launch_state */
+  struct cl_tuning_entry *tuning; /* Local size tuning measured by the NDRange */
+  cl_int tuning_candidate;   /* Local size measured among the candidates of tuning */
+  cl_mem *mem_args;          /* Memory arguments of the NDRange, held until it completes */
+  cl_uint mem_arg_n;
   cl_bool mid_event_of_enq;  /* For non-uniform ndrange, one enqueue have a sequence event, the
                                 last event need to parse device enqueue information.
                                 0 : last event; 1: non-last event */
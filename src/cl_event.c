@@ -20,6 +20,7 @@
 #include "cl_context.h"
 #include "cl_command_queue.h"
 #include "cl_alloc.h"
+#include "cl_local_size_tuner.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -122,6 +123,10 @@ cl_event_update_timestamp(cl_event event, cl_int state)
         event->timestamp[i] = event->timestamp[i - 1] + ts[i - 1];
       }
     }
+
+    if (event->exec_data.type == EnqueueNDRangeKernel && event->exec_data.tuning)
+      cl_local_size_tuning_report(event->exec_data.tuning, event->exec_data.tuning_candidate,
+                                  event->timestamp[3] - event->timestamp[2]);
   }
 }
 
@@ -149,9 +154,20 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
              cl_uint num_events, cl_event *event_list)
 {
   int i;
-  cl_event e = cl_calloc(1, sizeof(_cl_event));
-  if (e == NULL)
+  _cl_event_dependent *depend_nodes = NULL;
+  cl_event e;
+
+  if (num_events) {
+    depend_nodes = cl_calloc(num_events, sizeof(_cl_event_dependent));
+    if (depend_nodes == NULL)
+      return NULL;
+  }
+
+  e = cl_calloc(1, sizeof(_cl_event));
+  if (e == NULL) {
+    cl_free(depend_nodes);
     return NULL;
+  }
 
   CL_OBJECT_INIT_BASE(e, CL_OBJECT_EVENT_MAGIC);
 
@@ -160,7 +176,9 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
   e->queue = queue;
 
   list_init(&e->callbacks);
+  list_init(&e->dependents);
   list_node_init(&e->enqueue_node);
+  list_node_init(&e->ready_node);
 
   assert(type >= CL_COMMAND_NDRANGE_KERNEL && type <= CL_COMMAND_SVM_UNMAP);
   e->event_type = type;
@@ -176,6 +194,11 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
 
   e->depend_events = event_list;
   e->depend_event_num = num_events;
+  e->depend_nodes = depend_nodes;
+  for (i = 0; i < num_events; i++) {
+    list_node_init(&depend_nodes[i].node);
+    depend_nodes[i].event = e;
+  }
   for (i = 0; i < 4; i++) {
     e->timestamp[i] = CL_EVENT_INVALID_TIMESTAMP;
   }
@@ -187,11 +210,14 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
 LOCAL void
 cl_event_delete_depslist(cl_event event)
 {
+  cl_event_remove_dependents(event);
   CL_OBJECT_LOCK(event);
   cl_event *old_depend_events = event->depend_events;
+  _cl_event_dependent *old_depend_nodes = event->depend_nodes;
   int depend_count = event->depend_event_num;
   event->depend_event_num = 0;
   event->depend_events = NULL;
+  event->depend_nodes = NULL;
   CL_OBJECT_UNLOCK(event);
   if (old_depend_events) {
     assert(depend_count);
@@ -200,6 +226,69 @@ cl_event_delete_depslist(cl_event event)
     }
     cl_free(old_depend_events);
   }
+  cl_free(old_depend_nodes);
+}
+
+LOCAL cl_uint
+cl_event_add_dependents(cl_event event)
+{
+  cl_uint i;
+  cl_uint pending = 0;
+  cl_event dep;
+
+  for (i = 0; i < event->depend_event_num; i++) {
+    dep = event->depend_events[i];
+    CL_OBJECT_LOCK(dep);
+    /* A depend event completing after this is seen will count it down. */
+    if (dep->status > CL_COMPLETE) {
+      assert(list_node_out_of_list(&event->depend_nodes[i].node));
+      list_add_tail(&dep->dependents, &event->depend_nodes[i].node);
+      pending++;
+    }
+    CL_OBJECT_UNLOCK(dep);
+  }
+
+  return pending;
+}
+
+LOCAL void
+cl_event_remove_dependents(cl_event event)
+{
+  cl_uint i;
+  cl_event dep;
+
+  for (i = 0; i < event->depend_event_num; i++) {
+    dep = event->depend_events[i];
+    CL_OBJECT_LOCK(dep);
+    if (!list_node_out_of_list(&event->depend_nodes[i].node))
+      list_node_del(&event->depend_nodes[i].node);
+    CL_OBJECT_UNLOCK(dep);
+  }
+}
+
+/* Count down the enqueued events waiting for this one, which just completed */
+static void
+cl_event_complete_dependents(cl_event event)
+{
+  list_head tmp_dependents;
+  list_node *pos;
+  list_node *n;
+  _cl_event_dependent *dependent;
+  cl_event e;
+
+  CL_OBJECT_LOCK(event);
+  list_init(&tmp_dependents);
+  list_move(&event->dependents, &tmp_dependents);
+  CL_OBJECT_UNLOCK(event);
+
+  list_for_each_safe(pos, n, &tmp_dependents)
+  {
+    dependent = list_entry(pos, _cl_event_dependent, node);
+    e = dependent->event;
+    /* e may run and be deleted as soon as it is counted down */
+    list_node_del(&dependent->node);
+    cl_command_queue_depend_complete(e->queue, e);
+  }
 }
 
 LOCAL void
@@ -439,34 +528,17 @@ cl_event_set_status(cl_event event, cl_int status)
 
   CL_OBJECT_UNLOCK(event);
 
-  /* Need to notify all the command queue within the same context. */
+  /* Need to notify the command queues of the events waiting for this one. */
   if (notify_queue) {
-    cl_command_queue queue = NULL;
-
     /*First, we need to remove it from queue's barrier list. */
     if (CL_EVENT_IS_BARRIER(event)) {
       assert(event->queue);
       cl_command_queue_remove_barrier_event(event->queue, event);
     }
 
-    /* Then, notify all the queues within the same context. */
-    CL_OBJECT_LOCK(event->ctx);
-    /* Disable remove and add queue to the context temporary. We need to
-       make sure all the queues in the context currently are valid. */
-    event->ctx->queue_modify_disable++;
-    CL_OBJECT_UNLOCK(event->ctx);
-    list_for_each(pos, &event->ctx->queues)
-    {
-      queue = (cl_command_queue)(list_entry(pos, _cl_base_object, node));
-      assert(queue != NULL);
-      cl_command_queue_notify(queue);
-    }
-    CL_OBJECT_LOCK(event->ctx);
-    /* Disable remove and add queue to the context temporary. We need to
-       make sure all the queues in the context currently are valid. */
-    event->ctx->queue_modify_disable--;
-    CL_OBJECT_NOTIFY_COND(event->ctx);
-    CL_OBJECT_UNLOCK(event->ctx);
+    /* Then, count down the dependents, their queues only wake up when one
+       of them becomes ready. */
+    cl_event_complete_dependents(event);
   }
 
   return CL_SUCCESS;
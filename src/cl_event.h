@@ -37,6 +37,11 @@ typedef struct _cl_event_user_callback {
 
 typedef _cl_event_user_callback *cl_event_user_callback;
 
+typedef struct _cl_event_dependent {
+  list_node node;                /* In the dependents of the depend event */
+  cl_event event;                /* The event waiting for it */
+} _cl_event_dependent;
+
 typedef struct _cl_event {
   _cl_base_object base;
   cl_context ctx;             /* The context associated with event */
@@ -46,6 +51,10 @@ typedef struct _cl_event {
   cl_int status;              /* The execution status */
   cl_event *depend_events;    /* The events must complete before this. May disappear after they have completed - see cl_event_delete_depslist*/
   cl_uint depend_event_num;   /* The depend events number. */
+  _cl_event_dependent *depend_nodes; /* Nodes of this event in the dependents of each depend event */
+  cl_uint depend_pending;     /* Depend events not complete yet, under the lock of the queue */
+  list_head dependents;       /* The enqueued events waiting for this one to complete */
+  list_node ready_node;       /* The node in the ready list of an out of order queue. */
   list_head callbacks;        /* The events The event callback functions */
   list_node enqueue_node;     /* The node in the enqueue list. */
   cl_ulong timestamp[5];      /* The time stamps for profiling. */
@@ -73,6 +82,11 @@ extern cl_int cl_event_check_waitlist(cl_uint num_events_in_wait_list, const cl_
 extern cl_uint cl_event_exec(cl_event event, cl_int exec_to_status, cl_bool ignore_depends);
 /* 0 means ready, >0 means not ready, <0 means error. */
 extern cl_int cl_event_is_ready(cl_event event);
+/* Add the event to the dependents of its depend events which are not complete,
+   and return their number. Called once, with the lock of its queue. */
+extern cl_uint cl_event_add_dependents(cl_event event);
+/* Remove the event from the dependents of its depend events */
+extern void cl_event_remove_dependents(cl_event event);
 extern cl_int cl_event_get_status(cl_event event);
 extern void cl_event_add_ref(cl_event event);
 extern void cl_event_delete(cl_event event);
@@ -79,6 +79,8 @@ gbe_release_printf_info_cb* interp_release_printf_info = NULL;
 gbe_output_printf_cb* interp_output_printf = NULL;
 gbe_kernel_get_arg_info_cb *interp_kernel_get_arg_info = NULL;
 gbe_kernel_use_device_enqueue_cb *interp_kernel_use_device_enqueue = NULL;
+gbe_kernel_has_partial_group_guard_cb *interp_kernel_has_partial_group_guard = NULL;
+gbe_kernel_use_barrier_cb *interp_kernel_use_barrier = NULL;
 
 struct GbeLoaderInitializer
 {
@@ -276,6 +278,14 @@ struct GbeLoaderInitializer
     if (interp_kernel_use_device_enqueue == NULL)
       return false;
 
+    interp_kernel_has_partial_group_guard = *(gbe_kernel_has_partial_group_guard_cb**)dlsym(dlhInterp, "gbe_kernel_has_partial_group_guard");
+    if (interp_kernel_has_partial_group_guard == NULL)
+      return false;
+
+    interp_kernel_use_barrier = *(gbe_kernel_use_barrier_cb**)dlsym(dlhInterp, "gbe_kernel_use_barrier");
+    if (interp_kernel_use_barrier == NULL)
+      return false;
+
     return true;
   }
 
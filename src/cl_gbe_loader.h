@@ -79,6 +79,8 @@ extern gbe_release_printf_info_cb* interp_release_printf_info;
 extern gbe_output_printf_cb* interp_output_printf;
 extern gbe_kernel_get_arg_info_cb *interp_kernel_get_arg_info;
 extern gbe_kernel_use_device_enqueue_cb * interp_kernel_use_device_enqueue;
+extern gbe_kernel_has_partial_group_guard_cb * interp_kernel_has_partial_group_guard;
+extern gbe_kernel_use_barrier_cb * interp_kernel_use_barrier;
 
 int CompilerSupported();
 #ifdef __cplusplus
@@ -0,0 +1,179 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Host copies of tiled images through a CPU mapping of the bo instead of the
+ * uncached GTT aperture, where a fence does the tiling. The copies work in
+ * the linear space the fence exposes: a byte at linear offset y * pitch + x
+ * is in the tile (y / tile_h, x / tile_w).
+ *
+ * A X tile is made of rows of tile_w contiguous bytes. A Y tile is made of
+ * columns of 16 bytes wide owords, tile_h rows high, so that the copies are
+ * done one band of rows at a time, tile after tile, and one oword column for
+ * all the rows of the band with 16 bytes SSE moves. The swizzling XORs bit 9,
+ * or bits 9 and 10, of the address into bit 6.
+ */
+
+#include "cl_image_tiling.h"
+#include "cl_utils.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+
+LOCAL cl_bool
+cl_image_cpu_tiling_enabled(void)
+{
+  static int enabled = -1;
+  if (enabled < 0) {
+    int value = 1;
+    // can't use BVAR (backend/src/sys/cvar.hpp) here as it's C++
+    const char *env = getenv("OCL_CPU_TILING");
+    if (env != NULL)
+      sscanf(env, "%i", &value);
+    enabled = value;
+  }
+  return enabled != 0;
+}
+
+static INLINE size_t
+swizzle_address(cl_bit6_swizzle_t swizzle, size_t addr)
+{
+  switch (swizzle) {
+    case CL_SWIZZLE_9: return addr ^ (((addr >> 9) & 1) << 6);
+    case CL_SWIZZLE_9_10: return addr ^ ((((addr >> 9) ^ (addr >> 10)) & 1) << 6);
+    default: return addr;
+  }
+}
+
+static INLINE void
+copy_bytes(char *tiled, char *host, size_t n, int to_tiled)
+{
+  if (to_tiled)
+    memcpy(tiled, host, n);
+  else
+    memcpy(host, tiled, n);
+}
+
+/* rows rows of the same X tile row, from x to x + n */
+static void
+tiled_x_band(const cl_tiled_surface *surf, size_t y, size_t x, size_t n, size_t rows,
+             char *host, size_t host_row_pitch, int to_tiled)
+{
+  const size_t tile_sz = surf->tile_w * surf->tile_h;
+  const size_t row_base = (y / surf->tile_h) * (surf->pitch / surf->tile_w) * tile_sz;
+  const size_t y_in = y % surf->tile_h;
+  /* With swizzling, 64 bytes blocks are contiguous */
+  const size_t block = surf->swizzle == CL_SWIZZLE_NONE ? surf->tile_w : 64;
+  size_t r;
+
+  while (n > 0) {
+    const size_t tile = row_base + (x / surf->tile_w) * tile_sz;
+    const size_t x_in = x % surf->tile_w;
+    const size_t chunk = MIN(n, block - x_in % block);
+    for (r = 0; r < rows; r++) {
+      const size_t addr = swizzle_address(surf->swizzle, tile + (y_in + r) * surf->tile_w + x_in);
+      copy_bytes(surf->base + addr, host + r * host_row_pitch, chunk, to_tiled);
+    }
+    host += chunk;
+    x += chunk;
+    n -= chunk;
+  }
+}
+
+/* rows rows of the same Y tile row, from x to x + n */
+static void
+tiled_y_band(const cl_tiled_surface *surf, size_t y, size_t x, size_t n, size_t rows,
+             char *host, size_t host_row_pitch, int to_tiled)
+{
+  const size_t tile_sz = surf->tile_w * surf->tile_h;
+  const size_t column_sz = 16 * surf->tile_h;
+  const size_t row_base = (y / surf->tile_h) * (surf->pitch / surf->tile_w) * tile_sz;
+  const size_t y_in = y % surf->tile_h;
+  size_t r;
+
+  while (n > 0) {
+    const size_t x_in = x % surf->tile_w;
+    const size_t column = row_base + (x / surf->tile_w) * tile_sz + (x_in / 16) * column_sz;
+    const size_t chunk = MIN(n, 16 - x % 16);
+    /* Bits 9 and 10 are the same for the whole column */
+    const size_t swizzle = swizzle_address(surf->swizzle, column) ^ column;
+    char *tiled = surf->base + column + x % 16;
+
+    if (chunk == 16 && to_tiled) {
+      for (r = 0; r < rows; r++)
+        _mm_storeu_si128((__m128i *)(tiled + (((y_in + r) * 16) ^ swizzle)),
+                         _mm_loadu_si128((const __m128i *)(host + r * host_row_pitch)));
+    } else if (chunk == 16) {
+      for (r = 0; r < rows; r++)
+        _mm_storeu_si128((__m128i *)(host + r * host_row_pitch),
+                         _mm_loadu_si128((const __m128i *)(tiled + (((y_in + r) * 16) ^ swizzle))));
+    } else {
+      for (r = 0; r < rows; r++)
+        copy_bytes(tiled + (((y_in + r) * 16) ^ swizzle), host + r * host_row_pitch, chunk, to_tiled);
+    }
+    host += chunk;
+    x += chunk;
+    n -= chunk;
+  }
+}
+
+static void
+tiled_copy(const cl_tiled_surface *surf, size_t offset,
+           size_t row_bytes, size_t rows, size_t slices, size_t slice_pitch,
+           char *host, size_t host_row_pitch, size_t host_slice_pitch, int to_tiled)
+{
+  size_t z, r, band;
+
+  assert(surf->tiling == CL_TILE_X || surf->tiling == CL_TILE_Y);
+  assert(surf->pitch % surf->tile_w == 0 && slice_pitch % surf->pitch == 0);
+  assert(surf->tiling == CL_TILE_X || surf->swizzle == CL_SWIZZLE_NONE || surf->tile_h % 32 == 0);
+  for (z = 0; z < slices; z++) {
+    const size_t y = (offset + z * slice_pitch) / surf->pitch;
+    const size_t x = (offset + z * slice_pitch) % surf->pitch;
+    char *host_slice = host + z * host_slice_pitch;
+    assert(x + row_bytes <= surf->pitch);
+    /* The rows up to the end of each tile row at once */
+    for (r = 0; r < rows; r += band) {
+      band = MIN(rows - r, surf->tile_h - (y + r) % surf->tile_h);
+      if (surf->tiling == CL_TILE_X)
+        tiled_x_band(surf, y + r, x, row_bytes, band,
+                     host_slice + r * host_row_pitch, host_row_pitch, to_tiled);
+      else
+        tiled_y_band(surf, y + r, x, row_bytes, band,
+                     host_slice + r * host_row_pitch, host_row_pitch, to_tiled);
+    }
+  }
+}
+
+LOCAL void
+cl_tiled_write(const cl_tiled_surface *surf, size_t offset,
+               size_t row_bytes, size_t rows, size_t slices, size_t slice_pitch,
+               const void *host, size_t host_row_pitch, size_t host_slice_pitch)
+{
+  tiled_copy(surf, offset, row_bytes, rows, slices, slice_pitch,
+             (char *)host, host_row_pitch, host_slice_pitch, 1);
+}
+
+LOCAL void
+cl_tiled_read(const cl_tiled_surface *surf, size_t offset,
+              size_t row_bytes, size_t rows, size_t slices, size_t slice_pitch,
+              void *host, size_t host_row_pitch, size_t host_slice_pitch)
+{
+  tiled_copy(surf, offset, row_bytes, rows, slices, slice_pitch,
+             (char *)host, host_row_pitch, host_slice_pitch, 0);
+}
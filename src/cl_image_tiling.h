@@ -0,0 +1,49 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_IMAGE_TILING_H__
+#define __CL_IMAGE_TILING_H__
+
+#include "cl_mem.h"
+
+/* A tiled bo mapped linearly by the CPU */
+typedef struct cl_tiled_surface {
+  char *base;                   /* CPU mapping of the bo */
+  size_t pitch;                 /* Row pitch, a multiple of the tile width */
+  uint32_t tile_w;              /* Tile width in bytes */
+  uint32_t tile_h;              /* Tile height in rows */
+  cl_image_tiling_t tiling;     /* CL_TILE_X or CL_TILE_Y */
+  cl_bit6_swizzle_t swizzle;    /* Bit 6 swizzling of the addresses */
+} cl_tiled_surface;
+
+/* True unless OCL_CPU_TILING is 0 */
+extern cl_bool cl_image_cpu_tiling_enabled(void);
+
+/* Copy rows of row_bytes bytes from the host into the surface. offset is the
+ * linear offset of the first byte, as seen through a fence, and slice_pitch
+ * the distance of two slices in the same linear space */
+extern void cl_tiled_write(const cl_tiled_surface *surf, size_t offset,
+                           size_t row_bytes, size_t rows, size_t slices, size_t slice_pitch,
+                           const void *host, size_t host_row_pitch, size_t host_slice_pitch);
+
+/* Same from the surface to the host */
+extern void cl_tiled_read(const cl_tiled_surface *surf, size_t offset,
+                          size_t row_bytes, size_t rows, size_t slices, size_t slice_pitch,
+                          void *host, size_t host_row_pitch, size_t host_slice_pitch);
+
+#endif /* __CL_IMAGE_TILING_H__ */
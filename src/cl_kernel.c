@@ -29,6 +29,7 @@
 #include "cl_sampler.h"
 #include "cl_accelerator_intel.h"
 #include "cl_cmrt.h"
+#include "cl_local_size_tuner.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -78,6 +79,10 @@ cl_kernel_delete(cl_kernel k)
     cl_mem_svm_delete(k->program->ctx, k->device_enqueue_ptr);
   if (k->device_enqueue_infos)
     cl_free(k->device_enqueue_infos);
+  if (k->launch_state)
+    cl_launch_state_delete(k->launch_state);
+  if (k->payload)
+    cl_free(k->payload);
 
   CL_OBJECT_DESTROY_BASE(k);
 
@@ -121,6 +126,84 @@ cl_kernel_add_ref(cl_kernel k)
   CL_OBJECT_INC_REF(k);
 }
 
+LOCAL cl_launch_state *
+cl_launch_state_new(cl_gpgpu gpgpu, const uintptr_t *sig, uint32_t sig_n)
+{
+  cl_launch_state *state = NULL;
+
+  TRY_ALLOC_NO_ERR (state, cl_malloc(sizeof(cl_launch_state) + sig_n * sizeof(uintptr_t)));
+  state->gpgpu = gpgpu;
+  state->arg_epoch = 0;
+  state->sig_n = sig_n;
+  memcpy(state->sig, sig, sig_n * sizeof(uintptr_t));
+error:
+  return state;
+}
+
+LOCAL void
+cl_launch_state_delete(cl_launch_state *state)
+{
+  if (state == NULL)
+    return;
+  cl_gpgpu_delete(state->gpgpu);
+  cl_free(state);
+}
+
+LOCAL cl_launch_state *
+cl_kernel_take_launch_state(cl_kernel k, const uintptr_t *sig, uint32_t sig_n)
+{
+  cl_launch_state *state = NULL;
+
+  CL_OBJECT_LOCK(k);
+  if (k->launch_state && k->launch_state->sig_n == sig_n &&
+      memcmp(k->launch_state->sig, sig, sig_n * sizeof(uintptr_t)) == 0) {
+    state = k->launch_state;
+    k->launch_state = NULL;
+  }
+  CL_OBJECT_UNLOCK(k);
+  return state;
+}
+
+LOCAL void
+cl_kernel_put_launch_state(cl_kernel k, cl_launch_state *state)
+{
+  cl_launch_state *old = state;
+
+  CL_OBJECT_LOCK(k);
+  /* Not kept if it references the bos of replaced arguments */
+  if (state->arg_epoch == k->arg_epoch) {
+    old = k->launch_state;
+    k->launch_state = state;
+  }
+  CL_OBJECT_UNLOCK(k);
+  cl_launch_state_delete(old);
+}
+
+/* The relocations of the cached launch state reference the bos of the
+ * arguments, so it is dropped with the memory objects they no longer use */
+static void
+cl_kernel_set_arg_mem(cl_kernel k, cl_uint index, cl_mem mem)
+{
+  cl_mem old = k->args[index].mem;
+  cl_launch_state *state;
+
+  if (old == mem)
+    return;
+  if (mem)
+    cl_mem_add_ref(mem);
+  k->args[index].mem = mem;
+  if (old == NULL)
+    return;
+
+  CL_OBJECT_LOCK(k);
+  k->arg_epoch++;
+  state = k->launch_state;
+  k->launch_state = NULL;
+  CL_OBJECT_UNLOCK(k);
+  cl_launch_state_delete(state);
+  cl_mem_delete(old);
+}
+
 LOCAL cl_int
 cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
 {
@@ -254,9 +337,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
       *((uint32_t *)(k->curbe + offset)) = 0;
     assert(arg_type == GBE_ARG_GLOBAL_PTR || arg_type == GBE_ARG_CONSTANT_PTR);
 
-    if (k->args[index].mem)
-      cl_mem_delete(k->args[index].mem);
-    k->args[index].mem = NULL;
+    cl_kernel_set_arg_mem(k, index, NULL);
     k->args[index].is_set = 1;
     k->args[index].local_sz = 0;
     return CL_SUCCESS;
@@ -264,10 +345,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
 
   mem = *(cl_mem*) value;
 
-  cl_mem_add_ref(mem);
-  if (k->args[index].mem)
-    cl_mem_delete(k->args[index].mem);
-  k->args[index].mem = mem;
+  cl_kernel_set_arg_mem(k, index, mem);
   k->args[index].is_set = 1;
   k->args[index].is_svm = mem->is_svm;
   if(mem->is_svm)
@@ -297,12 +375,8 @@ cl_kernel_set_arg_svm_pointer(cl_kernel k, cl_uint index, const void *value)
   if(mem == NULL)
     return CL_INVALID_ARG_VALUE;
 
-  cl_mem_add_ref(mem);
-  if (k->args[index].mem)
-    cl_mem_delete(k->args[index].mem);
-
+  cl_kernel_set_arg_mem(k, index, mem);
   k->args[index].ptr = (void *)value;
-  k->args[index].mem = mem;
   k->args[index].is_set = 1;
   k->args[index].is_svm = 1;
   k->args[index].local_sz = 0;
@@ -439,6 +513,8 @@ cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
   /* Upload the code */
   cl_buffer_subdata(k->bo, 0, code_sz, code);
   k->opaque = opaque;
+  if (cl_local_size_tuning_enabled())
+    k->code_hash = cl_local_size_tuning_hash(code, code_sz);
 
   const char* kname = cl_kernel_get_name(k);
   if (kname != NULL &&
@@ -492,6 +568,7 @@ cl_kernel_dup(cl_kernel from)
   to->exec_info_n = from->exec_info_n;
   memcpy(to->compile_wg_sz, from->compile_wg_sz, sizeof(from->compile_wg_sz));
   to->stack_size = from->stack_size;
+  to->code_hash = from->code_hash;
   if (to->sampler_sz)
     memcpy(to->samplers, from->samplers, to->sampler_sz * sizeof(uint32_t));
   if (to->image_sz) {
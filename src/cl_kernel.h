@@ -47,6 +47,26 @@ typedef struct cl_argument {
   uint32_t is_svm:1;    /* Indicate this argument is SVMPointer */
 } cl_argument;
 
+/* GPGPU state of a finished NDRange, kept to launch the kernel again with the
+ * same bindings without rebuilding the surface, sampler and IDRT states
+ */
+typedef struct cl_launch_state {
+  cl_gpgpu gpgpu;       /* Owned by the launch state */
+  uint32_t arg_epoch;   /* arg_epoch of the kernel when it was launched */
+  uint32_t sig_n;       /* Number of words in sig */
+  uintptr_t sig[];      /* Everything the states were built from */
+} cl_launch_state;
+
+/* Local IDs, block IPs and thread ID of every thread of a work group, as they
+ * are written in the curbe, for the last local size the kernel was run with
+ */
+typedef struct cl_varying_payload {
+  size_t local_wk_sz[3];
+  uint32_t thread_n;
+  uint32_t thread_sz;   /* Bytes of data per thread */
+  char data[];
+} cl_varying_payload;
+
 /* One OCL function */
 struct _cl_kernel {
   _cl_base_object base;
@@ -78,6 +98,10 @@ struct _cl_kernel {
   void* device_enqueue_ptr;     /* device_enqueue buffer*/
   uint32_t device_enqueue_info_n; /* count of parent kernel's arguments buffers, as child enqueues' exec info */
   void** device_enqueue_infos;   /* parent kernel's arguments buffers, as child enqueues' exec info   */
+  cl_launch_state *launch_state; /* Idle state of the last NDRange, to launch the kernel again */
+  uint32_t arg_epoch;            /* Incremented when an argument drops its memory object */
+  cl_varying_payload *payload;   /* Varying curbe data of the last work group size */
+  uint64_t code_hash;            /* Hash of the Gen code, 0 if the local sizes are not tuned */
 };
 
 #define CL_OBJECT_KERNEL_MAGIC 0x1234567890abedefLL
@@ -129,6 +153,20 @@ extern int cl_get_kernel_arg_info(cl_kernel k, cl_uint arg_index,
                                   size_t param_value_size, void *param_value,
                                   size_t *param_value_size_ret);
 
+/* Create a launch state owning the gpgpu for the given signature */
+extern cl_launch_state *cl_launch_state_new(cl_gpgpu gpgpu, const uintptr_t *sig, uint32_t sig_n);
+
+/* Destroy the launch state and its gpgpu */
+extern void cl_launch_state_delete(cl_launch_state *state);
+
+/* Get the idle launch state of the kernel if it was built with the same
+ * signature. The caller owns it, NULL if there is none
+ */
+extern cl_launch_state *cl_kernel_take_launch_state(cl_kernel k, const uintptr_t *sig, uint32_t sig_n);
+
+/* Give back an idle launch state to the kernel. It replaces the previous one */
+extern void cl_kernel_put_launch_state(cl_kernel k, cl_launch_state *state);
+
 /* Compute and check the work group size from the user provided local size */
 extern cl_int
 cl_kernel_work_group_sz(cl_kernel ker,
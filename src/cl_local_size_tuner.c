@@ -0,0 +1,423 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Local size of the NDRanges enqueued without one. A model gives a first guess
+ * from the kernel attributes and the few next best local sizes. On profiling
+ * queues, every candidate is then run a few times and the fastest one is kept.
+ * The results are keyed by the Gen code of the kernel, its use of barriers and
+ * local memory and the class of global size (log2 of every dimension). They
+ * are kept by the context and appended to a file read by the next contexts,
+ * which start with the tuned local sizes.
+ */
+
+#include "cl_local_size_tuner.h"
+#include "cl_kernel.h"
+#include "cl_program.h"
+#include "cl_context.h"
+#include "cl_device_id.h"
+#include "cl_command_queue.h"
+#include "cl_gbe_loader.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TUNING_MAX_CANDIDATES 6
+#define TUNING_RUNS           3    /* Launches per candidate, the fastest one counts */
+#define TUNING_MAX_DIVISORS   128
+
+struct cl_tuning_entry {
+  uint64_t key;                 /* Hash of the Gen code, SLM use, work dim and global size class */
+  size_t local_wk_sz[3];        /* Tuned local size, or the best one so far */
+  cl_bool tuned;                /* All the candidates are measured */
+  size_t global_wk_sz[3];       /* Global size the candidates are measured with */
+  cl_int candidate_n;
+  size_t candidates[TUNING_MAX_CANDIDATES][3];
+  uint32_t started[TUNING_MAX_CANDIDATES];
+  uint32_t measured[TUNING_MAX_CANDIDATES];
+  cl_ulong best_ns[TUNING_MAX_CANDIDATES];
+  struct cl_tuning_entry *next;
+};
+
+static pthread_mutex_t tuning_lock = PTHREAD_MUTEX_INITIALIZER;
+
+LOCAL cl_bool
+cl_local_size_tuning_enabled(void)
+{
+  static int enabled = -1;
+  if (enabled < 0) {
+    int value = 0;
+    // can't use BVAR (backend/src/sys/cvar.hpp) here as it's C++
+    const char *env = getenv("OCL_TUNE_LOCAL_SIZE");
+    if (env != NULL)
+      sscanf(env, "%i", &value);
+    enabled = value;
+  }
+  return enabled != 0;
+}
+
+/* OCL_TUNE_LOCAL_SIZE_FILE, or a file in the home directory */
+static const char *
+tuning_file_path(void)
+{
+  static char path[1024];
+  static int initialized = 0;
+  if (!initialized) {
+    const char *env = getenv("OCL_TUNE_LOCAL_SIZE_FILE");
+    const char *home = getenv("HOME");
+    path[0] = '\0';
+    if (env != NULL)
+      snprintf(path, sizeof(path), "%s", env);
+    else if (home != NULL)
+      snprintf(path, sizeof(path), "%s/.beignet_local_size", home);
+    initialized = 1;
+  }
+  return path[0] ? path : NULL;
+}
+
+static uint64_t
+hash_bytes(uint64_t h, const void *data, size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  size_t i;
+  for (i = 0; i < size; i++) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static uint32_t
+size_class(size_t size)
+{
+  uint32_t c = 0;
+  while (size >>= 1)
+    c++;
+  return c;
+}
+
+LOCAL uint64_t
+cl_local_size_tuning_hash(const char *code, size_t code_sz)
+{
+  const uint64_t h = hash_bytes(0xcbf29ce484222325ULL, code, code_sz);
+  return h ? h : 1;
+}
+
+/* Local memory of the kernel and of its __local arguments */
+static size_t
+kernel_slm_size(cl_kernel ker)
+{
+  size_t slm_sz = interp_kernel_get_slm_size(ker->opaque);
+  cl_uint i;
+  for (i = 0; i < ker->arg_n; i++)
+    if (interp_kernel_get_arg_type(ker->opaque, i) == GBE_ARG_LOCAL_PTR)
+      slm_sz += ker->args[i].local_sz;
+  return slm_sz;
+}
+
+static uint64_t
+tuning_key(cl_kernel ker, cl_uint work_dim, const size_t *global_wk_sz)
+{
+  uint32_t classes[6] = {work_dim, 0, 0, 0, 0, 0};
+  cl_uint i;
+
+  assert(ker->code_hash != 0);
+  for (i = 0; i < work_dim; i++)
+    classes[i + 1] = size_class(global_wk_sz[i]);
+  /* The same code launched with more local memory fits fewer groups per subslice */
+  classes[4] = (interp_kernel_use_barrier(ker->opaque) ? 1 : 0) |
+               (interp_kernel_use_slm(ker->opaque) ? 2 : 0);
+  classes[5] = size_class(kernel_slm_size(ker));
+  return hash_bytes(ker->code_hash, classes, sizeof(classes));
+}
+
+static struct cl_tuning_entry *
+find_entry(cl_context ctx, uint64_t key)
+{
+  struct cl_tuning_entry *e;
+  for (e = ctx->tuning_entries; e != NULL; e = e->next)
+    if (e->key == key)
+      return e;
+  return NULL;
+}
+
+static struct cl_tuning_entry *
+add_entry(cl_context ctx, uint64_t key)
+{
+  struct cl_tuning_entry *e = cl_calloc(1, sizeof(struct cl_tuning_entry));
+  if (e == NULL)
+    return NULL;
+  e->key = key;
+  e->next = ctx->tuning_entries;
+  ctx->tuning_entries = e;
+  return e;
+}
+
+/* Lines of "key local_x local_y local_z", the last one of a key wins */
+static void
+load_tuning_file(cl_context ctx)
+{
+  const char *path = tuning_file_path();
+  unsigned long long key;
+  size_t local[3];
+  char line[256];
+  FILE *file;
+
+  ctx->tuning_file_loaded = CL_TRUE;
+  if (path == NULL || (file = fopen(path, "r")) == NULL)
+    return;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "%llx %zu %zu %zu", &key, &local[0], &local[1], &local[2]) != 4)
+      continue;
+    if (local[0] == 0 || local[1] == 0 || local[2] == 0)
+      continue;
+    struct cl_tuning_entry *e = find_entry(ctx, key);
+    if (e == NULL && (e = add_entry(ctx, key)) == NULL)
+      break;
+    memcpy(e->local_wk_sz, local, sizeof(local));
+    e->tuned = CL_TRUE;
+  }
+  fclose(file);
+}
+
+/* Appending a short line is atomic, the file can be shared by processes */
+static void
+save_tuning_entry(const struct cl_tuning_entry *e)
+{
+  const char *path = tuning_file_path();
+  FILE *file;
+
+  if (path == NULL || (file = fopen(path, "a")) == NULL)
+    return;
+  fprintf(file, "%016llx %zu %zu %zu\n", (unsigned long long)e->key,
+          e->local_wk_sz[0], e->local_wk_sz[1], e->local_wk_sz[2]);
+  fclose(file);
+}
+
+/* Model cost of a local size, the lower the better. Groups run whole threads
+ * of simd lanes, so the lanes disabled in the last thread are wasted, and
+ * the lanes of a thread should be consecutive work items along x, which
+ * usually access consecutive addresses. */
+static uint32_t
+local_size_cost(const size_t *local, uint32_t simd, size_t target, size_t global_x)
+{
+  const size_t lanes = local[0] * local[1] * local[2];
+  const size_t threads = (lanes + simd - 1) / simd;
+  const uint32_t lanes_class = size_class(lanes);
+  const uint32_t target_class = size_class(target);
+  uint32_t cost = 4 * (lanes_class > target_class ? lanes_class - target_class
+                                                  : target_class - lanes_class);
+  cost += 16 * (threads * simd - lanes) / (threads * simd);
+  if (local[0] < simd && local[0] != global_x)
+    cost += 2;
+  return cost;
+}
+
+static int
+get_divisors(size_t size, size_t max, size_t *divisors)
+{
+  int n = 0;
+  size_t d;
+  for (d = 1; d <= max && d <= size && n < TUNING_MAX_DIVISORS; d++)
+    if (size % d == 0)
+      divisors[n++] = d;
+  return n;
+}
+
+/* Sorted best local sizes dividing the global size according to the model */
+static cl_int
+model_local_sizes(cl_kernel ker, cl_uint work_dim, const size_t *global_wk_sz,
+                  size_t candidates[][3], cl_int max_candidates)
+{
+  size_t divisors[3][TUNING_MAX_DIVISORS];
+  int divisor_n[3] = {1, 1, 1};
+  uint32_t costs[TUNING_MAX_CANDIDATES];
+  const uint32_t simd = interp_kernel_get_simd_width(ker->opaque);
+  const size_t max_wg_sz = cl_get_kernel_max_wg_sz(ker);
+  cl_int n = 0;
+  cl_uint i;
+  int x, y, z, c;
+
+  /* Barriers and local memory work better with larger groups, the
+   * others need enough groups to spread over all the subslices. The register
+   * pressure shows as SIMD8 kernels, which get half as many lanes. */
+  const cl_bool group_bound = interp_kernel_use_barrier(ker->opaque) ||
+                              interp_kernel_use_slm(ker->opaque);
+  size_t target = simd * (group_bound ? 16 : 8);
+  if (target > max_wg_sz)
+    target = max_wg_sz;
+
+  divisors[1][0] = divisors[2][0] = 1;
+  for (i = 0; i < work_dim; i++)
+    divisor_n[i] = get_divisors(global_wk_sz[i], max_wg_sz, divisors[i]);
+
+  for (x = divisor_n[0] - 1; x >= 0; x--)
+  for (y = 0; y < divisor_n[1]; y++)
+  for (z = 0; z < divisor_n[2]; z++) {
+    const size_t local[3] = {divisors[0][x], divisors[1][y], divisors[2][z]};
+    if (local[0] * local[1] * local[2] > max_wg_sz)
+      break;
+    const uint32_t cost = local_size_cost(local, simd, target, global_wk_sz[0]);
+    /* One candidate per height, depth and power of two of the width, so that
+     * the measures compare different shapes and sizes rather than close widths */
+    for (c = 0; c < n; c++)
+      if (candidates[c][1] == local[1] && candidates[c][2] == local[2] &&
+          size_class(candidates[c][0]) == size_class(local[0]))
+        break;
+    if (c < n) {
+      if (costs[c] <= cost)
+        continue;
+      for (n--; c < n; c++) {
+        costs[c] = costs[c + 1];
+        memcpy(candidates[c], candidates[c + 1], sizeof(candidates[c]));
+      }
+    }
+    if (n == max_candidates && cost >= costs[n - 1])
+      continue;
+    /* Insert it sorted, ties keep the widest x first */
+    c = (n == max_candidates) ? n - 1 : n++;
+    for (; c > 0 && costs[c - 1] > cost; c--) {
+      costs[c] = costs[c - 1];
+      memcpy(candidates[c], candidates[c - 1], sizeof(candidates[c]));
+    }
+    costs[c] = cost;
+    memcpy(candidates[c], local, sizeof(local));
+  }
+  return n;
+}
+
+static cl_bool
+local_size_fits(cl_kernel ker, const size_t *global_wk_sz, const size_t *local)
+{
+  int i;
+  if (local[0] * local[1] * local[2] > cl_get_kernel_max_wg_sz(ker))
+    return CL_FALSE;
+  for (i = 0; i < 3; i++)
+    if (global_wk_sz[i] % local[i] != 0)
+      return CL_FALSE;
+  return CL_TRUE;
+}
+
+LOCAL void
+cl_local_size_tune(cl_kernel ker, cl_command_queue queue, cl_uint work_dim,
+                   const size_t *global_wk_sz, size_t *local_wk_sz,
+                   struct cl_tuning_entry **entry, cl_int *candidate)
+{
+  const size_t global[3] = {global_wk_sz[0],
+                            work_dim > 1 ? global_wk_sz[1] : 1,
+                            work_dim > 2 ? global_wk_sz[2] : 1};
+  size_t model[1][3];
+  cl_context ctx = queue->ctx;
+  struct cl_tuning_entry *e;
+  cl_int c, i;
+
+  *entry = NULL;
+  *candidate = -1;
+
+  /* The only valid local size */
+  if (ker->compile_wg_sz[0] || ker->compile_wg_sz[1] || ker->compile_wg_sz[2]) {
+    memcpy(local_wk_sz, ker->compile_wg_sz, sizeof(ker->compile_wg_sz));
+    return;
+  }
+
+  const uint64_t key = tuning_key(ker, work_dim, global);
+  pthread_mutex_lock(&tuning_lock);
+  if (!ctx->tuning_file_loaded)
+    load_tuning_file(ctx);
+  e = find_entry(ctx, key);
+  if (e == NULL && (e = add_entry(ctx, key)) != NULL) {
+    memcpy(e->global_wk_sz, global, sizeof(global));
+    e->candidate_n = model_local_sizes(ker, work_dim, global, e->candidates, TUNING_MAX_CANDIDATES);
+    if (e->candidate_n > 0)
+      memcpy(e->local_wk_sz, e->candidates[0], sizeof(e->local_wk_sz));
+    else
+      e->tuned = CL_TRUE;
+  }
+
+  /* Measure the candidate run the least so far. The times only compare with
+   * the same global size and the profiling timestamps of the launch. */
+  if (e != NULL && !e->tuned && (queue->props & CL_QUEUE_PROFILING_ENABLE) &&
+      memcmp(e->global_wk_sz, global, sizeof(global)) == 0) {
+    for (c = 0, i = 1; i < e->candidate_n; i++)
+      if (e->started[i] < e->started[c])
+        c = i;
+    if (e->started[c] < TUNING_RUNS) {
+      e->started[c]++;
+      memcpy(local_wk_sz, e->candidates[c], sizeof(e->candidates[c]));
+      *entry = e;
+      *candidate = c;
+      pthread_mutex_unlock(&tuning_lock);
+      return;
+    }
+  }
+
+  if (e != NULL && e->local_wk_sz[0] && local_size_fits(ker, global, e->local_wk_sz)) {
+    memcpy(local_wk_sz, e->local_wk_sz, sizeof(e->local_wk_sz));
+    pthread_mutex_unlock(&tuning_lock);
+    return;
+  }
+  pthread_mutex_unlock(&tuning_lock);
+
+  /* Another global size of the class, which the tuned local size does not divide */
+  if (model_local_sizes(ker, work_dim, global, model, 1) == 1)
+    memcpy(local_wk_sz, model[0], sizeof(model[0]));
+}
+
+LOCAL void
+cl_local_size_tuning_report(struct cl_tuning_entry *e, cl_int candidate, cl_ulong ns)
+{
+  cl_int c, best = -1;
+
+  assert(candidate >= 0 && candidate < e->candidate_n);
+  pthread_mutex_lock(&tuning_lock);
+  if (e->tuned) {
+    pthread_mutex_unlock(&tuning_lock);
+    return;
+  }
+  if (e->measured[candidate] == 0 || ns < e->best_ns[candidate])
+    e->best_ns[candidate] = ns;
+  e->measured[candidate]++;
+
+  for (c = 0; c < e->candidate_n; c++)
+    if (e->measured[c] && (best < 0 || e->best_ns[c] < e->best_ns[best]))
+      best = c;
+  memcpy(e->local_wk_sz, e->candidates[best], sizeof(e->local_wk_sz));
+
+  for (c = 0; c < e->candidate_n; c++)
+    if (e->measured[c] < TUNING_RUNS)
+      break;
+  if (c == e->candidate_n) {
+    e->tuned = CL_TRUE;
+    save_tuning_entry(e);
+  }
+  pthread_mutex_unlock(&tuning_lock);
+}
+
+LOCAL void
+cl_local_size_tuning_release(cl_context ctx)
+{
+  struct cl_tuning_entry *e, *next;
+
+  for (e = ctx->tuning_entries; e != NULL; e = next) {
+    next = e->next;
+    cl_free(e);
+  }
+  ctx->tuning_entries = NULL;
+}
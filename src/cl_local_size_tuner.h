@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_LOCAL_SIZE_TUNER_H__
+#define __CL_LOCAL_SIZE_TUNER_H__
+
+#include "cl_internals.h"
+#include "CL/cl.h"
+
+/* Local sizes tried for one kernel and one class of global sizes */
+struct cl_tuning_entry;
+
+/* True if OCL_TUNE_LOCAL_SIZE is set */
+extern cl_bool cl_local_size_tuning_enabled(void);
+
+/* Key of the Gen code of a kernel, never 0 */
+extern uint64_t cl_local_size_tuning_hash(const char *code, size_t code_sz);
+
+/* Choose the local size of an NDRange enqueued without one. If the launch
+ * measures one of the candidates, entry and candidate are set and its time
+ * must be reported once it is complete */
+extern void cl_local_size_tune(cl_kernel ker, cl_command_queue queue, cl_uint work_dim,
+                               const size_t *global_wk_sz, size_t *local_wk_sz,
+                               struct cl_tuning_entry **entry, cl_int *candidate);
+
+/* GPU time in ns of a launch measuring a candidate */
+extern void cl_local_size_tuning_report(struct cl_tuning_entry *entry, cl_int candidate,
+                                        cl_ulong ns);
+
+/* Free the local sizes tuned in the context */
+extern void cl_local_size_tuning_release(cl_context ctx);
+
+#endif /* __CL_LOCAL_SIZE_TUNER_H__ */
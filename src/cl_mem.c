@@ -29,6 +29,8 @@
 #include "cl_command_queue.h"
 #include "cl_cmrt.h"
 #include "cl_enqueue.h"
+#include "cl_mem_slab.h"
+#include "cl_image_tiling.h"
 
 #include "CL/cl.h"
 #include "CL/cl_intel.h"
@@ -148,6 +150,7 @@ cl_mem_allocate(enum cl_mem_type type,
   mem->flags = flags;
   mem->is_userptr = 0;
   mem->offset = 0;
+  mem->slab = NULL;
   mem->is_svm = 0;
   mem->cmrt_mem = NULL;
   if (mem->type == CL_MEM_IMAGE_TYPE) {
@@ -241,15 +244,23 @@ cl_mem_allocate(enum cl_mem_type type,
       bufCreated = 1;
     }
 
-    if (!bufCreated)
-      mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
+    if (!bufCreated) {
+      if (type == CL_MEM_BUFFER_TYPE && !(flags & CL_MEM_PINNABLE) && !is_tiled)
+        mem->slab = cl_slab_alloc(ctx->slab_allocator, sz, &mem->bo, &mem->offset);
+      if (mem->slab == NULL)
+        mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
+    }
 #else
     if(type == CL_MEM_IMAGE_TYPE && buffer != NULL) {
       // if the image if created from buffer, should use the bo directly to share same bo.
       mem->bo = buffer->bo;
       cl_mem_image(mem)->is_image_from_buffer = 1;
-    } else
-      mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
+    } else {
+      if (type == CL_MEM_BUFFER_TYPE && !(flags & CL_MEM_PINNABLE) && !is_tiled)
+        mem->slab = cl_slab_alloc(ctx->slab_allocator, sz, &mem->bo, &mem->offset);
+      if (mem->slab == NULL)
+        mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
+    }
 #endif
 
     if (UNLIKELY(mem->bo == NULL)) {
@@ -373,11 +384,11 @@ cl_mem_new_buffer(cl_context ctx,
     if (mem->is_userptr)
       memcpy(mem->host_ptr, data, sz);
     else
-      cl_buffer_subdata(mem->bo, 0, sz, data);
+      cl_buffer_subdata(mem->bo, mem->offset, sz, data);
   }
 
   if ((flags & CL_MEM_USE_HOST_PTR) && !mem->is_userptr)
-    cl_buffer_subdata(mem->bo, 0, sz, data);
+    cl_buffer_subdata(mem->bo, mem->offset, sz, data);
 
   if (flags & CL_MEM_USE_HOST_PTR)
     mem->host_ptr = data;
@@ -573,6 +584,54 @@ void cl_mem_replace_buffer(cl_mem buffer, cl_buffer new_bo)
   }
 }
 
+LOCAL cl_int
+cl_mem_slab_detach(cl_mem mem)
+{
+  struct _cl_mem_buffer *buffer = (struct _cl_mem_buffer *)mem;
+  struct _cl_mem_buffer *sub = NULL;
+  cl_buffer bo = NULL;
+  void *src = NULL;
+  int mapped = 0;
+
+  if (mem->type == CL_MEM_SUBBUFFER_TYPE) {
+    buffer = buffer->parent;
+    mem = &buffer->base;
+  }
+  if (mem->slab == NULL)
+    return CL_SUCCESS;
+
+  /* The host still holds a pointer in the slot */
+  mapped = mem->map_ref;
+  pthread_mutex_lock(&buffer->sub_lock);
+  for (sub = buffer->subs; sub != NULL; sub = sub->sub_next)
+    mapped += sub->base.map_ref;
+  pthread_mutex_unlock(&buffer->sub_lock);
+  if (mapped > 0)
+    return CL_INVALID_OPERATION;
+
+  bo = cl_buffer_alloc(cl_context_get_bufmgr(mem->ctx), "CL memory object", mem->size, 64);
+  if (bo == NULL)
+    return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  src = cl_mem_map(mem, 0);
+  cl_buffer_subdata(bo, 0, mem->size, src);
+  cl_mem_unmap(mem);
+
+  cl_slab_free(mem->slab, mem->offset);
+  cl_buffer_unreference(mem->bo);
+  mem->slab = NULL;
+  mem->bo = bo;
+  mem->offset = 0;
+
+  /* The sub-buffers share the bo without a reference */
+  pthread_mutex_lock(&buffer->sub_lock);
+  for (sub = buffer->subs; sub != NULL; sub = sub->sub_next) {
+    sub->base.bo = bo;
+    sub->base.offset = 0;
+  }
+  pthread_mutex_unlock(&buffer->sub_lock);
+  return CL_SUCCESS;
+}
+
 void* cl_mem_svm_allocate(cl_context ctx, cl_svm_mem_flags flags,
                                  size_t size, unsigned int alignment)
 {
@@ -711,16 +770,52 @@ cl_mem_copy_image_to_image(const size_t *dst_origin,const size_t *src_origin, co
 
 }
 
+LOCAL cl_bool
+cl_mem_image_tiled_copy(struct _cl_mem_image *image, const size_t *origin, const size_t *region,
+                        void *host, size_t host_row_pitch, size_t host_slice_pitch, cl_bool to_image)
+{
+  cl_mem mem = &image->base;
+  cl_tiled_surface surf;
+  size_t offset;
+
+  if (image->tiling == CL_NO_TILE || !cl_image_cpu_tiling_enabled())
+    return CL_FALSE;
+  surf.swizzle = cl_buffer_get_swizzle(mem->bo);
+  if (surf.swizzle == CL_SWIZZLE_UNKNOWN)
+    return CL_FALSE;
+  surf.tiling = image->tiling;
+  surf.pitch = image->row_pitch;
+  surf.tile_w = cl_buffer_get_tiling_align(mem->ctx, image->tiling, 0);
+  surf.tile_h = cl_buffer_get_tiling_align(mem->ctx, image->tiling, 1);
+
+  /* A CPU mapping, the bo is not fenced */
+  cl_buffer_map(mem->bo, to_image);
+  surf.base = cl_buffer_get_virtual(mem->bo);
+  offset = image->offset + image->bpp * origin[0] + image->row_pitch * origin[1] +
+           image->slice_pitch * origin[2];
+  if (to_image)
+    cl_tiled_write(&surf, offset, image->bpp * region[0], region[1], region[2],
+                   image->slice_pitch, host, host_row_pitch, host_slice_pitch);
+  else
+    cl_tiled_read(&surf, offset, image->bpp * region[0], region[1], region[2],
+                  image->slice_pitch, host, host_row_pitch, host_slice_pitch);
+  cl_buffer_unmap(mem->bo);
+  return CL_TRUE;
+}
+
 static void
 cl_mem_copy_image(struct _cl_mem_image *image,
 		  size_t row_pitch,
 		  size_t slice_pitch,
 		  void* host_ptr)
 {
-  char* dst_ptr = cl_mem_map_auto((cl_mem)image, 1);
   size_t origin[3] = {0, 0, 0};
   size_t region[3] = {image->w, image->h, image->depth};
 
+  if (cl_mem_image_tiled_copy(image, origin, region, host_ptr, row_pitch, slice_pitch, CL_TRUE))
+    return;
+
+  char* dst_ptr = cl_mem_map_auto((cl_mem)image, 1);
   cl_mem_copy_image_region(origin, region, dst_ptr, image->row_pitch, image->slice_pitch,
                            host_ptr, row_pitch, slice_pitch, image, CL_FALSE, CL_FALSE); //offset is 0
   cl_mem_unmap_auto((cl_mem)image);
@@ -1314,6 +1409,9 @@ _cl_mem_new_image_from_buffer(cl_context ctx,
     offset = ((struct _cl_mem_buffer *)buffer)->sub_offset;
     mem_buffer = mem_buffer->parent;
   }
+  /* The image surface needs the base address alignment of a whole bo */
+  if ((err = cl_mem_slab_detach(&mem_buffer->base)) != CL_SUCCESS)
+    goto error;
   /* Get the size of each pixel */
   if (UNLIKELY((err = cl_image_byte_per_pixel(image_format, &bpp)) != CL_SUCCESS))
     goto error;
@@ -1529,6 +1627,8 @@ cl_mem_delete(cl_mem mem)
     if (svm_mem != NULL)
       cl_mem_delete(svm_mem);
   } else if (LIKELY(mem->bo != NULL)) {
+    if (mem->slab)
+      cl_slab_free(mem->slab, mem->offset);
     cl_buffer_unreference(mem->bo);
   }
 
@@ -2410,12 +2510,21 @@ cl_mem_copy_buffer_to_image(cl_command_queue queue, cl_event event, cl_mem buffe
 }
 
 
+/* The small buffers start at the offset of their slot in the shared bo. The
+ * callers of the userptr ones add the offset in the page themselves */
+static void *
+cl_mem_virtual(cl_mem mem)
+{
+  char *ptr = (char *)cl_buffer_get_virtual(mem->bo);
+  return mem->is_userptr ? ptr : ptr + mem->offset;
+}
+
 LOCAL void*
 cl_mem_map(cl_mem mem, int write)
 {
   cl_buffer_map(mem->bo, write);
   assert(cl_buffer_get_virtual(mem->bo));
-  return cl_buffer_get_virtual(mem->bo);
+  return cl_mem_virtual(mem);
 }
 
 LOCAL cl_int
@@ -2431,7 +2540,7 @@ cl_mem_map_gtt(cl_mem mem)
   cl_buffer_map_gtt(mem->bo);
   assert(cl_buffer_get_virtual(mem->bo));
   mem->mapped_gtt = 1;
-  return cl_buffer_get_virtual(mem->bo);
+  return cl_mem_virtual(mem);
 }
 
 LOCAL void *
@@ -2439,7 +2548,7 @@ cl_mem_map_gtt_unsync(cl_mem mem)
 {
   cl_buffer_map_gtt_unsync(mem->bo);
   assert(cl_buffer_get_virtual(mem->bo));
-  return cl_buffer_get_virtual(mem->bo);
+  return cl_mem_virtual(mem);
 }
 
 LOCAL cl_int
@@ -2452,10 +2561,6 @@ cl_mem_unmap_gtt(cl_mem mem)
 LOCAL void*
 cl_mem_map_auto(cl_mem mem, int write)
 {
-  //if mem is not created from userptr, the offset should be always zero.
-  if (!mem->is_userptr)
-    assert(mem->offset == 0);
-
   if (IS_IMAGE(mem) && cl_mem_image(mem)->tiling != CL_NO_TILE)
     return cl_mem_map_gtt(mem);
   else {
@@ -2593,6 +2698,9 @@ cl_mem_get_fd(cl_mem mem,
               int* fd)
 {
   cl_int err = CL_SUCCESS;
+  /* The fd exports the whole bo */
+  if ((err = cl_mem_slab_detach(mem)) != CL_SUCCESS)
+    return err;
   if(cl_buffer_get_fd(mem->bo, fd))
 	err = CL_INVALID_OPERATION;
   return err;
@@ -55,6 +55,14 @@ typedef enum cl_image_tiling {
   CL_TILE_Y  = 2
 } cl_image_tiling_t;
 
+/* Address bits XORed into bit 6 of the tiled bos by the memory controller */
+typedef enum cl_bit6_swizzle {
+  CL_SWIZZLE_NONE    = 0,
+  CL_SWIZZLE_9       = 1,
+  CL_SWIZZLE_9_10    = 2,
+  CL_SWIZZLE_UNKNOWN = 3   /* Other modes, also depending on physical addresses */
+} cl_bit6_swizzle_t;
+
 typedef struct _cl_mapped_ptr {
   void * ptr;
   void * v_ptr;
@@ -100,7 +108,9 @@ typedef  struct _cl_mem {
   list_head dstr_cb_head;   /* All destroy callbacks. */
   uint8_t is_userptr;       /* CL_MEM_USE_HOST_PTR is enabled */
   cl_bool is_svm;           /* This object  is svm */
-  size_t offset;            /* offset of host_ptr to the page beginning, only for CL_MEM_USE_HOST_PTR*/
+  size_t offset;            /* offset of host_ptr to the page beginning for CL_MEM_USE_HOST_PTR,
+                               or of the slab slot for the small buffers */
+  struct cl_slab *slab;     /* Slab the bo is shared with, NULL if it has its own */
 
   uint8_t cmrt_mem_type;    /* CmBuffer, CmSurface2D, ... */
   void* cmrt_mem;
@@ -311,6 +321,13 @@ extern void *cl_mem_map_gtt_unsync(cl_mem);
 /* Unmap a memory object in GTT mode */
 extern cl_int cl_mem_unmap_gtt(cl_mem);
 
+/* Copy a region between the host and a tiled image through a CPU mapping,
+ * tiling in software. CL_FALSE if the image is not tiled or its swizzling is
+ * not handled, it must then be copied through a GTT mapping */
+extern cl_bool cl_mem_image_tiled_copy(struct _cl_mem_image *image, const size_t *origin,
+                                       const size_t *region, void *host, size_t host_row_pitch,
+                                       size_t host_slice_pitch, cl_bool to_image);
+
 /* Directly map a memory object - tiled images are mapped in GTT mode */
 extern void *cl_mem_map_auto(cl_mem, int);
 
@@ -321,6 +338,10 @@ extern cl_int cl_mem_unmap_auto(cl_mem);
 extern cl_int cl_mem_pin(cl_mem);
 extern cl_int cl_mem_unpin(cl_mem);
 
+/* Move a buffer sub-allocated in a slab, and its sub-buffers, to a bo of its
+ * own, for the uses of the whole bo like the images and the exported fds */
+extern cl_int cl_mem_slab_detach(cl_mem);
+
 extern cl_mem
 cl_mem_allocate(enum cl_mem_type type,
                 cl_context ctx,
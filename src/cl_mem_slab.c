@@ -0,0 +1,241 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Every buffer object costs an allocation ioctl, a relocation entry per
+ * launch and at least one page. The small buffers are instead given a slot of
+ * a 64KB buffer object shared with the other buffers of the same size class,
+ * and are bound with the offset of their slot. The slots are aligned on
+ * CL_DEVICE_MEM_BASE_ADDR_ALIGN so that the sub-buffers keep their alignment.
+ * The slabs with free slots of a class are kept in a list, and one empty slab
+ * per class is cached to not reallocate a buffer object when a single buffer
+ * is created and released in a loop. The NDRanges hold their buffers until
+ * they complete, so that the slot of a released buffer is not given again
+ * while a queued kernel may still write it.
+ *
+ * The kernel only tracks the GPU work per buffer object, so mapping, reading
+ * or writing a slot waits for every kernel using any slot of its slab, not
+ * only the ones using this buffer. The driver does not know which kernels
+ * used which slot to map them unsynchronized, so the applications updating
+ * small buffers while other small buffers are in use should lower
+ * OCL_SLAB_MAX_SIZE, or set it to 0.
+ */
+
+#include "cl_mem_slab.h"
+#include "cl_driver.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SLAB_BO_SIZE     (64 * 1024)
+#define SLAB_MIN_SHIFT   7      /* 128 bytes, CL_DEVICE_MEM_BASE_ADDR_ALIGN */
+#define SLAB_MAX_SHIFT   12     /* 4KB, larger buffers take a page anyway */
+#define SLAB_CLASS_N     (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+
+struct cl_slab {
+  cl_slab_allocator *allocator;
+  cl_buffer bo;
+  uint32_t class_id;
+  uint32_t slot_n;
+  uint32_t free_n;
+  struct cl_slab *prev, *next;  /* In the list of the class if it has free slots */
+  uint16_t free_slots[];        /* Stack of the free slot indices */
+};
+
+struct _cl_slab_allocator {
+  pthread_mutex_t lock;
+  cl_buffer_mgr bufmgr;
+  struct cl_slab *partial[SLAB_CLASS_N];  /* Slabs with used and free slots */
+  struct cl_slab *empty[SLAB_CLASS_N];    /* One cached slab without used slot */
+};
+
+LOCAL size_t
+cl_slab_max_size(void)
+{
+  static int max_size = -1;
+  if (max_size < 0) {
+    int value = 1 << SLAB_MAX_SHIFT;
+    // can't use IVAR (backend/src/sys/cvar.hpp) here as it's C++
+    const char *env = getenv("OCL_SLAB_MAX_SIZE");
+    if (env != NULL)
+      sscanf(env, "%i", &value);
+    if (value < 0)
+      value = 0;
+    max_size = MIN(value, 1 << SLAB_MAX_SHIFT);
+  }
+  return max_size;
+}
+
+static uint32_t
+slab_class_id(size_t sz)
+{
+  uint32_t shift = SLAB_MIN_SHIFT;
+  while (((size_t)1 << shift) < sz)
+    shift++;
+  return shift - SLAB_MIN_SHIFT;
+}
+
+static void
+slab_list_remove(struct cl_slab **list, struct cl_slab *slab)
+{
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    *list = slab->next;
+  if (slab->next)
+    slab->next->prev = slab->prev;
+  slab->prev = slab->next = NULL;
+}
+
+static void
+slab_list_add(struct cl_slab **list, struct cl_slab *slab)
+{
+  slab->prev = NULL;
+  slab->next = *list;
+  if (*list)
+    (*list)->prev = slab;
+  *list = slab;
+}
+
+static struct cl_slab *
+slab_new(cl_slab_allocator *allocator, uint32_t class_id)
+{
+  const uint32_t slot_n = SLAB_BO_SIZE >> (class_id + SLAB_MIN_SHIFT);
+  struct cl_slab *slab = NULL;
+  uint32_t i;
+
+  slab = cl_calloc(1, sizeof(struct cl_slab) + slot_n * sizeof(uint16_t));
+  if (slab == NULL)
+    return NULL;
+  slab->bo = cl_buffer_alloc(allocator->bufmgr, "CL slab memory object", SLAB_BO_SIZE, 4096);
+  if (slab->bo == NULL) {
+    cl_free(slab);
+    return NULL;
+  }
+  slab->allocator = allocator;
+  slab->class_id = class_id;
+  slab->slot_n = slot_n;
+  /* The first slots are given first */
+  for (i = 0; i < slot_n; i++)
+    slab->free_slots[i] = slot_n - 1 - i;
+  slab->free_n = slot_n;
+  return slab;
+}
+
+static void
+slab_delete(struct cl_slab *slab)
+{
+  cl_buffer_unreference(slab->bo);
+  cl_free(slab);
+}
+
+LOCAL cl_slab_allocator *
+cl_slab_allocator_new(cl_buffer_mgr bufmgr)
+{
+  cl_slab_allocator *allocator = NULL;
+
+  if (cl_slab_max_size() == 0)
+    return NULL;
+  allocator = cl_calloc(1, sizeof(cl_slab_allocator));
+  if (allocator == NULL)
+    return NULL;
+  pthread_mutex_init(&allocator->lock, NULL);
+  allocator->bufmgr = bufmgr;
+  return allocator;
+}
+
+LOCAL void
+cl_slab_allocator_delete(cl_slab_allocator *allocator)
+{
+  uint32_t i;
+
+  if (allocator == NULL)
+    return;
+  for (i = 0; i < SLAB_CLASS_N; i++) {
+    assert(allocator->partial[i] == NULL);
+    if (allocator->empty[i])
+      slab_delete(allocator->empty[i]);
+  }
+  pthread_mutex_destroy(&allocator->lock);
+  cl_free(allocator);
+}
+
+LOCAL struct cl_slab *
+cl_slab_alloc(cl_slab_allocator *allocator, size_t sz, cl_buffer *bo, size_t *offset)
+{
+  struct cl_slab *slab = NULL;
+  uint32_t class_id, slot;
+
+  if (allocator == NULL || sz == 0 || sz > cl_slab_max_size())
+    return NULL;
+  class_id = slab_class_id(sz);
+
+  pthread_mutex_lock(&allocator->lock);
+  slab = allocator->partial[class_id];
+  if (slab == NULL) {
+    slab = allocator->empty[class_id];
+    allocator->empty[class_id] = NULL;
+    if (slab == NULL)
+      slab = slab_new(allocator, class_id);
+    if (slab == NULL) {
+      pthread_mutex_unlock(&allocator->lock);
+      return NULL;
+    }
+    slab_list_add(&allocator->partial[class_id], slab);
+  }
+
+  assert(slab->free_n > 0);
+  slot = slab->free_slots[--slab->free_n];
+  if (slab->free_n == 0)
+    slab_list_remove(&allocator->partial[class_id], slab);
+  cl_buffer_reference(slab->bo);
+  pthread_mutex_unlock(&allocator->lock);
+
+  *bo = slab->bo;
+  *offset = (size_t)slot << (class_id + SLAB_MIN_SHIFT);
+  return slab;
+}
+
+LOCAL void
+cl_slab_free(struct cl_slab *slab, size_t offset)
+{
+  cl_slab_allocator *allocator = slab->allocator;
+  const uint32_t class_id = slab->class_id;
+  struct cl_slab *freed = NULL;
+
+  assert((offset & ((1 << (class_id + SLAB_MIN_SHIFT)) - 1)) == 0);
+  pthread_mutex_lock(&allocator->lock);
+  assert(slab->free_n < slab->slot_n);
+  if (slab->free_n == 0)
+    slab_list_add(&allocator->partial[class_id], slab);
+  slab->free_slots[slab->free_n++] = offset >> (class_id + SLAB_MIN_SHIFT);
+
+  /* Keep one empty slab per class, release the others */
+  if (slab->free_n == slab->slot_n) {
+    slab_list_remove(&allocator->partial[class_id], slab);
+    if (allocator->empty[class_id] == NULL)
+      allocator->empty[class_id] = slab;
+    else
+      freed = slab;
+  }
+  pthread_mutex_unlock(&allocator->lock);
+
+  if (freed)
+    slab_delete(freed);
+}
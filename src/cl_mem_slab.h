@@ -0,0 +1,49 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_MEM_SLAB_H__
+#define __CL_MEM_SLAB_H__
+
+#include "cl_driver_type.h"
+#include <stddef.h>
+
+/* Small buffers of a context, carved out of large shared buffer objects */
+typedef struct _cl_slab_allocator cl_slab_allocator;
+
+/* One shared buffer object and its slots */
+struct cl_slab;
+
+/* Largest buffer sub-allocated, set with OCL_SLAB_MAX_SIZE, 0 if disabled */
+extern size_t cl_slab_max_size(void);
+
+/* NULL if the slabs are disabled */
+extern cl_slab_allocator *cl_slab_allocator_new(cl_buffer_mgr bufmgr);
+
+/* All the slots must be freed */
+extern void cl_slab_allocator_delete(cl_slab_allocator *allocator);
+
+/* Find a slot of at least sz bytes. Its bo is referenced for the caller and
+ * the data starts at offset in it. NULL if sz is too large or the bo
+ * allocation failed */
+extern struct cl_slab *cl_slab_alloc(cl_slab_allocator *allocator, size_t sz,
+                                     cl_buffer *bo, size_t *offset);
+
+/* Give the slot back, the reference of the bo is released by the caller */
+extern void cl_slab_free(struct cl_slab *slab, size_t offset);
+
+#endif /* __CL_MEM_SLAB_H__ */
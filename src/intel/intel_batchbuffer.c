@@ -79,6 +79,8 @@ intel_batchbuffer_reset(intel_batchbuffer_t *batch, size_t sz)
   batch->atomic = 0;
   batch->last_bo = batch->buffer;
   batch->enable_slm = 0;
+  batch->chain = NULL;
+  batch->chain_err = 0;
   return 0;
 }
 
@@ -103,12 +105,11 @@ intel_batchbuffer_terminate(intel_batchbuffer_t *batch)
   batch->buffer = NULL;
 }
 
-LOCAL int
-intel_batchbuffer_flush(intel_batchbuffer_t *batch)
+/* Terminate the commands and release the mapping. Returns the size to execute */
+static uint32_t
+intel_batchbuffer_close(intel_batchbuffer_t *batch)
 {
   uint32_t used = batch->ptr - batch->map;
-  int is_locked = batch->intel->locked;
-  int err = 0;
 
   if (used == 0)
     return 0;
@@ -123,6 +124,27 @@ intel_batchbuffer_flush(intel_batchbuffer_t *batch)
   used = batch->ptr - batch->map;
   dri_bo_unmap(batch->buffer);
   batch->ptr = batch->map = NULL;
+  return used;
+}
+
+LOCAL int
+intel_batchbuffer_flush(intel_batchbuffer_t *batch)
+{
+  intel_batchbuffer_t *next, *chain;
+  int is_locked = batch->intel->locked;
+  int err = 0;
+  uint32_t used = intel_batchbuffer_close(batch);
+
+  if (used == 0) {
+    /* Submitted with the batch this one is chained to, report its result */
+    err = batch->chain_err;
+    batch->chain_err = 0;
+    return err;
+  }
+
+  /* The chained batches run with this submission, their own flush does nothing */
+  for (next = batch->chain; next; next = next->chain)
+    intel_batchbuffer_close(next);
 
   if (!is_locked)
     intel_driver_lock_hardware(batch->intel);
@@ -141,6 +163,13 @@ intel_batchbuffer_flush(intel_batchbuffer_t *batch)
   if (!is_locked)
     intel_driver_unlock_hardware(batch->intel);
 
+  /* The kernels of the chained batches fail with the first one */
+  for (next = batch->chain, batch->chain = NULL; next; next = chain) {
+    chain = next->chain;
+    next->chain = NULL;
+    next->chain_err = err;
+  }
+
   return err;
 }
 
@@ -87,6 +87,10 @@ typedef struct intel_batchbuffer
    *  flag when call exec. */
   uint8_t enable_slm;
   int atomic;
+  /** Batch jumped to at the end of this one, submitted with it */
+  struct intel_batchbuffer *chain;
+  /** Result of the submission of the batch this one is chained to */
+  int chain_err;
 } intel_batchbuffer_t;
 
 extern intel_batchbuffer_t* intel_batchbuffer_new(struct intel_driver*);
@@ -597,6 +597,22 @@ case CL_NO_TILE:
 return ret;
 }
 
+static int intel_buffer_get_swizzle(drm_intel_bo *bo)
+{
+uint32_t tiling_mode, swizzle_mode;
+
+if (drm_intel_bo_get_tiling(bo, &tiling_mode, &swizzle_mode) != 0)
+  return CL_SWIZZLE_UNKNOWN;
+switch (swizzle_mode) {
+case I915_BIT_6_SWIZZLE_NONE: return CL_SWIZZLE_NONE;
+case I915_BIT_6_SWIZZLE_9: return CL_SWIZZLE_9;
+case I915_BIT_6_SWIZZLE_9_10: return CL_SWIZZLE_9_10;
+default:
+  /* 9_11 and the bit 17 modes */
+  return CL_SWIZZLE_UNKNOWN;
+}
+}
+
 #if defined(HAS_GL_EGL)
 #include "intel_cl_gl_share_image_info.h"
 #include "cl_image.h"
@@ -1073,6 +1089,7 @@ cl_buffer_set_bo_use_full_range = (cl_buffer_set_bo_use_full_range_cb *) drm_int
   cl_buffer_wait_rendering = (cl_buffer_wait_rendering_cb *) drm_intel_bo_wait_rendering;
   cl_buffer_get_fd = (cl_buffer_get_fd_cb *) drm_intel_bo_gem_export_to_prime;
   cl_buffer_get_tiling_align = (cl_buffer_get_tiling_align_cb *)intel_buffer_get_tiling_align;
+  cl_buffer_get_swizzle = (cl_buffer_get_swizzle_cb *)intel_buffer_get_swizzle;
   cl_buffer_get_buffer_from_fd = (cl_buffer_get_buffer_from_fd_cb *) intel_share_buffer_from_fd;
   cl_buffer_get_image_from_fd = (cl_buffer_get_image_from_fd_cb *) intel_share_image_from_fd;
   intel_set_gpgpu_callbacks(intel_get_device_id());
@@ -871,6 +871,29 @@ intel_gpgpu_batch_end(intel_gpgpu_t *gpgpu, int32_t flush_mode)
   intel_batchbuffer_end_atomic(gpgpu->batch);
 }
 
+static int
+intel_gpgpu_chain_gen8(intel_gpgpu_t *gpgpu, intel_gpgpu_t *next)
+{
+  intel_batchbuffer_t *batch = gpgpu->batch;
+
+  /* Both batches must be complete and not submitted yet */
+  if (batch->map == NULL || batch->chain != NULL ||
+      next->batch == batch || next->batch->map == NULL)
+    return -1;
+  if (intel_batchbuffer_space(batch) < sizeof(gen8_pipe_control_t) + 3 * 4 + 8)
+    return -1;
+
+  /* Finish the walker and flush its writes before the next kernel starts */
+  intel_gpgpu_pipe_control(gpgpu);
+  BEGIN_BATCH(batch, 3);
+  OUT_BATCH(batch, MI_BATCH_BUFFER_START | MI_BATCH_BUFFER_START_PPGTT | (3 - 2));
+  OUT_RELOC(batch, next->batch->buffer, I915_GEM_DOMAIN_COMMAND, 0, 0);
+  OUT_BATCH(batch, 0);
+  ADVANCE_BATCH(batch);
+  batch->chain = next->batch;
+  return 0;
+}
+
 static int
 intel_gpgpu_batch_reset(intel_gpgpu_t *gpgpu, size_t sz)
 {
@@ -905,6 +928,7 @@ intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
 
   /* Binded buffers */
   gpgpu->binded_n = 0;
+  gpgpu->curbe_relocated = 0;
   gpgpu->img_bitmap = 0;
   gpgpu->img_index_base = 3;
   gpgpu->sampler_bitmap = ~((1 << max_sampler_n) - 1);
@@ -1819,26 +1843,36 @@ intel_gpgpu_build_idrt_gen9(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
   desc->desc6.slm_sz = slm_sz;
 }
 
-static int
-intel_gpgpu_upload_curbes_gen7(intel_gpgpu_t *gpgpu, const void* data, uint32_t size)
+/* The curbes are written in place in the mapped aux buffer, the relocations
+ * of our flat address space are patched over them when it is unmapped
+ */
+static void*
+intel_gpgpu_map_curbes(intel_gpgpu_t *gpgpu)
 {
-  unsigned char *curbe = NULL;
-  cl_gpgpu_kernel *k = gpgpu->ker;
-  uint32_t i, j;
-
-  /* Upload the data first */
   if (dri_bo_map(gpgpu->aux_buf.bo, 1) != 0) {
     fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
-    return -1;
+    return NULL;
   }
   assert(gpgpu->aux_buf.bo->virtual);
+  return gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.curbe_offset;
+}
+
+static void
+intel_gpgpu_unmap_curbes_gen7(intel_gpgpu_t *gpgpu)
+{
+  unsigned char *curbe = NULL;
+  cl_gpgpu_kernel *k = gpgpu->ker;
+  uint32_t i, j;
+
   curbe = (unsigned char *) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.curbe_offset);
-  memcpy(curbe, data, size);
 
   /* Now put all the relocations for our flat address space */
   for (i = 0; i < k->thread_n; ++i)
     for (j = 0; j < gpgpu->binded_n; ++j) {
       *(uint32_t *)(curbe + gpgpu->binded_offset[j]+i*k->curbe_sz) = gpgpu->binded_buf[j]->offset64 + gpgpu->target_buf_offset[j];
+      /* A reused state keeps the relocations of its first upload */
+      if (gpgpu->curbe_relocated)
+        continue;
       drm_intel_bo_emit_reloc(gpgpu->aux_buf.bo,
                               gpgpu->aux_offset.curbe_offset + gpgpu->binded_offset[j]+i*k->curbe_sz,
                               gpgpu->binded_buf[j],
@@ -1846,30 +1880,26 @@ intel_gpgpu_upload_curbes_gen7(intel_gpgpu_t *gpgpu, const void* data, uint32_t
                               I915_GEM_DOMAIN_RENDER,
                               I915_GEM_DOMAIN_RENDER);
     }
+  gpgpu->curbe_relocated = 1;
   dri_bo_unmap(gpgpu->aux_buf.bo);
-  return 0;
 }
 
-static int
-intel_gpgpu_upload_curbes_gen8(intel_gpgpu_t *gpgpu, const void* data, uint32_t size)
+static void
+intel_gpgpu_unmap_curbes_gen8(intel_gpgpu_t *gpgpu)
 {
   unsigned char *curbe = NULL;
   cl_gpgpu_kernel *k = gpgpu->ker;
   uint32_t i, j;
 
-  /* Upload the data first */
-  if (dri_bo_map(gpgpu->aux_buf.bo, 1) != 0) {
-    fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
-    return -1;
-  }
-  assert(gpgpu->aux_buf.bo->virtual);
   curbe = (unsigned char *) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.curbe_offset);
-  memcpy(curbe, data, size);
 
   /* Now put all the relocations for our flat address space */
   for (i = 0; i < k->thread_n; ++i)
     for (j = 0; j < gpgpu->binded_n; ++j) {
       *(size_t *)(curbe + gpgpu->binded_offset[j]+i*k->curbe_sz) = gpgpu->binded_buf[j]->offset64 + gpgpu->target_buf_offset[j];
+      /* A reused state keeps the relocations of its first upload */
+      if (gpgpu->curbe_relocated)
+        continue;
       drm_intel_bo_emit_reloc(gpgpu->aux_buf.bo,
                               gpgpu->aux_offset.curbe_offset + gpgpu->binded_offset[j]+i*k->curbe_sz,
                               gpgpu->binded_buf[j],
@@ -1877,8 +1907,8 @@ intel_gpgpu_upload_curbes_gen8(intel_gpgpu_t *gpgpu, const void* data, uint32_t
                               I915_GEM_DOMAIN_RENDER,
                               I915_GEM_DOMAIN_RENDER);
     }
+  gpgpu->curbe_relocated = 1;
   dri_bo_unmap(gpgpu->aux_buf.bo);
-  return 0;
 }
 
 static void
@@ -2198,6 +2228,20 @@ intel_gpgpu_states_setup(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
   dri_bo_unmap(gpgpu->aux_buf.bo);
 }
 
+static int
+intel_gpgpu_state_reuse(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
+{
+  /* The surface states, samplers and IDRT in the aux buffer are kept as they
+     are, so the previous launch must be done with them */
+  if (gpgpu->aux_buf.bo == NULL || !gpgpu->curbe_relocated)
+    return -1;
+  if (gpgpu->batch && gpgpu->batch->buffer &&
+      drm_intel_bo_busy(gpgpu->batch->buffer))
+    return -1;
+  gpgpu->ker = kernel;
+  return 0;
+}
+
 static void
 intel_gpgpu_set_perf_counters(intel_gpgpu_t *gpgpu, cl_buffer *perf)
 {
@@ -2577,6 +2621,7 @@ intel_set_gpgpu_callbacks(int device_id)
   cl_gpgpu_set_perf_counters = (cl_gpgpu_set_perf_counters_cb *) intel_gpgpu_set_perf_counters;
   cl_gpgpu_alloc_constant_buffer  = (cl_gpgpu_alloc_constant_buffer_cb *) intel_gpgpu_alloc_constant_buffer;
   cl_gpgpu_states_setup = (cl_gpgpu_states_setup_cb *) intel_gpgpu_states_setup;
+  cl_gpgpu_state_reuse = (cl_gpgpu_state_reuse_cb *) intel_gpgpu_state_reuse;
   cl_gpgpu_upload_samplers = (cl_gpgpu_upload_samplers_cb *) intel_gpgpu_upload_samplers;
   cl_gpgpu_batch_reset = (cl_gpgpu_batch_reset_cb *) intel_gpgpu_batch_reset;
   cl_gpgpu_batch_start = (cl_gpgpu_batch_start_cb *) intel_gpgpu_batch_start;
@@ -2596,6 +2641,7 @@ intel_set_gpgpu_callbacks(int device_id)
   cl_gpgpu_set_profiling_buffer = (cl_gpgpu_set_profiling_buffer_cb *)intel_gpgpu_set_profiling_buf;
   cl_gpgpu_set_profiling_info = (cl_gpgpu_set_profiling_info_cb *)intel_gpgpu_set_profiling_info;
   cl_gpgpu_get_profiling_info = (cl_gpgpu_get_profiling_info_cb *)intel_gpgpu_get_profiling_info;
+  cl_gpgpu_map_curbes = (cl_gpgpu_map_curbes_cb *) intel_gpgpu_map_curbes;
   cl_gpgpu_map_profiling_buffer = (cl_gpgpu_map_profiling_buffer_cb *)intel_gpgpu_map_profiling_buf;
   cl_gpgpu_unmap_profiling_buffer = (cl_gpgpu_unmap_profiling_buffer_cb *)intel_gpgpu_unmap_profiling_buf_addr;
   cl_gpgpu_set_printf_buffer = (cl_gpgpu_set_printf_buffer_cb *)intel_gpgpu_set_printf_buf;
@@ -2626,7 +2672,8 @@ intel_set_gpgpu_callbacks(int device_id)
     cl_gpgpu_bind_sampler = (cl_gpgpu_bind_sampler_cb *) intel_gpgpu_bind_sampler_gen8;
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen7;
-    cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_unmap_curbes = (cl_gpgpu_unmap_curbes_cb *) intel_gpgpu_unmap_curbes_gen8;
+    cl_gpgpu_chain = (cl_gpgpu_chain_cb *) intel_gpgpu_chain_gen8;
     return;
   }
   if (IS_GEN9(device_id)) {
@@ -2649,11 +2696,12 @@ intel_set_gpgpu_callbacks(int device_id)
     cl_gpgpu_bind_sampler = (cl_gpgpu_bind_sampler_cb *) intel_gpgpu_bind_sampler_gen8;
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen9;
-    cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_unmap_curbes = (cl_gpgpu_unmap_curbes_cb *) intel_gpgpu_unmap_curbes_gen8;
+    cl_gpgpu_chain = (cl_gpgpu_chain_cb *) intel_gpgpu_chain_gen8;
     return;
   }
 
-  cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen7;
+  cl_gpgpu_unmap_curbes = (cl_gpgpu_unmap_curbes_cb *) intel_gpgpu_unmap_curbes_gen7;
   intel_gpgpu_set_base_address = intel_gpgpu_set_base_address_gen7;
   intel_gpgpu_load_vfe_state = intel_gpgpu_load_vfe_state_gen7;
   cl_gpgpu_walker = (cl_gpgpu_walker_cb *)intel_gpgpu_walker_gen7;
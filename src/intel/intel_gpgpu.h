@@ -53,6 +53,7 @@ struct intel_gpgpu
   uint32_t target_buf_offset[max_buf_n];/* internal offset for buffers binded for the call */
   uint32_t binded_offset[max_buf_n];    /* their offsets in the curbe buffer */
   uint32_t binded_n;                    /* number of buffers binded */
+  uint32_t curbe_relocated;             /* relocations of the curbe pointers emitted */
   void *kernel;                         /* cl_kernel with this gpgpu */
 
   unsigned long img_bitmap;              /* image usage bitmap. */
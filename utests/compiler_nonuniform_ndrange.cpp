@@ -0,0 +1,47 @@
+#include "utest_helper.hpp"
+#include <cstring>
+
+/* Global sizes which are not multiples of the local size: every work item
+ * must run once and see the size of its own work group, and the work items
+ * beyond the global size must not run.
+ */
+static void compiler_nonuniform_ndrange(void)
+{
+  const size_t global_size[3] = {37, 13, 5};
+  const size_t local_size[3] = {8, 4, 2};
+  const size_t n = global_size[0] * global_size[1] * global_size[2];
+  const size_t pad = 256;
+
+  OCL_CREATE_KERNEL("compiler_nonuniform_ndrange");
+  OCL_CREATE_BUFFER(buf[0], 0, (n + pad) * sizeof(cl_int4), NULL);
+  OCL_MAP_BUFFER(0);
+  memset(buf_data[0], 0, (n + pad) * sizeof(cl_int4));
+  OCL_UNMAP_BUFFER(0);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+
+  for (int d = 0; d < 3; d++) {
+    globals[d] = global_size[d];
+    locals[d] = local_size[d];
+  }
+  OCL_NDRANGE(3);
+
+  OCL_MAP_BUFFER(0);
+  const int *dst = (const int *)buf_data[0];
+  for (size_t z = 0; z < global_size[2]; z++)
+  for (size_t y = 0; y < global_size[1]; y++)
+  for (size_t x = 0; x < global_size[0]; x++) {
+    const size_t coord[3] = {x, y, z};
+    const size_t id = (z * global_size[1] + y) * global_size[0] + x;
+    for (int d = 0; d < 3; d++) {
+      const size_t full = global_size[d] / local_size[d] * local_size[d];
+      const size_t expected = coord[d] < full ? local_size[d] : global_size[d] - full;
+      OCL_ASSERT(dst[4 * id + d] == (int)expected);
+    }
+    OCL_ASSERT(dst[4 * id + 3] == 1);
+  }
+  for (size_t i = 4 * n; i < 4 * (n + pad); i++)
+    OCL_ASSERT(dst[i] == 0);
+  OCL_UNMAP_BUFFER(0);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_nonuniform_ndrange);
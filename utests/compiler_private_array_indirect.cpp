@@ -0,0 +1,66 @@
+#include "utest_helper.hpp"
+#include <sstream>
+#include <vector>
+
+/* The dynamically indexed private arrays are kept in registers and read with
+ * INDIRECT_READ, check them against the host for SIMD8 and SIMD16
+ */
+#define PRIVATE_ARRAY_N  256
+
+static void compiler_private_array_indirect(void)
+{
+  std::vector<uint32_t> sizes;
+  int idx[PRIVATE_ARRAY_N];
+  int ref[3 * PRIVATE_ARRAY_N];
+
+  if (cl_check_reqd_subgroup()) {
+    sizes.push_back(8);
+    sizes.push_back(16);
+  } else
+    sizes.push_back(0);
+
+  /* Out of the array before the clamp on both sides */
+  for (int i = 0; i < PRIVATE_ARRAY_N; ++i)
+    idx[i] = (i * 7 + 3) % 24;
+
+  OCL_CREATE_BUFFER(buf[0], 0, sizeof(ref), NULL);
+  OCL_CREATE_BUFFER(buf[1], CL_MEM_COPY_HOST_PTR, sizeof(idx), idx);
+  for (size_t s = 0; s < sizes.size(); ++s) {
+    std::ostringstream opt;
+    if (sizes[s])
+      opt << "-D SIMD_SIZE=" << sizes[s];
+    if (program)
+      clReleaseProgram(program);
+    program = NULL;
+    OCL_CALL(cl_kernel_init, "compiler_private_array_indirect.cl",
+             "compiler_private_array_indirect", SOURCE, opt.str().c_str());
+
+    for (int uniform_idx = 0; uniform_idx < 16; uniform_idx += 5) {
+      for (int gid = 0; gid < PRIVATE_ARRAY_N; ++gid) {
+        int a[16];
+        int clamped = idx[gid] - 4;
+        clamped = clamped < 0 ? 0 : (clamped > 15 ? 15 : clamped);
+        for (int i = 0; i < 16; ++i)
+          a[i] = gid * 16 + i * i;
+        a[idx[gid] & 15] += 3;
+        ref[3 * gid] = a[(idx[gid] * 5) & 15];
+        ref[3 * gid + 1] = a[uniform_idx];
+        ref[3 * gid + 2] = a[clamped];
+      }
+
+      OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+      OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+      OCL_SET_ARG(2, sizeof(int), &uniform_idx);
+      globals[0] = PRIVATE_ARRAY_N;
+      locals[0] = 16;
+      OCL_NDRANGE(1);
+
+      OCL_MAP_BUFFER(0);
+      for (int i = 0; i < 3 * PRIVATE_ARRAY_N; ++i)
+        OCL_ASSERT(((int *)buf_data[0])[i] == ref[i]);
+      OCL_UNMAP_BUFFER(0);
+    }
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_private_array_indirect);
@@ -0,0 +1,204 @@
+#include "utest_helper.hpp"
+#include <string.h>
+#include <sstream>
+#include <vector>
+
+/* Control flow that the uniform analysis keeps in scalar registers, or must
+ * not, checked against the host for every required sub group size
+ */
+#define DIVERGENCE_N  256
+
+static std::vector<uint32_t> divergence_simd_sizes(void)
+{
+  std::vector<uint32_t> sizes;
+  if (cl_check_reqd_subgroup()) {
+    sizes.push_back(8);
+    sizes.push_back(16);
+  } else
+    sizes.push_back(0);
+  return sizes;
+}
+
+static void divergence_kernel_init(const char *kernel_name, uint32_t simd_size)
+{
+  std::ostringstream opt;
+  if (simd_size)
+    opt << "-D SIMD_SIZE=" << simd_size;
+  if (program)
+    clReleaseProgram(program);
+  program = NULL;
+  OCL_CALL(cl_kernel_init, "compiler_uniform_divergence.cl", kernel_name,
+           SOURCE, opt.str().c_str());
+}
+
+static void divergence_check(const int *ref)
+{
+  OCL_MAP_BUFFER(0);
+  for (int i = 0; i < DIVERGENCE_N; ++i)
+    OCL_ASSERT(((int *)buf_data[0])[i] == ref[i]);
+  OCL_UNMAP_BUFFER(0);
+}
+
+static void compiler_uniform_loop(void)
+{
+  const std::vector<uint32_t> sizes = divergence_simd_sizes();
+  int ref[DIVERGENCE_N];
+
+  OCL_CREATE_BUFFER(buf[0], 0, DIVERGENCE_N * sizeof(int), NULL);
+  for (size_t s = 0; s < sizes.size(); ++s) {
+    divergence_kernel_init("compiler_uniform_loop", sizes[s]);
+    for (int n = 0; n < 7; n += 3) {
+      for (int gid = 0; gid < DIVERGENCE_N; ++gid) {
+        int acc = gid, i;
+        for (i = 0; i < n; ++i)
+          acc = acc * 3 + i;
+        ref[gid] = acc + i * 1000;
+      }
+      OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+      OCL_SET_ARG(1, sizeof(int), &n);
+      globals[0] = DIVERGENCE_N;
+      locals[0] = 16;
+      OCL_NDRANGE(1);
+      divergence_check(ref);
+    }
+  }
+}
+
+static void compiler_divergent_break(void)
+{
+  const std::vector<uint32_t> sizes = divergence_simd_sizes();
+  const int n = 40;
+  int ref[DIVERGENCE_N];
+  int src[n];
+
+  /* Most lanes leave the loop early, the last ones never do */
+  for (int i = 0; i < n; ++i)
+    src[i] = (i * 37) % 53 + i * 4;
+  for (int gid = 0; gid < DIVERGENCE_N; ++gid) {
+    int last = -1, i;
+    for (i = 0; i < n; ++i) {
+      last = src[i] + i;
+      if (last > gid)
+        break;
+    }
+    ref[gid] = i * 1000 + last;
+  }
+
+  OCL_CREATE_BUFFER(buf[0], 0, DIVERGENCE_N * sizeof(int), NULL);
+  OCL_CREATE_BUFFER(buf[1], CL_MEM_COPY_HOST_PTR, sizeof(src), src);
+  for (size_t s = 0; s < sizes.size(); ++s) {
+    divergence_kernel_init("compiler_divergent_break", sizes[s]);
+    OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+    OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+    OCL_SET_ARG(2, sizeof(int), &n);
+    globals[0] = DIVERGENCE_N;
+    locals[0] = 16;
+    OCL_NDRANGE(1);
+    divergence_check(ref);
+  }
+}
+
+static void compiler_uniform_if(void)
+{
+  const std::vector<uint32_t> sizes = divergence_simd_sizes();
+  const int flags[] = {0, 1, 3, 4};
+  int ref[DIVERGENCE_N];
+  int src[DIVERGENCE_N];
+
+  for (int i = 0; i < DIVERGENCE_N; ++i)
+    src[i] = i * 13 - 700;
+
+  OCL_CREATE_BUFFER(buf[0], 0, DIVERGENCE_N * sizeof(int), NULL);
+  OCL_CREATE_BUFFER(buf[1], CL_MEM_COPY_HOST_PTR, sizeof(src), src);
+  for (size_t s = 0; s < sizes.size(); ++s) {
+    divergence_kernel_init("compiler_uniform_if", sizes[s]);
+    for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+      const int flag = flags[f];
+      for (int gid = 0; gid < DIVERGENCE_N; ++gid) {
+        int v = src[gid];
+        if (flag & 1) {
+          v = v * 2 + 1;
+          if (flag & 2)
+            v -= gid;
+        } else {
+          v ^= 0x55;
+          if (flag & 4)
+            v += flag;
+        }
+        ref[gid] = v;
+      }
+      OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+      OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+      OCL_SET_ARG(2, sizeof(int), &flag);
+      globals[0] = DIVERGENCE_N;
+      locals[0] = 16;
+      OCL_NDRANGE(1);
+      divergence_check(ref);
+    }
+  }
+}
+
+static void compiler_divergent_join(void)
+{
+  const std::vector<uint32_t> sizes = divergence_simd_sizes();
+  const int a = 6;
+  int ref[DIVERGENCE_N];
+
+  for (int gid = 0; gid < DIVERGENCE_N; ++gid) {
+    int v = (gid & 1) ? a + 7 : a * 5;
+    int acc = 0;
+    for (int j = 0; j < (v & 3); ++j)
+      acc += j + 1;
+    ref[gid] = v * 10 + acc;
+  }
+
+  OCL_CREATE_BUFFER(buf[0], 0, DIVERGENCE_N * sizeof(int), NULL);
+  for (size_t s = 0; s < sizes.size(); ++s) {
+    divergence_kernel_init("compiler_divergent_join", sizes[s]);
+    OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+    OCL_SET_ARG(1, sizeof(int), &a);
+    globals[0] = DIVERGENCE_N;
+    locals[0] = 16;
+    OCL_NDRANGE(1);
+    divergence_check(ref);
+  }
+}
+
+static void compiler_divergent_early_return(void)
+{
+  const std::vector<uint32_t> sizes = divergence_simd_sizes();
+  const int masks[] = {0, 2, 4};
+  const int a = 9;
+  int ref[DIVERGENCE_N];
+
+  OCL_CREATE_BUFFER(buf[0], 0, DIVERGENCE_N * sizeof(int), NULL);
+  for (size_t s = 0; s < sizes.size(); ++s) {
+    divergence_kernel_init("compiler_divergent_early_return", sizes[s]);
+    for (size_t m = 0; m < sizeof(masks) / sizeof(masks[0]); ++m) {
+      const int mask = masks[m];
+      for (int gid = 0; gid < DIVERGENCE_N; ++gid) {
+        if (gid & 1)
+          ref[gid] = a + 1;
+        else
+          ref[gid] = (gid & mask) ? -1 : a * 2;
+      }
+      /* The lanes returning early leave -1 */
+      OCL_MAP_BUFFER(0);
+      memset(buf_data[0], 0xff, DIVERGENCE_N * sizeof(int));
+      OCL_UNMAP_BUFFER(0);
+      OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+      OCL_SET_ARG(1, sizeof(int), &a);
+      OCL_SET_ARG(2, sizeof(int), &mask);
+      globals[0] = DIVERGENCE_N;
+      locals[0] = 16;
+      OCL_NDRANGE(1);
+      divergence_check(ref);
+    }
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_uniform_loop);
+MAKE_UTEST_FROM_FUNCTION(compiler_divergent_break);
+MAKE_UTEST_FROM_FUNCTION(compiler_uniform_if);
+MAKE_UTEST_FROM_FUNCTION(compiler_divergent_join);
+MAKE_UTEST_FROM_FUNCTION(compiler_divergent_early_return);
@@ -0,0 +1,48 @@
+#include "utest_helper.hpp"
+
+/* Hold a long list of dependent kernels behind a user event, so that the
+ * queue gets all of them ready at once and submits them in chained batches.
+ * Every kernel must see the result of the previous one.
+ */
+#define CHAINED_KERNEL_NUM  40
+#define CHAINED_DATA_SIZE   256
+
+void runtime_chained_kernels(void)
+{
+  cl_int status;
+  cl_event user_event;
+
+  OCL_CREATE_KERNEL("runtime_chained_kernels");
+  OCL_CREATE_BUFFER(buf[0], 0, CHAINED_DATA_SIZE * sizeof(uint32_t), NULL);
+  OCL_MAP_BUFFER(0);
+  for (int i = 0; i < CHAINED_DATA_SIZE; i++)
+    ((uint32_t *)buf_data[0])[i] = i;
+  OCL_UNMAP_BUFFER(0);
+
+  user_event = clCreateUserEvent(ctx, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  globals[0] = CHAINED_DATA_SIZE;
+  locals[0] = 16;
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  for (uint32_t k = 0; k < CHAINED_KERNEL_NUM; k++) {
+    OCL_SET_ARG(1, sizeof(uint32_t), &k);
+    OCL_CALL(clEnqueueNDRangeKernel, queue, kernel, 1, NULL, globals, locals,
+             k == 0 ? 1 : 0, k == 0 ? &user_event : NULL, NULL);
+  }
+
+  OCL_CALL(clSetUserEventStatus, user_event, CL_COMPLETE);
+  OCL_FINISH();
+
+  OCL_MAP_BUFFER(0);
+  for (int i = 0; i < CHAINED_DATA_SIZE; i++) {
+    uint32_t expected = i;
+    for (uint32_t k = 0; k < CHAINED_KERNEL_NUM; k++)
+      expected = expected * 3 + k;
+    OCL_ASSERT(((uint32_t *)buf_data[0])[i] == expected);
+  }
+  OCL_UNMAP_BUFFER(0);
+  clReleaseEvent(user_event);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_chained_kernels);
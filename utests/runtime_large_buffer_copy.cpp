@@ -0,0 +1,72 @@
+#include "utest_helper.hpp"
+#include <vector>
+
+/* The reads and writes of large buffers are split across several host threads
+ * and written with streaming stores. Every byte must land at its place, also
+ * with offsets and sizes which are not multiples of the parts or of 16 bytes.
+ */
+#define LARGE_COPY_SIZE  (24 * 1024 * 1024 + 13)
+
+static uint8_t large_copy_value(size_t i, uint8_t seed)
+{
+  return (uint8_t)((i * 131) ^ (i >> 11) ^ seed);
+}
+
+static void large_buffer_check(cl_mem mem, uint8_t seed)
+{
+  cl_int status;
+  uint8_t *data = (uint8_t *)clEnqueueMapBuffer(queue, mem, CL_TRUE, CL_MAP_READ, 0,
+                                                LARGE_COPY_SIZE, 0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  for (size_t i = 0; i < LARGE_COPY_SIZE; i++)
+    OCL_ASSERT(data[i] == large_copy_value(i, seed));
+  OCL_CALL(clEnqueueUnmapMemObject, queue, mem, data, 0, NULL, NULL);
+}
+
+static void runtime_large_buffer_copy(void)
+{
+  std::vector<uint8_t> host(LARGE_COPY_SIZE);
+  std::vector<uint8_t> read(LARGE_COPY_SIZE + 16);
+
+  for (size_t i = 0; i < LARGE_COPY_SIZE; i++)
+    host[i] = large_copy_value(i, 0);
+  OCL_CREATE_BUFFER(buf[0], 0, LARGE_COPY_SIZE, NULL);
+  OCL_CALL(clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, LARGE_COPY_SIZE, &host[0], 0, NULL, NULL);
+  large_buffer_check(buf[0], 0);
+
+  /* Rewrite all but the first 5 bytes, from a host pointer not aligned */
+  for (size_t i = 5; i < LARGE_COPY_SIZE; i++)
+    read[i + 3] = host[i] = large_copy_value(i, 0x5a);
+  OCL_CALL(clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 5, LARGE_COPY_SIZE - 5, &read[8], 0, NULL, NULL);
+  OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, LARGE_COPY_SIZE, &read[1], 0, NULL, NULL);
+  for (size_t i = 0; i < LARGE_COPY_SIZE; i++)
+    OCL_ASSERT(read[i + 1] == large_copy_value(i, i < 5 ? 0 : 0x5a));
+
+  /* Rectangles of rows shorter than their pitches, in both directions */
+  const size_t buffer_origin[3] = {7, 3, 1};
+  const size_t host_origin[3] = {1, 2, 0};
+  const size_t region[3] = {4093, 1000, 2};
+  const size_t row_pitch = 4200, slice_pitch = row_pitch * 1010;
+  const size_t host_row_pitch = 4100, host_slice_pitch = host_row_pitch * 1003;
+  for (size_t i = 0; i < LARGE_COPY_SIZE; i++)
+    host[i] = large_copy_value(i, 0xa5);
+  OCL_CALL(clEnqueueWriteBufferRect, queue, buf[0], CL_TRUE, buffer_origin, host_origin, region,
+           row_pitch, slice_pitch, host_row_pitch, host_slice_pitch, &host[0], 0, NULL, NULL);
+  std::fill(read.begin(), read.end(), 0);
+  OCL_CALL(clEnqueueReadBufferRect, queue, buf[0], CL_TRUE, buffer_origin, host_origin, region,
+           row_pitch, slice_pitch, host_row_pitch, host_slice_pitch, &read[0], 0, NULL, NULL);
+  for (size_t z = 0; z < region[2]; z++)
+  for (size_t y = 0; y < region[1]; y++) {
+    const size_t start = host_origin[0] + (host_origin[1] + y) * host_row_pitch +
+                         (host_origin[2] + z) * host_slice_pitch;
+    for (size_t x = 0; x < host_row_pitch; x++) {
+      const size_t i = start - host_origin[0] + x;
+      if (x >= host_origin[0] && x < host_origin[0] + region[0])
+        OCL_ASSERT(read[i] == host[i]);
+      else
+        OCL_ASSERT(read[i] == 0);
+    }
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_large_buffer_copy);
@@ -0,0 +1,173 @@
+#include "utest_helper.hpp"
+#include <stdio.h>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* NDRanges enqueued without a local size on a profiling queue, as many times
+ * as OCL_TUNE_LOCAL_SIZE measures the candidates and then some, with two sizes
+ * of local memory. Every local size chosen must divide the global size and
+ * run the whole groups. The tuned run also checks that the candidates are
+ * measured, that the tuned local size is kept and saved, and that another
+ * context loads the saved entries.
+ */
+#define TUNING_W          64
+#define TUNING_H          32
+#define TUNING_LAUNCHES   24
+#define TUNING_MEASURES   18    /* At most 6 candidates run 3 times each */
+
+typedef std::pair<size_t, size_t> local_size;
+
+static void local_size_tuning_check(const int *dst, size_t lx, size_t ly)
+{
+  for (size_t y = 0; y < TUNING_H; y++)
+    for (size_t x = 0; x < TUNING_W; x++) {
+      const size_t gx = x - x % lx, gy = y - y % ly;
+      const size_t m = lx * ly - 1 - (x % lx + (y % ly) * lx);
+      const int ref = (int)((gx + m % lx) + (gy + m / lx) * TUNING_W);
+      OCL_ASSERT(dst[x + y * TUNING_W] == ref);
+    }
+}
+
+/* Launch the kernel without local size and check the local size it got */
+static local_size local_size_tuning_launch(cl_command_queue q, cl_kernel k, cl_mem dst, cl_mem sizes)
+{
+  const size_t global[2] = {TUNING_W, TUNING_H};
+  size_t max_wg_sz = 0;
+  cl_int status;
+
+  OCL_CALL(clGetDeviceInfo, device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_wg_sz), &max_wg_sz, NULL);
+  OCL_CALL(clEnqueueNDRangeKernel, q, k, 2, NULL, global, NULL, 0, NULL, NULL);
+  OCL_CALL(clFinish, q);
+
+  int *data = (int *)clEnqueueMapBuffer(q, sizes, CL_TRUE, CL_MAP_READ, 0, 2 * sizeof(int),
+                                        0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  const size_t lx = data[0], ly = data[1];
+  OCL_CALL(clEnqueueUnmapMemObject, q, sizes, data, 0, NULL, NULL);
+  OCL_ASSERT(lx > 0 && ly > 0 && lx * ly <= max_wg_sz);
+  OCL_ASSERT(TUNING_W % lx == 0 && TUNING_H % ly == 0);
+
+  data = (int *)clEnqueueMapBuffer(q, dst, CL_TRUE, CL_MAP_READ, 0, TUNING_W * TUNING_H * sizeof(int),
+                                   0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  local_size_tuning_check(data, lx, ly);
+  OCL_CALL(clEnqueueUnmapMemObject, q, dst, data, 0, NULL, NULL);
+  return local_size(lx, ly);
+}
+
+/* The local sizes of the launches, for one and two ints of local memory per
+ * work item */
+static void local_size_tuning_run(std::vector<local_size> launched[2])
+{
+  size_t max_wg_sz = 0;
+  cl_int status;
+
+  OCL_CALL(clGetDeviceInfo, device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_wg_sz), &max_wg_sz, NULL);
+  cl_command_queue profiling_queue = clCreateCommandQueue(ctx, device, CL_QUEUE_PROFILING_ENABLE, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_CREATE_KERNEL("runtime_local_size_tuning");
+  OCL_CREATE_BUFFER(buf[0], 0, TUNING_W * TUNING_H * sizeof(int), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, 2 * sizeof(int), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+
+  for (int slm = 1; slm <= 2; slm++) {
+    OCL_SET_ARG(2, slm * max_wg_sz * sizeof(int), NULL);
+    for (int i = 0; i < TUNING_LAUNCHES; i++)
+      launched[slm - 1].push_back(local_size_tuning_launch(profiling_queue, kernel, buf[0], buf[1]));
+  }
+
+  OCL_CALL(clReleaseCommandQueue, profiling_queue);
+}
+
+static void runtime_local_size_tuning(void)
+{
+  std::vector<local_size> launched[2];
+  local_size_tuning_run(launched);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_local_size_tuning);
+
+static void runtime_local_size_tuning_tuned(void)
+{
+  const char *path = getenv("OCL_TUNE_LOCAL_SIZE_FILE");
+  std::vector<local_size> launched[2];
+  unsigned long long key = 0;
+  size_t saved[3] = {0, 0, 0};
+  size_t max_wg_sz = 0;
+  char line[256];
+  cl_int status;
+
+  OCL_ASSERT(path != NULL);
+  local_size_tuning_run(launched);
+
+  /* Several candidates are measured, then the fastest one is kept */
+  for (int slm = 0; slm < 2; slm++) {
+    const std::set<local_size> candidates(launched[slm].begin(), launched[slm].begin() + TUNING_MEASURES);
+    OCL_ASSERT(candidates.size() > 1);
+    OCL_ASSERT(candidates.count(launched[slm][TUNING_MEASURES]) == 1);
+    for (int i = TUNING_MEASURES; i < TUNING_LAUNCHES; i++)
+      OCL_ASSERT(launched[slm][i] == launched[slm][TUNING_MEASURES]);
+  }
+
+  /* One line per tuned entry, the last one with two ints of local memory */
+  FILE *file = fopen(path, "r");
+  OCL_ASSERT(file != NULL);
+  int line_n = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    OCL_ASSERT(sscanf(line, "%llx %zu %zu %zu", &key, &saved[0], &saved[1], &saved[2]) == 4);
+    line_n++;
+  }
+  fclose(file);
+  OCL_ASSERT(line_n == 2);
+  OCL_ASSERT(saved[0] == launched[1].back().first && saved[1] == launched[1].back().second &&
+             saved[2] == 1);
+
+  /* Another local size for the same key, the last line wins */
+  const local_size other = saved[0] == TUNING_W / 4 && saved[1] == 1 ? local_size(TUNING_W / 8, 2)
+                                                                        : local_size(TUNING_W / 4, 1);
+  file = fopen(path, "a");
+  OCL_ASSERT(file != NULL);
+  fprintf(file, "%016llx %zu %zu 1\n", key, other.first, other.second);
+  fclose(file);
+
+  /* A new context starts with it, even on a queue without profiling */
+  size_t source_sz = 0;
+  OCL_CALL(clGetProgramInfo, program, CL_PROGRAM_SOURCE, 0, NULL, &source_sz);
+  std::string source(source_sz, '\0');
+  OCL_CALL(clGetProgramInfo, program, CL_PROGRAM_SOURCE, source_sz, &source[0], NULL);
+  const char *src = source.c_str();
+
+  cl_context other_ctx = clCreateContext(NULL, 1, &device, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  cl_command_queue other_queue = clCreateCommandQueue(other_ctx, device, 0, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  cl_program other_program = clCreateProgramWithSource(other_ctx, 1, &src, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  OCL_CALL(clBuildProgram, other_program, 1, &device, NULL, NULL, NULL);
+  cl_kernel other_kernel = clCreateKernel(other_program, "runtime_local_size_tuning", &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  cl_mem dst = clCreateBuffer(other_ctx, 0, TUNING_W * TUNING_H * sizeof(int), NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  cl_mem sizes = clCreateBuffer(other_ctx, 0, 2 * sizeof(int), NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_CALL(clGetDeviceInfo, device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_wg_sz), &max_wg_sz, NULL);
+  OCL_CALL(clSetKernelArg, other_kernel, 0, sizeof(cl_mem), &dst);
+  OCL_CALL(clSetKernelArg, other_kernel, 1, sizeof(cl_mem), &sizes);
+  OCL_CALL(clSetKernelArg, other_kernel, 2, 2 * max_wg_sz * sizeof(int), NULL);
+  OCL_ASSERT(local_size_tuning_launch(other_queue, other_kernel, dst, sizes) == other);
+
+  OCL_CALL(clReleaseMemObject, sizes);
+  OCL_CALL(clReleaseMemObject, dst);
+  OCL_CALL(clReleaseKernel, other_kernel);
+  OCL_CALL(clReleaseProgram, other_program);
+  OCL_CALL(clReleaseCommandQueue, other_queue);
+  OCL_CALL(clReleaseContext, other_ctx);
+}
+
+MAKE_UTEST_FROM_FUNCTION_WITH_ENV(runtime_local_size_tuning_tuned,
+                                  "OCL_TUNE_LOCAL_SIZE=1 OCL_TUNE_LOCAL_SIZE_FILE=%T/local_size");
@@ -0,0 +1,141 @@
+#include "utest_helper.hpp"
+#include <sched.h>
+
+/* Deep graphs of events on an out of order queue and an in order queue, all
+ * waiting for a user event. The enqueued events are counted down by the
+ * events they wait for. Every event must complete after the events of its wait
+ * list, and the in order queue in its order.
+ */
+#define OOO_EVENT_NUM   1024
+
+static cl_event ooo_events[OOO_EVENT_NUM];
+static cl_event in_order_events[OOO_EVENT_NUM];
+static volatile int ooo_complete_num = 0;
+static int ooo_complete_order[2 * OOO_EVENT_NUM];
+
+static void CL_CALLBACK ooo_event_complete(cl_event event, cl_int status, void *user_data)
+{
+  OCL_ASSERT(status == CL_COMPLETE);
+  ooo_complete_order[(intptr_t)user_data] = __sync_fetch_and_add(&ooo_complete_num, 1);
+}
+
+/* An earlier event of the out of order queue */
+static int ooo_depend(int i)
+{
+  return 7919 % i;
+}
+
+static void runtime_out_of_order_events(void)
+{
+  cl_int status;
+  cl_command_queue ooo_queue = clCreateCommandQueue(ctx, device, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  cl_event gate = clCreateUserEvent(ctx, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  ooo_complete_num = 0;
+  for (int i = 0; i < OOO_EVENT_NUM; i++) {
+    cl_event wait_list[3] = {gate};
+    cl_uint wait_num = 1;
+    if (i > 0)
+      wait_list[wait_num++] = ooo_events[ooo_depend(i)];
+    if (i > 1 && i % 2 == 0)
+      wait_list[wait_num++] = ooo_events[i - 1];
+    OCL_CALL(clEnqueueMarkerWithWaitList, ooo_queue, wait_num, wait_list, &ooo_events[i]);
+    OCL_CALL(clSetEventCallback, ooo_events[i], CL_COMPLETE, ooo_event_complete, (void *)(intptr_t)i);
+
+    /* The in order queue waits for the events in the other order */
+    cl_event cross = ooo_events[OOO_EVENT_NUM - 1 - i < i ? OOO_EVENT_NUM - 1 - i : i];
+    OCL_CALL(clEnqueueMarkerWithWaitList, queue, 1, &cross, &in_order_events[i]);
+    OCL_CALL(clSetEventCallback, in_order_events[i], CL_COMPLETE, ooo_event_complete,
+             (void *)(intptr_t)(OOO_EVENT_NUM + i));
+  }
+
+  OCL_CALL(clGetEventInfo, ooo_events[OOO_EVENT_NUM - 1], CL_EVENT_COMMAND_EXECUTION_STATUS,
+           sizeof(status), &status, NULL);
+  OCL_ASSERT(status > CL_COMPLETE);
+  OCL_ASSERT(ooo_complete_num == 0);
+
+  OCL_CALL(clSetUserEventStatus, gate, CL_COMPLETE);
+  OCL_CALL(clFinish, ooo_queue);
+  OCL_CALL(clFinish, queue);
+  /* The callbacks may still run after the status is seen complete */
+  while (ooo_complete_num < 2 * OOO_EVENT_NUM)
+    sched_yield();
+
+  for (int i = 1; i < OOO_EVENT_NUM; i++) {
+    OCL_ASSERT(ooo_complete_order[ooo_depend(i)] < ooo_complete_order[i]);
+    if (i > 1 && i % 2 == 0)
+      OCL_ASSERT(ooo_complete_order[i - 1] < ooo_complete_order[i]);
+    OCL_ASSERT(ooo_complete_order[OOO_EVENT_NUM + i - 1] < ooo_complete_order[OOO_EVENT_NUM + i]);
+  }
+
+  for (int i = 0; i < OOO_EVENT_NUM; i++) {
+    OCL_CALL(clReleaseEvent, ooo_events[i]);
+    OCL_CALL(clReleaseEvent, in_order_events[i]);
+  }
+  OCL_CALL(clReleaseEvent, gate);
+  OCL_CALL(clReleaseCommandQueue, ooo_queue);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_out_of_order_events);
+
+static volatile int ooo_error_num = 0;
+
+static void CL_CALLBACK ooo_event_error(cl_event event, cl_int status, void *user_data)
+{
+  OCL_ASSERT(status < CL_COMPLETE);
+  __sync_fetch_and_add(&ooo_error_num, 1);
+}
+
+/* The same graphs with the user event set to an error, which must reach every
+ * event counted down from it instead of CL_COMPLETE
+ */
+static void runtime_out_of_order_events_error(void)
+{
+  cl_int status;
+  cl_command_queue ooo_queue = clCreateCommandQueue(ctx, device, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  cl_event gate = clCreateUserEvent(ctx, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  ooo_error_num = 0;
+  for (int i = 0; i < OOO_EVENT_NUM; i++) {
+    cl_event wait_list[2];
+    cl_uint wait_num = 0;
+    /* Only the first event waits for the gate itself */
+    wait_list[wait_num++] = i > 0 ? ooo_events[ooo_depend(i)] : gate;
+    if (i > 1 && i % 2 == 0)
+      wait_list[wait_num++] = ooo_events[i - 1];
+    OCL_CALL(clEnqueueMarkerWithWaitList, ooo_queue, wait_num, wait_list, &ooo_events[i]);
+    OCL_CALL(clSetEventCallback, ooo_events[i], CL_COMPLETE, ooo_event_error, NULL);
+
+    cl_event cross = ooo_events[OOO_EVENT_NUM - 1 - i < i ? OOO_EVENT_NUM - 1 - i : i];
+    OCL_CALL(clEnqueueMarkerWithWaitList, queue, 1, &cross, &in_order_events[i]);
+    OCL_CALL(clSetEventCallback, in_order_events[i], CL_COMPLETE, ooo_event_error, NULL);
+  }
+
+  OCL_CALL(clSetUserEventStatus, gate, -1);
+  clFinish(ooo_queue);
+  clFinish(queue);
+  while (ooo_error_num < 2 * OOO_EVENT_NUM)
+    sched_yield();
+
+  for (int i = 0; i < OOO_EVENT_NUM; i++) {
+    OCL_CALL(clGetEventInfo, ooo_events[i], CL_EVENT_COMMAND_EXECUTION_STATUS,
+             sizeof(status), &status, NULL);
+    OCL_ASSERT(status < CL_COMPLETE);
+    OCL_CALL(clGetEventInfo, in_order_events[i], CL_EVENT_COMMAND_EXECUTION_STATUS,
+             sizeof(status), &status, NULL);
+    OCL_ASSERT(status < CL_COMPLETE);
+  }
+
+  for (int i = 0; i < OOO_EVENT_NUM; i++) {
+    OCL_CALL(clReleaseEvent, ooo_events[i]);
+    OCL_CALL(clReleaseEvent, in_order_events[i]);
+  }
+  OCL_CALL(clReleaseEvent, gate);
+  OCL_CALL(clReleaseCommandQueue, ooo_queue);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_out_of_order_events_error);
@@ -0,0 +1,84 @@
+#include "utest_helper.hpp"
+#include <pthread.h>
+
+/* Build programs from several threads at the same time and check that every
+ * kernel computes what its own source says.
+ */
+#define BUILD_THREAD_NUM  8
+#define BUILD_PER_THREAD  4
+#define BUILD_DATA_SIZE   64
+
+static cl_program parallel_programs[BUILD_THREAD_NUM][BUILD_PER_THREAD];
+
+static void *build_thread_function(void *arg)
+{
+  int id = *((int *)arg);
+  char source[512];
+
+  for (int i = 0; i < BUILD_PER_THREAD; i++) {
+    const int value = id * BUILD_PER_THREAD + i;
+    snprintf(source, sizeof(source),
+             "kernel void parallel_build(global int *dst, global const int *src)\n"
+             "{\n"
+             "  int gid = get_global_id(0);\n"
+             "  int v = src[gid];\n"
+             "  for (int i = 0; i < %d; i++)\n"
+             "    v = v * 3 + %d;\n"
+             "  dst[gid] = v + %d;\n"
+             "}\n", i + 1, id, value);
+    const char *str = source;
+    cl_int status;
+    cl_program program = clCreateProgramWithSource(ctx, 1, &str, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    OCL_ASSERT(clBuildProgram(program, 1, &device, NULL, NULL, NULL) == CL_SUCCESS);
+    parallel_programs[id][i] = program;
+  }
+  return NULL;
+}
+
+void runtime_parallel_build(void)
+{
+  pthread_t tid[BUILD_THREAD_NUM];
+  int ids[BUILD_THREAD_NUM];
+
+  for (int t = 0; t < BUILD_THREAD_NUM; t++) {
+    ids[t] = t;
+    OCL_ASSERT(pthread_create(&tid[t], NULL, build_thread_function, &ids[t]) == 0);
+  }
+  for (int t = 0; t < BUILD_THREAD_NUM; t++)
+    pthread_join(tid[t], NULL);
+
+  OCL_CREATE_BUFFER(buf[0], 0, BUILD_DATA_SIZE * sizeof(int), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, BUILD_DATA_SIZE * sizeof(int), NULL);
+  OCL_MAP_BUFFER(1);
+  for (int j = 0; j < BUILD_DATA_SIZE; j++)
+    ((int *)buf_data[1])[j] = j;
+  OCL_UNMAP_BUFFER(1);
+  globals[0] = BUILD_DATA_SIZE;
+  locals[0] = 16;
+
+  for (int t = 0; t < BUILD_THREAD_NUM; t++) {
+    for (int i = 0; i < BUILD_PER_THREAD; i++) {
+      cl_int status;
+      cl_kernel k = clCreateKernel(parallel_programs[t][i], "parallel_build", &status);
+      OCL_ASSERT(status == CL_SUCCESS);
+      OCL_CALL(clSetKernelArg, k, 0, sizeof(cl_mem), &buf[0]);
+      OCL_CALL(clSetKernelArg, k, 1, sizeof(cl_mem), &buf[1]);
+      OCL_CALL(clEnqueueNDRangeKernel, queue, k, 1, NULL, globals, locals, 0, NULL, NULL);
+
+      OCL_MAP_BUFFER(0);
+      for (int j = 0; j < BUILD_DATA_SIZE; j++) {
+        int v = j;
+        for (int n = 0; n < i + 1; n++)
+          v = v * 3 + t;
+        OCL_ASSERT(((int *)buf_data[0])[j] == v + t * BUILD_PER_THREAD + i);
+      }
+      OCL_UNMAP_BUFFER(0);
+
+      clReleaseKernel(k);
+      clReleaseProgram(parallel_programs[t][i]);
+    }
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_parallel_build);
@@ -0,0 +1,96 @@
+#include "utest_helper.hpp"
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+/* Builds of the same source with OCL_PROGRAM_CACHE_DIR set. The second build
+ * is served from the cache: the entry is only touched, not stored again, and
+ * the kernel still runs right. Other build options get another entry.
+ */
+#define CACHE_N  64
+
+static const char program_cache_source[] =
+  "kernel void runtime_program_cache(global int *dst, int a) {\n"
+  "  int i = get_global_id(0);\n"
+  "  dst[i] = i * SCALE + a;\n"
+  "}\n";
+
+static std::vector<std::string> program_cache_entries(const char *dir_path)
+{
+  std::vector<std::string> entries;
+  DIR *dir = opendir(dir_path);
+  struct dirent *entry;
+
+  OCL_ASSERT(dir != NULL);
+  while ((entry = readdir(dir)) != NULL) {
+    const size_t len = strlen(entry->d_name);
+    if (len > 4 && strcmp(entry->d_name + len - 4, ".bin") == 0)
+      entries.push_back(std::string(dir_path) + "/" + entry->d_name);
+  }
+  closedir(dir);
+  return entries;
+}
+
+/* Build the source with -D SCALE=scale and check the kernel */
+static void program_cache_build_run(int scale)
+{
+  const char *source = program_cache_source;
+  const int a = 11;
+  char options[32];
+  cl_int status;
+
+  snprintf(options, sizeof(options), "-D SCALE=%d", scale);
+  cl_program prog = clCreateProgramWithSource(ctx, 1, &source, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  OCL_CALL(clBuildProgram, prog, 1, &device, options, NULL, NULL);
+  cl_kernel k = clCreateKernel(prog, "runtime_program_cache", &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_CREATE_BUFFER(buf[0], 0, CACHE_N * sizeof(int), NULL);
+  OCL_CALL(clSetKernelArg, k, 0, sizeof(cl_mem), &buf[0]);
+  OCL_CALL(clSetKernelArg, k, 1, sizeof(int), &a);
+  globals[0] = CACHE_N;
+  locals[0] = 16;
+  OCL_CALL(clEnqueueNDRangeKernel, queue, k, 1, NULL, globals, locals, 0, NULL, NULL);
+  OCL_MAP_BUFFER(0);
+  for (int i = 0; i < CACHE_N; i++)
+    OCL_ASSERT(((int *)buf_data[0])[i] == i * scale + a);
+  OCL_UNMAP_BUFFER(0);
+  OCL_CALL(clReleaseMemObject, buf[0]);
+  buf[0] = NULL;
+
+  OCL_CALL(clReleaseKernel, k);
+  OCL_CALL(clReleaseProgram, prog);
+}
+
+static void runtime_program_cache(void)
+{
+  const char *dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  struct stat before, after;
+
+  OCL_ASSERT(dir != NULL);
+  program_cache_build_run(3);
+  std::vector<std::string> entries = program_cache_entries(dir);
+  OCL_ASSERT(entries.size() == 1);
+
+  /* Age the entry, a hit touches it and a miss replaces it */
+  const struct timeval old[2] = {{1000, 0}, {1000, 0}};
+  OCL_ASSERT(utimes(entries[0].c_str(), old) == 0);
+  OCL_ASSERT(stat(entries[0].c_str(), &before) == 0);
+  program_cache_build_run(3);
+  OCL_ASSERT(program_cache_entries(dir).size() == 1);
+  OCL_ASSERT(stat(entries[0].c_str(), &after) == 0);
+  OCL_ASSERT(after.st_ino == before.st_ino);
+  OCL_ASSERT(after.st_mtime > before.st_mtime);
+
+  /* Other options miss */
+  program_cache_build_run(5);
+  OCL_ASSERT(program_cache_entries(dir).size() == 2);
+  OCL_ASSERT(stat(entries[0].c_str(), &after) == 0);
+  OCL_ASSERT(after.st_ino == before.st_ino);
+}
+
+MAKE_UTEST_FROM_FUNCTION_WITH_ENV(runtime_program_cache, "OCL_PROGRAM_CACHE_DIR=%T/cache");
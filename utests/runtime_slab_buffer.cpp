@@ -0,0 +1,136 @@
+#include "utest_helper.hpp"
+#include <vector>
+
+/* Many small buffers share the bos of the slab allocator. Every buffer must
+ * keep its own data through the writes, maps, kernels and sub-buffers, also
+ * when the buffers around it are released and their slots reused.
+ */
+#define SLAB_BUFFER_NUM  64
+
+/* 16 to 4096 bytes */
+static size_t slab_buffer_size(int i)
+{
+  return 16 << (i % 9);
+}
+
+static uint32_t slab_value(int i, uint32_t j)
+{
+  return i * 0x10000 + j;
+}
+
+static void slab_buffer_check(cl_mem mem, int i)
+{
+  const uint32_t n = slab_buffer_size(i) / sizeof(uint32_t);
+  cl_int status;
+  uint32_t *data = (uint32_t *)clEnqueueMapBuffer(queue, mem, CL_TRUE, CL_MAP_READ, 0,
+                                                  n * sizeof(uint32_t), 0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  for (uint32_t j = 0; j < n; j++)
+    OCL_ASSERT(data[j] == slab_value(i, j));
+  OCL_CALL(clEnqueueUnmapMemObject, queue, mem, data, 0, NULL, NULL);
+}
+
+void runtime_slab_buffer(void)
+{
+  cl_mem bufs[SLAB_BUFFER_NUM];
+  std::vector<uint32_t> host(4096 / sizeof(uint32_t));
+  cl_int status;
+
+  for (int i = 0; i < SLAB_BUFFER_NUM; i++) {
+    for (uint32_t j = 0; j < host.size(); j++)
+      host[j] = slab_value(i, j);
+    bufs[i] = clCreateBuffer(ctx, CL_MEM_COPY_HOST_PTR, slab_buffer_size(i), &host[0], &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+  }
+
+  /* Reuse the slots of every other buffer, written with a map */
+  for (int i = 1; i < SLAB_BUFFER_NUM; i += 2) {
+    const uint32_t n = slab_buffer_size(i) / sizeof(uint32_t);
+    OCL_CALL(clReleaseMemObject, bufs[i]);
+    bufs[i] = clCreateBuffer(ctx, 0, slab_buffer_size(i), NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    uint32_t *data = (uint32_t *)clEnqueueMapBuffer(queue, bufs[i], CL_TRUE, CL_MAP_WRITE, 0,
+                                                    n * sizeof(uint32_t), 0, NULL, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    for (uint32_t j = 0; j < n; j++)
+      data[j] = slab_value(i, j);
+    OCL_CALL(clEnqueueUnmapMemObject, queue, bufs[i], data, 0, NULL, NULL);
+  }
+
+  /* Copy every buffer with a kernel into a new one */
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  for (int i = 0; i < SLAB_BUFFER_NUM; i++) {
+    cl_mem dst = clCreateBuffer(ctx, 0, slab_buffer_size(i), NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    OCL_SET_ARG(0, sizeof(cl_mem), &bufs[i]);
+    OCL_SET_ARG(1, sizeof(cl_mem), &dst);
+    globals[0] = slab_buffer_size(i) / sizeof(float);
+    locals[0] = 4;
+    OCL_NDRANGE(1);
+    OCL_CALL(clReleaseMemObject, bufs[i]);
+    bufs[i] = dst;
+  }
+
+  /* Write the second half of the largest buffers through a sub-buffer */
+  for (int i = 8; i < SLAB_BUFFER_NUM; i += 9) {
+    const cl_buffer_region region = {2048, 2048};
+    cl_mem sub = clCreateSubBuffer(bufs[i], 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    for (uint32_t j = 0; j < 512; j++)
+      host[j] = slab_value(i, 512 + j) + 1;
+    OCL_CALL(clEnqueueWriteBuffer, queue, sub, CL_TRUE, 0, 2048, &host[0], 0, NULL, NULL);
+    OCL_CALL(clEnqueueReadBuffer, queue, bufs[i], CL_TRUE, 2048, 2048, &host[0], 0, NULL, NULL);
+    for (uint32_t j = 0; j < 512; j++) {
+      OCL_ASSERT(host[j] == slab_value(i, 512 + j) + 1);
+      host[j] = slab_value(i, 512 + j);
+    }
+    OCL_CALL(clEnqueueWriteBuffer, queue, sub, CL_TRUE, 0, 2048, &host[0], 0, NULL, NULL);
+    OCL_CALL(clReleaseMemObject, sub);
+  }
+
+  for (int i = 0; i < SLAB_BUFFER_NUM; i++) {
+    slab_buffer_check(bufs[i], i);
+    OCL_CALL(clReleaseMemObject, bufs[i]);
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_slab_buffer);
+
+/* A NDRange waiting for a user event still writes the buffer it was given,
+ * released in between: its slot must not be given to a new buffer before */
+void runtime_slab_buffer_deferred(void)
+{
+  const size_t n = slab_buffer_size(2) / sizeof(uint32_t);
+  std::vector<uint32_t> host(n);
+  cl_int status;
+
+  for (uint32_t j = 0; j < n; j++)
+    host[j] = slab_value(1, j);
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  OCL_CREATE_BUFFER(buf[0], CL_MEM_COPY_HOST_PTR, n * sizeof(uint32_t), &host[0]);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(uint32_t), NULL);
+  OCL_CREATE_BUFFER(buf[2], 0, n * sizeof(uint32_t), NULL);
+  cl_event gate = clCreateUserEvent(ctx, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  globals[0] = n;
+  locals[0] = 16;
+  OCL_CALL(clEnqueueNDRangeKernel, queue, kernel, 1, NULL, globals, locals, 1, &gate, NULL);
+
+  /* The kernel and the application drop the destination */
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[2]);
+  OCL_CALL(clReleaseMemObject, buf[1]);
+  for (uint32_t j = 0; j < n; j++)
+    host[j] = slab_value(2, j);
+  buf[1] = clCreateBuffer(ctx, CL_MEM_COPY_HOST_PTR, n * sizeof(uint32_t), &host[0], &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_CALL(clSetUserEventStatus, gate, CL_COMPLETE);
+  OCL_FINISH();
+  OCL_CALL(clReleaseEvent, gate);
+  slab_buffer_check(buf[1], 2);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_slab_buffer_deferred);
@@ -0,0 +1,242 @@
+#include "utest_helper.hpp"
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+/* The reads and writes of tiled images are tiled and detiled on the CPU. The
+ * GPU accesses the images through the sampler, and the bo of the images is
+ * also read raw through a buffer sharing it, and detiled by the reference
+ * below. The images written by the GPU check the reference against the
+ * hardware, the ones written by the CPU check the CPU tiling against the
+ * reference. The X and Y tiles are tested with OCL_TILING set to 1 and 2.
+ */
+#define TILED_W  333
+#define TILED_H  77
+#define TILED_D  5
+
+struct tiled_layout {
+  size_t tile_w, tile_h;        /* In bytes and rows */
+  bool y_major;
+};
+
+static const tiled_layout tiled_x = {512, 8, false};
+static const tiled_layout tiled_y = {128, 32, true};
+
+/* Offset in the bo of the byte x of the row y of the linear space, with the
+ * bit 6 swizzling none, 9 or 9_10. The bit 17 modes are 9 or 9_10 on each
+ * page, which is a tile.
+ */
+static size_t tiled_reference_offset(const tiled_layout &layout, int swizzle,
+                                     size_t pitch, size_t x, size_t y)
+{
+  const size_t tile = (y / layout.tile_h) * (pitch / layout.tile_w) + x / layout.tile_w;
+  const size_t x_in = x % layout.tile_w, y_in = y % layout.tile_h;
+  size_t offset = tile * layout.tile_w * layout.tile_h;
+
+  if (layout.y_major)
+    offset += (x_in / 16) * 16 * layout.tile_h + y_in * 16 + x_in % 16;
+  else
+    offset += y_in * layout.tile_w + x_in;
+  if (swizzle == 1)
+    offset ^= ((offset >> 9) & 1) << 6;
+  else if (swizzle == 2)
+    offset ^= (((offset >> 9) ^ (offset >> 10)) & 1) << 6;
+  return offset;
+}
+
+static uint32_t tiled_value(size_t x, size_t y, size_t z)
+{
+  return (z << 24) | (y << 12) | x;
+}
+
+static cl_mem tiled_image_new(cl_mem_object_type type, size_t depth)
+{
+  cl_image_format format;
+  cl_image_desc desc;
+  cl_int status;
+
+  memset(&desc, 0x0, sizeof(cl_image_desc));
+  memset(&format, 0x0, sizeof(cl_image_format));
+  format.image_channel_order = CL_R;
+  format.image_channel_data_type = CL_UNSIGNED_INT32;
+  desc.image_type = type;
+  desc.image_width = TILED_W;
+  desc.image_height = TILED_H;
+  desc.image_depth = depth;
+  cl_mem image = clCreateImage(ctx, 0, &format, &desc, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  return image;
+}
+
+/* Write the image with regions which start and end in the middle of tiles */
+static void tiled_image_write(cl_mem image, size_t depth)
+{
+  const size_t xs[] = {0, 5, 128, 200, TILED_W};
+  const size_t ys[] = {0, 3, 32, 40, TILED_H};
+  const size_t host_row_pitch = (TILED_W + 7) * sizeof(uint32_t);
+  std::vector<uint32_t> host((TILED_W + 7) * TILED_H * depth);
+
+  for (size_t i = 0; i + 1 < sizeof(xs) / sizeof(xs[0]); i++)
+  for (size_t j = 0; j + 1 < sizeof(ys) / sizeof(ys[0]); j++) {
+    const size_t origin[3] = {xs[i], ys[j], 0};
+    const size_t region[3] = {xs[i + 1] - xs[i], ys[j + 1] - ys[j], depth};
+    const size_t host_slice_pitch = host_row_pitch * region[1];
+    for (size_t z = 0; z < region[2]; z++)
+    for (size_t y = 0; y < region[1]; y++)
+    for (size_t x = 0; x < region[0]; x++)
+      host[(z * host_slice_pitch + y * host_row_pitch) / sizeof(uint32_t) + x] =
+        tiled_value(origin[0] + x, origin[1] + y, z);
+    OCL_CALL(clEnqueueWriteImage, queue, image, CL_TRUE, origin, region,
+             host_row_pitch, host_slice_pitch, &host[0], 0, NULL, NULL);
+  }
+}
+
+/* Read regions of the image and check them against the whole image */
+static void tiled_image_read(cl_mem image, size_t depth)
+{
+  const size_t origins[][3] = {{0, 0, 0}, {3, 1, 0}, {100, 31, 0}, {257, 60, 0}};
+  std::vector<uint32_t> host(TILED_W * TILED_H * depth);
+
+  for (size_t i = 0; i < sizeof(origins) / sizeof(origins[0]); i++) {
+    const size_t *origin = origins[i];
+    const size_t region[3] = {TILED_W - origin[0], TILED_H - origin[1], depth};
+    OCL_CALL(clEnqueueReadImage, queue, image, CL_TRUE, origin, region,
+             0, 0, &host[0], 0, NULL, NULL);
+    for (size_t z = 0; z < region[2]; z++)
+    for (size_t y = 0; y < region[1]; y++)
+    for (size_t x = 0; x < region[0]; x++)
+      OCL_ASSERT(host[(z * region[1] + y) * region[0] + x] ==
+                 tiled_value(origin[0] + x, origin[1] + y, z));
+  }
+}
+
+static void tiled_buffer_check(cl_mem buffer, size_t depth)
+{
+  cl_int status;
+  uint32_t *data = (uint32_t *)clEnqueueMapBuffer(queue, buffer, CL_TRUE, CL_MAP_READ, 0,
+                                                  TILED_W * TILED_H * depth * sizeof(uint32_t),
+                                                  0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  for (size_t z = 0; z < depth; z++)
+  for (size_t y = 0; y < TILED_H; y++)
+  for (size_t x = 0; x < TILED_W; x++)
+    OCL_ASSERT(data[(z * TILED_H + y) * TILED_W + x] == tiled_value(x, y, z));
+  OCL_CALL(clEnqueueUnmapMemObject, queue, buffer, data, 0, NULL, NULL);
+}
+
+/* Detile the raw bo of the image, each tile must match with a swizzling */
+static void tiled_image_raw_check(cl_mem image, size_t depth, const tiled_layout &layout)
+{
+  static clGetMemObjectFdIntel_fn get_fd = NULL;
+  static clCreateBufferFromFdINTEL_fn buffer_from_fd = NULL;
+  size_t pitch, slice_pitch;
+  cl_int status;
+  int fd;
+
+  if (get_fd == NULL) {
+    get_fd = (clGetMemObjectFdIntel_fn)
+      clGetExtensionFunctionAddressForPlatform(platform, "clGetMemObjectFdIntel");
+    buffer_from_fd = (clCreateBufferFromFdINTEL_fn)
+      clGetExtensionFunctionAddressForPlatform(platform, "clCreateBufferFromFdINTEL");
+  }
+  OCL_ASSERT(get_fd != NULL && buffer_from_fd != NULL);
+  OCL_CALL(clGetImageInfo, image, CL_IMAGE_ROW_PITCH, sizeof(pitch), &pitch, NULL);
+  OCL_CALL(clGetImageInfo, image, CL_IMAGE_SLICE_PITCH, sizeof(slice_pitch), &slice_pitch, NULL);
+  /* The slices follow each other in the linear space */
+  const size_t slice_rows = depth > 1 ? slice_pitch / pitch : 0;
+  const size_t rows = (depth - 1) * slice_rows + TILED_H;
+  const size_t size = pitch * ((rows + layout.tile_h - 1) / layout.tile_h * layout.tile_h);
+
+  OCL_CALL(get_fd, ctx, image, &fd);
+  cl_import_buffer_info_intel info = {fd, (int)size};
+  cl_mem raw = buffer_from_fd(ctx, &info, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  close(fd);
+  const char *data = (const char *)clEnqueueMapBuffer(queue, raw, CL_TRUE, CL_MAP_READ, 0, size,
+                                                      0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  /* The swizzlings still matching each tile */
+  std::vector<int> swizzles(size / (layout.tile_w * layout.tile_h), 0x7);
+  for (size_t z = 0; z < depth; z++)
+  for (size_t y = 0; y < TILED_H; y++)
+  for (size_t x = 0; x < TILED_W; x++) {
+    const size_t row = z * slice_rows + y, x_bytes = x * sizeof(uint32_t);
+    const size_t tile = tiled_reference_offset(layout, 0, pitch, x_bytes, row) /
+                        (layout.tile_w * layout.tile_h);
+    for (int swizzle = 0; swizzle < 3; swizzle++) {
+      uint32_t value;
+      memcpy(&value, data + tiled_reference_offset(layout, swizzle, pitch, x_bytes, row),
+             sizeof(value));
+      if (value != tiled_value(x, y, z))
+        swizzles[tile] &= ~(1 << swizzle);
+    }
+    OCL_ASSERT(swizzles[tile] != 0);
+  }
+  OCL_CALL(clEnqueueUnmapMemObject, queue, raw, (void *)data, 0, NULL, NULL);
+  OCL_CALL(clReleaseMemObject, raw);
+}
+
+static void tiled_image_copy(const tiled_layout &layout)
+{
+  /* 2D: written by the CPU and read by the GPU */
+  OCL_CREATE_KERNEL_FROM_FILE("runtime_tiled_image_copy", "runtime_tiled_image2d_to_buffer");
+  OCL_CREATE_BUFFER(buf[0], 0, TILED_W * TILED_H * TILED_D * sizeof(uint32_t), NULL);
+  buf[1] = tiled_image_new(CL_MEM_OBJECT_IMAGE2D, 0);
+  tiled_image_write(buf[1], 1);
+  tiled_image_raw_check(buf[1], 1, layout);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[0]);
+  globals[0] = TILED_W;
+  globals[1] = TILED_H;
+  locals[0] = 1;
+  locals[1] = 1;
+  OCL_NDRANGE(2);
+  tiled_buffer_check(buf[0], 1);
+  OCL_CALL(clReleaseMemObject, buf[1]);
+
+  /* 2D: written by the GPU and read by the CPU */
+  OCL_CREATE_KERNEL_FROM_FILE("runtime_tiled_image_copy", "runtime_tiled_buffer_to_image2d");
+  buf[1] = tiled_image_new(CL_MEM_OBJECT_IMAGE2D, 0);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_NDRANGE(2);
+  tiled_image_raw_check(buf[1], 1, layout);
+  tiled_image_read(buf[1], 1);
+  OCL_CALL(clReleaseMemObject, buf[1]);
+  buf[1] = NULL;
+  if (!layout.y_major)
+    return;
+
+  /* 3D: written by the CPU, read by the GPU and by the CPU */
+  OCL_CREATE_KERNEL_FROM_FILE("runtime_tiled_image_copy", "runtime_tiled_image3d_to_buffer");
+  buf[1] = tiled_image_new(CL_MEM_OBJECT_IMAGE3D, TILED_D);
+  tiled_image_write(buf[1], TILED_D);
+  tiled_image_raw_check(buf[1], TILED_D, layout);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[0]);
+  globals[2] = TILED_D;
+  locals[2] = 1;
+  OCL_NDRANGE(3);
+  tiled_buffer_check(buf[0], TILED_D);
+  tiled_image_read(buf[1], TILED_D);
+  OCL_CALL(clReleaseMemObject, buf[1]);
+  buf[1] = NULL;
+  globals[2] = locals[2] = 0;
+}
+
+/* OCL_TILING is read once, each tiling gets its own process */
+static void runtime_tiled_image_copy_x(void)
+{
+  tiled_image_copy(tiled_x);
+}
+
+MAKE_UTEST_FROM_FUNCTION_WITH_ENV(runtime_tiled_image_copy_x, "OCL_TILING=1");
+
+/* The 3D images of SKL can't be X tiled, they are only tested Y tiled */
+static void runtime_tiled_image_copy_y(void)
+{
+  tiled_image_copy(tiled_y);
+}
+
+MAKE_UTEST_FROM_FUNCTION_WITH_ENV(runtime_tiled_image_copy_y, "OCL_TILING=2");
@@ -35,8 +35,11 @@
 #include <random>
 #include <chrono>
 #include <iterator>
+#include <sstream>
 #include <semaphore.h>
 #include <unistd.h>
+#include <ftw.h>
+#include <sys/wait.h>
 
 struct signalMap
 {
@@ -53,6 +56,11 @@ RStatistics UTest::retStatistics;
 
 void releaseUTestList(void) { delete UTest::utestList; }
 void runSummaryAtExit(void) {
+  // The process running a single test for another one has no summary
+  if (getenv("UTEST_CHILD") != NULL) {
+    releaseUTestList();
+    return;
+  }
   // If case crashes, count it as fail, and accumulate finishrun
   if(UTest::retStatistics.finishrun != UTest::utestList->size()) {
     UTest::retStatistics.finishrun++;
@@ -139,8 +147,10 @@ void *multithread(void * arg)
 }
 
 
-UTest::UTest(Function fn, const char *name, bool isBenchMark, bool haveIssue, bool needDestroyProgram)
-       : fn(fn), name(name), isBenchMark(isBenchMark), haveIssue(haveIssue), needDestroyProgram(needDestroyProgram) {
+UTest::UTest(Function fn, const char *name, bool isBenchMark, bool haveIssue, bool needDestroyProgram,
+             const char *env)
+       : fn(fn), name(name), isBenchMark(isBenchMark), haveIssue(haveIssue), needDestroyProgram(needDestroyProgram),
+         env(env) {
 
   if (utestList == NULL) {
     utestList = new vector<UTest>;
@@ -157,13 +167,68 @@ static bool strequal(const char *s1, const char *s2) {
   return false;
 }
 
+static int removeTmpFile(const char *path, const struct stat *sb, int flag, struct FTW *ftw) {
+  return remove(path);
+}
+
+void UTest::do_run_child(struct UTest utest){
+  char tmpDir[] = "/tmp/utest_XXXXXX";
+  vector<string> vars;
+  int status = -1;
+
+  if (mkdtemp(tmpDir) == NULL) {
+    perror("Could not create the temporary directory");
+    tmpDir[0] = '\0';
+  }
+  string env = utest.env;
+  for (size_t pos = 0; (pos = env.find("%T", pos)) != string::npos; )
+    env.replace(pos, 2, tmpDir);
+  istringstream vars_in(env);
+  copy(istream_iterator<string>(vars_in), istream_iterator<string>(), back_inserter(vars));
+
+  // The driver state can't be shared, run a new utest_run for the test
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    for (size_t i = 0; i < vars.size(); ++i)
+      putenv(const_cast<char *>(vars[i].c_str()));
+    setenv("UTEST_CHILD", "1", 1);
+    execl("/proc/self/exe", "utest_run", "-c", utest.name, (char *)NULL);
+    perror("Could not run the test process");
+    _exit(127);
+  }
+  if (pid > 0)
+    waitpid(pid, &status, 0);
+  if (tmpDir[0])
+    nftw(tmpDir, removeTmpFile, 16, FTW_DEPTH | FTW_PHYS);
+
+  // The test prints its own result, unless it crashed
+  retStatistics.actualrun++;
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    retStatistics.passCount++;
+  else {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 1)
+      std::cout << utest.name << "()    [FAILED]" << std::endl;
+    retStatistics.failCount++;
+  }
+}
+
 void UTest::do_run(struct UTest utest){
+  if (utest.env != NULL && getenv("UTEST_CHILD") == NULL) {
+    do_run_child(utest);
+    return;
+  }
   // Print function name
   printf("%s()", utest.name);
   fflush(stdout);
   retStatistics.actualrun++;
   // Run one case in utestList, print result [SUCCESS] or [FAILED]
   (utest.fn)();
+  // Run for another process, which gets the result in the exit status
+  if (utest.env != NULL) {
+    fflush(stdout);
+    exit(retStatistics.failCount != 0);
+  }
 }
 
 void UTest::run(const char *name) {
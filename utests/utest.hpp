@@ -49,7 +49,8 @@ struct UTest
   /*! Empty test */
   UTest(void);
   /*! Build a new unit test and append it to the unit test list */
-  UTest(Function fn, const char *name, bool isBenchMark = false, bool haveIssue = false, bool needDestroyProgram = true);
+  UTest(Function fn, const char *name, bool isBenchMark = false, bool haveIssue = false, bool needDestroyProgram = true,
+        const char *env = NULL);
   /*! Function to execute */
   Function fn;
   /*! Name of the test */
@@ -62,6 +63,9 @@ struct UTest
   bool haveIssue;
   /*! Indicate whether destroy kernels/program. */
   bool needDestroyProgram;
+  /*! "NAME=value ..." to run the test in its own process with, %T in a value
+   *  is replaced by a temporary directory removed after the run */
+  const char *env;
   /*! The tests that are registered */
   static std::vector<UTest> *utestList;
   /*! Run the test with the given name */
@@ -84,6 +88,8 @@ struct UTest
   static RStatistics retStatistics;
   /*! Do run a test case actually */
   static void do_run(struct UTest utest);
+  /*! Run a test case with its environment in a new process */
+  static void do_run_child(struct UTest utest);
 };
 
 /*! Register a new unit test */
@@ -99,6 +105,12 @@ struct UTest
   static void __ANON__##FN##__(void) { UTEST_EXPECT_SUCCESS(FN()); } \
   static const UTest __##FN##__(__ANON__##FN##__, #FN);
 
+/*! Turn a function into a unit test run in its own process with the
+ *  variables of ENV set, as the ones the driver reads only once */
+#define MAKE_UTEST_FROM_FUNCTION_WITH_ENV(FN, ENV) \
+  static void __ANON__##FN##__(void) { UTEST_EXPECT_SUCCESS(FN()); } \
+  static const UTest __##FN##__(__ANON__##FN##__, #FN, false, false, true, ENV);
+
 /*! Register a test case which has issue to be fixed */
 #define MAKE_UTEST_FROM_FUNCTION_WITH_ISSUE(FN) \
   static void __ANON__##FN##__(void) { UTEST_EXPECT_SUCCESS(FN()); } \
@@ -29,6 +29,7 @@
 #include <cassert>
 #include <cmath>
 #include <algorithm>
+#include <sys/time.h>
 
 #define FATAL(...) \
 do { \
@@ -827,6 +828,38 @@ double time_subtract(struct timeval *y, struct timeval *x, struct timeval *resul
   return msec;
 }
 
+double time_loop_kernel(const char *file_name, const char *kernel_name,
+                        size_t global_size, size_t elem_size, cl_uint loop)
+{
+  struct timeval start,stop;
+  const size_t sz = global_size * elem_size;
+
+  OCL_CALL(cl_kernel_init, file_name, kernel_name, SOURCE, "");
+  OCL_CREATE_BUFFER(buf[0], 0, sz, NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, sz, NULL);
+
+  OCL_MAP_BUFFER(0);
+  for (size_t i = 0; i < sz; i++)
+    ((unsigned char*)buf_data[0])[i] = rand();
+  OCL_UNMAP_BUFFER(0);
+
+  globals[0] = global_size;
+  locals[0] = 64;
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(2, sizeof(cl_uint), &loop);
+
+  /* Warm up */
+  OCL_NDRANGE(1);
+  OCL_FINISH();
+
+  gettimeofday(&start,0);
+  OCL_NDRANGE(1);
+  OCL_FINISH();
+  gettimeofday(&stop,0);
+  return time_subtract(&stop, &start, 0);
+}
+
 float select_ulpsize(float ULPSIZE_FAST_MATH, float ULPSIZE_NO_FAST_MATH)
 {
   const char* env_strict = getenv("OCL_STRICT_CONFORMANCE");
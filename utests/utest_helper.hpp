@@ -291,6 +291,11 @@ extern int cl_INT_ULP(int int_number);
 /* subtract the time */
 double time_subtract(struct timeval *y, struct timeval *x, struct timeval *result);
 
+/* Run a kernel(src, dst, loop) with src in buf[0] filled with random bytes and
+ * dst in buf[1], once to warm up, and return the time of a second run in msec */
+double time_loop_kernel(const char *file_name, const char *kernel_name,
+                        size_t global_size, size_t elem_size, cl_uint loop);
+
 /* check ulpsize */
 float select_ulpsize(float ULPSIZE_FAST_MATH, float ULPSIZE_NO_FAST_MATH);
 